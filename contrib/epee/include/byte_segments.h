@@ -0,0 +1,130 @@
+// Copyright (c) 2018, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "span.h"
+
+namespace epee
+{
+  /*!
+    \brief Byte sequence made of owned bytes and references to external buffers.
+
+    Small writes are copied into an internal buffer, while `write_ref` only
+    records a pointer to memory owned elsewhere. Whoever owns that memory must
+    outlive this object; `add_owner` can be used to tie its lifetime to ours.
+    This lets a serializer emit framing bytes into a small buffer and reference
+    large blobs in place, so a message can be handed to a gather write without
+    being flattened first.
+   */
+  class byte_segments
+  {
+  public:
+    byte_segments(): m_size(0) {}
+
+    //! Copies `size` bytes into the owned buffer.
+    void write(const char* data, std::size_t size)
+    {
+      if (!size)
+        return;
+      if (m_segments.empty() || m_segments.back().ref || m_segments.back().offset + m_segments.back().size != m_owned.size())
+        m_segments.push_back({nullptr, m_owned.size(), 0});
+      m_owned.append(data, size);
+      m_segments.back().size += size;
+      m_size += size;
+    }
+
+    //! Records a reference to `size` bytes at `data` without copying them.
+    void write_ref(const char* data, std::size_t size)
+    {
+      if (!size)
+        return;
+      m_segments.push_back({data, 0, size});
+      m_size += size;
+    }
+
+    //! Keeps `owner` alive for as long as this object is.
+    void add_owner(std::shared_ptr<const void> owner)
+    {
+      m_owners.push_back(std::move(owner));
+    }
+
+    //! Appends the segments of `other` by reference and keeps it alive.
+    void append(std::shared_ptr<const byte_segments> other)
+    {
+      for (std::size_t i = 0; i < other->segment_count(); ++i)
+      {
+        const span<const std::uint8_t> s = other->segment(i);
+        write_ref(reinterpret_cast<const char*>(s.data()), s.size());
+      }
+      m_owners.push_back(std::move(other));
+    }
+
+    std::size_t size() const noexcept { return m_size; }
+    std::size_t segment_count() const noexcept { return m_segments.size(); }
+
+    span<const std::uint8_t> segment(std::size_t i) const noexcept
+    {
+      const segment_t& s = m_segments[i];
+      const char* data = s.ref ? s.ref : m_owned.data() + s.offset;
+      return {reinterpret_cast<const std::uint8_t*>(data), s.size};
+    }
+
+    //! \return A contiguous copy of all segments.
+    std::string str() const
+    {
+      std::string out;
+      out.reserve(m_size);
+      for (std::size_t i = 0; i < m_segments.size(); ++i)
+      {
+        const span<const std::uint8_t> s = segment(i);
+        out.append(reinterpret_cast<const char*>(s.data()), s.size());
+      }
+      return out;
+    }
+
+  private:
+    // owned segments are kept as offsets, since m_owned may reallocate
+    struct segment_t
+    {
+      const char* ref;
+      std::size_t offset;
+      std::size_t size;
+    };
+
+    std::string m_owned;
+    std::vector<segment_t> m_segments;
+    std::vector<std::shared_ptr<const void>> m_owners;
+    std::size_t m_size;
+  };
+}
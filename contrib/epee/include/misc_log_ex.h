@@ -36,14 +36,31 @@
 #define MAX_LOG_FILE_SIZE 104850000 // 100 MB - 7600 bytes
 #define MAX_LOG_FILES 50
 
-#define MCFATAL(cat,x) CLOG(FATAL,cat) << x
-#define MCERROR(cat,x) CLOG(ERROR,cat) << x
-#define MCWARNING(cat,x) CLOG(WARNING,cat) << x
-#define MCINFO(cat,x) CLOG(INFO,cat) << x
-#define MCDEBUG(cat,x) CLOG(DEBUG,cat) << x
-#define MCTRACE(cat,x) CLOG(TRACE,cat) << x
-#define MCLOG(level,cat,x) ELPP_WRITE_LOG(el::base::Writer, level, el::base::DispatchAction::NormalLog, cat) << x
-#define MCLOG_FILE(level,cat,x) ELPP_WRITE_LOG(el::base::Writer, level, el::base::DispatchAction::FileOnlyLog, cat) << x
+// The message is only built, and its arguments evaluated, if the line is
+// enabled for that category and level
+#define MCLOG_TYPE(level,cat,type,x) do { \
+    if (ELPP->vRegistry()->allowed(level, cat)) { \
+      ELPP_WRITE_LOG(el::base::Writer, level, type, cat) << x; \
+    } \
+  } while (0)
+
+#define MCFATAL(cat,x) MCLOG_TYPE(el::Level::Fatal,cat,el::base::DispatchAction::NormalLog,x)
+#define MCERROR(cat,x) MCLOG_TYPE(el::Level::Error,cat,el::base::DispatchAction::NormalLog,x)
+#define MCWARNING(cat,x) MCLOG_TYPE(el::Level::Warning,cat,el::base::DispatchAction::NormalLog,x)
+#define MCINFO(cat,x) MCLOG_TYPE(el::Level::Info,cat,el::base::DispatchAction::NormalLog,x)
+#define MCDEBUG(cat,x) MCLOG_TYPE(el::Level::Debug,cat,el::base::DispatchAction::NormalLog,x)
+#define MCTRACE(cat,x) MCLOG_TYPE(el::Level::Trace,cat,el::base::DispatchAction::NormalLog,x)
+#define MCLOG(level,cat,x) MCLOG_TYPE(level,cat,el::base::DispatchAction::NormalLog,x)
+#define MCLOG_FILE(level,cat,x) MCLOG_TYPE(level,cat,el::base::DispatchAction::FileOnlyLog,x)
+
+// Lines in code run per output or per signature, where even checking
+// whether a line is enabled (a lock and a category lookup) shows up, are
+// compiled out unless the build defines MONERO_HOT_PATH_LOGS
+#ifdef MONERO_HOT_PATH_LOGS
+#define MCLOG_HOT(level,cat,x) MCLOG(level,cat,x)
+#else
+#define MCLOG_HOT(level,cat,x) do { if (false) { MCLOG(level,cat,x); } } while (0)
+#endif
 
 #define MCLOG_COLOR(level,cat,color,x) MCLOG(level,cat,"\033[1;" color "m" << x << "\033[0m")
 #define MCLOG_RED(level,cat,x) MCLOG_COLOR(level,cat,"31",x)
@@ -67,6 +84,7 @@
 #define MDEBUG(x) MCDEBUG(MONERO_DEFAULT_LOG_CATEGORY,x)
 #define MTRACE(x) MCTRACE(MONERO_DEFAULT_LOG_CATEGORY,x)
 #define MLOG(level,x) MCLOG(level,MONERO_DEFAULT_LOG_CATEGORY,x)
+#define MLOG_HOT(level,x) MCLOG_HOT(level,MONERO_DEFAULT_LOG_CATEGORY,x)
 
 #define MGINFO(x) MCINFO("global",x)
 #define MGINFO_RED(x) MCLOG_RED(el::Level::Info, "global",x)
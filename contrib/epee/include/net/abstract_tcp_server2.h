@@ -118,11 +118,14 @@ namespace net_utils
   private:
     //----------------- i_service_endpoint ---------------------
     virtual bool do_send(const void* ptr, size_t cb); ///< (see do_send from i_service_endpoint)
+    virtual bool do_send(const std::shared_ptr<const byte_segments>& message); ///< gather-writes message without copying it
     virtual bool do_send_chunk(const void* ptr, size_t cb); ///< will send (or queue) a part of data
+    bool do_send_chunk(send_buffer&& chunk); ///< will send (or queue) an already built chunk
     virtual bool send_done();
     virtual bool close();
     virtual bool call_run_once_service_io();
     virtual bool request_callback();
+    virtual bool request_callback_when_sent();
     virtual boost::asio::io_service& get_io_service();
     virtual bool add_ref();
     virtual bool release();
@@ -171,6 +174,7 @@ namespace net_utils
     boost::asio::deadline_timer m_timer;
     bool m_local;
     bool m_ready_to_close;
+    bool m_callback_when_sent; // under m_send_que_lock
     std::string m_host;
 
 	public:
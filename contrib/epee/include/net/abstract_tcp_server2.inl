@@ -93,7 +93,8 @@ PRAGMA_WARNING_DISABLE_VS(4355)
 		m_throttle_speed_out("speed_out", "throttle_speed_out"),
 		m_timer(io_service),
 		m_local(false),
-		m_ready_to_close(false)
+		m_ready_to_close(false),
+		m_callback_when_sent(false)
   {
     MDEBUG("test, connection constructor set m_connection_type="<<m_connection_type);
   }
@@ -219,6 +220,26 @@ PRAGMA_WARNING_DISABLE_VS(4355)
   }
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
+  bool connection<t_protocol_handler>::request_callback_when_sent()
+  {
+    TRY_ENTRY();
+    auto self = safe_shared_from_this();
+    if(!self)
+      return false;
+
+    CRITICAL_REGION_BEGIN(m_send_que_lock);
+    if(!m_send_que.empty())
+    {
+      // handle_write fires it once the queue drains
+      m_callback_when_sent = true;
+      return true;
+    }
+    CRITICAL_REGION_END();
+    return request_callback();
+    CATCH_ENTRY_L0("connection<t_protocol_handler>::request_callback_when_sent()", false);
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
   boost::asio::io_service& connection<t_protocol_handler>::get_io_service()
   {
     return GET_IO_SERVICE(socket_);
@@ -490,9 +511,63 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send", false);
 	} // do_send()
 
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  bool connection<t_protocol_handler>::do_send(const std::shared_ptr<const byte_segments>& message)
+  {
+    TRY_ENTRY();
+
+    // Use safe_shared_from_this, because of this is public method and it can be called on the object being deleted
+    auto self = safe_shared_from_this();
+    if (!self) return false;
+    if (m_was_shutdown) return false;
+    CHECK_AND_ASSERT_MES(message, false, "Null message");
+
+    // same policy as the copying do_send: only messages over twice the chunk size are split
+    const size_t chunksize_good = 32 * 1024;
+    const bool allow_split = (m_connection_type == e_connection_type_RPC) ? false : true; // do not split RPC data
+    const size_t chunksize = (allow_split && message->size() > chunksize_good * 2) ? chunksize_good : message->size();
+
+    epee::critical_region_t<decltype(m_chunking_lock)> send_guard(m_chunking_lock); // *** critical ***
+    send_buffer chunk;
+    chunk.m_message = message;
+    for (size_t i = 0; i < message->segment_count(); ++i)
+    {
+      const span<const uint8_t> segment = message->segment(i);
+      size_t pos = 0;
+      while (pos < segment.size())
+      {
+        const size_t len = std::min(segment.size() - pos, chunksize - chunk.m_slices_size);
+        chunk.m_slices.push_back(boost::asio::buffer(segment.data() + pos, len));
+        chunk.m_slices_size += len;
+        pos += len;
+        if (chunk.m_slices_size == chunksize)
+        {
+          if (!do_send_chunk(std::move(chunk)))
+          {
+            MDEBUG("do_send() SEND was aborted in middle of big package - this is mostly harmless (e.g. peer closed connection)");
+            return false;
+          }
+          chunk = send_buffer();
+          chunk.m_message = message;
+        }
+      }
+    }
+    return chunk.m_slices_size ? do_send_chunk(std::move(chunk)) : true;
+
+    CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send", false);
+  }
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
   bool connection<t_protocol_handler>::do_send_chunk(const void* ptr, size_t cb)
+  {
+    send_buffer chunk;
+    chunk.m_owned.assign((const char*)ptr, cb);
+    return do_send_chunk(std::move(chunk));
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  bool connection<t_protocol_handler>::do_send_chunk(send_buffer&& chunk)
   {
     TRY_ENTRY();
     // Use safe_shared_from_this, because of this is public method and it can be called on the object being deleted
@@ -501,6 +576,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
       return false;
     if(m_was_shutdown)
       return false;
+    const size_t cb = chunk.size();
     {
 		CRITICAL_REGION_LOCAL(m_throttle_speed_out_mutex);
 		m_throttle_speed_out.handle_trafic_exact(cb);
@@ -543,8 +619,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
         }
     }
 
-    m_send_que.resize(m_send_que.size()+1);
-    m_send_que.back().assign((const char*)ptr, cb);
+    m_send_que.push_back(std::move(chunk));
     
     if(m_send_que.size() > 1)
     { // active operation should be in progress, nothing to do, just wait last operation callback
@@ -566,11 +641,11 @@ PRAGMA_WARNING_DISABLE_VS(4355)
         auto size_now = m_send_que.front().size();
         MDEBUG("do_send_chunk() NOW SENSD: packet="<<size_now<<" B");
         if (speed_limit_is_enabled())
-			do_send_handler_write( ptr , size_now ); // (((H)))
+			do_send_handler_write( nullptr , size_now ); // (((H)))
 
         CHECK_AND_ASSERT_MES( size_now == m_send_que.front().size(), false, "Unexpected queue size");
         reset_timer(get_default_timeout(), false);
-        boost::asio::async_write(socket_, boost::asio::buffer(m_send_que.front().data(), size_now ) ,
+        boost::asio::async_write(socket_, m_send_que.front().get_buffers(),
                                  //strand_.wrap(
                                  boost::bind(&connection<t_protocol_handler>::handle_write, self, _1, _2)
                                  //)
@@ -580,8 +655,6 @@ PRAGMA_WARNING_DISABLE_VS(4355)
         //_info("[sock " << socket_.native_handle() << "] Async send requested " << m_send_que.front().size());
     }
     
-    //do_send_handler_stop( ptr , cb ); // empty function
-
     return true;
 
     CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send_chunk", false);
@@ -731,6 +804,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
 		}
 
     bool do_shutdown = false;
+    bool do_callback = false;
     CRITICAL_REGION_BEGIN(m_send_que_lock);
     if(m_send_que.empty())
     {
@@ -745,6 +819,8 @@ PRAGMA_WARNING_DISABLE_VS(4355)
       {
         do_shutdown = true;
       }
+      do_callback = m_callback_when_sent;
+      m_callback_when_sent = false;
     }else
     {
       //have more data to send
@@ -754,7 +830,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
 		if (speed_limit_is_enabled())
 			do_send_handler_write_from_queue(e, m_send_que.front().size() , m_send_que.size()); // (((H)))
 		CHECK_AND_ASSERT_MES( size_now == m_send_que.front().size(), void(), "Unexpected queue size");
-		boost::asio::async_write(socket_, boost::asio::buffer(m_send_que.front().data(), size_now) , 
+		boost::asio::async_write(socket_, m_send_que.front().get_buffers(),
         // strand_.wrap(
           boost::bind(&connection<t_protocol_handler>::handle_write, connection<t_protocol_handler>::shared_from_this(), _1, _2)
 				// )
@@ -767,6 +843,10 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     {
       shutdown();
     }
+    else if(do_callback)
+    {
+      request_callback();
+    }
     CATCH_ENTRY_L0("connection<t_protocol_handler>::handle_write", void());
   }
 
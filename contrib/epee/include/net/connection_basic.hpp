@@ -82,6 +82,25 @@ class connection_basic_pimpl; // PIMPL for this class
   
   std::string to_string(t_connection_type type);
 
+  /// One queued write: either an owned copy of the data, or slices of a shared message
+  struct send_buffer
+  {
+    std::string m_owned;
+    std::shared_ptr<const byte_segments> m_message; // keeps m_slices alive
+    std::vector<boost::asio::const_buffer> m_slices;
+    size_t m_slices_size;
+
+    send_buffer(): m_slices_size(0) {}
+
+    size_t size() const { return m_message ? m_slices_size : m_owned.size(); }
+    std::vector<boost::asio::const_buffer> get_buffers() const
+    {
+      if (!m_message)
+        return std::vector<boost::asio::const_buffer>(1, boost::asio::buffer(m_owned));
+      return m_slices;
+    }
+  };
+
 class connection_basic { // not-templated base class for rapid developmet of some code parts
 	public:
 		std::unique_ptr< connection_basic_pimpl > mI; // my Implementation
@@ -90,7 +109,7 @@ class connection_basic { // not-templated base class for rapid developmet of som
     volatile uint32_t m_want_close_connection;
     std::atomic<bool> m_was_shutdown;
     critical_section m_send_que_lock;
-    std::list<std::string> m_send_que;
+    std::list<send_buffer> m_send_que;
     volatile bool m_is_multithreaded;
     double m_start_time;
     /// Strand to ensure the connection's handlers are not called concurrently.
@@ -30,6 +30,7 @@
 #include <boost/lexical_cast.hpp>
 #include <boost/regex.hpp>
 #include <boost/utility/string_ref.hpp>
+#include <functional>
 #include <string>
 #include <utility>
 
@@ -190,6 +191,7 @@ namespace net_utils
 			std::string			m_response_comment;
 			fields_list	        m_additional_fields;
 			std::string			m_body;
+			std::function<bool(std::string&)> m_body_stream;// server only: if set, the body is sent chunked, a piece per call, until an empty one
 			std::string			m_mime_tipe;
 			http_header_info    m_header_info;
 			int                 m_http_ver_hi;// OUT paramter only
@@ -274,6 +274,7 @@ namespace net_utils
 			reciev_machine_state m_state;
 			chunked_state m_chunked_state;
 			std::string m_chunked_cache;
+			std::function<bool(std::string&)> m_body_handler;
 			critical_section m_lock;
 			bool m_ssl;
 
@@ -292,6 +293,7 @@ namespace net_utils
 				, m_state()
 				, m_chunked_state()
 				, m_chunked_cache()
+				, m_body_handler()
 				, m_lock()
 				, m_ssl(false)
 			{}
@@ -339,6 +341,8 @@ namespace net_utils
 			virtual bool handle_target_data(std::string& piece_of_transfer)
 			{
 				CRITICAL_REGION_LOCAL(m_lock);
+				if(m_body_handler && m_response_info.m_response_code == 200)
+					return m_body_handler(piece_of_transfer);
 				m_response_info.m_body += piece_of_transfer;
         piece_of_transfer.clear();
 				return true;
@@ -425,6 +429,37 @@ namespace net_utils
 				return false;
 			}
 			//---------------------------------------------------------------------------
+			//like invoke, but the body of a successful response is handed to body_handler as it comes in, rather than kept in m_body
+			inline bool invoke_stream(const boost::string_ref uri, const boost::string_ref method, const std::string& body, std::chrono::milliseconds timeout, const std::function<bool(std::string&)>& body_handler, const http_response_info** ppresponse_info = NULL, const fields_list& additional_params = fields_list())
+			{
+				CRITICAL_REGION_LOCAL(m_lock);
+				bool handler_ok = true;
+				m_body_handler = [&](std::string& piece_of_transfer) {
+					handler_ok = handler_ok && body_handler(piece_of_transfer);
+					piece_of_transfer.clear();
+					return handler_ok;
+				};
+				bool res = false;
+				try
+				{
+					res = invoke(uri, method, body, timeout, ppresponse_info, additional_params);
+				}
+				catch (...)
+				{
+					m_body_handler = nullptr;
+					disconnect();
+					throw;
+				}
+				m_body_handler = nullptr;
+				if(!handler_ok)
+				{
+					//the rest of the body may still be on the wire
+					disconnect();
+					return false;
+				}
+				return res;
+			}
+			//---------------------------------------------------------------------------
 			inline bool invoke_post(const boost::string_ref uri, const std::string& body, std::chrono::milliseconds timeout, const http_response_info** ppresponse_info = NULL, const fields_list& additional_params = fields_list())
 			{
 				CRITICAL_REGION_LOCAL(m_lock);
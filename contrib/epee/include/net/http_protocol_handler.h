@@ -92,6 +92,7 @@ namespace net_utils
 			}
 			virtual bool handle_recv(const void* ptr, size_t cb);
 			virtual bool handle_request(const http::http_request_info& query_info, http_response_info& response);
+			void handle_qued_callback();
 
 		private:
 			enum machine_state{
@@ -128,6 +129,7 @@ namespace net_utils
 
 			//major function 
 			inline bool handle_request_and_send_response(const http::http_request_info& query_info);
+			bool send_body_stream_piece();
 
 
 			std::string get_not_found_response_body(const std::string& URI);
@@ -142,6 +144,7 @@ namespace net_utils
 			config_type& m_config;
 			bool m_want_close;
 			size_t m_newlines;
+			std::function<bool(std::string&)> m_body_stream;
 		protected:
 			i_service_endpoint* m_psnd_hndlr; 
 			t_connection_context& m_conn_context;
@@ -209,8 +212,6 @@ namespace net_utils
 			{
 				return m_config.m_phandler->deinit_server_thread();
 			}
-			void handle_qued_callback()
-			{}
 			bool after_init_connection()
 			{
 				return true;
@@ -27,6 +27,8 @@
 
 #include <boost/regex.hpp>
 #include <boost/lexical_cast.hpp>
+#include <sstream>
+#include "byte_segments.h"
 #include "http_protocol_handler.h"
 #include "reg_exp_definer.h"
 #include "string_tools.h"
@@ -226,12 +228,19 @@ namespace net_utils
   template<class t_connection_context>
 	bool simple_http_connection_handler<t_connection_context>::handle_recv(const void* ptr, size_t cb)
 	{
+		if(m_body_stream)
+		{
+			//a response is still being streamed, the next request waits for it
+			m_cache.append((const char*)ptr, cb);
+			return true;
+		}
+
 		std::string buf((const char*)ptr, cb);
 		//LOG_PRINT_L0("HTTP_RECV: " << ptr << "\r\n" << buf);
 		//file_io_utils::save_string_to_file(string_tools::get_current_module_folder() + "/" + boost::lexical_cast<std::string>(ptr), std::string((const char*)ptr, cb));
 
 		bool res = handle_buff_in(buf);
-		if(m_want_close/*m_state == http_state_connection_close || m_state == http_state_error*/)
+		if(m_want_close/*m_state == http_state_connection_close || m_state == http_state_error*/ && !m_body_stream)
 			return false;
 		return res;
 	}
@@ -318,7 +327,7 @@ namespace net_utils
 				return false;
 			}
 
-			if(!m_cache.size())
+			if(!m_cache.size() || m_body_stream)
 				m_is_stop_handling = true;
 		}
 
@@ -589,12 +598,79 @@ namespace net_utils
     LOG_PRINT_L3("HTTP_RESPONSE_HEAD: << \r\n" << response_data);
 		
 		m_psnd_hndlr->do_send((void*)response_data.data(), response_data.size());
+		if (response.m_body_stream && query_info.m_http_method != http::http_method_head && query_info.m_http_method != http::http_method_options)
+		{
+			//the rest is sent piece by piece, each once the previous one is out
+			m_body_stream = std::move(response.m_body_stream);
+			return send_body_stream_piece() && res;
+		}
 		if ((response.m_body.size() && (query_info.m_http_method != http::http_method_head)) || (query_info.m_http_method == http::http_method_options))
 			m_psnd_hndlr->do_send((void*)response.m_body.data(), response.m_body.size());
 		m_psnd_hndlr->send_done();
 		return res;
 	}
 	//-----------------------------------------------------------------------------------
+  template<class t_connection_context>
+	bool simple_http_connection_handler<t_connection_context>::send_body_stream_piece()
+	{
+		std::shared_ptr<std::string> piece = std::make_shared<std::string>();
+		bool res = false;
+		try
+		{
+			res = m_body_stream(*piece);
+		}
+		catch (const std::exception &e)
+		{
+			LOG_ERROR_CC(m_conn_context, "Exception while producing response body: " << e.what());
+		}
+		if (!res)
+		{
+			//nothing to tell the client this late but to cut the body short
+			LOG_ERROR_CC(m_conn_context, "Failed to produce response body, closing connection");
+			m_body_stream = nullptr;
+			m_want_close = true;
+			m_psnd_hndlr->close();
+			return false;
+		}
+
+		std::shared_ptr<byte_segments> chunk = std::make_shared<byte_segments>();
+		std::stringstream chunk_head;
+		chunk_head << std::hex << piece->size() << "\r\n";
+		const std::string head = chunk_head.str();
+		chunk->write(head.data(), head.size());
+		chunk->write_ref(piece->data(), piece->size());
+		chunk->add_owner(piece);
+		chunk->write("\r\n", 2);
+		if (!m_psnd_hndlr->do_send(std::shared_ptr<const byte_segments>(std::move(chunk))))
+		{
+			m_body_stream = nullptr;
+			return false;
+		}
+
+		if (!piece->empty())
+			return m_psnd_hndlr->request_callback_when_sent();
+
+		m_body_stream = nullptr;
+		m_psnd_hndlr->send_done();
+		if (m_want_close)
+			return m_psnd_hndlr->close();
+		if (m_cache.size())
+		{
+			//requests which came in meanwhile
+			std::string buf;
+			if (!handle_buff_in(buf) || (m_want_close && !m_body_stream))
+				return m_psnd_hndlr->close();
+		}
+		return true;
+	}
+	//-----------------------------------------------------------------------------------
+  template<class t_connection_context>
+	void simple_http_connection_handler<t_connection_context>::handle_qued_callback()
+	{
+		if (m_body_stream)
+			send_body_stream_piece();
+	}
+	//-----------------------------------------------------------------------------------
   template<class t_connection_context>
 	bool simple_http_connection_handler<t_connection_context>::handle_request(const http::http_request_info& query_info, http_response_info& response)
 	{
@@ -630,9 +706,11 @@ namespace net_utils
 	{
 		std::string buf = "HTTP/1.1 ";
 		buf += boost::lexical_cast<std::string>(response.m_response_code) + " " + response.m_response_comment + "\r\n" +
-			"Server: Epee-based\r\n"
-			"Content-Length: ";
-		buf += boost::lexical_cast<std::string>(response.m_body.size()) + "\r\n";
+			"Server: Epee-based\r\n";
+		if(response.m_body_stream)
+			buf += "Transfer-Encoding: chunked\r\n";
+		else
+			buf += "Content-Length: " + boost::lexical_cast<std::string>(response.m_body.size()) + "\r\n";
 
 		if(!response.m_mime_tipe.empty())
 		{
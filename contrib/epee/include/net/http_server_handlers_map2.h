@@ -110,6 +110,73 @@
       MDEBUG( s_pattern << "() processed with " << ticks1-ticks << "/"<< ticks2-ticks1 << "/" << ticks3-ticks2 << "ms"); \
     }
 
+//like MAP_URI_AUTO_BIN2, but the callback may set the body itself, e.g. from pre-packed entries
+#define MAP_URI_AUTO_BIN_PACKED2(s_pattern, callback_f, command_type) \
+    else if(query_info.m_URI == s_pattern) \
+    { \
+      handled = true; \
+      uint64_t ticks = misc_utils::get_tick_count(); \
+      boost::value_initialized<command_type::request> req; \
+      bool parse_res = epee::serialization::load_t_from_binary(static_cast<command_type::request&>(req), query_info.m_body); \
+      CHECK_AND_ASSERT_MES(parse_res, false, "Failed to parse bin body data, body size=" << query_info.m_body.size()); \
+      uint64_t ticks1 = misc_utils::get_tick_count(); \
+      boost::value_initialized<command_type::response> resp;\
+      response_info.m_body.clear(); \
+      if(!callback_f(static_cast<command_type::request&>(req), static_cast<command_type::response&>(resp), response_info.m_body)) \
+      { \
+        LOG_ERROR("Failed to " << #callback_f << "()"); \
+        response_info.m_response_code = 500; \
+        response_info.m_response_comment = "Internal Server Error"; \
+        return true; \
+      } \
+      uint64_t ticks2 = misc_utils::get_tick_count(); \
+      if(response_info.m_body.empty()) \
+        epee::serialization::store_t_to_binary(static_cast<command_type::response&>(resp), response_info.m_body); \
+      uint64_t ticks3 = epee::misc_utils::get_tick_count(); \
+      response_info.m_mime_tipe = " application/octet-stream"; \
+      response_info.m_header_info.m_content_type = " application/octet-stream"; \
+      MDEBUG( s_pattern << "() processed with " << ticks1-ticks << "/"<< ticks2-ticks1 << "/" << ticks3-ticks2 << "ms"); \
+    }
+
+//the response is a stream of framed command_type::response messages: the callback either fills resp,
+//sent as the only one, or sets next_page, called for each message as the previous one is sent until it returns false
+#define MAP_URI_AUTO_BIN_STREAM2(s_pattern, callback_f, command_type) \
+    else if(query_info.m_URI == s_pattern) \
+    { \
+      handled = true; \
+      uint64_t ticks = misc_utils::get_tick_count(); \
+      boost::value_initialized<command_type::request> req; \
+      bool parse_res = epee::serialization::load_t_from_binary(static_cast<command_type::request&>(req), query_info.m_body); \
+      CHECK_AND_ASSERT_MES(parse_res, false, "Failed to parse bin body data, body size=" << query_info.m_body.size()); \
+      uint64_t ticks1 = misc_utils::get_tick_count(); \
+      boost::value_initialized<command_type::response> resp;\
+      std::function<bool(command_type::response&)> next_page; \
+      if(!callback_f(static_cast<command_type::request&>(req), static_cast<command_type::response&>(resp), next_page)) \
+      { \
+        LOG_ERROR("Failed to " << #callback_f << "()"); \
+        response_info.m_response_code = 500; \
+        response_info.m_response_comment = "Internal Server Error"; \
+        return true; \
+      } \
+      uint64_t ticks2 = misc_utils::get_tick_count(); \
+      if(next_page) \
+      { \
+        response_info.m_body_stream = [next_page](std::string& piece) mutable -> bool \
+        { \
+          boost::value_initialized<command_type::response> page; \
+          if(!next_page(static_cast<command_type::response&>(page))) \
+            return true; \
+          return epee::serialization::store_t_to_binary_frame(static_cast<command_type::response&>(page), piece); \
+        }; \
+      } \
+      else \
+        epee::serialization::store_t_to_binary_frame(static_cast<command_type::response&>(resp), response_info.m_body); \
+      uint64_t ticks3 = epee::misc_utils::get_tick_count(); \
+      response_info.m_mime_tipe = " application/octet-stream"; \
+      response_info.m_header_info.m_content_type = " application/octet-stream"; \
+      MDEBUG( s_pattern << "() processed with " << ticks1-ticks << "/"<< ticks2-ticks1 << "/" << ticks3-ticks2 << "ms"); \
+    }
+
 #define CHAIN_URI_MAP2(callback) else {callback(query_info, response_info, m_conn_context);handled = true;}
 
 #define END_URI_MAP2() return handled;}
@@ -31,8 +31,10 @@
 
 #include <boost/uuid/uuid.hpp>
 #include <boost/asio/io_service.hpp>
+#include <memory>
 #include <typeinfo>
 #include <type_traits>
+#include "byte_segments.h"
 #include "serialization/keyvalue_serialization.h"
 #include "misc_log_ex.h"
 
@@ -280,10 +282,18 @@ namespace net_utils
 	struct i_service_endpoint
 	{
 		virtual bool do_send(const void* ptr, size_t cb)=0;
+    //endpoints able to gather-write override this; by default the message is flattened
+    virtual bool do_send(const std::shared_ptr<const byte_segments>& message)
+    {
+      const std::string buff = message->str();
+      return do_send(buff.data(), buff.size());
+    }
     virtual bool close()=0;
     virtual bool send_done()=0;
     virtual bool call_run_once_service_io()=0;
     virtual bool request_callback()=0;
+    //like request_callback, but waits until everything queued so far has been sent
+    virtual bool request_callback_when_sent() { return request_callback(); }
     virtual boost::asio::io_service& get_io_service()=0;
     //protect from deletion connection object(with protocol instance) during external call "invoke"
     virtual bool add_ref()=0;
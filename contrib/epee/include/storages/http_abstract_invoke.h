@@ -28,6 +28,7 @@
 #pragma once
 #include <boost/utility/string_ref.hpp>
 #include <chrono>
+#include <functional>
 #include <string>
 #include "portable_storage_template_helper.h"
 #include "net/http_base.h"
@@ -100,6 +101,59 @@ namespace epee
       return serialization::load_t_from_binary(result_struct, pri->m_body);
     }
 
+    //the response is a stream of framed t_response messages, each handed to page_handler as soon as it is read
+    template<class t_request, class t_response, class t_transport>
+    bool invoke_http_bin_stream(const boost::string_ref uri, const t_request& out_struct, const std::function<bool(t_response&)>& page_handler, t_transport& transport, std::chrono::milliseconds timeout = std::chrono::seconds(15), const boost::string_ref method = "GET")
+    {
+      std::string req_param;
+      if(!serialization::store_t_to_binary(out_struct, req_param))
+        return false;
+
+      std::string pending, frame;
+      const auto body_handler = [&](std::string& piece) -> bool
+      {
+        pending += piece;
+        while(serialization::take_binary_frame(pending, frame))
+        {
+          t_response page = AUTO_VAL_INIT(page);
+          if(!serialization::load_t_from_binary(page, frame))
+          {
+            LOG_PRINT_L1("Failed to parse message streamed from " << uri);
+            return false;
+          }
+          if(!page_handler(page))
+            return false;
+        }
+        return true;
+      };
+
+      const http::http_response_info* pri = NULL;
+      if(!transport.invoke_stream(uri, method, req_param, timeout, body_handler, std::addressof(pri)))
+      {
+        LOG_PRINT_L1("Failed to invoke http request to  " << uri);
+        return false;
+      }
+
+      if(!pri)
+      {
+        LOG_PRINT_L1("Failed to invoke http request to  " << uri << ", internal error (null response ptr)");
+        return false;
+      }
+
+      if(pri->m_response_code != 200)
+      {
+        LOG_PRINT_L1("Failed to invoke http request to  " << uri << ", wrong response code: " << pri->m_response_code);
+        return false;
+      }
+
+      if(!pending.empty())
+      {
+        LOG_PRINT_L1("Truncated message streamed from " << uri);
+        return false;
+      }
+      return true;
+    }
+
     template<class t_request, class t_response, class t_transport>
     bool invoke_http_json_rpc(const boost::string_ref uri, std::string method_name, const t_request& out_struct, t_response& result_struct, t_transport& transport, std::chrono::milliseconds timeout = std::chrono::seconds(15), const boost::string_ref http_method = "GET", const std::string& req_id = "0")
     {
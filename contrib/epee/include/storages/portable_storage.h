@@ -80,6 +80,13 @@ namespace epee
 
       //-------------------------------------------------------------------------------
       bool		store_to_binary(binarybuffer& target);
+      //blobs are referenced, not copied: this storage must outlive target
+      bool		store_to_binary(byte_segments& target);
+      //root entries only, with no header nor count, to be spliced into another storage by the overloads below
+      bool		store_entries_to_binary(binarybuffer& target, size_t& count);
+      //raw_entries come first and must not share names with this storage's own root entries
+      bool		store_to_binary(binarybuffer& target, const binarybuffer& raw_entries, size_t raw_count);
+      bool		store_to_binary(byte_segments& target, const std::shared_ptr<const binarybuffer>& raw_entries, size_t raw_count);
       bool		load_from_binary(const binarybuffer& target);
       template<class trace_policy>
       bool		  dump_as_xml(std::string& targetObj, const std::string& root_name = "");
@@ -133,14 +140,71 @@ namespace epee
     bool portable_storage::store_to_binary(binarybuffer& target)
     {
       TRY_ENTRY();
-      std::stringstream ss;
+      target.clear();
+      string_append_stream ss{target};
       storage_block_header sbh = AUTO_VAL_INIT(sbh);
       sbh.m_signature_a = PORTABLE_STORAGE_SIGNATUREA;
       sbh.m_signature_b = PORTABLE_STORAGE_SIGNATUREB;
       sbh.m_ver = PORTABLE_STORAGE_FORMAT_VER;
       ss.write((const char*)&sbh, sizeof(storage_block_header));
       pack_entry_to_buff(ss, m_root);
-      target = ss.str();
+      return true;
+      CATCH_ENTRY("portable_storage::store_to_binary", false)
+    }
+    inline
+    bool portable_storage::store_to_binary(byte_segments& target)
+    {
+      TRY_ENTRY();
+      storage_block_header sbh = AUTO_VAL_INIT(sbh);
+      sbh.m_signature_a = PORTABLE_STORAGE_SIGNATUREA;
+      sbh.m_signature_b = PORTABLE_STORAGE_SIGNATUREB;
+      sbh.m_ver = PORTABLE_STORAGE_FORMAT_VER;
+      target.write((const char*)&sbh, sizeof(storage_block_header));
+      pack_entry_to_buff(target, m_root);
+      return true;
+      CATCH_ENTRY("portable_storage::store_to_binary", false)
+    }
+    inline
+    bool portable_storage::store_entries_to_binary(binarybuffer& target, size_t& count)
+    {
+      TRY_ENTRY();
+      target.clear();
+      string_append_stream ss{target};
+      pack_section_entries(ss, m_root);
+      count = m_root.m_entries.size();
+      return true;
+      CATCH_ENTRY("portable_storage::store_entries_to_binary", false)
+    }
+    inline
+    bool portable_storage::store_to_binary(binarybuffer& target, const binarybuffer& raw_entries, size_t raw_count)
+    {
+      TRY_ENTRY();
+      target.clear();
+      string_append_stream ss{target};
+      storage_block_header sbh = AUTO_VAL_INIT(sbh);
+      sbh.m_signature_a = PORTABLE_STORAGE_SIGNATUREA;
+      sbh.m_signature_b = PORTABLE_STORAGE_SIGNATUREB;
+      sbh.m_ver = PORTABLE_STORAGE_FORMAT_VER;
+      ss.write((const char*)&sbh, sizeof(storage_block_header));
+      pack_varint(ss, m_root.m_entries.size() + raw_count);
+      ss.write(raw_entries.data(), raw_entries.size());
+      pack_section_entries(ss, m_root);
+      return true;
+      CATCH_ENTRY("portable_storage::store_to_binary", false)
+    }
+    inline
+    bool portable_storage::store_to_binary(byte_segments& target, const std::shared_ptr<const binarybuffer>& raw_entries, size_t raw_count)
+    {
+      TRY_ENTRY();
+      storage_block_header sbh = AUTO_VAL_INIT(sbh);
+      sbh.m_signature_a = PORTABLE_STORAGE_SIGNATUREA;
+      sbh.m_signature_b = PORTABLE_STORAGE_SIGNATUREB;
+      sbh.m_ver = PORTABLE_STORAGE_FORMAT_VER;
+      target.write((const char*)&sbh, sizeof(storage_block_header));
+      pack_varint(target, m_root.m_entries.size() + raw_count);
+      target.write_ref(raw_entries->data(), raw_entries->size());
+      target.add_owner(raw_entries);
+      pack_section_entries(target, m_root);
       return true;
       CATCH_ENTRY("portable_storage::store_to_binary", false)
     }
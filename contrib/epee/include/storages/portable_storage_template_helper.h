@@ -26,6 +26,7 @@
 
 #pragma once
 
+#include <memory>
 #include <string>
 
 #include "parserse_base_utils.h"
@@ -119,5 +120,76 @@ namespace epee
       store_t_to_binary(str_in, binary_buff, indent);
       return binary_buff;
     }
+    //-----------------------------------------------------------------------------------------------------------
+    //large blobs are referenced from the storage, which the returned buffer keeps alive
+    template<class t_struct>
+    std::shared_ptr<const byte_segments> store_t_to_segments(t_struct& str_in)
+    {
+      std::shared_ptr<portable_storage> ps = std::make_shared<portable_storage>();
+      str_in.store(*ps);
+      std::shared_ptr<byte_segments> segments = std::make_shared<byte_segments>();
+      if(!ps->store_to_binary(*segments))
+        return nullptr;
+      segments->add_owner(ps);
+      return segments;
+    }
+    //-----------------------------------------------------------------------------------------------------------
+    //messages streamed back to back are each prefixed with their size, as 4 bytes little endian
+    template<class t_struct>
+    bool store_t_to_binary_frame(t_struct& str_in, std::string& binary_buff)
+    {
+      std::string blob;
+      if(!store_t_to_binary(str_in, blob) || blob.size() > 0xffffffff)
+        return false;
+      const uint32_t size = blob.size();
+      for(size_t i = 0; i < 4; ++i)
+        binary_buff.push_back((char)((size >> (8 * i)) & 0xff));
+      binary_buff += blob;
+      return true;
+    }
+    //-----------------------------------------------------------------------------------------------------------
+    //moves the first complete frame out of binary_buff, if there is one yet
+    inline bool take_binary_frame(std::string& binary_buff, std::string& frame)
+    {
+      if(binary_buff.size() < 4)
+        return false;
+      uint32_t size = 0;
+      for(size_t i = 0; i < 4; ++i)
+        size |= (uint32_t)(uint8_t)binary_buff[i] << (8 * i);
+      if(binary_buff.size() - 4 < size)
+        return false;
+      frame.assign(binary_buff, 4, size);
+      binary_buff.erase(0, 4 + (size_t)size);
+      return true;
+    }
+    //-----------------------------------------------------------------------------------------------------------
+    template<class t_struct>
+    bool store_t_entries_to_binary(t_struct& str_in, std::string& binary_buff, size_t& count)
+    {
+      portable_storage ps;
+      str_in.store(ps);
+      return ps.store_entries_to_binary(binary_buff, count);
+    }
+    //-----------------------------------------------------------------------------------------------------------
+    //raw_entries, as packed by store_t_entries_to_binary, are added to the fields of str_in
+    template<class t_struct>
+    bool store_t_to_binary(t_struct& str_in, std::string& binary_buff, const std::string& raw_entries, size_t raw_count)
+    {
+      portable_storage ps;
+      str_in.store(ps);
+      return ps.store_to_binary(binary_buff, raw_entries, raw_count);
+    }
+    //-----------------------------------------------------------------------------------------------------------
+    template<class t_struct>
+    std::shared_ptr<const byte_segments> store_t_to_segments(t_struct& str_in, const std::shared_ptr<const std::string>& raw_entries, size_t raw_count)
+    {
+      std::shared_ptr<portable_storage> ps = std::make_shared<portable_storage>();
+      str_in.store(*ps);
+      std::shared_ptr<byte_segments> segments = std::make_shared<byte_segments>();
+      if(!ps->store_to_binary(*segments, raw_entries, raw_count))
+        return nullptr;
+      segments->add_owner(ps);
+      return segments;
+    }
   }
 }
@@ -30,8 +30,12 @@
 
 #include "pragma_comp_defs.h"
 #include "misc_language.h"
+#include "byte_segments.h"
 #include "portable_storage_base.h"
 
+//strings of at least this size are referenced instead of copied when packing into byte_segments
+#define PORTABLE_STORAGE_MIN_REF_STRING_SIZE   1024
+
 namespace epee
 {
   namespace serialization
@@ -82,6 +86,24 @@ namespace epee
       return true;
     }
 
+    inline
+    bool put_string(byte_segments& strm, const std::string& v)
+    {
+      pack_varint(strm, v.size());
+      if(v.size() >= PORTABLE_STORAGE_MIN_REF_STRING_SIZE)
+        strm.write_ref(v.data(), v.size());
+      else if(v.size())
+        strm.write(v.data(), v.size());
+      return true;
+    }
+
+    //lets the packers append straight into a std::string, without going through a stringstream
+    struct string_append_stream
+    {
+      std::string& m_str;
+      void write(const char* data, size_t size) { m_str.append(data, size); }
+    };
+
     template<class t_stream>
     struct array_entry_store_visitor: public boost::static_visitor<bool>
     {
@@ -198,10 +220,9 @@ namespace epee
     }
 
     template<class t_stream>
-    bool pack_entry_to_buff(t_stream& strm, const section& sec)
+    bool pack_section_entries(t_stream& strm, const section& sec)
     {
       typedef std::map<std::string, storage_entry>::value_type section_pair;
-      pack_varint(strm, sec.m_entries.size());
       for(const section_pair& se: sec.m_entries)
       {
         CHECK_AND_ASSERT_THROW_MES(se.first.size() < std::numeric_limits<uint8_t>::max(), "storage_entry_name is too long: " << se.first.size() << ", val: " << se.first);
@@ -212,5 +233,12 @@ namespace epee
       }
       return true;
     }
+
+    template<class t_stream>
+    bool pack_entry_to_buff(t_stream& strm, const section& sec)
+    {
+      pack_varint(strm, sec.m_entries.size());
+      return pack_section_entries(strm, sec);
+    }
   }
 }
@@ -343,6 +343,14 @@ transaction BlockchainDB::get_tx(const crypto::hash& h) const
   return tx;
 }
 
+size_t BlockchainDB::get_output_keys_sorted(uint64_t amount, const uint64_t *offsets, size_t count, output_data_t *outputs)
+{
+  std::vector<output_data_t> found;
+  get_output_key(amount, std::vector<uint64_t>(offsets, offsets + count), found, true);
+  std::copy(found.begin(), found.end(), outputs);
+  return found.size();
+}
+
 void BlockchainDB::reset_stats()
 {
   num_calls = 0;
@@ -1342,6 +1342,26 @@ public:
    * @param outputs return-by-reference a list of outputs' metadata
    */
   virtual void get_output_key(const uint64_t &amount, const std::vector<uint64_t> &offsets, std::vector<output_data_t> &outputs, bool allow_partial = false) = 0;
+
+  /**
+   * @brief gets outputs' data for a sorted list of indices
+   *
+   * Like get_output_key with allow_partial set, but the offsets must be
+   * sorted in increasing order and free of duplicates, which lets the
+   * subclass walk its output table forward instead of looking up each
+   * output from scratch. Results are written to the caller's buffer so
+   * a bulk caller can keep them all in one place.
+   *
+   * Lookup stops at the first output which does not exist.
+   *
+   * @param amount an output amount
+   * @param offsets sorted amount-specific output indices
+   * @param count the number of offsets
+   * @param outputs room for count outputs' metadata
+   *
+   * @return the number of outputs found
+   */
+  virtual size_t get_output_keys_sorted(uint64_t amount, const uint64_t *offsets, size_t count, output_data_t *outputs);
   
   /*
    * FIXME: Need to check with git blame and ask what this does to
@@ -1575,6 +1595,16 @@ public:
 
   virtual bool get_output_distribution(uint64_t amount, uint64_t from_height, uint64_t to_height, std::vector<uint64_t> &distribution, uint64_t &base) const = 0;
 
+  /**
+   * @brief get how well key blobs are shared between stored transactions
+   *
+   * @param unique_keys return-by-reference the number of distinct keys stored
+   * @param key_references return-by-reference the number of keys the stored transactions carry
+   *
+   * @return false if the backend does not share keys between transactions
+   */
+  virtual bool get_tx_key_stats(uint64_t &unique_keys, uint64_t &key_references) const = 0;
+
   /**
    * @brief is BlockchainDB in read-only mode?
    *
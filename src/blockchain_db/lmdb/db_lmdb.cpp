@@ -38,6 +38,7 @@
 #include "string_tools.h"
 #include "file_io_utils.h"
 #include "common/util.h"
+#include "common/varint.h"
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "crypto/crypto.h"
 #include "profile_tools.h"
@@ -55,7 +56,7 @@ using epee::string_tools::pod_to_hex;
 using namespace crypto;
 
 // Increase when the DB structure changes
-#define VERSION 4
+#define VERSION 7
 
 namespace
 {
@@ -165,16 +166,19 @@ int compare_string(const MDB_val *a, const MDB_val *b)
  * block_heights    block hash   block height
  * block_info       block ID     {block metadata}
  *
- * txs_pruned       txn ID       pruned txn blob
+ * txs_pruned       txn ID       pruned txn blob, with its keys interned
  * txs_prunable     txn ID       prunable txn blob
  * txs_prunable_hash txn ID      prunable txn hash
  * tx_indices       txn hash     {txn ID, metadata}
  * tx_outputs       txn ID       [txn amount output indices]
+ * tx_keys          key hash     {reference count, key}
  *
  * output_txs       output ID    {txn hash, local index}
- * output_amounts   amount       [{amount output index, metadata}...]
+ * output_amounts   amount       [{amount output index, output ID, unlock time, height}...]
+ * output_pubkeys   output ID    {output pubkey, commitment}
  *
- * spent_keys       input hash   -
+ * spent_keys       key image hash  -
+ * spent_key_images key image hash  key image
  *
  * txpool_meta      txn hash     txn metadata
  * txpool_blob      txn hash     txn blob
@@ -186,6 +190,25 @@ int compare_string(const MDB_val *a, const MDB_val *b)
  * (DUPFIXED saves 8 bytes per record.)
  *
  * The output_amounts table doesn't use a dummy key, but uses DUPSORT.
+ *
+ * Key images are as large as a Dilithium public key, so spent_keys only
+ * holds their 32 byte cn_fast_hash, which keeps the table used by
+ * has_key_image small enough to stay in the page cache. The full images
+ * are kept in spent_key_images, which is only read by for_all_key_images.
+ *
+ * Output pubkeys are large for the same reason, so output_amounts only
+ * holds fixed width records, and scans over it such as the output
+ * distribution do not page in any keys. The pubkey, and the commitment of
+ * RCT outputs, live in output_pubkeys and are looked up by output ID when
+ * an output's key is asked for.
+ *
+ * A pruned txn carries a key per input and output and one or more txn
+ * pubkeys in its extra, and the same key often shows up in many txns, so
+ * each of those is interned in tx_keys and the pruned blob only keeps its
+ * hash. A stored pruned blob is a varint count of interned keys, followed
+ * by a {varint gap, key hash} pair per key, where the gap is the number of
+ * literal bytes before the key, followed by the literal bytes of the txn
+ * with the keys cut out.
  */
 const char* const LMDB_BLOCKS = "blocks";
 const char* const LMDB_BLOCK_HEIGHTS = "block_heights";
@@ -197,10 +220,13 @@ const char* const LMDB_TXS_PRUNABLE = "txs_prunable";
 const char* const LMDB_TXS_PRUNABLE_HASH = "txs_prunable_hash";
 const char* const LMDB_TX_INDICES = "tx_indices";
 const char* const LMDB_TX_OUTPUTS = "tx_outputs";
+const char* const LMDB_TX_KEYS = "tx_keys";
 
 const char* const LMDB_OUTPUT_TXS = "output_txs";
 const char* const LMDB_OUTPUT_AMOUNTS = "output_amounts";
+const char* const LMDB_OUTPUT_PUBKEYS = "output_pubkeys";
 const char* const LMDB_SPENT_KEYS = "spent_keys";
+const char* const LMDB_SPENT_KEY_IMAGES = "spent_key_images";
 
 const char* const LMDB_TXPOOL_META = "txpool_meta";
 const char* const LMDB_TXPOOL_BLOB = "txpool_blob";
@@ -213,6 +239,10 @@ const char* const LMDB_PROPERTIES = "properties";
 // RNG
 const char* const LMDB_SPENT_RNG = "spent_rng";
 
+// furthest get_output_keys_sorted steps along output_amounts before it
+// falls back to a fresh lookup
+const uint64_t OUTPUT_KEYS_MAX_STEP = 16;
+
 const char zerokey[8] = {0};
 const MDB_val zerokval = { sizeof(zerokey), (void *)zerokey };
 
@@ -222,6 +252,11 @@ const std::string lmdb_error(const std::string& error_string, int mdb_res)
   return full_string;
 }
 
+inline crypto::hash key_image_hash(const crypto::key_image& k_image)
+{
+  return crypto::cn_fast_hash(&k_image, sizeof(k_image));
+}
+
 inline void lmdb_db_open(MDB_txn* txn, const char* name, int flags, MDB_dbi& dbi, const std::string& error_string)
 {
   if (auto res = mdb_dbi_open(txn, name, flags, &dbi))
@@ -300,24 +335,270 @@ typedef struct txindex {
     tx_data_t data;
 } txindex;
 
-typedef struct pre_rct_outkey {
+// output_amounts records up to DB version 5, which carried the pubkey
+typedef struct pre_rct_outkey_1 {
     uint64_t amount_index;
     uint64_t output_id;
     pre_rct_output_data_t data;
-} pre_rct_outkey;
+} pre_rct_outkey_1;
 
-typedef struct outkey {
+typedef struct outkey_1 {
     uint64_t amount_index;
     uint64_t output_id;
     output_data_t data;
+} outkey_1;
+
+typedef struct outkey {
+    uint64_t amount_index;
+    uint64_t output_id;
+    uint64_t unlock_time;
+    uint64_t height;
 } outkey;
 
+// pre RCT outputs only store the pubkey, their commitment is implied by the amount
+typedef struct outpubkey {
+    crypto::public_key pubkey;
+    rct::key commitment;
+} outpubkey;
+
 typedef struct outtx {
     uint64_t output_id;
     crypto::hash tx_hash;
     uint64_t local_index;
 } outtx;
 
+typedef struct txkey {
+    uint64_t refcount;
+    crypto::ec_point key;
+} txkey;
+
+typedef struct txkeyref {
+    uint64_t gap;
+    crypto::hash hash;
+} txkeyref;
+
+// fills in an output's data from its output_amounts record and its entry in output_pubkeys
+static void read_output_data(MDB_cursor *cur_output_pubkeys, uint64_t amount, const outkey &ok, output_data_t &data)
+{
+  MDB_val_set(k, ok.output_id);
+  MDB_val v;
+  int result = mdb_cursor_get(cur_output_pubkeys, &k, &v, MDB_SET);
+  if (result == MDB_NOTFOUND)
+    throw0(DB_ERROR("Unexpected: output pubkey not found in m_output_pubkeys"));
+  else if (result)
+    throw0(DB_ERROR(lmdb_error("Error attempting to retrieve an output pubkey from the db: ", result).c_str()));
+
+  const outpubkey *opk = (const outpubkey *)v.mv_data;
+  data.pubkey = opk->pubkey;
+  data.unlock_time = ok.unlock_time;
+  data.height = ok.height;
+  if (amount == 0)
+    data.commitment = opk->commitment;
+  else
+    data.commitment = rct::zeroCommit(amount);
+}
+
+// the keys a pruned tx blob carries, in the order they are serialized
+static std::vector<crypto::ec_point> get_tx_key_blobs(const transaction_prefix &tx)
+{
+  std::vector<crypto::ec_point> keys;
+  for (const auto &in: tx.vin)
+    if (in.type() == typeid(txin_to_key))
+      keys.push_back(boost::get<txin_to_key>(in).k_image);
+  for (const auto &out: tx.vout)
+    if (out.target.type() == typeid(txout_to_key))
+      keys.push_back(boost::get<txout_to_key>(out.target).key);
+  const crypto::public_key tx_pub_key = get_tx_pub_key_from_extra(tx);
+  if (tx_pub_key != crypto::null_pkey)
+    keys.push_back(tx_pub_key);
+  for (const crypto::public_key &pk: get_additional_tx_pub_keys_from_extra(tx))
+    keys.push_back(pk);
+  return keys;
+}
+
+// parses the key references at the front of a stored pruned tx blob, and
+// sets where the literal bytes start
+static bool parse_tx_key_refs(const MDB_val &v, std::vector<txkeyref> &refs, size_t &pos)
+{
+  const char *ptr = (const char *)v.mv_data, *end = ptr + v.mv_size;
+  uint64_t n_refs;
+  int read = tools::read_varint(ptr + 0, end + 0, n_refs);
+  if (read <= 0 || n_refs > v.mv_size / sizeof(crypto::hash))
+    return false;
+  ptr += read;
+  refs.resize(n_refs);
+  for (txkeyref &ref: refs)
+  {
+    read = tools::read_varint(ptr + 0, end + 0, ref.gap);
+    if (read <= 0 || (size_t)(end - ptr - read) < sizeof(ref.hash))
+      return false;
+    ptr += read;
+    memcpy(&ref.hash, ptr, sizeof(ref.hash));
+    ptr += sizeof(ref.hash);
+  }
+  pos = ptr - (const char *)v.mv_data;
+  return true;
+}
+
+// reads the key references at the front of a stored pruned tx blob, and
+// returns where the literal bytes start
+static size_t read_tx_key_refs(const MDB_val &v, std::vector<txkeyref> &refs)
+{
+  size_t pos;
+  if (!parse_tx_key_refs(v, refs, pos))
+    throw0(DB_ERROR("Invalid key references in pruned tx blob"));
+  return pos;
+}
+
+// whether a txs_pruned record is a stored pruned tx blob rather than one
+// from before its keys were interned: its references parse, its gaps fit in
+// its literal bytes, and every key it references is in tx_keys
+static bool is_interned_tx_blob(MDB_cursor *cur_tx_keys, const MDB_val &v)
+{
+  std::vector<txkeyref> refs;
+  size_t pos;
+  if (!parse_tx_key_refs(v, refs, pos))
+    return false;
+  uint64_t literal = v.mv_size - pos;
+  for (const txkeyref &ref: refs)
+  {
+    if (ref.gap > literal)
+      return false;
+    literal -= ref.gap;
+    MDB_val_set(k, ref.hash);
+    MDB_val kv;
+    int result = mdb_cursor_get(cur_tx_keys, &k, &kv, MDB_SET);
+    if (result == MDB_NOTFOUND)
+      return false;
+    else if (result)
+      throw0(DB_ERROR(lmdb_error("Error attempting to retrieve a tx key from the db: ", result).c_str()));
+  }
+  return true;
+}
+
+// moves the keys out of a pruned tx blob into tx_keys, and returns the blob to store
+static cryptonote::blobdata intern_tx_keys(MDB_cursor *cur_tx_keys, const cryptonote::blobdata &blob, const std::vector<crypto::ec_point> &keys)
+{
+  std::string refs, literal;
+  uint64_t n_refs = 0;
+  size_t pos = 0;
+  for (const crypto::ec_point &key: keys)
+  {
+    // keys are searched for in order, past the previous one, so an
+    // identical run of bytes elsewhere in the blob can only stand in
+    // for a key with the same contents
+    const auto it = std::search(blob.begin() + pos, blob.end(), key.data, key.data + sizeof(key.data));
+    if (it == blob.end())
+      continue;
+    const size_t offset = it - blob.begin();
+
+    const crypto::hash h = crypto::cn_fast_hash(&key, sizeof(key));
+    MDB_val_set(k, h);
+    MDB_val v;
+    txkey tk;
+    int result = mdb_cursor_get(cur_tx_keys, &k, &v, MDB_SET);
+    if (result == 0)
+    {
+      if (v.mv_size != sizeof(tk))
+        throw0(DB_ERROR("Invalid data from tx_keys"));
+      memcpy(&tk, v.mv_data, sizeof(tk));
+      if (memcmp(&tk.key, &key, sizeof(key)))
+        throw0(DB_ERROR("Unexpected: different keys with the same hash in tx_keys"));
+      ++tk.refcount;
+      MDB_val_set(tkv, tk);
+      result = mdb_cursor_put(cur_tx_keys, &k, &tkv, MDB_CURRENT);
+    }
+    else if (result == MDB_NOTFOUND)
+    {
+      tk.refcount = 1;
+      tk.key = key;
+      MDB_val_set(tkv, tk);
+      result = mdb_cursor_put(cur_tx_keys, &k, &tkv, MDB_NOOVERWRITE);
+    }
+    else
+      throw0(DB_ERROR(lmdb_error("Error attempting to retrieve a tx key from the db: ", result).c_str()));
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to add tx key to db transaction: ", result).c_str()));
+
+    tools::write_varint(std::back_inserter(refs), offset - pos);
+    refs.append((const char *)&h, sizeof(h));
+    literal.append(blob, pos, offset - pos);
+    pos = offset + sizeof(key);
+    ++n_refs;
+  }
+  literal.append(blob, pos, std::string::npos);
+
+  cryptonote::blobdata interned;
+  interned.reserve(refs.size() + literal.size() + 10);
+  tools::write_varint(std::back_inserter(interned), n_refs);
+  interned.append(refs);
+  interned.append(literal);
+  return interned;
+}
+
+// drops the references a stored pruned tx blob holds on tx_keys
+static void release_tx_keys(MDB_cursor *cur_tx_keys, const MDB_val &stored)
+{
+  std::vector<txkeyref> refs;
+  read_tx_key_refs(stored, refs);
+  for (const txkeyref &ref: refs)
+  {
+    MDB_val_set(k, ref.hash);
+    MDB_val v;
+    int result = mdb_cursor_get(cur_tx_keys, &k, &v, MDB_SET);
+    if (result == MDB_NOTFOUND)
+      throw0(DB_ERROR("Unexpected: tx key not found in m_tx_keys"));
+    else if (result)
+      throw0(DB_ERROR(lmdb_error("Error attempting to retrieve a tx key from the db: ", result).c_str()));
+    if (v.mv_size != sizeof(txkey))
+      throw0(DB_ERROR("Invalid data from tx_keys"));
+    txkey tk;
+    memcpy(&tk, v.mv_data, sizeof(tk));
+    if (tk.refcount <= 1)
+    {
+      result = mdb_cursor_del(cur_tx_keys, 0);
+    }
+    else
+    {
+      --tk.refcount;
+      MDB_val_set(tkv, tk);
+      result = mdb_cursor_put(cur_tx_keys, &k, &tkv, MDB_CURRENT);
+    }
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to add removal of tx key to db transaction: ", result).c_str()));
+  }
+}
+
+// rebuilds a pruned tx blob from its stored form and the keys it references
+static void rehydrate_tx_keys(MDB_cursor *cur_tx_keys, const MDB_val &stored, cryptonote::blobdata &bd)
+{
+  std::vector<txkeyref> refs;
+  size_t pos = read_tx_key_refs(stored, refs);
+  const char *data = (const char *)stored.mv_data;
+  bd.clear();
+  bd.reserve(stored.mv_size - pos + refs.size() * sizeof(crypto::ec_point));
+  for (const txkeyref &ref: refs)
+  {
+    if (ref.gap > stored.mv_size - pos)
+      throw0(DB_ERROR("Invalid key references in pruned tx blob"));
+    bd.append(data + pos, ref.gap);
+    pos += ref.gap;
+
+    MDB_val_set(k, ref.hash);
+    MDB_val v;
+    int result = mdb_cursor_get(cur_tx_keys, &k, &v, MDB_SET);
+    if (result == MDB_NOTFOUND)
+      throw0(DB_ERROR("Unexpected: tx key not found in m_tx_keys"));
+    else if (result)
+      throw0(DB_ERROR(lmdb_error("Error attempting to retrieve a tx key from the db: ", result).c_str()));
+    if (v.mv_size != sizeof(txkey))
+      throw0(DB_ERROR("Invalid data from tx_keys"));
+    const txkey *tk = (const txkey *)v.mv_data;
+    bd.append((const char *)&tk->key, sizeof(tk->key));
+  }
+  bd.append(data + pos, stored.mv_size - pos);
+}
+
 std::atomic<uint64_t> mdb_txn_safe::num_active_txns{0};
 std::atomic_flag mdb_txn_safe::creation_gate = ATOMIC_FLAG_INIT;
 
@@ -822,6 +1103,7 @@ uint64_t BlockchainLMDB::add_transaction_data(const crypto::hash& blk_hash, cons
   CURSOR(txs_prunable)
   CURSOR(txs_prunable_hash)
   CURSOR(tx_indices)
+  CURSOR(tx_keys)
 
   MDB_val_set(val_tx_id, tx_id);
   MDB_val_set(val_h, tx_hash);
@@ -855,7 +1137,7 @@ uint64_t BlockchainLMDB::add_transaction_data(const crypto::hash& blk_hash, cons
   if (!r)
     throw0(DB_ERROR("Failed to serialize pruned tx"));
   std::string pruned = ss.str();
-  MDB_val_copy<blobdata> pruned_blob(pruned);
+  MDB_val_copy<blobdata> pruned_blob(intern_tx_keys(m_cur_tx_keys, pruned, get_tx_key_blobs(tx)));
   result = mdb_cursor_put(m_cur_txs_pruned, &val_tx_id, &pruned_blob, MDB_APPEND);
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to add pruned tx blob to db transaction: ", result).c_str()));
@@ -894,6 +1176,7 @@ void BlockchainLMDB::remove_transaction_data(const crypto::hash& tx_hash, const
   CURSOR(txs_prunable)
   CURSOR(txs_prunable_hash)
   CURSOR(tx_outputs)
+  CURSOR(tx_keys)
 
   MDB_val_set(val_h, tx_hash);
 
@@ -902,8 +1185,10 @@ void BlockchainLMDB::remove_transaction_data(const crypto::hash& tx_hash, const
   txindex *tip = (txindex *)val_h.mv_data;
   MDB_val_set(val_tx_id, tip->data.tx_id);
 
-  if ((result = mdb_cursor_get(m_cur_txs_pruned, &val_tx_id, NULL, MDB_SET)))
+  MDB_val val_pruned;
+  if ((result = mdb_cursor_get(m_cur_txs_pruned, &val_tx_id, &val_pruned, MDB_SET)))
       throw1(DB_ERROR(lmdb_error("Failed to locate pruned tx for removal: ", result).c_str()));
+  release_tx_keys(m_cur_tx_keys, val_pruned);
   result = mdb_cursor_del(m_cur_txs_pruned, 0);
   if (result)
       throw1(DB_ERROR(lmdb_error("Failed to add removal of pruned tx to db transaction: ", result).c_str()));
@@ -958,6 +1243,7 @@ uint64_t BlockchainLMDB::add_output(const crypto::hash& tx_hash,
 
   CURSOR(output_txs)
   CURSOR(output_amounts)
+  CURSOR(output_pubkeys)
 
   if (tx_output.target.type() != typeid(txout_to_key))
     throw0(DB_ERROR("Wrong output type: expected txout_to_key"));
@@ -988,21 +1274,29 @@ uint64_t BlockchainLMDB::add_output(const crypto::hash& tx_hash,
   else
     ok.amount_index = 0;
   ok.output_id = m_num_outputs;
-  ok.data.pubkey = boost::get < txout_to_key > (tx_output.target).key;
-  ok.data.unlock_time = unlock_time;
-  ok.data.height = m_height;
+  ok.unlock_time = unlock_time;
+  ok.height = m_height;
+  data.mv_size = sizeof(ok);
+  data.mv_data = &ok;
+
+  if ((result = mdb_cursor_put(m_cur_output_amounts, &val_amount, &data, MDB_APPENDDUP)))
+      throw0(DB_ERROR(lmdb_error("Failed to add output amount to db transaction: ", result).c_str()));
+
+  outpubkey opk;
+  opk.pubkey = boost::get < txout_to_key > (tx_output.target).key;
+  MDB_val_set(val_output_id, ok.output_id);
+  data.mv_data = &opk;
   if (tx_output.amount == 0)
   {
-    ok.data.commitment = *commitment;
-    data.mv_size = sizeof(ok);
+    opk.commitment = *commitment;
+    data.mv_size = sizeof(opk);
   }
   else
   {
-    data.mv_size = sizeof(pre_rct_outkey);
+    data.mv_size = sizeof(opk.pubkey);
   }
-  data.mv_data = &ok;
 
-  if ((result = mdb_cursor_put(m_cur_output_amounts, &val_amount, &data, MDB_APPENDDUP)))
+  if ((result = mdb_cursor_put(m_cur_output_pubkeys, &val_output_id, &data, MDB_APPEND)))
       throw0(DB_ERROR(lmdb_error("Failed to add output pubkey to db transaction: ", result).c_str()));
 
   return ok.amount_index;
@@ -1060,6 +1354,7 @@ void BlockchainLMDB::remove_output(const uint64_t amount, const uint64_t& out_in
   mdb_txn_cursors *m_cursors = &m_wcursors;
   CURSOR(output_amounts);
   CURSOR(output_txs);
+  CURSOR(output_pubkeys);
 
   MDB_val_set(k, amount);
   MDB_val_set(v, out_index);
@@ -1070,8 +1365,8 @@ void BlockchainLMDB::remove_output(const uint64_t amount, const uint64_t& out_in
   else if (result)
     throw0(DB_ERROR(lmdb_error("DB error attempting to get an output", result).c_str()));
 
-  const pre_rct_outkey *ok = (const pre_rct_outkey *)v.mv_data;
-  MDB_val_set(otxk, ok->output_id);
+  const uint64_t output_id = ((const outkey *)v.mv_data)->output_id;
+  MDB_val_set(otxk, output_id);
   result = mdb_cursor_get(m_cur_output_txs, (MDB_val *)&zerokval, &otxk, MDB_GET_BOTH);
   if (result == MDB_NOTFOUND)
   {
@@ -1085,6 +1380,16 @@ void BlockchainLMDB::remove_output(const uint64_t amount, const uint64_t& out_in
   if (result)
     throw0(DB_ERROR(lmdb_error(std::string("Error deleting output index ").append(boost::lexical_cast<std::string>(out_index).append(": ")).c_str(), result).c_str()));
 
+  MDB_val_set(opkk, output_id);
+  result = mdb_cursor_get(m_cur_output_pubkeys, &opkk, NULL, MDB_SET);
+  if (result == MDB_NOTFOUND)
+    throw0(DB_ERROR("Unexpected: global output index not found in m_output_pubkeys"));
+  else if (result)
+    throw1(DB_ERROR(lmdb_error("Error adding removal of output pubkey to db transaction", result).c_str()));
+  result = mdb_cursor_del(m_cur_output_pubkeys, 0);
+  if (result)
+    throw0(DB_ERROR(lmdb_error(std::string("Error deleting output pubkey ").append(boost::lexical_cast<std::string>(out_index).append(": ")).c_str(), result).c_str()));
+
   // now delete the amount
   result = mdb_cursor_del(m_cur_output_amounts, 0);
   if (result)
@@ -1098,12 +1403,20 @@ void BlockchainLMDB::add_spent_key(const crypto::key_image& k_image)
   mdb_txn_cursors *m_cursors = &m_wcursors;
 
   CURSOR(spent_keys)
+  CURSOR(spent_key_images)
 
-  MDB_val k = {sizeof(k_image), (void *)&k_image};
+  const crypto::hash h = key_image_hash(k_image);
+  MDB_val k = {sizeof(h), (void *)&h};
   auto result = mdb_cursor_put(m_cur_spent_keys, (MDB_val *)&zerokval, &k, MDB_NODUPDATA);
   
   // TODO: For now log the result of same key inside the db.
   LOG_PRINT_L3("::add_spent_key in DB" << result);
+  if (result == MDB_SUCCESS)
+  {
+    MDB_val v = {sizeof(k_image), (void *)&k_image};
+    if ((result = mdb_cursor_put(m_cur_spent_key_images, &k, &v, MDB_NOOVERWRITE)))
+      throw1(DB_ERROR(lmdb_error("Error adding spent key image to db transaction: ", result).c_str()));
+  }
   /*if (auto result = mdb_cursor_put(m_cur_spent_keys, (MDB_val *)&zerokval, &k, MDB_NODUPDATA)) {
     if (result == MDB_KEYEXIST)
       throw1(KEY_IMAGE_EXISTS("Attempting to add spent key image that's already in the db"));
@@ -1160,8 +1473,10 @@ void BlockchainLMDB::remove_spent_key(const crypto::key_image& k_image)
   mdb_txn_cursors *m_cursors = &m_wcursors;
 
   CURSOR(spent_keys)
+  CURSOR(spent_key_images)
 
-  MDB_val k = {sizeof(k_image), (void *)&k_image};
+  const crypto::hash h = key_image_hash(k_image);
+  MDB_val k = {sizeof(h), (void *)&h};
   auto result = mdb_cursor_get(m_cur_spent_keys, (MDB_val *)&zerokval, &k, MDB_GET_BOTH);
   if (result != 0 && result != MDB_NOTFOUND)
       throw1(DB_ERROR(lmdb_error("Error finding spent key to remove", result).c_str()));
@@ -1170,6 +1485,17 @@ void BlockchainLMDB::remove_spent_key(const crypto::key_image& k_image)
     result = mdb_cursor_del(m_cur_spent_keys, 0);
     if (result)
         throw1(DB_ERROR(lmdb_error("Error adding removal of key image to db transaction", result).c_str()));
+
+    MDB_val v;
+    result = mdb_cursor_get(m_cur_spent_key_images, &k, &v, MDB_SET);
+    if (result != 0 && result != MDB_NOTFOUND)
+        throw1(DB_ERROR(lmdb_error("Error finding spent key image to remove", result).c_str()));
+    if (!result)
+    {
+      result = mdb_cursor_del(m_cur_spent_key_images, 0);
+      if (result)
+          throw1(DB_ERROR(lmdb_error("Error adding removal of key image to db transaction", result).c_str()));
+    }
   }
 }
 
@@ -1286,7 +1612,7 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
   // set up lmdb environment
   if ((result = mdb_env_create(&m_env)))
     throw0(DB_ERROR(lmdb_error("Failed to create lmdb environment: ", result).c_str()));
-  if ((result = mdb_env_set_maxdbs(m_env, 20)))
+  if ((result = mdb_env_set_maxdbs(m_env, 24)))
     throw0(DB_ERROR(lmdb_error("Failed to set max number of dbs: ", result).c_str()));
 
   int threads = tools::get_max_concurrency();
@@ -1349,11 +1675,14 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
   lmdb_db_open(txn, LMDB_TXS_PRUNABLE_HASH, MDB_INTEGERKEY | MDB_CREATE, m_txs_prunable_hash, "Failed to open db handle for m_txs_prunable_hash");
   lmdb_db_open(txn, LMDB_TX_INDICES, MDB_INTEGERKEY | MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED, m_tx_indices, "Failed to open db handle for m_tx_indices");
   lmdb_db_open(txn, LMDB_TX_OUTPUTS, MDB_INTEGERKEY | MDB_CREATE, m_tx_outputs, "Failed to open db handle for m_tx_outputs");
+  lmdb_db_open(txn, LMDB_TX_KEYS, MDB_CREATE, m_tx_keys, "Failed to open db handle for m_tx_keys");
 
   lmdb_db_open(txn, LMDB_OUTPUT_TXS, MDB_INTEGERKEY | MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED, m_output_txs, "Failed to open db handle for m_output_txs");
   lmdb_db_open(txn, LMDB_OUTPUT_AMOUNTS, MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED | MDB_CREATE, m_output_amounts, "Failed to open db handle for m_output_amounts");
+  lmdb_db_open(txn, LMDB_OUTPUT_PUBKEYS, MDB_INTEGERKEY | MDB_CREATE, m_output_pubkeys, "Failed to open db handle for m_output_pubkeys");
 
   lmdb_db_open(txn, LMDB_SPENT_KEYS, MDB_INTEGERKEY | MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED, m_spent_keys, "Failed to open db handle for m_spent_keys");
+  lmdb_db_open(txn, LMDB_SPENT_KEY_IMAGES, MDB_CREATE, m_spent_key_images, "Failed to open db handle for m_spent_key_images");
 
   //RNG
   lmdb_db_open(txn, LMDB_SPENT_RNG, MDB_INTEGERKEY | MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED, m_spent_rng, "Failed to open db handle for m_spent_rng");
@@ -1378,6 +1707,7 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
   mdb_set_dupsort(txn, m_output_txs, compare_uint64);
   mdb_set_dupsort(txn, m_block_info, compare_uint64);
 
+  mdb_set_compare(txn, m_spent_key_images, compare_hash32);
   mdb_set_compare(txn, m_txpool_meta, compare_hash32);
   mdb_set_compare(txn, m_txpool_blob, compare_hash32);
   mdb_set_compare(txn, m_properties, compare_string);
@@ -1533,12 +1863,18 @@ void BlockchainLMDB::reset()
     throw0(DB_ERROR(lmdb_error("Failed to drop m_tx_indices: ", result).c_str()));
   if (auto result = mdb_drop(txn, m_tx_outputs, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_tx_outputs: ", result).c_str()));
+  if (auto result = mdb_drop(txn, m_tx_keys, 0))
+    throw0(DB_ERROR(lmdb_error("Failed to drop m_tx_keys: ", result).c_str()));
   if (auto result = mdb_drop(txn, m_output_txs, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_output_txs: ", result).c_str()));
   if (auto result = mdb_drop(txn, m_output_amounts, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_output_amounts: ", result).c_str()));
+  if (auto result = mdb_drop(txn, m_output_pubkeys, 0))
+    throw0(DB_ERROR(lmdb_error("Failed to drop m_output_pubkeys: ", result).c_str()));
   if (auto result = mdb_drop(txn, m_spent_keys, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_spent_keys: ", result).c_str()));
+  if (auto result = mdb_drop(txn, m_spent_key_images, 0))
+    throw0(DB_ERROR(lmdb_error("Failed to drop m_spent_key_images: ", result).c_str()));
   (void)mdb_drop(txn, m_hf_starting_heights, 0); // this one is dropped in new code
   if (auto result = mdb_drop(txn, m_hf_versions, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_hf_versions: ", result).c_str()));
@@ -2405,6 +2741,7 @@ bool BlockchainLMDB::get_tx_blob(const crypto::hash& h, cryptonote::blobdata &bd
   RCURSOR(tx_indices);
   RCURSOR(txs_pruned);
   RCURSOR(txs_prunable);
+  RCURSOR(tx_keys);
 
   MDB_val_set(v, h);
   MDB_val result0, result1;
@@ -2424,7 +2761,7 @@ bool BlockchainLMDB::get_tx_blob(const crypto::hash& h, cryptonote::blobdata &bd
   else if (get_result)
     throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx from hash", get_result).c_str()));
 
-  bd.assign(reinterpret_cast<char*>(result0.mv_data), result0.mv_size);
+  rehydrate_tx_keys(m_cur_tx_keys, result0, bd);
   bd.append(reinterpret_cast<char*>(result1.mv_data), result1.mv_size);
 
   TXN_POSTFIX_RDONLY();
@@ -2440,6 +2777,7 @@ bool BlockchainLMDB::get_pruned_tx_blob(const crypto::hash& h, cryptonote::blobd
   TXN_PREFIX_RDONLY();
   RCURSOR(tx_indices);
   RCURSOR(txs_pruned);
+  RCURSOR(tx_keys);
 
   MDB_val_set(v, h);
   MDB_val result;
@@ -2455,7 +2793,7 @@ bool BlockchainLMDB::get_pruned_tx_blob(const crypto::hash& h, cryptonote::blobd
   else if (get_result)
     throw0(DB_ERROR(lmdb_error("DB error attempting to fetch tx from hash", get_result).c_str()));
 
-  bd.assign(reinterpret_cast<char*>(result.mv_data), result.mv_size);
+  rehydrate_tx_keys(m_cur_tx_keys, result, bd);
 
   TXN_POSTFIX_RDONLY();
 
@@ -2577,6 +2915,7 @@ output_data_t BlockchainLMDB::get_output_key(const uint64_t& amount, const uint6
 
   TXN_PREFIX_RDONLY();
   RCURSOR(output_amounts);
+  RCURSOR(output_pubkeys);
 
   MDB_val_set(k, amount);
   MDB_val_set(v, index);
@@ -2587,17 +2926,7 @@ output_data_t BlockchainLMDB::get_output_key(const uint64_t& amount, const uint6
     throw0(DB_ERROR("Error attempting to retrieve an output pubkey from the db"));
 
   output_data_t ret;
-  if (amount == 0)
-  {
-    const outkey *okp = (const outkey *)v.mv_data;
-    ret = okp->data;
-  }
-  else
-  {
-    const pre_rct_outkey *okp = (const pre_rct_outkey *)v.mv_data;
-    memcpy(&ret, &okp->data, sizeof(pre_rct_output_data_t));;
-    ret.commitment = rct::zeroCommit(amount);
-  }
+  read_output_data(m_cur_output_pubkeys, amount, *(const outkey *)v.mv_data, ret);
   TXN_POSTFIX_RDONLY();
   return ret;
 }
@@ -2686,7 +3015,8 @@ bool BlockchainLMDB::has_key_image(const crypto::key_image& img) const
   TXN_PREFIX_RDONLY();
   RCURSOR(spent_keys);
 
-  MDB_val k = {sizeof(img), (void *)&img};
+  const crypto::hash h = key_image_hash(img);
+  MDB_val k = {sizeof(h), (void *)&h};
   ret = (mdb_cursor_get(m_cur_spent_keys, (MDB_val *)&zerokval, &k, MDB_GET_BOTH) == 0);
 
   TXN_POSTFIX_RDONLY();
@@ -2754,16 +3084,15 @@ bool BlockchainLMDB::for_all_key_images(std::function<bool(const crypto::key_ima
   check_open();
 
   TXN_PREFIX_RDONLY();
-  RCURSOR(spent_keys);
+  RCURSOR(spent_key_images);
 
   MDB_val k, v;
   bool fret = true;
 
-  k = zerokval;
   MDB_cursor_op op = MDB_FIRST;
   while (1)
   {
-    int ret = mdb_cursor_get(m_cur_spent_keys, &k, &v, op);
+    int ret = mdb_cursor_get(m_cur_spent_key_images, &k, &v, op);
     op = MDB_NEXT;
     if (ret == MDB_NOTFOUND)
       break;
@@ -2841,6 +3170,7 @@ bool BlockchainLMDB::for_all_transactions(std::function<bool(const crypto::hash&
   RCURSOR(txs_pruned);
   RCURSOR(txs_prunable);
   RCURSOR(tx_indices);
+  RCURSOR(tx_keys);
 
   MDB_val k;
   MDB_val v;
@@ -2868,7 +3198,7 @@ bool BlockchainLMDB::for_all_transactions(std::function<bool(const crypto::hash&
       throw0(DB_ERROR(lmdb_error("Failed to enumerate transactions: ", ret).c_str()));
     transaction tx;
     blobdata bd;
-    bd.assign(reinterpret_cast<char*>(v.mv_data), v.mv_size);
+    rehydrate_tx_keys(m_cur_tx_keys, v, bd);
     if (pruned)
     {
       if (!parse_and_validate_tx_base_from_blob(bd, tx))
@@ -2918,7 +3248,7 @@ bool BlockchainLMDB::for_all_outputs(std::function<bool(uint64_t amount, const c
     uint64_t amount = *(const uint64_t*)k.mv_data;
     outkey *ok = (outkey *)v.mv_data;
     tx_out_index toi = get_output_tx_and_index_from_global(ok->output_id);
-    if (!f(amount, toi.first, ok->data.height, toi.second)) {
+    if (!f(amount, toi.first, ok->height, toi.second)) {
       fret = false;
       break;
     }
@@ -2958,7 +3288,7 @@ bool BlockchainLMDB::for_all_outputs(uint64_t amount, const std::function<bool(u
       break;
     }
     const outkey *ok = (const outkey *)v.mv_data;
-    if (!f(ok->data.height)) {
+    if (!f(ok->height)) {
       fret = false;
       break;
     }
@@ -3341,6 +3671,7 @@ void BlockchainLMDB::get_output_key(const uint64_t &amount, const std::vector<ui
   TXN_PREFIX_RDONLY();
 
   RCURSOR(output_amounts);
+  RCURSOR(output_pubkeys);
 
   MDB_val_set(k, amount);
   for (const uint64_t &index : offsets)
@@ -3361,24 +3692,65 @@ void BlockchainLMDB::get_output_key(const uint64_t &amount, const std::vector<ui
       throw0(DB_ERROR(lmdb_error("Error attempting to retrieve an output pubkey from the db", get_result).c_str()));
 
     output_data_t data;
-    if (amount == 0)
+    read_output_data(m_cur_output_pubkeys, amount, *(const outkey *)v.mv_data, data);
+    outputs.push_back(data);
+  }
+
+  TXN_POSTFIX_RDONLY();
+
+  TIME_MEASURE_FINISH(db3);
+  LOG_PRINT_L3("db3: " << db3);
+}
+
+size_t BlockchainLMDB::get_output_keys_sorted(uint64_t amount, const uint64_t *offsets, size_t count, output_data_t *outputs)
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  TIME_MEASURE_START(db3);
+  check_open();
+
+  TXN_PREFIX_RDONLY();
+
+  RCURSOR(output_amounts);
+  RCURSOR(output_pubkeys);
+
+  MDB_val_set(k, amount);
+  MDB_val v;
+  size_t n;
+  for (n = 0; n < count; ++n)
+  {
+    const uint64_t index = offsets[n];
+    int get_result = 0;
+    bool stepped = false;
+
+    // amount indices are dense, so an index close to the previous one is
+    // reached by stepping along the duplicates on the pages the cursor
+    // already has, rather than by a lookup from the root
+    if (n > 0 && index > offsets[n - 1] && index - offsets[n - 1] <= OUTPUT_KEYS_MAX_STEP)
     {
-      const outkey *okp = (const outkey *)v.mv_data;
-      data = okp->data;
+      uint64_t step = index - offsets[n - 1];
+      while (step > 0 && !(get_result = mdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_NEXT_DUP)))
+        --step;
+      stepped = !get_result && *(const uint64_t *)v.mv_data == index;
     }
-    else
+    if (!stepped)
     {
-      const pre_rct_outkey *okp = (const pre_rct_outkey *)v.mv_data;
-      memcpy(&data, &okp->data, sizeof(pre_rct_output_data_t));
-      data.commitment = rct::zeroCommit(amount);
+      v.mv_size = sizeof(index);
+      v.mv_data = (void *)&index;
+      get_result = mdb_cursor_get(m_cur_output_amounts, &k, &v, MDB_GET_BOTH);
     }
-    outputs.push_back(data);
+    if (get_result == MDB_NOTFOUND)
+      break;
+    if (get_result)
+      throw0(DB_ERROR(lmdb_error("Error attempting to retrieve an output pubkey from the db", get_result).c_str()));
+
+    read_output_data(m_cur_output_pubkeys, amount, *(const outkey *)v.mv_data, outputs[n]);
   }
 
   TXN_POSTFIX_RDONLY();
 
   TIME_MEASURE_FINISH(db3);
   LOG_PRINT_L3("db3: " << db3);
+  return n;
 }
 
 void BlockchainLMDB::get_output_tx_and_index(const uint64_t& amount, const std::vector<uint64_t> &offsets, std::vector<tx_out_index> &indices) const
@@ -3537,7 +3909,7 @@ bool BlockchainLMDB::get_output_distribution(uint64_t amount, uint64_t from_heig
     if (ret)
       throw0(DB_ERROR("Failed to enumerate outputs"));
     const outkey *ok = (const outkey *)v.mv_data;
-    const uint64_t height = ok->data.height;
+    const uint64_t height = ok->height;
     if (height >= from_height)
       distribution[height - from_height]++;
     else
@@ -3556,6 +3928,37 @@ bool BlockchainLMDB::get_output_distribution(uint64_t amount, uint64_t from_heig
   return true;
 }
 
+bool BlockchainLMDB::get_tx_key_stats(uint64_t &unique_keys, uint64_t &key_references) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_PREFIX_RDONLY();
+  RCURSOR(tx_keys);
+
+  unique_keys = 0;
+  key_references = 0;
+  MDB_val k;
+  MDB_val v;
+  MDB_cursor_op op = MDB_FIRST;
+  while (1)
+  {
+    int ret = mdb_cursor_get(m_cur_tx_keys, &k, &v, op);
+    op = MDB_NEXT;
+    if (ret == MDB_NOTFOUND)
+      break;
+    if (ret)
+      throw0(DB_ERROR(lmdb_error("Failed to enumerate tx keys: ", ret).c_str()));
+    const txkey *tk = (const txkey *)v.mv_data;
+    ++unique_keys;
+    key_references += tk->refcount;
+  }
+
+  TXN_POSTFIX_RDONLY();
+
+  return true;
+}
+
 void BlockchainLMDB::check_hard_fork_info()
 {
 }
@@ -4653,6 +5056,416 @@ void BlockchainLMDB::migrate_3_4()
   txn.commit();
 }
 
+void BlockchainLMDB::migrate_4_5()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  uint64_t i, z;
+  int result;
+  mdb_txn_safe txn(false);
+  MDB_val k, v;
+  char *ptr;
+
+  MGINFO_YELLOW("Migrating blockchain from DB version 4 to 5 - this may take a while:");
+
+  do {
+    LOG_PRINT_L1("migrating spent keys:");
+
+    result = mdb_txn_begin(m_env, NULL, 0, txn);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+
+    MDB_stat db_stats;
+    if ((result = mdb_stat(txn, m_spent_keys, &db_stats)))
+      throw0(DB_ERROR(lmdb_error("Failed to query m_spent_keys: ", result).c_str()));
+    z = db_stats.ms_entries;
+
+    /* spent_keys used to hold the full key images, it now holds their hashes.
+     * Build the new table under a similar name, and move the full images to
+     * spent_key_images, which open() has already created.
+     */
+    MDB_dbi o_spent_keys = m_spent_keys;
+    lmdb_db_open(txn, "spent_keyr", MDB_INTEGERKEY | MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED, m_spent_keys, "Failed to open db handle for spent_keyr");
+    mdb_set_dupsort(txn, m_spent_keys, compare_hash32);
+    txn.commit();
+
+    MDB_cursor *c_old, *c_cur, *c_images;
+    i = 0;
+    while(1) {
+      if (!(i % 1000)) {
+        if (i) {
+          LOGIF(el::Level::Info) {
+            std::cout << i << " / " << z << "  \r" << std::flush;
+          }
+          txn.commit();
+        }
+        result = mdb_txn_begin(m_env, NULL, 0, txn);
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+        result = mdb_cursor_open(txn, m_spent_keys, &c_cur);
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Failed to open a cursor for spent_keyr: ", result).c_str()));
+        result = mdb_cursor_open(txn, m_spent_key_images, &c_images);
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Failed to open a cursor for spent_key_images: ", result).c_str()));
+        result = mdb_cursor_open(txn, o_spent_keys, &c_old);
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Failed to open a cursor for spent_keys: ", result).c_str()));
+        if (!i) {
+          MDB_stat ms;
+          result = mdb_stat(txn, m_spent_keys, &ms);
+          if (result)
+            throw0(DB_ERROR(lmdb_error("Failed to query spent_keyr: ", result).c_str()));
+          i = ms.ms_entries;
+          z += i;
+        }
+      }
+      result = mdb_cursor_get(c_old, &k, &v, MDB_NEXT);
+      if (result == MDB_NOTFOUND) {
+        txn.commit();
+        break;
+      }
+      else if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to get a record from spent_keys: ", result).c_str()));
+      if (v.mv_size != sizeof(crypto::key_image))
+        throw0(DB_ERROR("Invalid data from spent_keys"));
+
+      const crypto::hash h = crypto::cn_fast_hash(v.mv_data, v.mv_size);
+      MDB_val_set(hk, h);
+      result = mdb_cursor_put(c_cur, (MDB_val *)&zerokval, &hk, MDB_NODUPDATA);
+      if (result && result != MDB_KEYEXIST)
+        throw0(DB_ERROR(lmdb_error("Failed to put a record into spent_keyr: ", result).c_str()));
+      result = mdb_cursor_put(c_images, &hk, &v, 0);
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to put a record into spent_key_images: ", result).c_str()));
+      /* delete the old records as we go, so the key images are not held twice */
+      result = mdb_cursor_del(c_old, 0);
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to delete a record from spent_keys: ", result).c_str()));
+      i++;
+    }
+
+    result = mdb_txn_begin(m_env, NULL, 0, txn);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+    /* Delete the old table */
+    result = mdb_drop(txn, o_spent_keys, 1);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to delete old spent_keys table: ", result).c_str()));
+
+    RENAME_DB("spent_keyr");
+    mdb_dbi_close(m_env, m_spent_keys);
+
+    lmdb_db_open(txn, LMDB_SPENT_KEYS, MDB_INTEGERKEY | MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED, m_spent_keys, "Failed to open db handle for m_spent_keys");
+    mdb_set_dupsort(txn, m_spent_keys, compare_hash32);
+
+    txn.commit();
+  } while(0);
+
+  uint32_t version = 5;
+  v.mv_data = (void *)&version;
+  v.mv_size = sizeof(version);
+  MDB_val_copy<const char *> vk("version");
+  result = mdb_txn_begin(m_env, NULL, 0, txn);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+  result = mdb_put(txn, m_properties, &vk, &v, 0);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to update version for the db: ", result).c_str()));
+  txn.commit();
+}
+
+void BlockchainLMDB::migrate_5_6()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  uint64_t i, z;
+  int result;
+  mdb_txn_safe txn(false);
+  MDB_val k, v;
+  char *ptr;
+
+  MGINFO_YELLOW("Migrating blockchain from DB version 5 to 6 - this may take a while:");
+
+  do {
+    LOG_PRINT_L1("migrating output amounts:");
+
+    result = mdb_txn_begin(m_env, NULL, 0, txn);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+
+    /* output_amounts used to carry each output's pubkey, it now only holds
+     * fixed width records, and the pubkeys go to output_pubkeys, which open()
+     * has already created. The table is already in the new format if
+     * migrate_0_1 rebuilt it, and there is nothing to convert if it is empty,
+     * unless an earlier run was interrupted after moving every record.
+     */
+    MDB_dbi dbi;
+    const bool resuming = !mdb_dbi_open(txn, "output_amountr", 0, &dbi);
+    MDB_cursor *c_old, *c_cur, *c_pubkeys;
+    result = mdb_cursor_open(txn, m_output_amounts, &c_old);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to open a cursor for output_amounts: ", result).c_str()));
+    result = mdb_cursor_get(c_old, &k, &v, MDB_FIRST);
+    if (result && result != MDB_NOTFOUND)
+      throw0(DB_ERROR(lmdb_error("Failed to get a record from output_amounts: ", result).c_str()));
+    if (!resuming && (result == MDB_NOTFOUND || v.mv_size == sizeof(outkey)))
+    {
+      txn.abort();
+      LOG_PRINT_L1("  output amounts already migrated");
+      break;
+    }
+
+    MDB_stat db_stats;
+    if ((result = mdb_stat(txn, m_output_amounts, &db_stats)))
+      throw0(DB_ERROR(lmdb_error("Failed to query m_output_amounts: ", result).c_str()));
+    z = db_stats.ms_entries;
+
+    MDB_dbi o_output_amounts = m_output_amounts;
+    lmdb_db_open(txn, "output_amountr", MDB_INTEGERKEY | MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED, m_output_amounts, "Failed to open db handle for output_amountr");
+    mdb_set_dupsort(txn, m_output_amounts, compare_uint64);
+    txn.commit();
+
+    i = 0;
+    while(1) {
+      if (!(i % 1000)) {
+        if (i) {
+          LOGIF(el::Level::Info) {
+            std::cout << i << " / " << z << "  \r" << std::flush;
+          }
+          txn.commit();
+        }
+        result = mdb_txn_begin(m_env, NULL, 0, txn);
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+        result = mdb_cursor_open(txn, m_output_amounts, &c_cur);
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Failed to open a cursor for output_amountr: ", result).c_str()));
+        result = mdb_cursor_open(txn, m_output_pubkeys, &c_pubkeys);
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Failed to open a cursor for output_pubkeys: ", result).c_str()));
+        result = mdb_cursor_open(txn, o_output_amounts, &c_old);
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Failed to open a cursor for output_amounts: ", result).c_str()));
+        if (!i) {
+          MDB_stat ms;
+          result = mdb_stat(txn, m_output_amounts, &ms);
+          if (result)
+            throw0(DB_ERROR(lmdb_error("Failed to query output_amountr: ", result).c_str()));
+          i = ms.ms_entries;
+          z += i;
+        }
+      }
+      /* records are deleted as they are moved, so the first one left is the
+       * next to move; stepping with MDB_NEXT trips over the dup cursor once
+       * the last output of an amount is gone */
+      result = mdb_cursor_get(c_old, &k, &v, MDB_FIRST);
+      if (result == MDB_NOTFOUND) {
+        txn.commit();
+        break;
+      }
+      else if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to get a record from output_amounts: ", result).c_str()));
+
+      const uint64_t amount = *(const uint64_t *)k.mv_data;
+      if (v.mv_size != (amount ? sizeof(pre_rct_outkey_1) : sizeof(outkey_1)))
+        throw0(DB_ERROR("Invalid data from output_amounts"));
+      outkey_1 old_ok;
+      memcpy(&old_ok, v.mv_data, v.mv_size);
+
+      outkey ok = {old_ok.amount_index, old_ok.output_id, old_ok.data.unlock_time, old_ok.data.height};
+      MDB_val_set(ak, amount);
+      MDB_val_set(av, ok);
+      result = mdb_cursor_put(c_cur, &ak, &av, MDB_APPENDDUP);
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to put a record into output_amountr: ", result).c_str()));
+
+      outpubkey opk;
+      opk.pubkey = old_ok.data.pubkey;
+      MDB_val_set(pk, ok.output_id);
+      MDB_val pv = {sizeof(opk.pubkey), (void *)&opk};
+      if (amount == 0)
+      {
+        opk.commitment = old_ok.data.commitment;
+        pv.mv_size = sizeof(opk);
+      }
+      result = mdb_cursor_put(c_pubkeys, &pk, &pv, 0);
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to put a record into output_pubkeys: ", result).c_str()));
+      /* delete the old records as we go, so the pubkeys are not held twice */
+      result = mdb_cursor_del(c_old, 0);
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to delete a record from output_amounts: ", result).c_str()));
+      i++;
+    }
+
+    result = mdb_txn_begin(m_env, NULL, 0, txn);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+    /* Delete the old table */
+    result = mdb_drop(txn, o_output_amounts, 1);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to delete old output_amounts table: ", result).c_str()));
+
+    RENAME_DB("output_amountr");
+    mdb_dbi_close(m_env, m_output_amounts);
+
+    lmdb_db_open(txn, LMDB_OUTPUT_AMOUNTS, MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED | MDB_CREATE, m_output_amounts, "Failed to open db handle for m_output_amounts");
+    mdb_set_dupsort(txn, m_output_amounts, compare_uint64);
+
+    txn.commit();
+  } while(0);
+
+  uint32_t version = 6;
+  v.mv_data = (void *)&version;
+  v.mv_size = sizeof(version);
+  MDB_val_copy<const char *> vk("version");
+  result = mdb_txn_begin(m_env, NULL, 0, txn);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+  result = mdb_put(txn, m_properties, &vk, &v, 0);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to update version for the db: ", result).c_str()));
+  txn.commit();
+}
+
+void BlockchainLMDB::migrate_6_7()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  uint64_t i, z;
+  int result;
+  mdb_txn_safe txn(false);
+  MDB_val k, v;
+  char *ptr;
+
+  MGINFO_YELLOW("Migrating blockchain from DB version 6 to 7 - this may take a while:");
+
+  do {
+    LOG_PRINT_L1("interning tx keys:");
+
+    result = mdb_txn_begin(m_env, NULL, 0, txn);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+
+    /* txs_pruned used to hold the pruned blobs as is, their keys now go to
+     * tx_keys, which open() has already created. There is nothing to convert
+     * if it is empty, unless an earlier run was interrupted after moving
+     * every record.
+     */
+    MDB_dbi dbi;
+    const bool resuming = !mdb_dbi_open(txn, "txs_prunec", 0, &dbi);
+    MDB_stat db_stats;
+    if ((result = mdb_stat(txn, m_txs_pruned, &db_stats)))
+      throw0(DB_ERROR(lmdb_error("Failed to query m_txs_pruned: ", result).c_str()));
+    if (!resuming && db_stats.ms_entries == 0)
+    {
+      txn.abort();
+      LOG_PRINT_L1("  tx keys already interned");
+      break;
+    }
+    z = db_stats.ms_entries;
+
+    MDB_dbi o_txs_pruned = m_txs_pruned;
+    lmdb_db_open(txn, "txs_prunec", MDB_INTEGERKEY | MDB_CREATE, m_txs_pruned, "Failed to open db handle for txs_prunec");
+    txn.commit();
+
+    MDB_cursor *c_old, *c_cur, *c_tx_keys;
+    i = 0;
+    while(1) {
+      if (!(i % 1000)) {
+        if (i) {
+          LOGIF(el::Level::Info) {
+            std::cout << i << " / " << z << "  \r" << std::flush;
+          }
+          txn.commit();
+        }
+        result = mdb_txn_begin(m_env, NULL, 0, txn);
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+        result = mdb_cursor_open(txn, m_txs_pruned, &c_cur);
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Failed to open a cursor for txs_prunec: ", result).c_str()));
+        result = mdb_cursor_open(txn, m_tx_keys, &c_tx_keys);
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Failed to open a cursor for tx_keys: ", result).c_str()));
+        result = mdb_cursor_open(txn, o_txs_pruned, &c_old);
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Failed to open a cursor for txs_pruned: ", result).c_str()));
+        if (!i) {
+          MDB_stat ms;
+          result = mdb_stat(txn, m_txs_pruned, &ms);
+          if (result)
+            throw0(DB_ERROR(lmdb_error("Failed to query txs_prunec: ", result).c_str()));
+          i = ms.ms_entries;
+          z += i;
+        }
+      }
+      result = mdb_cursor_get(c_old, &k, &v, MDB_FIRST);
+      if (result == MDB_NOTFOUND) {
+        txn.commit();
+        break;
+      }
+      else if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to get a record from txs_pruned: ", result).c_str()));
+
+      const uint64_t tx_id = *(const uint64_t *)k.mv_data;
+      const cryptonote::blobdata bd(reinterpret_cast<const char*>(v.mv_data), v.mv_size);
+      /* a run interrupted after the rename but before the version was
+       * written leaves blobs that are already interned in txs_pruned, which
+       * must move as they are, or their keys would be referenced twice
+       */
+      cryptonote::blobdata interned;
+      if (is_interned_tx_blob(c_tx_keys, v))
+      {
+        interned = bd;
+      }
+      else
+      {
+        transaction tx;
+        if (!parse_and_validate_tx_base_from_blob(bd, tx))
+          throw0(DB_ERROR("Failed to parse tx from blob retrieved from the db"));
+        interned = intern_tx_keys(c_tx_keys, bd, get_tx_key_blobs(tx));
+      }
+
+      MDB_val_copy<blobdata> pruned_blob(interned);
+      MDB_val_set(val_tx_id, tx_id);
+      result = mdb_cursor_put(c_cur, &val_tx_id, &pruned_blob, MDB_APPEND);
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to put a record into txs_prunec: ", result).c_str()));
+      /* delete the old records as we go, so the keys are not held twice */
+      result = mdb_cursor_del(c_old, 0);
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to delete a record from txs_pruned: ", result).c_str()));
+      i++;
+    }
+
+    result = mdb_txn_begin(m_env, NULL, 0, txn);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+    /* Delete the old table */
+    result = mdb_drop(txn, o_txs_pruned, 1);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to delete old txs_pruned table: ", result).c_str()));
+
+    RENAME_DB("txs_prunec");
+    mdb_dbi_close(m_env, m_txs_pruned);
+
+    lmdb_db_open(txn, LMDB_TXS_PRUNED, MDB_INTEGERKEY | MDB_CREATE, m_txs_pruned, "Failed to open db handle for m_txs_pruned");
+
+    txn.commit();
+  } while(0);
+
+  uint32_t version = 7;
+  v.mv_data = (void *)&version;
+  v.mv_size = sizeof(version);
+  MDB_val_copy<const char *> vk("version");
+  result = mdb_txn_begin(m_env, NULL, 0, txn);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+  result = mdb_put(txn, m_properties, &vk, &v, 0);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to update version for the db: ", result).c_str()));
+  txn.commit();
+}
+
 void BlockchainLMDB::migrate(const uint32_t oldversion)
 {
   switch(oldversion) {
@@ -4664,6 +5477,12 @@ void BlockchainLMDB::migrate(const uint32_t oldversion)
     migrate_2_3(); /* FALLTHRU */
   case 3:
     migrate_3_4(); /* FALLTHRU */
+  case 4:
+    migrate_4_5(); /* FALLTHRU */
+  case 5:
+    migrate_5_6(); /* FALLTHRU */
+  case 6:
+    migrate_6_7(); /* FALLTHRU */
   default:
     ;
   }
@@ -48,6 +48,7 @@ typedef struct mdb_txn_cursors
 
   MDB_cursor *m_txc_output_txs;
   MDB_cursor *m_txc_output_amounts;
+  MDB_cursor *m_txc_output_pubkeys;
 
   MDB_cursor *m_txc_txs;
   MDB_cursor *m_txc_txs_pruned;
@@ -55,8 +56,10 @@ typedef struct mdb_txn_cursors
   MDB_cursor *m_txc_txs_prunable_hash;
   MDB_cursor *m_txc_tx_indices;
   MDB_cursor *m_txc_tx_outputs;
+  MDB_cursor *m_txc_tx_keys;
 
   MDB_cursor *m_txc_spent_keys;
+  MDB_cursor *m_txc_spent_key_images;
 
   MDB_cursor *m_txc_txpool_meta;
   MDB_cursor *m_txc_txpool_blob;
@@ -71,13 +74,16 @@ typedef struct mdb_txn_cursors
 #define m_cur_block_info	m_cursors->m_txc_block_info
 #define m_cur_output_txs	m_cursors->m_txc_output_txs
 #define m_cur_output_amounts	m_cursors->m_txc_output_amounts
+#define m_cur_output_pubkeys	m_cursors->m_txc_output_pubkeys
 #define m_cur_txs	m_cursors->m_txc_txs
 #define m_cur_txs_pruned	m_cursors->m_txc_txs_pruned
 #define m_cur_txs_prunable	m_cursors->m_txc_txs_prunable
 #define m_cur_txs_prunable_hash	m_cursors->m_txc_txs_prunable_hash
 #define m_cur_tx_indices	m_cursors->m_txc_tx_indices
 #define m_cur_tx_outputs	m_cursors->m_txc_tx_outputs
+#define m_cur_tx_keys	m_cursors->m_txc_tx_keys
 #define m_cur_spent_keys	m_cursors->m_txc_spent_keys
+#define m_cur_spent_key_images	m_cursors->m_txc_spent_key_images
 #define m_cur_txpool_meta	m_cursors->m_txc_txpool_meta
 #define m_cur_txpool_blob	m_cursors->m_txc_txpool_blob
 #define m_cur_hf_versions	m_cursors->m_txc_hf_versions
@@ -93,13 +99,16 @@ typedef struct mdb_rflags
   bool m_rf_block_info;
   bool m_rf_output_txs;
   bool m_rf_output_amounts;
+  bool m_rf_output_pubkeys;
   bool m_rf_txs;
   bool m_rf_txs_pruned;
   bool m_rf_txs_prunable;
   bool m_rf_txs_prunable_hash;
   bool m_rf_tx_indices;
   bool m_rf_tx_outputs;
+  bool m_rf_tx_keys;
   bool m_rf_spent_keys;
+  bool m_rf_spent_key_images;
   bool m_rf_txpool_meta;
   bool m_rf_txpool_blob;
   bool m_rf_hf_versions;
@@ -252,6 +261,7 @@ public:
 
   virtual output_data_t get_output_key(const uint64_t& amount, const uint64_t& index);
   virtual void get_output_key(const uint64_t &amount, const std::vector<uint64_t> &offsets, std::vector<output_data_t> &outputs, bool allow_partial = false);
+  virtual size_t get_output_keys_sorted(uint64_t amount, const uint64_t *offsets, size_t count, output_data_t *outputs);
 
   virtual tx_out_index get_output_tx_and_index_from_global(const uint64_t& index) const;
   virtual void get_output_tx_and_index_from_global(const std::vector<uint64_t> &global_indices,
@@ -325,6 +335,8 @@ public:
 
   bool get_output_distribution(uint64_t amount, uint64_t from_height, uint64_t to_height, std::vector<uint64_t> &distribution, uint64_t &base) const;
 
+  bool get_tx_key_stats(uint64_t &unique_keys, uint64_t &key_references) const;
+
 private:
   void do_resize(uint64_t size_increase=0);
 
@@ -420,6 +432,15 @@ private:
   // migrate from DB version 3 to 4
   void migrate_3_4();
 
+  // migrate from DB version 4 to 5
+  void migrate_4_5();
+
+  // migrate from DB version 5 to 6
+  void migrate_5_6();
+
+  // migrate from DB version 6 to 7
+  void migrate_6_7();
+
   void cleanup_batch();
 
 private:
@@ -435,11 +456,14 @@ private:
   MDB_dbi m_txs_prunable_hash;
   MDB_dbi m_tx_indices;
   MDB_dbi m_tx_outputs;
+  MDB_dbi m_tx_keys;
 
   MDB_dbi m_output_txs;
   MDB_dbi m_output_amounts;
+  MDB_dbi m_output_pubkeys;
 
   MDB_dbi m_spent_keys;
+  MDB_dbi m_spent_key_images;
 
   MDB_dbi m_txpool_meta;
   MDB_dbi m_txpool_blob;
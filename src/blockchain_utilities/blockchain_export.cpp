@@ -55,6 +55,7 @@ int main(int argc, char* argv[])
   uint32_t log_level = 0;
   uint64_t block_stop = 0;
   bool blocks_dat = false;
+  bool indexed = false;
 
   tools::on_startup();
 
@@ -69,6 +70,7 @@ int main(int argc, char* argv[])
     "database", available_dbs.c_str(), default_db_type
   };
   const command_line::arg_descriptor<bool> arg_blocks_dat = {"blocksdat", "Output in blocks.dat format", blocks_dat};
+  const command_line::arg_descriptor<bool> arg_indexed = {"indexed", "Output in the indexed (v2) bootstrap format, for random access on import", indexed};
 
 
   command_line::add_arg(desc_cmd_sett, cryptonote::arg_data_dir);
@@ -79,6 +81,7 @@ int main(int argc, char* argv[])
   command_line::add_arg(desc_cmd_sett, arg_database);
   command_line::add_arg(desc_cmd_sett, arg_block_stop);
   command_line::add_arg(desc_cmd_sett, arg_blocks_dat);
+  command_line::add_arg(desc_cmd_sett, arg_indexed);
 
   command_line::add_arg(desc_cmd_only, command_line::arg_help);
 
@@ -119,6 +122,12 @@ int main(int argc, char* argv[])
     return 1;
   }
   bool opt_blocks_dat = command_line::get_arg(vm, arg_blocks_dat);
+  bool opt_indexed = command_line::get_arg(vm, arg_indexed);
+  if (opt_blocks_dat && opt_indexed)
+  {
+    std::cerr << "Can't specify both --blocksdat and --indexed" << std::endl;
+    return 1;
+  }
 
   std::string m_config_folder;
 
@@ -189,7 +198,7 @@ int main(int argc, char* argv[])
   else
   {
     BootstrapFile bootstrap;
-    r = bootstrap.store_blockchain_raw(core_storage, NULL, output_file_path, block_stop);
+    r = bootstrap.store_blockchain_raw(core_storage, NULL, output_file_path, block_stop, opt_indexed);
   }
   CHECK_AND_ASSERT_MES(r, 1, "Failed to export blockchain raw data");
   LOG_PRINT_L0("Blockchain raw data exported OK");
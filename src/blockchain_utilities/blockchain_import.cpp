@@ -29,10 +29,14 @@
 #include <atomic>
 #include <cstdio>
 #include <algorithm>
+#include <deque>
 #include <fstream>
+#include <memory>
 
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/stream.hpp>
 #include <unistd.h>
 #include "misc_log_ex.h"
 #include "bootstrap_file.h"
@@ -41,6 +45,7 @@
 #include "serialization/binary_utils.h" // dump_binary(), parse_binary()
 #include "serialization/json_utils.h" // dump_json()
 #include "include_base_utils.h"
+#include "common/threadpool.h"
 #include "blockchain_db/db_types.h"
 #include "cryptonote_core/cryptonote_core.h"
 
@@ -165,7 +170,95 @@ int pop_blocks(cryptonote::core& core, int num_blocks)
   return num_blocks;
 }
 
-int check_flush(cryptonote::core &core, std::vector<block_complete_entry> &blocks, bool force)
+namespace
+{
+// The import runs as a pipeline: a reader thread streams chunks from the
+// bootstrap file, a prep thread parses and hashes them over the thread pool
+// (and checks tx signatures, which do not depend on the chain, ahead of the
+// tip), and the calling thread adds them to the db in order.
+
+// number of blocks handed from one stage to the next at once
+const size_t pipeline_span_size = 100;
+// number of spans a stage may run ahead of the next one
+const size_t pipeline_queue_spans = 8;
+
+// A bounded queue between two stages of the pipeline. push() blocks while
+// the queue is full and pop() while it is empty. Once closed, push() fails
+// and pop() fails when the queue is drained, so either side can stop the
+// other.
+template<typename T>
+class stage_queue
+{
+public:
+  stage_queue(size_t max_size): m_max_size(max_size), m_closed(false) {}
+
+  bool push(T &&t)
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    while (!m_closed && m_queue.size() >= m_max_size)
+      m_cond_push.wait(lock);
+    if (m_closed)
+      return false;
+    m_queue.push_back(std::move(t));
+    m_cond_pop.notify_one();
+    return true;
+  }
+
+  bool pop(T &t)
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    while (!m_closed && m_queue.empty())
+      m_cond_pop.wait(lock);
+    if (m_queue.empty())
+      return false;
+    t = std::move(m_queue.front());
+    m_queue.pop_front();
+    m_cond_push.notify_one();
+    return true;
+  }
+
+  void close()
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    m_closed = true;
+    m_cond_push.notify_all();
+    m_cond_pop.notify_all();
+  }
+
+private:
+  boost::mutex m_mutex;
+  boost::condition_variable m_cond_push;
+  boost::condition_variable m_cond_pop;
+  std::deque<T> m_queue;
+  size_t m_max_size;
+  bool m_closed;
+};
+
+struct raw_block
+{
+  uint64_t height;
+  std::string package;
+  const char* data; // for indexed files, the chunk in the mapping instead of package
+  uint32_t size;
+  crypto::hash checksum;
+  uint64_t next_batch_bytes; // if a batch ends at this block (unverified import)
+};
+
+struct prepared_block
+{
+  uint64_t height;
+  bootstrap::block_package bp; // txs are dropped once serialized when verifying
+  block_complete_entry entry;  // only when verifying
+  crypto::hash id;
+  Blockchain::tx_signature_results signatures;
+  uint64_t next_batch_bytes;
+};
+
+typedef stage_queue<std::vector<raw_block>> raw_queue;
+typedef stage_queue<std::vector<prepared_block>> prepared_queue;
+}
+
+int check_flush(cryptonote::core &core, std::vector<block_complete_entry> &blocks, std::vector<crypto::hash> &hashes, Blockchain::tx_signature_results &signatures, bool force)
 {
   if (blocks.empty())
     return 0;
@@ -177,21 +270,9 @@ int check_flush(cryptonote::core &core, std::vector<block_complete_entry> &block
   if (!force && new_height % HASH_OF_HASHES_STEP)
     return 0;
 
-  std::vector<crypto::hash> hashes;
-  for (const auto &b: blocks)
-  {
-    cryptonote::block block;
-    if (!parse_and_validate_block_from_blob(b.block, block))
-    {
-      MERROR("Failed to parse block: "
-          << epee::string_tools::pod_to_hex(get_blob_hash(b.block)));
-      core.cleanup_handle_incoming_blocks();
-      return 1;
-    }
-    hashes.push_back(cryptonote::get_block_hash(block));
-  }
   core.prevalidate_block_hashes(core.get_blockchain_storage().get_db().height(), hashes);
 
+  core.get_blockchain_storage().add_prechecked_tx_signatures(signatures);
   core.prepare_handle_incoming_blocks(blocks);
 
   for(const block_complete_entry& block_entry: blocks)
@@ -235,9 +316,284 @@ int check_flush(cryptonote::core &core, std::vector<block_complete_entry> &block
     return 1;
 
   blocks.clear();
+  hashes.clear();
+  signatures.clear();
   return 0;
 }
 
+// Reader stage: streams the chunks for heights h to block_stop from the
+// bootstrap file. Returns 1 at the end of the file or at block_stop, 2 on
+// error or if the next stage stopped.
+int read_blocks(std::ifstream& import_file, BootstrapFile& bootstrap, uint64_t h, uint64_t block_stop, bool use_batch, raw_queue& out)
+{
+  std::string str1;
+  char buffer1[1024];
+  std::vector<char> buffer_block(BUFFER_SIZE);
+  std::vector<raw_block> span;
+  uint64_t bytes_read = 0;
+  int quit = 0;
+
+  while (! quit)
+  {
+    uint32_t chunk_size;
+    import_file.read(buffer1, sizeof(chunk_size));
+    // TODO: bootstrap.read_chunk();
+    if (! import_file) {
+      std::cout << refresh_string;
+      MINFO("End of file reached");
+      quit = 1;
+      break;
+    }
+    bytes_read += sizeof(chunk_size);
+
+    str1.assign(buffer1, sizeof(chunk_size));
+    if (! ::serialization::parse_binary(str1, chunk_size))
+    {
+      MFATAL("Error in deserialization of chunk size");
+      quit = 2;
+      break;
+    }
+    MDEBUG("chunk_size: " << chunk_size);
+
+    if (chunk_size > BUFFER_SIZE)
+    {
+      MWARNING("WARNING: chunk_size " << chunk_size << " > BUFFER_SIZE " << BUFFER_SIZE);
+      MFATAL("Aborting: chunk size exceeds buffer size");
+      quit = 2;
+      break;
+    }
+    if (chunk_size > CHUNK_SIZE_WARNING_THRESHOLD)
+    {
+      MINFO("NOTE: chunk_size " << chunk_size << " > " << CHUNK_SIZE_WARNING_THRESHOLD);
+    }
+    else if (chunk_size == 0) {
+      MFATAL("ERROR: chunk_size == 0");
+      quit = 2;
+      break;
+    }
+    import_file.read(buffer_block.data(), chunk_size);
+    if (! import_file) {
+      if (import_file.eof())
+      {
+        std::cout << refresh_string;
+        MINFO("End of file reached - file was truncated");
+        quit = 1;
+      }
+      else
+      {
+        MFATAL("ERROR: unexpected end of file: bytes read before error: "
+            << import_file.gcount() << " of chunk_size " << chunk_size);
+        quit = 2;
+      }
+      break;
+    }
+    bytes_read += chunk_size;
+    MDEBUG("Total bytes read: " << bytes_read);
+
+    if (h > block_stop)
+    {
+      std::cout << refresh_string << "block " << h-1
+        << " / " << block_stop
+        << std::flush;
+      std::cout << ENDL << ENDL;
+      MINFO("Specified block number reached - stopping.  block: " << h-1 << "  total blocks: " << h);
+      quit = 1;
+      break;
+    }
+
+    // NOTE: use of NUM_BLOCKS_PER_CHUNK is a placeholder in case multi-block chunks are later supported.
+    raw_block raw;
+    raw.height = h;
+    raw.package.assign(buffer_block.data(), chunk_size);
+    raw.data = NULL;
+    raw.size = 0;
+    raw.next_batch_bytes = 0;
+    span.push_back(std::move(raw));
+    h += NUM_BLOCKS_PER_CHUNK;
+
+    // size the next batch while we have the file at hand
+    if (use_batch && (h-1) % db_batch_size == 0)
+    {
+      uint64_t h2;
+      bool q2;
+      std::streampos pos = import_file.tellg();
+      span.back().next_batch_bytes = bootstrap.count_bytes(import_file, db_batch_size, h2, q2);
+      if (import_file.eof())
+        import_file.clear();
+      import_file.seekg(pos);
+    }
+
+    if (span.size() >= pipeline_span_size)
+    {
+      if (!out.push(std::move(span)))
+        quit = 2;
+      span.clear();
+    }
+  } // while
+
+  if (quit == 1 && !span.empty())
+    out.push(std::move(span));
+  out.close();
+  return quit;
+}
+
+// Reader stage for indexed files: hands out the chunks for heights h to
+// block_stop straight from the mapping
+int read_indexed_blocks(const BootstrapFile& bootstrap, uint64_t h, uint64_t block_stop, bool use_batch, raw_queue& out)
+{
+  const uint64_t block_end = bootstrap.indexed_block_first() + bootstrap.indexed_num_blocks();
+  std::vector<raw_block> span;
+  int quit = 0;
+
+  for (; h <= block_stop && h < block_end; ++h)
+  {
+    raw_block raw;
+    raw.height = h;
+    raw.next_batch_bytes = 0;
+    if (!bootstrap.get_chunk(h, raw.data, raw.size, raw.checksum))
+    {
+      MFATAL("ERROR: bad index entry for block " << h);
+      quit = 2;
+      break;
+    }
+    if (use_batch && h % db_batch_size == 0)
+      raw.next_batch_bytes = bootstrap.indexed_bytes(h + 1, db_batch_size);
+    span.push_back(std::move(raw));
+
+    if (span.size() >= pipeline_span_size)
+    {
+      if (!out.push(std::move(span)))
+      {
+        quit = 2;
+        break;
+      }
+      span.clear();
+    }
+  }
+
+  if (!quit)
+  {
+    std::cout << refresh_string;
+    if (h > block_stop)
+      MINFO("Specified block number reached - stopping.  block: " << h-1 << "  total blocks: " << h);
+    else
+      MINFO("End of file reached");
+    quit = 1;
+    if (!span.empty())
+      out.push(std::move(span));
+  }
+  out.close();
+  return quit;
+}
+
+// deserializes a block package in place, without copying the chunk
+bool parse_package(const char* data, size_t size, bootstrap::block_package& bp)
+{
+  boost::iostreams::stream<boost::iostreams::array_source> stream(data, size);
+  binary_archive<false> ar(stream);
+  return ::serialization::serialize(ar, bp);
+}
+
+bool prepare_block(const raw_block& raw, prepared_block& b, std::vector<crypto::hash>& prefix_hashes)
+{
+  b.height = raw.height;
+  b.next_batch_bytes = raw.next_batch_bytes;
+  try
+  {
+    const char *data = raw.data ? raw.data : raw.package.data();
+    const size_t size = raw.data ? raw.size : raw.package.size();
+    if (raw.data && crypto::cn_fast_hash(data, size) != raw.checksum)
+    {
+      MERROR("Checksum mismatch for chunk at height " << raw.height);
+      return false;
+    }
+    if (!parse_package(data, size, b.bp))
+      return false;
+    b.id = cryptonote::get_block_hash(b.bp.block);
+    if (opt_verify)
+    {
+      cryptonote::block_to_blob(b.bp.block, b.entry.block);
+      b.entry.txs.reserve(b.bp.txs.size());
+      prefix_hashes.reserve(b.bp.txs.size());
+      for (const auto &tx: b.bp.txs)
+      {
+        b.entry.txs.push_back(cryptonote::blobdata());
+        cryptonote::tx_to_blob(tx, b.entry.txs.back());
+        prefix_hashes.push_back(cryptonote::get_transaction_prefix_hash(tx));
+      }
+    }
+  }
+  catch (const std::exception &e)
+  {
+    MERROR("Exception parsing block at height " << raw.height << ": " << e.what());
+    return false;
+  }
+  return true;
+}
+
+// Prep stage: parses and hashes each span over the thread pool, and checks
+// its tx signatures when verifying. Returns false if a block failed to parse.
+bool prepare_blocks(raw_queue& in, prepared_queue& out)
+{
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  std::vector<raw_block> raw;
+  bool success = true;
+
+  while (in.pop(raw))
+  {
+    std::vector<prepared_block> span(raw.size());
+    std::vector<std::vector<crypto::hash>> prefix_hashes(raw.size());
+    std::unique_ptr<bool[]> parsed(new bool[raw.size()]);
+    tools::threadpool::waiter waiter;
+    for (size_t i = 0; i < raw.size(); ++i)
+      tpool.submit(&waiter, [&raw, &span, &prefix_hashes, &parsed, i]() { parsed[i] = prepare_block(raw[i], span[i], prefix_hashes[i]); }, true);
+    waiter.wait(&tpool);
+
+    for (size_t i = 0; i < raw.size() && success; ++i)
+    {
+      if (!parsed[i])
+      {
+        std::cout << refresh_string;
+        MFATAL("Error in deserialization of chunk at height " << raw[i].height);
+        success = false;
+      }
+    }
+    if (!success)
+      break;
+
+    if (opt_verify)
+    {
+      std::vector<std::pair<const transaction*, crypto::hash>> txes;
+      for (size_t i = 0; i < span.size(); ++i)
+        for (size_t n = 0; n < span[i].bp.txs.size(); ++n)
+          txes.push_back(std::make_pair(&span[i].bp.txs[n], prefix_hashes[i][n]));
+      Blockchain::tx_signature_results signatures;
+      Blockchain::check_tx_signatures(txes, signatures);
+
+      // keep each block's results with it, the writer hands them over with
+      // the blocks they belong to
+      for (size_t i = 0; i < span.size(); ++i)
+      {
+        for (const crypto::hash &prefix_hash: prefix_hashes[i])
+        {
+          const auto it = signatures.find(prefix_hash);
+          if (it != signatures.end())
+            span[i].signatures.insert(*it);
+        }
+        span[i].bp.txs.clear();
+        span[i].bp.txs.shrink_to_fit();
+      }
+    }
+
+    if (!out.push(std::move(span)))
+      break;
+  }
+
+  in.close();
+  out.close();
+  return success;
+}
+
 int import_from_file(cryptonote::core& core, const std::string& import_file_path, uint64_t block_stop=0)
 {
   // Reset stats, in case we're using newly created db, accumulating stats
@@ -260,8 +616,22 @@ int import_from_file(cryptonote::core& core, const std::string& import_file_path
   seek_height = start_height;
   BootstrapFile bootstrap;
   std::streampos pos;
-  // BootstrapFile bootstrap(import_file_path);
-  uint64_t total_source_blocks = bootstrap.count_blocks(import_file_path, pos, seek_height);
+  uint64_t total_source_blocks;
+  // indexed files are mapped, and blocks found without scanning the file
+  const bool indexed = bootstrap.open_indexed(import_file_path);
+  if (indexed)
+  {
+    total_source_blocks = bootstrap.indexed_block_first() + bootstrap.indexed_num_blocks();
+    if (start_height < bootstrap.indexed_block_first())
+    {
+      MFATAL("bootstrap file starts at block " << bootstrap.indexed_block_first() << ", past the blockchain height " << start_height);
+      return 1;
+    }
+  }
+  else
+  {
+    total_source_blocks = bootstrap.count_blocks(import_file_path, pos, seek_height);
+  }
   MINFO("bootstrap file last block number: " << total_source_blocks-1 << " (zero-based height)  total blocks: " << total_source_blocks);
 
   if (total_source_blocks-1 <= start_height)
@@ -274,26 +644,23 @@ int import_from_file(cryptonote::core& core, const std::string& import_file_path
   std::cout << ENDL;
 
   std::ifstream import_file;
-  import_file.open(import_file_path, std::ios_base::binary | std::ifstream::in);
-
   uint64_t h = 0;
   uint64_t num_imported = 0;
-  if (import_file.fail())
+  if (!indexed)
   {
-    MFATAL("import_file.open() fail");
-    return false;
-  }
+    import_file.open(import_file_path, std::ios_base::binary | std::ifstream::in);
 
-  // 4 byte magic + (currently) 1024 byte header structures
-  bootstrap.seek_to_first_chunk(import_file);
+    if (import_file.fail())
+    {
+      MFATAL("import_file.open() fail");
+      return 1;
+    }
+
+    // 4 byte magic + (currently) 1024 byte header structures
+    bootstrap.seek_to_first_chunk(import_file);
+  }
 
-  std::string str1;
-  char buffer1[1024];
-  char buffer_block[BUFFER_SIZE];
-  block b;
-  transaction tx;
   int quit = 0;
-  uint64_t bytes_read;
 
   // Note that a new blockchain will start with block number 0 (total blocks: 1)
   // due to genesis block being added at initialization.
@@ -314,21 +681,31 @@ int import_from_file(cryptonote::core& core, const std::string& import_file_path
   std::cout << ENDL;
 
   std::vector<block_complete_entry> blocks;
+  std::vector<crypto::hash> hashes;
+  Blockchain::tx_signature_results signatures;
 
   // Skip to start_height before we start adding.
+  if (indexed)
+  {
+    h = start_height;
+  }
+  else
   {
     bool q2 = false;
     import_file.seekg(pos);
-    bytes_read = bootstrap.count_bytes(import_file, start_height-seek_height, h, q2);
+    bootstrap.count_bytes(import_file, start_height-seek_height, h, q2);
     if (q2)
     {
       quit = 2;
-      goto quitting;
     }
     h = start_height;
   }
 
-  if (use_batch)
+  if (use_batch && !quit && indexed)
+  {
+    core.get_blockchain_storage().get_db().batch_start(db_batch_size, bootstrap.indexed_bytes(h, db_batch_size));
+  }
+  else if (use_batch && !quit)
   {
     uint64_t bytes, h2;
     bool q2;
@@ -339,82 +716,30 @@ int import_from_file(cryptonote::core& core, const std::string& import_file_path
     import_file.seekg(pos);
     core.get_blockchain_storage().get_db().batch_start(db_batch_size, bytes);
   }
-  while (! quit)
-  {
-    uint32_t chunk_size;
-    import_file.read(buffer1, sizeof(chunk_size));
-    // TODO: bootstrap.read_chunk();
-    if (! import_file) {
-      std::cout << refresh_string;
-      MINFO("End of file reached");
-      quit = 1;
-      break;
-    }
-    bytes_read += sizeof(chunk_size);
 
-    str1.assign(buffer1, sizeof(chunk_size));
-    if (! ::serialization::parse_binary(str1, chunk_size))
-    {
-      throw std::runtime_error("Error in deserialization of chunk size");
-    }
-    MDEBUG("chunk_size: " << chunk_size);
-
-    if (chunk_size > BUFFER_SIZE)
-    {
-      MWARNING("WARNING: chunk_size " << chunk_size << " > BUFFER_SIZE " << BUFFER_SIZE);
-      throw std::runtime_error("Aborting: chunk size exceeds buffer size");
-    }
-    if (chunk_size > CHUNK_SIZE_WARNING_THRESHOLD)
-    {
-      MINFO("NOTE: chunk_size " << chunk_size << " > " << CHUNK_SIZE_WARNING_THRESHOLD);
-    }
-    else if (chunk_size == 0) {
-      MFATAL("ERROR: chunk_size == 0");
-      return 2;
-    }
-    import_file.read(buffer_block, chunk_size);
-    if (! import_file) {
-      if (import_file.eof())
-      {
-        std::cout << refresh_string;
-        MINFO("End of file reached - file was truncated");
-        quit = 1;
-        break;
-      }
+  if (!quit)
+  {
+    raw_queue raw_blocks(pipeline_queue_spans);
+    prepared_queue prepared_blocks(pipeline_queue_spans);
+    int read_quit = 0;
+    bool prepared = true;
+    const uint64_t first_height = h;
+    boost::thread reader([&]() {
+      if (indexed)
+        read_quit = read_indexed_blocks(bootstrap, first_height, block_stop, use_batch, raw_blocks);
       else
-      {
-        MFATAL("ERROR: unexpected end of file: bytes read before error: "
-            << import_file.gcount() << " of chunk_size " << chunk_size);
-        return 2;
-      }
-    }
-    bytes_read += chunk_size;
-    MDEBUG("Total bytes read: " << bytes_read);
-
-    if (h > block_stop)
+        read_quit = read_blocks(import_file, bootstrap, first_height, block_stop, use_batch, raw_blocks);
+    });
+    boost::thread preparer([&]() { prepared = prepare_blocks(raw_blocks, prepared_blocks); });
+
+    const int display_interval = 1000;
+    const int progress_interval = 10;
+    std::vector<prepared_block> span;
+    while (!quit && prepared_blocks.pop(span))
     {
-      std::cout << refresh_string << "block " << h-1
-        << " / " << block_stop
-        << std::flush;
-      std::cout << ENDL << ENDL;
-      MINFO("Specified block number reached - stopping.  block: " << h-1 << "  total blocks: " << h);
-      quit = 1;
-      break;
-    }
-
-    try
-    {
-      str1.assign(buffer_block, chunk_size);
-      bootstrap::block_package bp;
-      if (! ::serialization::parse_binary(str1, bp))
-        throw std::runtime_error("Error in deserialization of chunk");
-
-      int display_interval = 1000;
-      int progress_interval = 10;
-      // NOTE: use of NUM_BLOCKS_PER_CHUNK is a placeholder in case multi-block chunks are later supported.
-      for (int chunk_ind = 0; chunk_ind < NUM_BLOCKS_PER_CHUNK; ++chunk_ind)
+      for (prepared_block &pb: span)
       {
-        ++h;
+        h = pb.height + 1;
         if ((h-1) % display_interval == 0)
         {
           std::cout << refresh_string;
@@ -424,7 +749,7 @@ int import_from_file(cryptonote::core& core, const std::string& import_file_path
         {
           MDEBUG("loading block number " << h-1);
         }
-        b = bp.block;
+        const block &b = pb.bp.block;
         MDEBUG("block prev_id: " << b.prev_id << ENDL);
 
         if ((h-1) % progress_interval == 0)
@@ -436,16 +761,10 @@ int import_from_file(cryptonote::core& core, const std::string& import_file_path
 
         if (opt_verify)
         {
-          cryptonote::blobdata block;
-          cryptonote::block_to_blob(bp.block, block);
-          std::vector<cryptonote::blobdata> txs;
-          for (const auto &tx: bp.txs)
-          {
-            txs.push_back(cryptonote::blobdata());
-            cryptonote::tx_to_blob(tx, txs.back());
-          }
-          blocks.push_back({block, txs});
-          int ret = check_flush(core, blocks, false);
+          blocks.push_back(std::move(pb.entry));
+          hashes.push_back(pb.id);
+          signatures.insert(pb.signatures.begin(), pb.signatures.end());
+          int ret = check_flush(core, blocks, hashes, signatures, false);
           if (ret)
           {
             quit = 2; // make sure we don't commit partial block data
@@ -454,33 +773,26 @@ int import_from_file(cryptonote::core& core, const std::string& import_file_path
         }
         else
         {
-          std::vector<transaction> txs;
-          std::vector<transaction> archived_txs;
-
-          archived_txs = bp.txs;
-
           // tx number 1: coinbase tx
           // tx number 2 onwards: archived_txs
-          for (const transaction &tx : archived_txs)
-          {
-            // add blocks with verification.
-            // for Blockchain and blockchain_storage add_new_block().
-            // for add_block() method, without (much) processing.
-            // don't add coinbase transaction to txs.
-            //
-            // because add_block() calls
-            // add_transaction(blk_hash, blk.miner_tx) first, and
-            // then a for loop for the transactions in txs.
-            txs.push_back(tx);
-          }
+          //
+          // add blocks with verification.
+          // for Blockchain and blockchain_storage add_new_block().
+          // for add_block() method, without (much) processing.
+          // don't add coinbase transaction to txs.
+          //
+          // because add_block() calls
+          // add_transaction(blk_hash, blk.miner_tx) first, and
+          // then a for loop for the transactions in txs.
+          const std::vector<transaction> &txs = pb.bp.txs;
 
           size_t block_weight;
           difficulty_type cumulative_difficulty;
           uint64_t coins_generated;
 
-          block_weight = bp.block_weight;
-          cumulative_difficulty = bp.cumulative_difficulty;
-          coins_generated = bp.coins_generated;
+          block_weight = pb.bp.block_weight;
+          cumulative_difficulty = pb.bp.cumulative_difficulty;
+          coins_generated = pb.bp.coins_generated;
 
           try
           {
@@ -499,16 +811,11 @@ int import_from_file(cryptonote::core& core, const std::string& import_file_path
           {
             if ((h-1) % db_batch_size == 0)
             {
-              uint64_t bytes, h2;
-              bool q2;
               std::cout << refresh_string;
               // zero-based height
               std::cout << ENDL << "[- batch commit at height " << h-1 << " -]" << ENDL;
               core.get_blockchain_storage().get_db().batch_stop();
-              pos = import_file.tellg();
-              bytes = bootstrap.count_bytes(import_file, db_batch_size, h2, q2);
-              import_file.seekg(pos);
-              core.get_blockchain_storage().get_db().batch_start(db_batch_size, bytes);
+              core.get_blockchain_storage().get_db().batch_start(db_batch_size, pb.next_batch_bytes);
               std::cout << ENDL;
               core.get_blockchain_storage().get_db().show_stats();
             }
@@ -516,21 +823,23 @@ int import_from_file(cryptonote::core& core, const std::string& import_file_path
         }
         ++num_imported;
       }
-    }
-    catch (const std::exception& e)
-    {
-      std::cout << refresh_string;
-      MFATAL("exception while reading from file, height=" << h << ": " << e.what());
-      return 2;
-    }
-  } // while
+    } // while
+
+    // stop the other stages if we bailed out early
+    prepared_blocks.close();
+    raw_blocks.close();
+    reader.join();
+    preparer.join();
+    if (!quit)
+      quit = prepared ? read_quit : 2;
+  }
 
-quitting:
   import_file.close();
+  bootstrap.close_indexed();
 
-  if (opt_verify)
+  if (opt_verify && quit < 2)
   {
-    int ret = check_flush(core, blocks, true);
+    int ret = check_flush(core, blocks, hashes, signatures, true);
     if (ret)
       return ret;
   }
@@ -555,7 +864,7 @@ quitting:
     MINFO("Finished at block: " << h-1 << "  total blocks: " << h);
 
   std::cout << ENDL;
-  return 0;
+  return quit > 1 ? 2 : 0;
 }
 
 int main(int argc, char* argv[])
@@ -256,6 +256,21 @@ int main(int argc, char* argv[])
     MINFO("No outputs to process");
   }
 
+  uint64_t unique_keys, key_references;
+  if (core_storage->get_db().get_tx_key_stats(unique_keys, key_references) && unique_keys > 0)
+  {
+    const float ratio = (float)key_references / unique_keys;
+    // each reference still costs a key hash and a varint gap of at least a
+    // byte in the pruned blob, and each unique key a key hash and a refcount
+    // on top of the key itself in tx_keys
+    const uint64_t inline_size = key_references * sizeof(crypto::public_key);
+    const uint64_t interned_size = key_references * (sizeof(crypto::hash) + 1) + unique_keys * (sizeof(crypto::public_key) + sizeof(crypto::hash) + sizeof(uint64_t));
+    if (inline_size >= interned_size)
+      MINFO(std::to_string(key_references) << " tx keys stored as " << unique_keys << " unique keys (dedup ratio " << ratio << ", at most " << inline_size - interned_size << " bytes saved)");
+    else
+      MINFO(std::to_string(key_references) << " tx keys stored as " << unique_keys << " unique keys (dedup ratio " << ratio << ", at least " << interned_size - inline_size << " bytes more than inline keys)");
+  }
+
   LOG_PRINT_L0("Blockchain usage exported OK");
   return 0;
 
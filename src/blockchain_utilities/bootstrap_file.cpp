@@ -26,9 +26,18 @@
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 #include "bootstrap_serialization.h"
 #include "serialization/binary_utils.h" // dump_binary(), parse_binary()
 #include "serialization/json_utils.h" // dump_json()
+#include "common/int-util.h"
 
 #include "bootstrap_file.h"
 
@@ -47,10 +56,26 @@ namespace
   const uint32_t blockchain_raw_magic = 0x28721586;
   const uint32_t header_size = 1024;
 
+  // Leading 4 bytes of: echo Monero bootstrap index | sha1sum
+  const uint32_t blockchain_index_magic = 0xa60eeb98;
+  // file_info major version of indexed files, plain ones are 0
+  const uint8_t indexed_major_version = 1;
+
   std::string refresh_string = "\r                                    \r";
 }
 
 
+BootstrapFile::BootstrapFile():
+  m_blockchain_storage(NULL), m_tx_pool(NULL), m_raw_data_file(NULL), m_output_stream(NULL),
+  m_height(0), m_cur_height(0), m_max_chunk(0), m_indexed(false), m_block_first(0),
+  m_map(NULL), m_map_size(0), m_map_handle(NULL), m_footer(NULL), m_index_entries(NULL)
+{
+}
+
+BootstrapFile::~BootstrapFile()
+{
+  close_indexed();
+}
 
 bool BootstrapFile::open_writer(const boost::filesystem::path& file_path)
 {
@@ -88,7 +113,27 @@ bool BootstrapFile::open_writer(const boost::filesystem::path& file_path)
   }
   else
   {
-    num_blocks = count_blocks(file_path.string());
+    const bool existing_indexed = open_indexed(file_path.string());
+    if (existing_indexed != m_indexed)
+    {
+      MFATAL("existing file " << file_path << (existing_indexed ? " is" : " is not") << " an indexed bootstrap file");
+      close_indexed();
+      return false;
+    }
+    if (m_indexed)
+    {
+      m_block_first = indexed_block_first();
+      num_blocks = m_block_first + indexed_num_blocks();
+      m_index.assign(m_index_entries, m_index_entries + indexed_num_blocks());
+      const uint64_t index_offset = SWAP64LE(m_footer->index_offset);
+      close_indexed();
+      // new chunks go where the index was, it is written again on close
+      boost::filesystem::resize_file(file_path, index_offset);
+    }
+    else
+    {
+      num_blocks = count_blocks(file_path.string());
+    }
     MDEBUG("appending to existing file with height: " << num_blocks-1 << "  total blocks: " << num_blocks);
   }
   m_height = num_blocks;
@@ -124,8 +169,8 @@ bool BootstrapFile::initialize_file()
   *m_raw_data_file << blob;
 
   bootstrap::file_info bfi;
-  bfi.major_version = 0;
-  bfi.minor_version = 1;
+  bfi.major_version = m_indexed ? indexed_major_version : 0;
+  bfi.minor_version = m_indexed ? 0 : 1;
   bfi.header_size = header_size;
 
   bootstrap::blocks_info bbi;
@@ -191,6 +236,14 @@ void BootstrapFile::flush_chunk()
     m_max_chunk = chunk_size;
   }
   long pos_before = m_raw_data_file->tellp();
+  if (m_indexed)
+  {
+    bootstrap::chunk_index_entry entry;
+    entry.offset = SWAP64LE((uint64_t)pos_before);
+    entry.size = SWAP32LE(chunk_size);
+    crypto::cn_fast_hash(m_buffer.data(), m_buffer.size(), entry.checksum);
+    m_index.push_back(entry);
+  }
   std::copy(m_buffer.begin(), m_buffer.end(), std::ostreambuf_iterator<char>(*m_raw_data_file));
   m_raw_data_file->flush();
   long pos_after = m_raw_data_file->tellp();
@@ -249,11 +302,25 @@ void BootstrapFile::write_block(block& block)
   m_output_stream->write((const char*)bd.data(), bd.size());
 }
 
+void BootstrapFile::write_index()
+{
+  bootstrap::index_footer footer;
+  footer.index_offset = SWAP64LE((uint64_t)m_raw_data_file->tellp());
+  footer.block_first = SWAP64LE(m_block_first);
+  footer.num_blocks = SWAP64LE((uint64_t)m_index.size());
+  footer.magic = SWAP32LE(blockchain_index_magic);
+  m_raw_data_file->write((const char*)m_index.data(), m_index.size() * sizeof(bootstrap::chunk_index_entry));
+  m_raw_data_file->write((const char*)&footer, sizeof(footer));
+  MINFO("Wrote index of " << m_index.size() << " blocks");
+}
+
 bool BootstrapFile::close()
 {
   if (m_raw_data_file->fail())
     return false;
 
+  if (m_indexed)
+    write_index();
   m_raw_data_file->flush();
   delete m_output_stream;
   delete m_raw_data_file;
@@ -261,10 +328,11 @@ bool BootstrapFile::close()
 }
 
 
-bool BootstrapFile::store_blockchain_raw(Blockchain* _blockchain_storage, tx_memory_pool* _tx_pool, boost::filesystem::path& output_file, uint64_t requested_block_stop)
+bool BootstrapFile::store_blockchain_raw(Blockchain* _blockchain_storage, tx_memory_pool* _tx_pool, boost::filesystem::path& output_file, uint64_t requested_block_stop, bool indexed)
 {
   uint64_t num_blocks_written = 0;
   m_max_chunk = 0;
+  m_indexed = indexed;
   m_blockchain_storage = _blockchain_storage;
   m_tx_pool = _tx_pool;
   uint64_t progress_interval = 100;
@@ -432,6 +500,13 @@ uint64_t BootstrapFile::count_bytes(std::ifstream& import_file, uint64_t blocks,
 
 uint64_t BootstrapFile::count_blocks(const std::string& import_file_path)
 {
+  if (open_indexed(import_file_path))
+  {
+    const uint64_t blocks = indexed_block_first() + indexed_num_blocks();
+    close_indexed();
+    return blocks;
+  }
+
   std::streampos dummy_pos;
   uint64_t dummy_height = 0;
   return count_blocks(import_file_path, dummy_pos, dummy_height);
@@ -501,3 +576,131 @@ uint64_t BootstrapFile::count_blocks(const std::string& import_file_path, std::s
   // one-based height.
   return h;
 }
+
+bool BootstrapFile::open_indexed(const std::string& import_file_path)
+{
+  close_indexed();
+
+  boost::system::error_code ec;
+  const uint64_t file_size = boost::filesystem::file_size(import_file_path, ec);
+  if (ec || file_size < sizeof(uint32_t) * 2 + header_size + sizeof(bootstrap::index_footer))
+    return false;
+  if (file_size != (size_t)file_size)
+  {
+    MWARNING("bootstrap file is too large to be mapped");
+    return false;
+  }
+
+#ifdef _WIN32
+  HANDLE file = CreateFileA(import_file_path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (file == INVALID_HANDLE_VALUE)
+    return false;
+  HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle(file);
+  if (mapping == NULL)
+    return false;
+  void *map = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if (map == NULL)
+  {
+    CloseHandle(mapping);
+    return false;
+  }
+  m_map_handle = mapping;
+#else
+  int fd = ::open(import_file_path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  void *map = mmap(NULL, file_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED)
+    return false;
+#endif
+  m_map = (const char*)map;
+  m_map_size = file_size;
+
+  // same header as plain files, with the indexed major version
+  uint32_t file_magic, file_info_size;
+  memcpy(&file_magic, m_map, sizeof(file_magic));
+  memcpy(&file_info_size, m_map + sizeof(file_magic), sizeof(file_info_size));
+  file_magic = SWAP32LE(file_magic);
+  file_info_size = SWAP32LE(file_info_size);
+  bootstrap::file_info bfi;
+  if (file_magic != blockchain_raw_magic || file_info_size > header_size
+      || !::serialization::parse_binary(std::string(m_map + sizeof(file_magic) + sizeof(file_info_size), file_info_size), bfi)
+      || bfi.major_version != indexed_major_version)
+  {
+    close_indexed();
+    return false;
+  }
+
+  m_footer = (const bootstrap::index_footer*)(m_map + m_map_size - sizeof(bootstrap::index_footer));
+  const uint64_t index_offset = SWAP64LE(m_footer->index_offset);
+  const uint64_t index_end = m_map_size - sizeof(bootstrap::index_footer);
+  if (SWAP32LE(m_footer->magic) != blockchain_index_magic || index_offset < sizeof(file_magic) + header_size || index_offset > index_end
+      || (index_end - index_offset) % sizeof(bootstrap::chunk_index_entry) != 0
+      || (index_end - index_offset) / sizeof(bootstrap::chunk_index_entry) != SWAP64LE(m_footer->num_blocks))
+  {
+    close_indexed();
+    MFATAL("bootstrap file index is corrupt: " << import_file_path);
+    throw std::runtime_error("Aborting");
+  }
+  m_index_entries = (const bootstrap::chunk_index_entry*)(m_map + index_offset);
+
+  MINFO("bootstrap file v" << unsigned(bfi.major_version) << "." << unsigned(bfi.minor_version) << ", indexed blocks "
+      << indexed_block_first() << " to " << indexed_block_first() + indexed_num_blocks() - 1);
+  return true;
+}
+
+void BootstrapFile::close_indexed()
+{
+  if (!m_map)
+    return;
+#ifdef _WIN32
+  UnmapViewOfFile(m_map);
+  CloseHandle((HANDLE)m_map_handle);
+#else
+  munmap((void*)m_map, m_map_size);
+#endif
+  m_map = NULL;
+  m_map_size = 0;
+  m_map_handle = NULL;
+  m_footer = NULL;
+  m_index_entries = NULL;
+}
+
+uint64_t BootstrapFile::indexed_block_first() const
+{
+  return m_footer ? SWAP64LE(m_footer->block_first) : 0;
+}
+
+uint64_t BootstrapFile::indexed_num_blocks() const
+{
+  return m_footer ? SWAP64LE(m_footer->num_blocks) : 0;
+}
+
+uint64_t BootstrapFile::indexed_bytes(uint64_t height, uint64_t blocks) const
+{
+  const uint64_t first = indexed_block_first();
+  const uint64_t num_blocks = indexed_num_blocks();
+  uint64_t bytes = 0;
+  for (uint64_t h = std::max(height, first); h - height < blocks && h - first < num_blocks; ++h)
+    bytes += sizeof(uint32_t) + SWAP32LE(m_index_entries[h - first].size);
+  return bytes;
+}
+
+bool BootstrapFile::get_chunk(uint64_t height, const char*& data, uint32_t& size, crypto::hash& checksum) const
+{
+  const uint64_t first = indexed_block_first();
+  if (!m_map || height < first || height - first >= indexed_num_blocks())
+    return false;
+
+  const bootstrap::chunk_index_entry &entry = m_index_entries[height - first];
+  const uint64_t offset = SWAP64LE(entry.offset);
+  const uint64_t index_offset = SWAP64LE(m_footer->index_offset);
+  size = SWAP32LE(entry.size);
+  if (size == 0 || size > BUFFER_SIZE || offset > index_offset || size > index_offset - offset)
+    return false;
+  data = m_map + offset;
+  checksum = entry.checksum;
+  return true;
+}
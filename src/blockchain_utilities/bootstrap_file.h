@@ -48,6 +48,7 @@
 #include "version.h"
 
 #include "blockchain_utilities.h"
+#include "bootstrap_serialization.h"
 
 
 using namespace cryptonote;
@@ -57,13 +58,30 @@ class BootstrapFile
 {
 public:
 
+  BootstrapFile();
+  ~BootstrapFile();
+
   uint64_t count_bytes(std::ifstream& import_file, uint64_t blocks, uint64_t& h, bool& quit);
   uint64_t count_blocks(const std::string& dir_path, std::streampos& start_pos, uint64_t& seek_height);
   uint64_t count_blocks(const std::string& dir_path);
   uint64_t seek_to_first_chunk(std::ifstream& import_file);
 
+  // Indexed (v2) files are memory mapped and their chunks found through the
+  // index, without reading the file up to them. open_indexed returns false
+  // if the file is not an indexed bootstrap file.
+  bool open_indexed(const std::string& import_file_path);
+  void close_indexed();
+  bool is_indexed() const { return m_map != NULL; }
+  uint64_t indexed_block_first() const;
+  uint64_t indexed_num_blocks() const;
+  // size of the chunks of blocks from height on
+  uint64_t indexed_bytes(uint64_t height, uint64_t blocks) const;
+  // chunk data for the block at height, pointing into the mapping, and the
+  // checksum the index has for it
+  bool get_chunk(uint64_t height, const char*& data, uint32_t& size, crypto::hash& checksum) const;
+
   bool store_blockchain_raw(cryptonote::Blockchain* cs, cryptonote::tx_memory_pool* txp,
-      boost::filesystem::path& output_file, uint64_t use_block_height=0);
+      boost::filesystem::path& output_file, uint64_t use_block_height=0, bool indexed=false);
 
 protected:
 
@@ -81,10 +99,23 @@ protected:
   bool close();
   void write_block(block& block);
   void flush_chunk();
+  void write_index();
 
 private:
 
   uint64_t m_height;
   uint64_t m_cur_height; // tracks current height during export
   uint32_t m_max_chunk;
+
+  // writing an indexed file
+  bool m_indexed;
+  uint64_t m_block_first;
+  std::vector<bootstrap::chunk_index_entry> m_index;
+
+  // mapping of an indexed file
+  const char* m_map;
+  uint64_t m_map_size;
+  void* m_map_handle;
+  const bootstrap::index_footer* m_footer;
+  const bootstrap::chunk_index_entry* m_index_entries;
 };
@@ -83,6 +83,26 @@ namespace cryptonote
       END_SERIALIZE()
     };
 
+    // Indexed (v2) files end with an index of their chunks, one entry per
+    // block from block_first on, then a footer. Both are fixed size and
+    // little endian, so they can be used straight from a mapping of the file.
+#pragma pack(push, 1)
+    struct chunk_index_entry
+    {
+      uint64_t offset; // of the chunk data, past its size
+      uint32_t size;
+      crypto::hash checksum; // cn_fast_hash of the chunk data
+    };
+
+    struct index_footer
+    {
+      uint64_t index_offset;
+      uint64_t block_first;
+      uint64_t num_blocks;
+      uint32_t magic;
+    };
+#pragma pack(pop)
+
   }
 
 }
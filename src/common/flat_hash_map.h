@@ -0,0 +1,276 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace tools
+{
+//! Open addressing hash map for large keys
+//!
+//! Entries are stored densely, in insertion order (until an erase moves
+//! the last entry into the hole), and a separate power of two table of
+//! small slots maps each entry's 64 bit hash to its position. Probes only
+//! touch the slot table, and keys are only compared when the full hashes
+//! match, so a lookup usually costs one key compare for a hit and none
+//! for a miss, whatever the key size.
+//!
+//! Only the std::unordered_map subset used in the tree is provided.
+//! Iterators and references are invalidated by any insertion or erase.
+template<typename K, typename V, typename Hash = std::hash<K>, typename KeyEqual = std::equal_to<K>>
+class flat_hash_map
+{
+public:
+  typedef K key_type;
+  typedef V mapped_type;
+  typedef std::pair<K, V> value_type; // the key must not be changed through iterators
+
+private:
+  struct entry
+  {
+    uint64_t hash;
+    value_type value;
+  };
+
+  template<typename E, typename T>
+  class iterator_base: public std::iterator<std::forward_iterator_tag, T>
+  {
+  public:
+    iterator_base(): m_entry(NULL) {}
+    explicit iterator_base(E *e): m_entry(e) {}
+    template<typename E2, typename T2>
+    iterator_base(const iterator_base<E2, T2> &other): m_entry(other.m_entry) {}
+
+    T &operator*() const { return m_entry->value; }
+    T *operator->() const { return &m_entry->value; }
+    iterator_base &operator++() { ++m_entry; return *this; }
+    iterator_base operator++(int) { iterator_base i(*this); ++m_entry; return i; }
+    template<typename E2, typename T2>
+    bool operator==(const iterator_base<E2, T2> &other) const { return m_entry == other.m_entry; }
+    template<typename E2, typename T2>
+    bool operator!=(const iterator_base<E2, T2> &other) const { return m_entry != other.m_entry; }
+
+  private:
+    template<typename, typename> friend class iterator_base;
+    friend class flat_hash_map;
+    E *m_entry;
+  };
+
+public:
+  typedef iterator_base<entry, value_type> iterator;
+  typedef iterator_base<const entry, const value_type> const_iterator;
+
+  flat_hash_map(): m_mask(0) {}
+
+  size_t size() const { return m_entries.size(); }
+  bool empty() const { return m_entries.empty(); }
+
+  iterator begin() { return iterator(m_entries.data()); }
+  iterator end() { return iterator(m_entries.data() + m_entries.size()); }
+  const_iterator begin() const { return const_iterator(m_entries.data()); }
+  const_iterator end() const { return const_iterator(m_entries.data() + m_entries.size()); }
+
+  void clear()
+  {
+    m_entries.clear();
+    m_slots.clear();
+    m_mask = 0;
+  }
+
+  void reserve(size_t n)
+  {
+    m_entries.reserve(n);
+    if (n > max_load(m_slots.size()))
+      rehash(n);
+  }
+
+  iterator find(const K &k)
+  {
+    const size_t slot = find_slot(k, hash_key(k));
+    return slot == npos ? end() : iterator(&m_entries[m_slots[slot].index]);
+  }
+
+  const_iterator find(const K &k) const
+  {
+    const size_t slot = find_slot(k, hash_key(k));
+    return slot == npos ? end() : const_iterator(&m_entries[m_slots[slot].index]);
+  }
+
+  size_t count(const K &k) const { return find_slot(k, hash_key(k)) == npos ? 0 : 1; }
+
+  V &at(const K &k)
+  {
+    const iterator i = find(k);
+    if (i == end())
+      throw std::out_of_range("key not found in flat_hash_map");
+    return i->second;
+  }
+
+  const V &at(const K &k) const
+  {
+    const const_iterator i = find(k);
+    if (i == end())
+      throw std::out_of_range("key not found in flat_hash_map");
+    return i->second;
+  }
+
+  template<typename... Args>
+  std::pair<iterator, bool> emplace(const K &k, Args&&... args)
+  {
+    const uint64_t h = hash_key(k);
+    const size_t slot = find_slot(k, h);
+    if (slot != npos)
+      return std::make_pair(iterator(&m_entries[m_slots[slot].index]), false);
+    if (m_entries.size() + 1 > max_load(m_slots.size()))
+      rehash(m_entries.size() + 1);
+    m_entries.push_back(entry{h, value_type(std::piecewise_construct, std::forward_as_tuple(k), std::forward_as_tuple(std::forward<Args>(args)...))});
+    place(h, m_entries.size() - 1);
+    return std::make_pair(iterator(&m_entries.back()), true);
+  }
+
+  std::pair<iterator, bool> insert(const value_type &v) { return emplace(v.first, v.second); }
+
+  V &operator[](const K &k) { return emplace(k).first->second; }
+
+  size_t erase(const K &k)
+  {
+    size_t slot = find_slot(k, hash_key(k));
+    if (slot == npos)
+      return 0;
+
+    // move the last entry into the erased entry's place
+    const uint32_t index = m_slots[slot].index;
+    const uint32_t last = m_entries.size() - 1;
+    if (index != last)
+    {
+      size_t last_slot = m_entries[last].hash & m_mask;
+      while (m_slots[last_slot].index != last)
+        last_slot = (last_slot + 1) & m_mask;
+      m_slots[last_slot].index = index;
+      m_entries[index] = std::move(m_entries[last]);
+    }
+    m_entries.pop_back();
+
+    // backward shift the rest of the run into the hole, so that no
+    // tombstones are needed: a slot may fill the hole if its home slot
+    // is not between the hole and itself
+    for (size_t i = (slot + 1) & m_mask; m_slots[i].index != empty_slot; i = (i + 1) & m_mask)
+    {
+      const size_t home = m_slots[i].hash & m_mask;
+      if (((i - home) & m_mask) >= ((i - slot) & m_mask))
+      {
+        m_slots[slot] = m_slots[i];
+        slot = i;
+      }
+    }
+    m_slots[slot].index = empty_slot;
+    return 1;
+  }
+
+  iterator erase(const_iterator i)
+  {
+    const size_t index = i.m_entry - m_entries.data();
+    erase(i->first);
+    return iterator(m_entries.data() + index);
+  }
+
+private:
+  struct slot
+  {
+    uint64_t hash;
+    uint32_t index;
+  };
+
+  static const uint32_t empty_slot = 0xffffffff;
+  static const size_t npos = (size_t)-1;
+
+  // at most 7/8 full
+  static size_t max_load(size_t slots) { return slots - slots / 8; }
+
+  // finalizer from murmur3, so that hashers returning a key's first word,
+  // or small integers, still spread over the slots
+  uint64_t hash_key(const K &k) const
+  {
+    uint64_t h = m_hash(k);
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+  }
+
+  size_t find_slot(const K &k, uint64_t h) const
+  {
+    if (m_slots.empty())
+      return npos;
+    for (size_t i = h & m_mask; ; i = (i + 1) & m_mask)
+    {
+      const slot &s = m_slots[i];
+      if (s.index == empty_slot)
+        return npos;
+      if (s.hash == h && m_equal(m_entries[s.index].value.first, k))
+        return i;
+    }
+  }
+
+  void place(uint64_t h, uint32_t index)
+  {
+    size_t i = h & m_mask;
+    while (m_slots[i].index != empty_slot)
+      i = (i + 1) & m_mask;
+    m_slots[i].hash = h;
+    m_slots[i].index = index;
+  }
+
+  void rehash(size_t n)
+  {
+    size_t slots = 8;
+    while (max_load(slots) < n)
+      slots *= 2;
+    m_slots.assign(slots, slot{0, empty_slot});
+    m_mask = slots - 1;
+    for (size_t i = 0; i < m_entries.size(); ++i)
+      place(m_entries[i].hash, i);
+  }
+
+  std::vector<entry> m_entries;
+  std::vector<slot> m_slots;
+  size_t m_mask;
+  Hash m_hash;
+  KeyEqual m_equal;
+};
+}
@@ -0,0 +1,109 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <boost/thread/shared_mutex.hpp>
+
+namespace tools
+{
+//! Reader/writer lock whose exclusive side is recursive.
+//!
+//! The thread holding it exclusively may lock it again, either way,
+//! without blocking, so code that calls back into an object it locked
+//! keeps working. Shared locks are not recursive across threads without
+//! the exclusive lock: a reader must not take it again while it holds it,
+//! since a waiting writer would block the second lock.
+class recursive_shared_mutex
+{
+public:
+  recursive_shared_mutex(): m_owner(std::thread::id()), m_depth(0) {}
+
+  void lock()
+  {
+    if (owned())
+    {
+      ++m_depth;
+      return;
+    }
+    m_mutex.lock();
+    m_owner = std::this_thread::get_id();
+    m_depth = 1;
+  }
+
+  bool try_lock()
+  {
+    if (owned())
+    {
+      ++m_depth;
+      return true;
+    }
+    if (!m_mutex.try_lock())
+      return false;
+    m_owner = std::this_thread::get_id();
+    m_depth = 1;
+    return true;
+  }
+
+  void unlock()
+  {
+    if (--m_depth == 0)
+    {
+      m_owner = std::thread::id();
+      m_mutex.unlock();
+    }
+  }
+
+  void lock_shared()
+  {
+    if (owned())
+      ++m_depth;
+    else
+      m_mutex.lock_shared();
+  }
+
+  void unlock_shared()
+  {
+    if (owned())
+      --m_depth;
+    else
+      m_mutex.unlock_shared();
+  }
+
+private:
+  // only ever equal to the calling thread's id if that thread set it
+  bool owned() const { return m_owner == std::this_thread::get_id(); }
+
+  boost::shared_mutex m_mutex;
+  std::atomic<std::thread::id> m_owner;
+  size_t m_depth; // only used by the exclusive owner
+};
+}
@@ -0,0 +1,155 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
+
+namespace tools
+{
+//! Concurrent map from a key to a set of values, split into independently
+//! locked shards so that lookups and updates of unrelated keys do not
+//! contend with each other.
+//!
+//! Each operation locks a single shard, except for for_each, clear and
+//! size, which visit the shards in turn and so do not see an atomic
+//! snapshot of the whole map.
+template<typename K, typename V, size_t log_shards = 4>
+class sharded_multimap
+{
+public:
+  static const size_t num_shards = (size_t)1 << log_shards;
+
+  //! adds v to the set for k; fails if v is already there, or if the set
+  //! is not empty and allow_existing is false
+  bool insert(const K &k, const V &v, bool allow_existing = true)
+  {
+    shard &s = get_shard(k);
+    boost::lock_guard<boost::mutex> lock(s.mutex);
+    std::unordered_set<V> &values = s.map[k];
+    if (!allow_existing && !values.empty())
+      return false;
+    return values.insert(v).second;
+  }
+
+  //! removes v from the set for k, and k itself once its set is empty
+  bool erase(const K &k, const V &v)
+  {
+    shard &s = get_shard(k);
+    boost::lock_guard<boost::mutex> lock(s.mutex);
+    const auto i = s.map.find(k);
+    if (i == s.map.end() || i->second.erase(v) == 0)
+      return false;
+    if (i->second.empty())
+      s.map.erase(i);
+    return true;
+  }
+
+  bool contains(const K &k) const
+  {
+    const shard &s = get_shard(k);
+    boost::lock_guard<boost::mutex> lock(s.mutex);
+    return s.map.find(k) != s.map.end();
+  }
+
+  //! returns a copy of the values for k, empty if k is not present
+  std::vector<V> get(const K &k) const
+  {
+    const shard &s = get_shard(k);
+    boost::lock_guard<boost::mutex> lock(s.mutex);
+    const auto i = s.map.find(k);
+    if (i == s.map.end())
+      return std::vector<V>();
+    return std::vector<V>(i->second.begin(), i->second.end());
+  }
+
+  //! calls f(key, values) for every key, with that key's shard locked;
+  //! f must not call back into the map
+  template<typename F>
+  void for_each(F f) const
+  {
+    for (const shard &s: m_shards)
+    {
+      boost::lock_guard<boost::mutex> lock(s.mutex);
+      for (const auto &e: s.map)
+        f(e.first, e.second);
+    }
+  }
+
+  void clear()
+  {
+    for (shard &s: m_shards)
+    {
+      boost::lock_guard<boost::mutex> lock(s.mutex);
+      s.map.clear();
+    }
+  }
+
+  size_t size() const
+  {
+    size_t n = 0;
+    for (const shard &s: m_shards)
+    {
+      boost::lock_guard<boost::mutex> lock(s.mutex);
+      n += s.map.size();
+    }
+    return n;
+  }
+
+private:
+  // padded so that no two shard mutexes share a cache line, without
+  // needing over-aligned allocation
+  struct shard
+  {
+    mutable boost::mutex mutex;
+    std::unordered_map<K, std::unordered_set<V>> map;
+    char padding[64];
+  };
+
+  // The std::hash specializations for crypto types just read the first
+  // bytes of the key, and the maps inside the shards use the low bits of
+  // that, so pick the shard from the high bits of a multiplicative mix
+  static size_t shard_index(const K &k)
+  {
+    const uint64_t h = (uint64_t)std::hash<K>()(k) * 0x9e3779b97f4a7c15ull;
+    return h >> (64 - log_shards);
+  }
+
+  shard &get_shard(const K &k) { return m_shards[shard_index(k)]; }
+  const shard &get_shard(const K &k) const { return m_shards[shard_index(k)]; }
+
+  shard m_shards[num_shards];
+};
+}
@@ -0,0 +1,107 @@
+// Copyright (c) 2019, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <set>
+
+namespace tools
+{
+//! Multiset of values which keeps track of its median, so that a sliding
+//! window can be moved by one erase and one insert in O(log n) instead of
+//! sorting the whole window again.
+//!
+//! The median matches epee::misc_utils::median: the middle value for an odd
+//! count, the mean of the two middle values for an even count, and a value
+//! initialized T when empty.
+template<typename T>
+class sliding_median
+{
+public:
+  void insert(const T &v)
+  {
+    if (m_low.empty() || !(*m_low.rbegin() < v))
+      m_low.insert(v);
+    else
+      m_high.insert(v);
+    rebalance();
+  }
+
+  //! removes one instance of v, fails if there is none
+  bool erase(const T &v)
+  {
+    typename std::multiset<T>::iterator i;
+    if (!m_low.empty() && !(*m_low.rbegin() < v) && (i = m_low.find(v)) != m_low.end())
+      m_low.erase(i);
+    else if ((i = m_high.find(v)) != m_high.end())
+      m_high.erase(i);
+    else
+      return false;
+    rebalance();
+    return true;
+  }
+
+  T median() const
+  {
+    if (m_low.empty())
+      return T();
+    if (m_low.size() > m_high.size())
+      return *m_low.rbegin();
+    return (*m_low.rbegin() + *m_high.begin()) / 2;
+  }
+
+  size_t size() const { return m_low.size() + m_high.size(); }
+  bool empty() const { return m_low.empty(); }
+  void clear() { m_low.clear(); m_high.clear(); }
+
+private:
+  // all of m_low compares no greater than all of m_high, and m_low holds
+  // either as many values as m_high, or one more
+  void rebalance()
+  {
+    if (m_low.size() > m_high.size() + 1)
+    {
+      const auto i = std::prev(m_low.end());
+      m_high.insert(*i);
+      m_low.erase(i);
+    }
+    else if (m_high.size() > m_low.size())
+    {
+      const auto i = m_high.begin();
+      m_low.insert(*i);
+      m_high.erase(i);
+    }
+  }
+
+  std::multiset<T> m_low;
+  std::multiset<T> m_high;
+};
+}
@@ -29,25 +29,73 @@
 #include "common/threadpool.h"
 
 #include <cassert>
+#include <climits>
 #include <limits>
 #include <stdexcept>
 
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 #include "cryptonote_config.h"
 #include "common/util.h"
 
+// how many times an idle worker looks for work before sleeping
+#define WORKER_SPIN_COUNT 64
+// how many times a waiter checks for completion before sleeping
+#define WAITER_SPIN_COUNT 1024
+
 static __thread int depth = 0;
 static __thread bool is_leaf = false;
+static __thread const tools::threadpool *current_pool = NULL;
+static __thread unsigned int current_worker = 0;
+
+static inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#else
+  boost::this_thread::yield();
+#endif
+}
+
+// spinning only helps if whoever we wait for runs on another core
+static bool can_spin()
+{
+  static const bool multicore = boost::thread::hardware_concurrency() > 1;
+  return multicore;
+}
+
+#ifdef __linux__
+static_assert(sizeof(std::atomic<int>) == sizeof(int), "futex needs a plain int");
+
+static void futex_wait(std::atomic<int> *addr, int expected)
+{
+  syscall(SYS_futex, reinterpret_cast<int*>(addr), FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+}
+
+static void futex_wake(std::atomic<int> *addr)
+{
+  syscall(SYS_futex, reinterpret_cast<int*>(addr), FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+}
+#endif
 
 namespace tools
 {
-threadpool::threadpool(unsigned int max_threads) : running(true), active(0) {
+threadpool::threadpool(unsigned int max_threads) : slabs(new std::atomic<task*>[max_slabs]), num_slabs(0), free_tasks(0),
+  queued(0), pending(0), sleeping(0), active(0), running(true) {
+  for (uint32_t n = 0; n < max_slabs; ++n)
+    slabs[n].store(NULL, std::memory_order_relaxed);
   boost::thread::attributes attrs;
   attrs.set_stack_size(THREAD_STACK_SIZE);
   max = max_threads ? max_threads : tools::get_max_concurrency();
   size_t i = max ? max - 1 : 0;
-  while(i--) {
-    threads.push_back(boost::thread(attrs, boost::bind(&threadpool::run, this, false)));
-  }
+  for (size_t n = 0; n < i; ++n)
+    workers.emplace_back(new worker());
+  for (size_t n = 0; n < i; ++n)
+    threads.push_back(boost::thread(attrs, boost::bind(&threadpool::run, this, n)));
 }
 
 threadpool::~threadpool() {
@@ -60,29 +108,134 @@ threadpool::~threadpool() {
     try { threads[i].join(); }
     catch (...) { /* ignore */ }
   }
+  // tasks still queued are dropped with their slab
+  const uint32_t n = num_slabs.load(std::memory_order_acquire);
+  for (uint32_t i = 0; i < n; ++i)
+    delete[] slabs[i].load(std::memory_order_relaxed);
+}
+
+threadpool::depth_guard::depth_guard(bool leaf) {
+  ++depth;
+  is_leaf = leaf;
 }
 
-void threadpool::submit(waiter *obj, std::function<void()> f, bool leaf) {
+threadpool::depth_guard::~depth_guard() {
+  --depth;
+  is_leaf = false;
+}
+
+bool threadpool::run_inline(bool leaf) const {
   CHECK_AND_ASSERT_THROW_MES(!is_leaf, "A leaf routine is using a thread pool");
-  boost::unique_lock<boost::mutex> lock(mutex);
-  if (!leaf && ((active == max && !queue.empty()) || depth > 0)) {
-    // if all available threads are already running
-    // and there's work waiting, just run in current thread
-    lock.unlock();
-    ++depth;
-    is_leaf = leaf;
-    f();
-    --depth;
-    is_leaf = false;
+  return !leaf && ((active.load(std::memory_order_relaxed) == max && pending.load(std::memory_order_relaxed) > 0) || depth > 0);
+}
+
+threadpool::task *threadpool::get_task(uint32_t index) const {
+  return slabs[index / slab_size].load(std::memory_order_acquire) + index % slab_size;
+}
+
+threadpool::task *threadpool::allocate_task() {
+  // the free list head is the index of the first free task + 1, tagged
+  // in the upper half with a counter so a stale head fails the CAS
+  uint64_t head = free_tasks.load(std::memory_order_acquire);
+  while (true) {
+    while ((uint32_t)head) {
+      task *t = get_task((uint32_t)head - 1);
+      const uint64_t next = (((head >> 32) + 1) << 32) | t->next.load(std::memory_order_relaxed);
+      if (free_tasks.compare_exchange_weak(head, next, std::memory_order_acquire, std::memory_order_acquire))
+        return t;
+    }
+
+    boost::lock_guard<boost::mutex> lock(slabs_mutex);
+    head = free_tasks.load(std::memory_order_acquire);
+    if ((uint32_t)head)
+      continue;
+    const uint32_t n = num_slabs.load(std::memory_order_relaxed);
+    if (n == max_slabs)
+      return NULL;
+    task *slab = new task[slab_size];
+    for (uint32_t i = 0; i < slab_size; ++i)
+      slab[i].index = n * slab_size + i;
+    for (uint32_t i = 1; i + 1 < slab_size; ++i)
+      slab[i].next.store(slab[i + 1].index + 1, std::memory_order_relaxed);
+    slabs[n].store(slab, std::memory_order_release);
+    num_slabs.store(n + 1, std::memory_order_release);
+    release_tasks(&slab[1], &slab[slab_size - 1]);
+    return &slab[0];
+  }
+}
+
+void threadpool::release_tasks(task *first, task *last) {
+  uint64_t head = free_tasks.load(std::memory_order_relaxed);
+  uint64_t next;
+  do {
+    last->next.store((uint32_t)head, std::memory_order_relaxed);
+    next = (((head >> 32) + 1) << 32) | (first->index + 1);
+  } while (!free_tasks.compare_exchange_weak(head, next, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void threadpool::free_task(task *t) {
+  t->clear();
+  t->wo = NULL;
+  release_tasks(t, t);
+}
+
+void threadpool::push(task *t) {
+  pending.fetch_add(1);
+  if (current_pool == this) {
+    // leaf or not, the owner pops the most recent task first
+    workers[current_worker]->tasks.push(t);
+    if (sleeping.load()) {
+      const boost::unique_lock<boost::mutex> lock(mutex);
+      has_work.notify_one();
+    }
   } else {
-    if (obj)
-      obj->inc();
-    if (leaf)
-      queue.push_front({obj, f, leaf});
+    const boost::unique_lock<boost::mutex> lock(mutex);
+    if (t->leaf)
+      queue.push_front(t);
     else
-      queue.push_back({obj, f, leaf});
-    has_work.notify_one();
+      queue.push_back(t);
+    queued.fetch_add(1, std::memory_order_relaxed);
+    if (sleeping.load())
+      has_work.notify_one();
+  }
+}
+
+threadpool::task *threadpool::pop() {
+  task *t;
+  if (current_pool == this && workers[current_worker]->tasks.pop(t))
+    return t;
+  if (queued.load(std::memory_order_relaxed)) {
+    const boost::unique_lock<boost::mutex> lock(mutex);
+    if (!queue.empty()) {
+      t = queue.front();
+      queue.pop_front();
+      queued.fetch_sub(1, std::memory_order_relaxed);
+      return t;
+    }
   }
+  const size_t n = workers.size();
+  const size_t start = current_pool == this ? current_worker + 1 : 0;
+  for (size_t i = 0; i < n; ++i) {
+    work_stealing_deque<task*> &victim = workers[(start + i) % n]->tasks;
+    while (!victim.empty())
+      if (victim.steal(t))
+        return t;
+  }
+  return NULL;
+}
+
+void threadpool::execute(task *t) {
+  pending.fetch_sub(1, std::memory_order_relaxed);
+  active.fetch_add(1, std::memory_order_relaxed);
+  {
+    const depth_guard guard(t->leaf);
+    (*t)();
+  }
+  waiter *wo = t->wo;
+  free_task(t);
+  if (wo)
+    wo->dec();
+  active.fetch_sub(1, std::memory_order_relaxed);
 }
 
 unsigned int threadpool::get_max_concurrency() const {
@@ -91,11 +244,8 @@ unsigned int threadpool::get_max_concurrency() const {
 
 threadpool::waiter::~waiter()
 {
-  {
-    boost::unique_lock<boost::mutex> lock(mt);
-    if (num)
-      MERROR("wait should have been called before waiter dtor - waiting now");
-  }
+  if (num.load())
+    MERROR("wait should have been called before waiter dtor - waiting now");
   try
   {
     wait(NULL);
@@ -108,50 +258,66 @@ threadpool::waiter::~waiter()
 
 void threadpool::waiter::wait(threadpool *tpool) {
   if (tpool)
-    tpool->run(true);
+    tpool->flush();
+  if (can_spin())
+    for (unsigned int i = 0; i < WAITER_SPIN_COUNT && num.load(std::memory_order_acquire); ++i)
+      cpu_relax();
+#ifdef __linux__
+  int n;
+  while ((n = num.load(std::memory_order_acquire)))
+    futex_wait(&num, n);
+#else
+  // dec holds the lock while it decrements, so taking it here also
+  // ensures it is done with this object
   boost::unique_lock<boost::mutex> lock(mt);
-  while(num)
+  while(num.load(std::memory_order_acquire))
     cv.wait(lock);
+#endif
 }
 
 void threadpool::waiter::inc() {
-  const boost::unique_lock<boost::mutex> lock(mt);
-  num++;
+  num.fetch_add(1, std::memory_order_relaxed);
 }
 
 void threadpool::waiter::dec() {
+#ifdef __linux__
+  // a woken waiter may destroy this object at once, so num must not be
+  // touched after the decrement; waking a stale futex address is harmless
+  if (num.fetch_sub(1, std::memory_order_acq_rel) == 1)
+    futex_wake(&num);
+#else
   const boost::unique_lock<boost::mutex> lock(mt);
-  num--;
-  if (!num)
+  if (num.fetch_sub(1, std::memory_order_acq_rel) == 1)
     cv.notify_all();
+#endif
 }
 
-void threadpool::run(bool flush) {
-  boost::unique_lock<boost::mutex> lock(mutex);
-  while (running) {
-    entry e;
-    while(queue.empty() && running)
-    {
-      if (flush)
-        return;
-      has_work.wait(lock);
+void threadpool::flush() {
+  while (task *t = pop())
+    execute(t);
+}
+
+void threadpool::run(unsigned int index) {
+  current_pool = this;
+  current_worker = index;
+  const unsigned int spin_count = can_spin() ? WORKER_SPIN_COUNT : 0;
+  unsigned int idle = 0;
+  while (running.load(std::memory_order_acquire)) {
+    if (task *t = pop()) {
+      execute(t);
+      idle = 0;
+      continue;
+    }
+    if (++idle < spin_count) {
+      cpu_relax();
+      continue;
     }
-    if (!running) break;
-
-    active++;
-    e = queue.front();
-    queue.pop_front();
-    lock.unlock();
-    ++depth;
-    is_leaf = e.leaf;
-    e.f();
-    --depth;
-    is_leaf = false;
-
-    if (e.wo)
-      e.wo->dec();
-    lock.lock();
-    active--;
+    boost::unique_lock<boost::mutex> lock(mutex);
+    sleeping.fetch_add(1);
+    while (running.load(std::memory_order_relaxed) && !pending.load())
+      has_work.wait(lock);
+    sleeping.fetch_sub(1);
+    idle = 0;
   }
 }
 }
@@ -30,15 +30,27 @@
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/thread.hpp>
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
+#include <deque>
 #include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
 #include <utility>
 #include <vector>
 #include <stdexcept>
 
+#include "common/work_stealing_deque.h"
+
 namespace tools
 {
 //! A global thread pool
+//!
+//! Each worker owns a work stealing deque: tasks submitted from a worker go
+//! to its own deque, tasks submitted from other threads go to a shared queue,
+//! and idle threads steal from the other workers before going to sleep.
 class threadpool
 {
 public:
@@ -53,9 +65,11 @@ public:
   // The waiter lets the caller know when all of its
   // tasks are completed.
   class waiter {
+    std::atomic<int> num;
+#ifndef __linux__
     boost::mutex mt;
     boost::condition_variable cv;
-    int num;
+#endif
     public:
     void inc();
     void dec();
@@ -67,7 +81,28 @@ public:
   // Submit a task to the pool. The waiter pointer may be
   // NULL if the caller doesn't care to wait for the
   // task to finish.
-  void submit(waiter *waiter, std::function<void()> f, bool leaf = false);
+  template<typename F>
+  void submit(waiter *waiter, F &&f, bool leaf = false)
+  {
+    task *t = NULL;
+    if (!run_inline(leaf))
+      t = allocate_task();
+    if (!t)
+    {
+      // if all available threads are already running
+      // and there's work waiting, just run in current thread
+      const depth_guard guard(leaf);
+      f();
+      return;
+    }
+    try { t->set(std::forward<F>(f)); }
+    catch (...) { free_task(t); throw; }
+    t->wo = waiter;
+    t->leaf = leaf;
+    if (waiter)
+      waiter->inc();
+    push(t);
+  }
 
   unsigned int get_max_concurrency() const;
 
@@ -75,19 +110,92 @@ public:
 
   private:
     threadpool(unsigned int max_threads = 0);
-    typedef struct entry {
+
+    //! A type erased callable, stored in place when small enough so that
+    //! submitting does not allocate. Tasks are recycled by the pool.
+    class task {
+    public:
+      static const size_t inline_size = 64;
+
+      task(): wo(NULL), leaf(false), index(0), next(0), invoke(NULL), destroy(NULL) {}
+      ~task() { clear(); }
+
+      template<typename F>
+      void set(F &&f)
+      {
+        typedef typename std::decay<F>::type fn_t;
+        set_impl<fn_t>(std::forward<F>(f), std::integral_constant<bool, sizeof(fn_t) <= inline_size && alignof(fn_t) <= alignof(storage_t)>());
+      }
+      void operator()() { invoke(&storage); }
+      void clear() { if (destroy) destroy(&storage); invoke = NULL; destroy = NULL; }
+
       waiter *wo;
-      std::function<void()> f;
       bool leaf;
-    } entry;
-    std::deque<entry> queue;
+      uint32_t index;
+      std::atomic<uint32_t> next;
+
+    private:
+      typedef typename std::aligned_storage<inline_size>::type storage_t;
+
+      template<typename fn_t, typename F>
+      void set_impl(F &&f, std::true_type)
+      {
+        new (&storage) fn_t(std::forward<F>(f));
+        invoke = [](void *p){ (*static_cast<fn_t*>(p))(); };
+        destroy = [](void *p){ static_cast<fn_t*>(p)->~fn_t(); };
+      }
+      template<typename fn_t, typename F>
+      void set_impl(F &&f, std::false_type)
+      {
+        *static_cast<fn_t**>(static_cast<void*>(&storage)) = new fn_t(std::forward<F>(f));
+        invoke = [](void *p){ (**static_cast<fn_t**>(p))(); };
+        destroy = [](void *p){ delete *static_cast<fn_t**>(p); };
+      }
+
+      storage_t storage;
+      void (*invoke)(void*);
+      void (*destroy)(void*);
+    };
+
+    class depth_guard {
+    public:
+      depth_guard(bool leaf);
+      ~depth_guard();
+    };
+
+    struct worker {
+      work_stealing_deque<task*> tasks;
+    };
+
+    bool run_inline(bool leaf) const;
+    task *allocate_task();
+    void free_task(task *t);
+    void release_tasks(task *first, task *last);
+    task *get_task(uint32_t index) const;
+    void push(task *t);
+    task *pop();
+    void execute(task *t);
+    void run(unsigned int index);
+    void flush();
+
+    static const uint32_t slab_size = 1024;
+    static const uint32_t max_slabs = 4096;
+    std::unique_ptr<std::atomic<task*>[]> slabs;
+    std::atomic<uint32_t> num_slabs;
+    std::atomic<uint64_t> free_tasks;
+    boost::mutex slabs_mutex;
+
+    std::vector<std::unique_ptr<worker>> workers;
+    std::deque<task*> queue;
+    std::atomic<unsigned int> queued;
+    std::atomic<unsigned int> pending;
+    std::atomic<unsigned int> sleeping;
     boost::condition_variable has_work;
     boost::mutex mutex;
     std::vector<boost::thread> threads;
-    unsigned int active;
+    std::atomic<unsigned int> active;
     unsigned int max;
-    bool running;
-    void run(bool flush = false);
+    std::atomic<bool> running;
 };
 
 }
@@ -33,6 +33,7 @@
 #include <boost/serialization/split_free.hpp>
 #include <unordered_map>
 #include <unordered_set>
+#include "common/flat_hash_map.h"
 
 namespace boost
 {
@@ -67,6 +68,37 @@ namespace boost
     }
 
 
+    // same format as std::unordered_map, so either can load what the other saved
+    template <class Archive, class h_key, class hval, class hash, class key_equal>
+    inline void save(Archive &a, const tools::flat_hash_map<h_key, hval, hash, key_equal> &x, const boost::serialization::version_type ver)
+    {
+      size_t s = x.size();
+      a << s;
+      for(auto& v: x)
+      {
+        a << v.first;
+        a << v.second;
+      }
+    }
+
+    template <class Archive, class h_key, class hval, class hash, class key_equal>
+    inline void load(Archive &a, tools::flat_hash_map<h_key, hval, hash, key_equal> &x, const boost::serialization::version_type ver)
+    {
+      x.clear();
+      size_t s = 0;
+      a >> s;
+      x.reserve(s);
+      for(size_t i = 0; i != s; i++)
+      {
+        h_key k;
+        hval v;
+        a >> k;
+        a >> v;
+        x.insert(std::pair<h_key, hval>(k, v));
+      }
+    }
+
+
     template <class Archive, class h_key, class hval>
     inline void save(Archive &a, const std::unordered_multimap<h_key, hval> &x, const boost::serialization::version_type ver)
     {
@@ -128,6 +160,12 @@ namespace boost
       split_free(a, x, ver);
     }
 
+    template <class Archive, class h_key, class hval, class hash, class key_equal>
+    inline void serialize(Archive &a, tools::flat_hash_map<h_key, hval, hash, key_equal> &x, const boost::serialization::version_type ver)
+    {
+      split_free(a, x, ver);
+    }
+
     template <class Archive, class h_key, class hval>
     inline void serialize(Archive &a, std::unordered_multimap<h_key, hval> &x, const boost::serialization::version_type ver)
     {
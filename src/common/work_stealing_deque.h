@@ -0,0 +1,138 @@
+// Copyright (c) 2018, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace tools
+{
+//! Chase-Lev work stealing deque (Le, Pop, Cohen and Zappa Nardelli's C11 version)
+//!
+//! push and pop may only be called by the thread owning the deque, and
+//! work on the bottom end; steal may be called by any thread and takes
+//! from the top end. T must be cheap to copy, typically a pointer.
+template<typename T>
+class work_stealing_deque
+{
+public:
+  explicit work_stealing_deque(unsigned int log_size = 8): m_top(0), m_bottom(0)
+  {
+    m_rings.emplace_back(new ring(log_size));
+    m_ring.store(m_rings.back().get(), std::memory_order_relaxed);
+  }
+
+  void push(T x)
+  {
+    const int64_t b = m_bottom.load(std::memory_order_relaxed);
+    const int64_t t = m_top.load(std::memory_order_acquire);
+    ring *r = m_ring.load(std::memory_order_relaxed);
+    if (b - t > (int64_t)r->mask)
+    {
+      // thieves may still be reading the old ring, it is kept until destruction
+      m_rings.emplace_back(r->grow(t, b));
+      r = m_rings.back().get();
+      m_ring.store(r, std::memory_order_release);
+    }
+    r->put(b, x);
+    m_bottom.store(b + 1, std::memory_order_release);
+  }
+
+  bool pop(T &x)
+  {
+    const int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+    ring *r = m_ring.load(std::memory_order_relaxed);
+    m_bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = m_top.load(std::memory_order_relaxed);
+    if (t > b)
+    {
+      m_bottom.store(b + 1, std::memory_order_relaxed);
+      return false;
+    }
+    x = r->get(b);
+    if (t == b)
+    {
+      // last item, race against thieves for it
+      const bool won = m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+      m_bottom.store(b + 1, std::memory_order_relaxed);
+      return won;
+    }
+    return true;
+  }
+
+  //! returns false if the deque was empty, or another thread won the race for the top item
+  bool steal(T &x)
+  {
+    int64_t t = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const int64_t b = m_bottom.load(std::memory_order_acquire);
+    if (t >= b)
+      return false;
+    const ring *r = m_ring.load(std::memory_order_acquire);
+    x = r->get(t);
+    return m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+  }
+
+  bool empty() const
+  {
+    return m_bottom.load(std::memory_order_relaxed) <= m_top.load(std::memory_order_relaxed);
+  }
+
+private:
+  struct ring
+  {
+    explicit ring(unsigned int log_size): log_size(log_size), mask((uint64_t(1) << log_size) - 1), items(new std::atomic<T>[mask + 1]) {}
+    T get(int64_t i) const { return items[i & mask].load(std::memory_order_relaxed); }
+    void put(int64_t i, T x) { items[i & mask].store(x, std::memory_order_relaxed); }
+    ring *grow(int64_t top, int64_t bottom) const
+    {
+      ring *r = new ring(log_size + 1);
+      for (int64_t i = top; i < bottom; ++i)
+        r->put(i, get(i));
+      return r;
+    }
+
+    const unsigned int log_size;
+    const uint64_t mask;
+    std::unique_ptr<std::atomic<T>[]> items;
+  };
+
+  // top is written by thieves, bottom by the owner: keep them on separate cache lines
+  std::atomic<int64_t> m_top;
+  char m_pad0[64 - sizeof(std::atomic<int64_t>)];
+  std::atomic<int64_t> m_bottom;
+  char m_pad1[64 - sizeof(std::atomic<int64_t>)];
+  std::atomic<ring*> m_ring;
+  std::vector<std::unique_ptr<ring>> m_rings;
+};
+}
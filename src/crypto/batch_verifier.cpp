@@ -0,0 +1,91 @@
+// Copyright (c) 2018, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <boost/bind.hpp>
+
+#include "misc_log_ex.h"
+#include "common/threadpool.h"
+#include "batch_verifier.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "crypto.batch"
+
+// don't bother splitting up batches smaller than this
+#define BATCH_VERIFIER_MIN_CHUNK 4
+
+namespace crypto {
+
+  size_t batch_signature_verifier::add(const hash &prefix_hash, const public_key &pub, const signature &sig)
+  {
+    m_entries.push_back({prefix_hash, &pub, &sig});
+    return m_entries.size() - 1;
+  }
+
+  void batch_signature_verifier::verify_range(size_t start, size_t end, std::vector<uint64_t> &results) const
+  {
+    for (size_t i = start; i < end; ++i)
+    {
+      const entry &e = m_entries[i];
+      results[i] = check_signature(e.prefix_hash, *prepare_public_key(*e.pub), *e.sig) ? 1 : 0;
+    }
+  }
+
+  bool batch_signature_verifier::verify(std::vector<uint64_t> &results, tools::threadpool *tpool) const
+  {
+    const size_t n_entries = m_entries.size();
+    results.clear();
+    results.resize(n_entries, 0);
+    if (n_entries == 0)
+      return true;
+
+    size_t threads = tpool ? tpool->get_max_concurrency() : 1;
+    threads = std::max<size_t>(1, std::min<size_t>(threads, n_entries / BATCH_VERIFIER_MIN_CHUNK));
+
+    if (threads > 1)
+    {
+      const size_t chunk = (n_entries + threads - 1) / threads;
+      tools::threadpool::waiter waiter;
+      for (size_t start = 0; start < n_entries; start += chunk)
+      {
+        const size_t end = std::min(start + chunk, n_entries);
+        tpool->submit(&waiter, boost::bind(&batch_signature_verifier::verify_range, this, start, end, std::ref(results)), true);
+      }
+      waiter.wait(tpool);
+    }
+    else
+    {
+      verify_range(0, n_entries, results);
+    }
+
+    const bool ok = std::find(results.begin(), results.end(), 0) == results.end();
+    MDEBUG("Verified " << n_entries << " signatures on " << threads << " thread(s), " << (ok ? "all valid" : "some invalid"));
+    return ok;
+  }
+
+}
@@ -0,0 +1,74 @@
+// Copyright (c) 2018, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "crypto.h"
+
+namespace tools { class threadpool; }
+
+namespace crypto {
+
+  /* Verifies a set of Dilithium signatures in one go.
+   * Entries only reference the keys and signatures passed to add(), so those
+   * must outlive the call to verify().
+   */
+  class batch_signature_verifier {
+  public:
+    struct entry {
+      hash prefix_hash;
+      const public_key *pub;
+      const signature *sig;
+    };
+
+    void reserve(size_t n) { m_entries.reserve(n); }
+    size_t size() const { return m_entries.size(); }
+    bool empty() const { return m_entries.empty(); }
+    void clear() { m_entries.clear(); }
+
+    /* Queues a signature check, returns its index in the results vector.
+     */
+    size_t add(const hash &prefix_hash, const public_key &pub, const signature &sig);
+
+    /* Checks all queued signatures, split in contiguous chunks over the thread
+     * pool (or inline if tpool is NULL). results[i] is set to 1 if entry i is
+     * valid, 0 otherwise. Returns true if all signatures are valid.
+     */
+    bool verify(std::vector<uint64_t> &results, tools::threadpool *tpool = NULL) const;
+
+  private:
+    void verify_range(size_t start, size_t end, std::vector<uint64_t> &results) const;
+
+    std::vector<entry> m_entries;
+  };
+
+}
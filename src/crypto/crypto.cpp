@@ -43,6 +43,7 @@
 #include "warnings.h"
 #include "crypto.h"
 #include "hash.h"
+#include "prepared_key_cache.h"
 
 // Add some log capabilities
 #include "misc_log_ex.h"
@@ -62,6 +63,7 @@ namespace crypto {
   extern "C" {
 #include "crypto-ops.h"
 #include "random.h"	  
+#include "dilithium-prepared.h"
   }
 
   const crypto::public_key null_pkey = crypto::public_key{};
@@ -90,6 +92,16 @@ namespace crypto {
     generate_random_bytes_not_thread_safe(_N, bytes);
   }
 
+  const uint64_t *get_key_fingerprint_key()
+  {
+    static const struct fingerprint_key
+    {
+      uint64_t k[2];
+      fingerprint_key() { generate_random_bytes_thread_safe(sizeof(k), (uint8_t*)k); }
+    } key;
+    return key.k;
+  }
+
   static inline bool less32(const unsigned char *k0, const unsigned char *k1)
   {
     for (int n = 31; n >= 0; --n)
@@ -124,7 +136,7 @@ namespace crypto {
   }
 
   rand_seed crypto_ops::generate_keys(public_key &pub, secret_key &sec, const rand_seed& recovery_key, bool recover) {
-    LOG_PRINT_L1("crypto_ops " <<__func__);
+    MLOG_HOT(el::Level::Info, "crypto_ops " << __func__);
     rand_seed rng;
 
     unsigned char pk[CRYPTO_PUBLICKEYBYTES];
@@ -151,14 +163,14 @@ namespace crypto {
   }
 
   bool crypto_ops::check_key(const public_key &key) {
-    LOG_PRINT_L1("crypto_ops " <<__func__);
+    MLOG_HOT(el::Level::Info, "crypto_ops " << __func__);
 
     ge_p3 point;
     return ge_frombytes_vartime(&point, &key) == 0;
   }
 
   bool crypto_ops::secret_key_to_public_key(const secret_key &sec, public_key &pub) {
-    LOG_PRINT_L1("crypto_ops " <<__func__);
+    MLOG_HOT(el::Level::Info, "crypto_ops " << __func__);
     ge_p3 point;
     if (sc_check(&unwrap(sec)) != 0) {
       return false;
@@ -169,7 +181,7 @@ namespace crypto {
   }
 
   bool crypto_ops::generate_key_derivation(const public_key &key1, const secret_key &key2, key_derivation &derivation) {
-    LOG_PRINT_L1("crypto_ops " <<__func__);
+    MLOG_HOT(el::Level::Info, "crypto_ops " << __func__);
 
     // TODO: No Dilithium implementation yet, so derivation = PVk
     std::memcpy(&derivation, &key1, CRYPTO_PUBLICKEYBYTES);
@@ -178,7 +190,7 @@ namespace crypto {
   }
 
   void crypto_ops::derivation_to_scalar(const key_derivation &derivation, size_t output_index, ec_scalar &res) {
-    LOG_PRINT_L1("crypto_ops " <<__func__);
+    MLOG_HOT(el::Level::Info, "crypto_ops " << __func__);
     struct {
       key_derivation derivation;
       char output_index[(sizeof(size_t) * 8 + 6) / 7];
@@ -192,7 +204,7 @@ namespace crypto {
 
   bool crypto_ops::derive_public_key(const key_derivation &derivation, size_t output_index,
     const public_key &base, public_key &derived_key) {
-    LOG_PRINT_L1("crypto_ops " <<__func__);
+    MLOG_HOT(el::Level::Info, "crypto_ops " << __func__);
     // TODO: No Dilithium implementation yet, so derived_key = PSk
     std::memcpy(&derived_key, &base, CRYPTO_PUBLICKEYBYTES);
 
@@ -201,14 +213,14 @@ namespace crypto {
 
   void crypto_ops::derive_secret_key(const key_derivation &derivation, size_t output_index,
     const secret_key &base, secret_key &derived_key) {
-    LOG_PRINT_L1("crypto_ops " <<__func__);
+    MLOG_HOT(el::Level::Info, "crypto_ops " << __func__);
 
     // TODO: No Dilithium implementation yet, so derived_key = sSk
     std::memcpy(&derived_key, &base, CRYPTO_SECRETKEYBYTES);
   }
 
   bool crypto_ops::derive_subaddress_public_key(const public_key &out_key, const key_derivation &derivation, std::size_t output_index, public_key &derived_key) {
-    LOG_PRINT_L1("crypto_ops " <<__func__);
+    MLOG_HOT(el::Level::Info, "crypto_ops " << __func__);
 
     // TODO: No Dilithium implementation yet, so derived_key = Poutk
     std::memcpy(&derived_key, &out_key, CRYPTO_PUBLICKEYBYTES);
@@ -218,7 +230,7 @@ namespace crypto {
 
 // Dilithium Signature - crypto_sign
   void crypto_ops::generate_signature(const hash &prefix_hash, const public_key &pub, const secret_key &sec, signature &sig) {
-    LOG_PRINT_L1("crypto_ops " <<__func__);
+    MLOG_HOT(el::Level::Info, "crypto_ops " << __func__);
 
     unsigned long long signatureLen = 0L;
     auto result = crypto_sign_dilithium((unsigned char*)&sig, &signatureLen, (unsigned char *)&prefix_hash, sizeof(prefix_hash), &sec);
@@ -226,27 +238,47 @@ namespace crypto {
   }
 // Dilithium Signature - crypto_open
   bool crypto_ops::check_signature(const hash &prefix_hash, const public_key &pub, const signature &sig) {
-    LOG_PRINT_L1("crypto_ops " << __func__);
+    MLOG_HOT(el::Level::Info, "crypto_ops " << __func__);
 
+    return crypto::check_signature(prefix_hash, *prepare_public_key(pub), sig);
+  }
+
+  static prepared_key_cache &get_prepared_key_cache()
+  {
+    static prepared_key_cache cache;
+    return cache;
+  }
+
+  std::shared_ptr<const prepared_public_key> prepare_public_key(const public_key &pub) {
+    return get_prepared_key_cache().get(pub);
+  }
+
+  bool check_signature(const hash &prefix_hash, const prepared_public_key &pub, const signature &sig) {
     unsigned long long mLen = 0L;
     unsigned char m[HASH_SIZE + CRYPTO_BYTES];
-    auto result = crypto_sign_dilithium_open(m, &mLen, (unsigned char *)&sig, sizeof(sig), &pub);
-    LOG_PRINT_L1("crypto_ops signature: " << result);
+    auto result = dilithium_open_prepared(m, &mLen, (const unsigned char *)&sig, sizeof(sig), (const dilithium_prepared_pk *)pub.data());
+    MLOG_HOT(el::Level::Info, "crypto_ops signature: " << result);
 
     return result == 0 ? true : false;
   }
 
+  void get_prepared_key_cache_stats(uint64_t &hits, uint64_t &misses) {
+    const prepared_key_cache &cache = get_prepared_key_cache();
+    hits = cache.get_hits();
+    misses = cache.get_misses();
+  }
+
   void crypto_ops::generate_tx_proof(const hash &prefix_hash, const public_key &R, const public_key &A, const boost::optional<public_key> &B, const public_key &_D, const secret_key &r, signature &sig) {
-    LOG_PRINT_L1("crypto_ops " <<__func__);
+    MLOG_HOT(el::Level::Info, "crypto_ops " << __func__);
   }
 
   bool crypto_ops::check_tx_proof(const hash &prefix_hash, const public_key &R, const public_key &A, const boost::optional<public_key> &B, const public_key &_D, const signature &sig) {
-    LOG_PRINT_L1("crypto_ops " <<__func__);
+    MLOG_HOT(el::Level::Info, "crypto_ops " << __func__);
       return true;
   }
 
   void crypto_ops::generate_key_image(const public_key &pub, const secret_key &sec, key_image &image) {
-    LOG_PRINT_L1("crypto_ops " <<__func__);
+    MLOG_HOT(el::Level::Info, "crypto_ops " << __func__);
     std::memcpy(&image, &pub, CRYPTO_PUBLICKEYBYTES);
   }
 
@@ -265,14 +297,14 @@ POP_WARNINGS
     const public_key *const *pubs, size_t pubs_count,
     const secret_key &sec, size_t sec_index,
     signature *sig) {
-    LOG_PRINT_L1("crypto_ops " <<__func__);
+    MLOG_HOT(el::Level::Info, "crypto_ops " << __func__);
 
   }
 
   bool crypto_ops::check_ring_signature(const hash &prefix_hash, const key_image &image,
     const public_key *const *pubs, size_t pubs_count,
     const signature *sig) {
-    LOG_PRINT_L1("crypto_ops " <<__func__);
+    MLOG_HOT(el::Level::Info, "crypto_ops " << __func__);
 
     return true;
   }
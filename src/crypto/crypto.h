@@ -35,6 +35,7 @@
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/lock_guard.hpp>
 #include <boost/optional.hpp>
+#include <memory>
 #include <type_traits>
 #include <vector>
 
@@ -224,6 +225,16 @@ namespace crypto {
     return crypto_ops::check_signature(prefix_hash, pub, sig);
   }
 
+  /* Checking of a standard signature against a prepared public key: the
+   * expensive, key only part of the check (unpacking and expanding the
+   * Dilithium matrix) is done once in prepare_public_key, which keeps recently
+   * used keys in a bounded cache. check_signature above goes through it too.
+   */
+  class prepared_public_key;
+  std::shared_ptr<const prepared_public_key> prepare_public_key(const public_key &pub);
+  bool check_signature(const hash &prefix_hash, const prepared_public_key &pub, const signature &sig);
+  void get_prepared_key_cache_stats(uint64_t &hits, uint64_t &misses);
+
   /* Generation and checking of a tx proof; given a tx pubkey R, the recipient's view pubkey A, and the key 
    * derivation D, the signature proves the knowledge of the tx secret key r such that R=r*G and D=r*A
    * When the recipient's address is a subaddress, the tx pubkey R is defined as R=r*B where B is the recipient's spend pubkey
@@ -0,0 +1,127 @@
+// Copyright (c) 2018, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <stdint.h>
+
+#include "dilithium-prepared.h"
+#include "dilithium/ref/params.h"
+#include "dilithium/ref/sign.h"
+#include "dilithium/ref/packing.h"
+#include "dilithium/ref/poly.h"
+#include "dilithium/ref/polyvec.h"
+#include "dilithium/ref/symmetric.h"
+
+struct dilithium_prepared_pk {
+  polyvecl mat[K];
+  polyveck t1;
+  unsigned char tr[CRHBYTES];
+};
+
+size_t dilithium_prepared_pk_size(void) {
+  return sizeof(struct dilithium_prepared_pk);
+}
+
+void dilithium_prepare_pk(struct dilithium_prepared_pk *ppk, const unsigned char *pk) {
+  unsigned char rho[SEEDBYTES];
+
+  unpack_pk(rho, &ppk->t1, pk);
+  expand_mat(ppk->mat, rho);
+  polyveck_shiftl(&ppk->t1);
+  polyveck_ntt(&ppk->t1);
+  crh(ppk->tr, pk, CRYPTO_PUBLICKEYBYTES);
+}
+
+/* This follows crypto_sign_dilithium_open step by step, minus the key
+ * unpacking and matrix expansion, so it must accept and reject exactly the
+ * same signatures.
+ */
+int dilithium_open_prepared(unsigned char *m, unsigned long long *mlen,
+    const unsigned char *sm, unsigned long long smlen,
+    const struct dilithium_prepared_pk *ppk) {
+  unsigned long long i;
+  unsigned char mu[CRHBYTES];
+  poly c, chat, cp;
+  polyvecl z;
+  polyveck w1, h, tmp1, tmp2;
+
+  if(smlen < CRYPTO_BYTES)
+    goto badsig;
+
+  *mlen = smlen - CRYPTO_BYTES;
+
+  if(unpack_sig(&z, &h, &c, sm))
+    goto badsig;
+  if(polyvecl_chknorm(&z, GAMMA1 - BETA))
+    goto badsig;
+
+  /* Compute CRH(CRH(rho, t1), msg) using m as "playground" buffer */
+  if(sm != m)
+    for(i = 0; i < *mlen; ++i)
+      m[CRYPTO_BYTES + i] = sm[CRYPTO_BYTES + i];
+
+  for(i = 0; i < CRHBYTES; ++i)
+    m[CRYPTO_BYTES - CRHBYTES + i] = ppk->tr[i];
+  crh(mu, m + CRYPTO_BYTES - CRHBYTES, CRHBYTES + *mlen);
+
+  /* Matrix-vector multiplication; compute Az - c2^dt1 */
+  polyvecl_ntt(&z);
+  for(i = 0; i < K ; ++i)
+    polyvecl_pointwise_acc_invmontgomery(tmp1.vec+i, ppk->mat+i, &z);
+
+  chat = c;
+  poly_ntt(&chat);
+  for(i = 0; i < K; ++i)
+    poly_pointwise_invmontgomery(tmp2.vec+i, &chat, ppk->t1.vec+i);
+
+  polyveck_sub(&tmp1, &tmp1, &tmp2);
+  polyveck_reduce(&tmp1);
+  polyveck_invntt_montgomery(&tmp1);
+
+  /* Reconstruct w1 */
+  polyveck_csubq(&tmp1);
+  polyveck_use_hint(&w1, &tmp1, &h);
+
+  /* Call random oracle and verify challenge */
+  challenge(&cp, mu, &w1);
+  for(i = 0; i < N; ++i)
+    if(c.coeffs[i] != cp.coeffs[i])
+      goto badsig;
+
+  /* All good, copy msg, return 0 */
+  for(i = 0; i < *mlen; ++i)
+    m[i] = sm[CRYPTO_BYTES + i];
+
+  return 0;
+
+badsig:
+  *mlen = (unsigned long long) -1;
+  for(i = 0; i < smlen; ++i)
+    m[i] = 0;
+
+  return -1;
+}
@@ -31,10 +31,13 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <cstring>
 #include <functional>
 #include <sodium/crypto_verify_32.h>
 
+#include "siphash.h"
+
 #define CRYPTO_MAKE_COMPARABLE(type) \
 namespace crypto { \
   inline bool operator==(const type &_v1, const type &_v2) { \
@@ -79,3 +82,24 @@ CRYPTO_DEFINE_HASH_FUNCTIONS(type)
 CRYPTO_MAKE_COMPARABLE_CONSTANT_TIME(type) \
 CRYPTO_DEFINE_HASH_FUNCTIONS(type)
 
+namespace crypto {
+  // the SipHash key of key_fingerprint, drawn at random once per process
+  const uint64_t *get_key_fingerprint_key();
+
+  // Hash of the whole of a POD key, rather than of its first word as with
+  // the std::hash specializations above. That is all that is needed for
+  // random 32 byte hashes, but keys and key images are about 1.3 KB and
+  // often chosen by peers, who could otherwise pick them so they all land
+  // in the same bucket. Keying the hash with a secret makes that as hard
+  // as guessing the key.
+  inline uint64_t key_fingerprint(const void *data, std::size_t size) {
+    return siphash(get_key_fingerprint_key(), data, size);
+  }
+
+  template<typename T>
+  struct fingerprint_hash {
+    std::size_t operator()(const T &_v) const {
+      return key_fingerprint(&_v, sizeof(_v));
+    }
+  };
+}
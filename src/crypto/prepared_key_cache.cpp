@@ -0,0 +1,112 @@
+// Copyright (c) 2018, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstring>
+#include <boost/thread/lock_guard.hpp>
+
+#include "prepared_key_cache.h"
+
+extern "C" {
+#include "dilithium-prepared.h"
+}
+
+namespace crypto {
+
+  prepared_public_key::prepared_public_key(const public_key &pub):
+    m_data(new uint64_t[(dilithium_prepared_pk_size() + sizeof(uint64_t) - 1) / sizeof(uint64_t)])
+  {
+    dilithium_prepare_pk(reinterpret_cast<dilithium_prepared_pk*>(m_data.get()), (const unsigned char*)&pub);
+  }
+
+  prepared_key_cache::prepared_key_cache(size_t max_entries, size_t n_shards):
+    m_shards(new shard[n_shards ? n_shards : 1]),
+    m_n_shards(n_shards ? n_shards : 1),
+    m_hits(0),
+    m_misses(0)
+  {
+    m_max_entries_per_shard = (max_entries + m_n_shards - 1) / m_n_shards;
+    if (m_max_entries_per_shard == 0)
+      m_max_entries_per_shard = 1;
+  }
+
+  prepared_key_cache::shard &prepared_key_cache::get_shard(const hash &h)
+  {
+    uint64_t idx;
+    memcpy(&idx, &h, sizeof(idx));
+    return m_shards[idx % m_n_shards];
+  }
+
+  std::shared_ptr<const prepared_public_key> prepared_key_cache::get(const public_key &pub)
+  {
+    const hash h = cn_fast_hash(&pub, sizeof(pub));
+    shard &s = get_shard(h);
+
+    {
+      boost::lock_guard<boost::mutex> lock(s.mutex);
+      auto it = s.entries.find(h);
+      if (it != s.entries.end())
+      {
+        s.lru.splice(s.lru.begin(), s.lru, it->second.second);
+        ++m_hits;
+        return it->second.first;
+      }
+    }
+
+    ++m_misses;
+    entry_ptr prepared = std::make_shared<const prepared_public_key>(pub);
+
+    boost::lock_guard<boost::mutex> lock(s.mutex);
+    auto it = s.entries.find(h);
+    if (it != s.entries.end())
+    {
+      // another thread prepared the same key meanwhile
+      s.lru.splice(s.lru.begin(), s.lru, it->second.second);
+      return it->second.first;
+    }
+    while (s.entries.size() >= m_max_entries_per_shard)
+    {
+      s.entries.erase(s.lru.back());
+      s.lru.pop_back();
+    }
+    s.lru.push_front(h);
+    s.entries.emplace(h, std::make_pair(prepared, s.lru.begin()));
+    return prepared;
+  }
+
+  size_t prepared_key_cache::size() const
+  {
+    size_t n = 0;
+    for (size_t i = 0; i < m_n_shards; ++i)
+    {
+      boost::lock_guard<boost::mutex> lock(m_shards[i].mutex);
+      n += m_shards[i].entries.size();
+    }
+    return n;
+  }
+
+}
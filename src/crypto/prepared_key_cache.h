@@ -0,0 +1,90 @@
+// Copyright (c) 2018, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <boost/thread/mutex.hpp>
+
+#include "crypto.h"
+#include "hash.h"
+
+#define PREPARED_KEY_CACHE_DEFAULT_ENTRIES 2048
+#define PREPARED_KEY_CACHE_DEFAULT_SHARDS 16
+
+namespace crypto {
+
+  /* A public key ready for signature checks, see dilithium-prepared.h
+   */
+  class prepared_public_key {
+  public:
+    explicit prepared_public_key(const public_key &pub);
+    const void *data() const { return m_data.get(); }
+
+  private:
+    std::unique_ptr<uint64_t[]> m_data;
+  };
+
+  /* Bounded LRU cache of prepared public keys, keyed by the hash of the key.
+   * Split into shards with their own lock so threads checking signatures in
+   * parallel rarely contend. Keys are prepared outside of the lock.
+   */
+  class prepared_key_cache {
+  public:
+    prepared_key_cache(size_t max_entries = PREPARED_KEY_CACHE_DEFAULT_ENTRIES, size_t n_shards = PREPARED_KEY_CACHE_DEFAULT_SHARDS);
+
+    std::shared_ptr<const prepared_public_key> get(const public_key &pub);
+
+    size_t size() const;
+    uint64_t get_hits() const { return m_hits; }
+    uint64_t get_misses() const { return m_misses; }
+
+  private:
+    typedef std::shared_ptr<const prepared_public_key> entry_ptr;
+
+    struct shard {
+      mutable boost::mutex mutex;
+      std::list<hash> lru; // most recently used first
+      std::unordered_map<hash, std::pair<entry_ptr, std::list<hash>::iterator>> entries;
+    };
+
+    shard &get_shard(const hash &h);
+
+    std::unique_ptr<shard[]> m_shards;
+    size_t m_n_shards;
+    size_t m_max_entries_per_shard;
+    std::atomic<uint64_t> m_hits;
+    std::atomic<uint64_t> m_misses;
+  };
+
+}
@@ -265,7 +265,7 @@ namespace cryptonote
   //---------------------------------------------------------------
   bool generate_key_image_helper_precomp(const account_keys& ack, const crypto::public_key& out_key, const crypto::key_derivation& recv_derivation, size_t real_output_index, const subaddress_index& received_index, keypair& in_ephemeral, crypto::key_image& ki, hw::device &hwdev)
   {
-	LOG_PRINT_L1("::generate_key_image_helper_precomp");
+	MLOG_HOT(el::Level::Info, "::generate_key_image_helper_precomp");
     if (ack.m_spend_secret_key == crypto::null_skey)
     {
       // for watch-only wallet, simply copy the known output pubkey
@@ -293,14 +293,14 @@ namespace cryptonote
       }
 
       in_ephemeral.sec = scalar_step2;
-      LOG_PRINT_L1("::generate_key_image_helper_precomp in_ephermal.sec = " << in_ephemeral.sec);
+      MLOG_HOT(el::Level::Info, "::generate_key_image_helper_precomp in_ephemeral.sec derived");
 
       if (ack.m_multisig_keys.empty())
       {
         // when not in multisig, we know the full spend secret key, so the output pubkey can be obtained by scalarmultBase
         //CHECK_AND_ASSERT_MES(hwdev.secret_key_to_public_key(in_ephemeral.sec, in_ephemeral.pub), false, "Failed to derive public key"); TODO
         in_ephemeral.pub = out_key;
-	    LOG_PRINT_L1("::generate_key_image_helper_precomp in_ephermal.pub = " << in_ephemeral.sec);
+	    MLOG_HOT(el::Level::Info, "::generate_key_image_helper_precomp in_ephemeral.pub = " << in_ephemeral.pub);
       }
       else
       {
@@ -1014,6 +1014,16 @@ namespace cryptonote
     return blob;
   }
   //---------------------------------------------------------------
+  size_t get_block_hashing_blob_nonce_offset(const block_header& b)
+  {
+    // the nonce is the only fixed width field after the varint encoded header fields and prev_id,
+    // so a miner can serialize the hashing blob once and patch these four bytes for each attempt
+    return tools::get_varint_data(b.major_version).size() +
+      tools::get_varint_data(b.minor_version).size() +
+      tools::get_varint_data(b.timestamp).size() +
+      sizeof(crypto::hash);
+  }
+  //---------------------------------------------------------------
   bool calculate_block_hash(const block& b, crypto::hash& res)
   {
     // EXCEPTION FOR BLOCK 202612
@@ -1068,7 +1078,7 @@ namespace cryptonote
     return p;
   }
   //---------------------------------------------------------------
-  bool get_block_longhash(const block& b, crypto::hash& res, uint64_t height)
+  bool get_block_longhash(const blobdata& hashing_blob, uint8_t major_version, crypto::hash& res, uint64_t height)
   {
     // block 202612 bug workaround
     const std::string longhash_202612 = "84f64766475d51837ac9efbef1926486e58563c95a19fef4aec3254f03000000";
@@ -1077,12 +1087,16 @@ namespace cryptonote
       string_tools::hex_to_pod(longhash_202612, res);
       return true;
     }
-    blobdata bd = get_block_hashing_blob(b);
-    const int cn_variant = b.major_version >= 7 ? b.major_version - 6 : 0;
-    crypto::cn_slow_hash(bd.data(), bd.size(), res, cn_variant, height);
+    const int cn_variant = major_version >= 7 ? major_version - 6 : 0;
+    crypto::cn_slow_hash(hashing_blob.data(), hashing_blob.size(), res, cn_variant, height);
     return true;
   }
   //---------------------------------------------------------------
+  bool get_block_longhash(const block& b, crypto::hash& res, uint64_t height)
+  {
+    return get_block_longhash(get_block_hashing_blob(b), b.major_version, res, height);
+  }
+  //---------------------------------------------------------------
   std::vector<uint64_t> relative_output_offsets_to_absolute(const std::vector<uint64_t>& off)
   {
     std::vector<uint64_t> res = off;
@@ -119,24 +119,9 @@ namespace cryptonote {
     return !carry;
   }
 
-  difficulty_type next_difficulty(std::vector<std::uint64_t> timestamps, std::vector<difficulty_type> cumulative_difficulties, size_t target_seconds) {
-
-    if(timestamps.size() > DIFFICULTY_WINDOW)
-    {
-      timestamps.resize(DIFFICULTY_WINDOW);
-      cumulative_difficulties.resize(DIFFICULTY_WINDOW);
-    }
-
-
-    size_t length = timestamps.size();
-    assert(length == cumulative_difficulties.size());
-    if (length <= 1) {
-      return 1;
-    }
-    static_assert(DIFFICULTY_WINDOW >= 2, "Window is too small");
-    assert(length <= DIFFICULTY_WINDOW);
-    sort(timestamps.begin(), timestamps.end());
-    size_t cut_begin, cut_end;
+  // the range of the sorted timestamps, and of the cumulative difficulties,
+  // which is left after cutting outliers off a window of length blocks
+  static void get_cut(size_t length, size_t &cut_begin, size_t &cut_end) {
     static_assert(2 * DIFFICULTY_CUT <= DIFFICULTY_WINDOW - 2, "Cut length is too large");
     if (length <= DIFFICULTY_WINDOW - 2 * DIFFICULTY_CUT) {
       cut_begin = 0;
@@ -146,11 +131,12 @@ namespace cryptonote {
       cut_end = cut_begin + (DIFFICULTY_WINDOW - 2 * DIFFICULTY_CUT);
     }
     assert(/*cut_begin >= 0 &&*/ cut_begin + 2 <= cut_end && cut_end <= length);
-    uint64_t time_span = timestamps[cut_end - 1] - timestamps[cut_begin];
+  }
+
+  static difficulty_type difficulty_from_span(uint64_t time_span, difficulty_type total_work, size_t target_seconds) {
     if (time_span == 0) {
       time_span = 1;
     }
-    difficulty_type total_work = cumulative_difficulties[cut_end - 1] - cumulative_difficulties[cut_begin];
     assert(total_work > 0);
     uint64_t low, high;
     mul(total_work, target_seconds, low, high);
@@ -162,4 +148,85 @@ namespace cryptonote {
     return (low + time_span - 1) / time_span;
   }
 
+  difficulty_type next_difficulty(std::vector<std::uint64_t> timestamps, std::vector<difficulty_type> cumulative_difficulties, size_t target_seconds) {
+
+    if(timestamps.size() > DIFFICULTY_WINDOW)
+    {
+      timestamps.resize(DIFFICULTY_WINDOW);
+      cumulative_difficulties.resize(DIFFICULTY_WINDOW);
+    }
+
+
+    size_t length = timestamps.size();
+    assert(length == cumulative_difficulties.size());
+    if (length <= 1) {
+      return 1;
+    }
+    static_assert(DIFFICULTY_WINDOW >= 2, "Window is too small");
+    assert(length <= DIFFICULTY_WINDOW);
+    sort(timestamps.begin(), timestamps.end());
+    size_t cut_begin, cut_end;
+    get_cut(length, cut_begin, cut_end);
+    return difficulty_from_span(timestamps[cut_end - 1] - timestamps[cut_begin], cumulative_difficulties[cut_end - 1] - cumulative_difficulties[cut_begin], target_seconds);
+  }
+
+  difficulty_window::difficulty_window(): m_blocks(DIFFICULTY_BLOCKS_COUNT) {
+    m_sorted_timestamps.reserve(DIFFICULTY_WINDOW);
+  }
+
+  void difficulty_window::insert_timestamp(uint64_t timestamp) {
+    m_sorted_timestamps.insert(std::upper_bound(m_sorted_timestamps.begin(), m_sorted_timestamps.end(), timestamp), timestamp);
+  }
+
+  void difficulty_window::erase_timestamp(uint64_t timestamp) {
+    const auto i = std::lower_bound(m_sorted_timestamps.begin(), m_sorted_timestamps.end(), timestamp);
+    assert(i != m_sorted_timestamps.end() && *i == timestamp);
+    m_sorted_timestamps.erase(i);
+  }
+
+  // only the first DIFFICULTY_WINDOW blocks are used, the last DIFFICULTY_LAG
+  // ones are waiting their turn, so each move below keeps m_sorted_timestamps
+  // in step with whichever blocks are at positions [0, DIFFICULTY_WINDOW)
+  void difficulty_window::push_back(uint64_t timestamp, difficulty_type cumulative_difficulty) {
+    if (m_blocks.full()) {
+      erase_timestamp(m_blocks.front().first);
+      m_blocks.pop_front();
+      if (m_blocks.size() >= DIFFICULTY_WINDOW)
+        insert_timestamp(m_blocks[DIFFICULTY_WINDOW - 1].first);
+    }
+    m_blocks.push_back(std::make_pair(timestamp, cumulative_difficulty));
+    if (m_blocks.size() <= DIFFICULTY_WINDOW)
+      insert_timestamp(timestamp);
+  }
+
+  void difficulty_window::push_front(uint64_t timestamp, difficulty_type cumulative_difficulty) {
+    assert(!m_blocks.full());
+    if (m_blocks.size() >= DIFFICULTY_WINDOW)
+      erase_timestamp(m_blocks[DIFFICULTY_WINDOW - 1].first);
+    m_blocks.push_front(std::make_pair(timestamp, cumulative_difficulty));
+    insert_timestamp(timestamp);
+  }
+
+  void difficulty_window::pop_back() {
+    assert(!m_blocks.empty());
+    if (m_blocks.size() <= DIFFICULTY_WINDOW)
+      erase_timestamp(m_blocks.back().first);
+    m_blocks.pop_back();
+  }
+
+  void difficulty_window::clear() {
+    m_blocks.clear();
+    m_sorted_timestamps.clear();
+  }
+
+  difficulty_type difficulty_window::next_difficulty(size_t target_seconds) const {
+    const size_t length = m_sorted_timestamps.size();
+    if (length <= 1) {
+      return 1;
+    }
+    size_t cut_begin, cut_end;
+    get_cut(length, cut_begin, cut_end);
+    return difficulty_from_span(m_sorted_timestamps[cut_end - 1] - m_sorted_timestamps[cut_begin], m_blocks[cut_end - 1].second - m_blocks[cut_begin].second, target_seconds);
+  }
+
 }
@@ -32,6 +32,7 @@
 
 #include <cstdint>
 #include <vector>
+#include <boost/circular_buffer.hpp>
 
 #include "crypto/hash.h"
 
@@ -53,4 +54,42 @@ namespace cryptonote
      */
     bool check_hash(const crypto::hash &hash, difficulty_type difficulty);
     difficulty_type next_difficulty(std::vector<std::uint64_t> timestamps, std::vector<difficulty_type> cumulative_difficulties, size_t target_seconds);
+
+    /**
+     * @brief the timestamps and cumulative difficulties of the last blocks a difficulty is computed from
+     *
+     * Holds up to DIFFICULTY_BLOCKS_COUNT blocks, oldest first, in a fixed
+     * capacity ring buffer, and keeps the timestamps of the first
+     * DIFFICULTY_WINDOW of them sorted as they move in and out, so that
+     * next_difficulty gives the same result as the free function on the same
+     * blocks without copying or sorting anything.
+     *
+     * Windows are cheap to copy, which is how a window for an alternative
+     * chain is forked off the main chain's one.
+     */
+    class difficulty_window
+    {
+    public:
+      difficulty_window();
+
+      //! appends the newest block, dropping the oldest one if full
+      void push_back(std::uint64_t timestamp, difficulty_type cumulative_difficulty);
+      //! prepends a block older than all the others, must not be full
+      void push_front(std::uint64_t timestamp, difficulty_type cumulative_difficulty);
+      void pop_back();
+      void clear();
+
+      size_t size() const { return m_blocks.size(); }
+      bool empty() const { return m_blocks.empty(); }
+      bool full() const { return m_blocks.full(); }
+
+      difficulty_type next_difficulty(size_t target_seconds) const;
+
+    private:
+      void insert_timestamp(std::uint64_t timestamp);
+      void erase_timestamp(std::uint64_t timestamp);
+
+      boost::circular_buffer<std::pair<std::uint64_t, difficulty_type>> m_blocks;
+      std::vector<std::uint64_t> m_sorted_timestamps;
+    };
 }
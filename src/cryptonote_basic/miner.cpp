@@ -45,6 +45,7 @@
 #include "string_tools.h"
 #include "storages/portable_storage_template_helper.h"
 #include "boost/logic/tribool.hpp"
+#include "common/int-util.h"
 
 #ifdef __APPLE__
   #include <sys/times.h>
@@ -69,6 +70,11 @@
 #include <unistd.h>
 #endif
 
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "miner"
 
@@ -87,11 +93,38 @@ namespace cryptonote
     const command_line::arg_descriptor<std::string> arg_extra_messages =  {"extra-messages-file", "Specify file for extra messages to include into coinbase transactions", "", true};
     const command_line::arg_descriptor<std::string> arg_start_mining =    {"start-mining", "Specify wallet address to mining for", "", true};
     const command_line::arg_descriptor<uint32_t>      arg_mining_threads =  {"mining-threads", "Specify mining threads count", 0, true};
+    const command_line::arg_descriptor<bool>        arg_mining_pin_threads =  {"mining-pin-threads", "Pin each mining thread to its own CPU core", false, true};
     const command_line::arg_descriptor<bool>        arg_bg_mining_enable =  {"bg-mining-enable", "enable/disable background mining", true, true};
     const command_line::arg_descriptor<bool>        arg_bg_mining_ignore_battery =  {"bg-mining-ignore-battery", "if true, assumes plugged in when unable to query system power status", false, true};    
     const command_line::arg_descriptor<uint64_t>    arg_bg_mining_min_idle_interval_seconds =  {"bg-mining-min-idle-interval", "Specify min lookback interval in seconds for determining idle state", miner::BACKGROUND_MINING_DEFAULT_MIN_IDLE_INTERVAL_IN_SECONDS, true};
     const command_line::arg_descriptor<uint16_t>     arg_bg_mining_idle_threshold_percentage =  {"bg-mining-idle-threshold", "Specify minimum avg idle percentage over lookback interval", miner::BACKGROUND_MINING_DEFAULT_IDLE_THRESHOLD_PERCENTAGE, true};
     const command_line::arg_descriptor<uint16_t>     arg_bg_mining_miner_target_percentage =  {"bg-mining-miner-target", "Specify maximum percentage cpu use by miner(s)", miner::BACKGROUND_MINING_DEFAULT_MINING_TARGET_PERCENTAGE, true};
+
+    bool pin_current_thread(uint32_t index)
+    {
+      const unsigned int cores = boost::thread::hardware_concurrency();
+      if (cores == 0)
+        return false;
+      const unsigned int core = index % cores;
+#if defined(_WIN32)
+      if (core >= sizeof(DWORD_PTR) * 8)
+        return false;
+      return SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << core) != 0;
+#elif defined(__linux__)
+      cpu_set_t cpus;
+      CPU_ZERO(&cpus);
+      CPU_SET(core, &cpus);
+      return pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+#else
+      return false;
+#endif
+    }
+
+    void set_hashing_blob_nonce(blobdata& hashing_blob, size_t nonce_offset, uint32_t nonce)
+    {
+      nonce = SWAP32LE(nonce);
+      memcpy(&hashing_blob[nonce_offset], &nonce, sizeof(nonce));
+    }
   }
 
 
@@ -106,10 +139,10 @@ namespace cryptonote
     m_threads_total(0),
     m_starter_nonce(0),
     m_last_hr_merge_time(0),
-    m_hashes(0),
+    m_current_hash_rate(0),
     m_do_print_hashrate(false),
     m_do_mining(false),
-    m_current_hash_rate(0),
+    m_pin_threads(false),
     m_is_background_mining_enabled(false),
     m_min_idle_seconds(BACKGROUND_MINING_DEFAULT_MIN_IDLE_INTERVAL_IN_SECONDS),
     m_idle_threshold(BACKGROUND_MINING_DEFAULT_IDLE_THRESHOLD_PERCENTAGE),
@@ -188,10 +221,21 @@ namespace cryptonote
   //-----------------------------------------------------------------------------------------------------
   void miner::merge_hr()
   {
+    CRITICAL_REGION_LOCAL(m_last_hash_rates_lock);
+    std::vector<uint64_t> threads_hashes(m_threads_hashes.size());
+    uint64_t hashes = 0;
+    for(size_t i = 0; i != m_threads_hashes.size(); i++)
+    {
+      threads_hashes[i] = m_threads_hashes[i].exchange(0);
+      hashes += threads_hashes[i];
+    }
     if(m_last_hr_merge_time && is_mining())
     {
-      m_current_hash_rate = m_hashes * 1000 / ((misc_utils::get_tick_count() - m_last_hr_merge_time + 1));
-      CRITICAL_REGION_LOCAL(m_last_hash_rates_lock);
+      const uint64_t elapsed = misc_utils::get_tick_count() - m_last_hr_merge_time + 1;
+      m_current_hash_rate = hashes * 1000 / elapsed;
+      m_threads_hash_rates.resize(threads_hashes.size());
+      for(size_t i = 0; i != threads_hashes.size(); i++)
+        m_threads_hash_rates[i] = threads_hashes[i] * 1000 / elapsed;
       m_last_hash_rates.push_back(m_current_hash_rate);
       if(m_last_hash_rates.size() > 19)
         m_last_hash_rates.pop_front();
@@ -205,7 +249,6 @@ namespace cryptonote
       }
     }
     m_last_hr_merge_time = misc_utils::get_tick_count();
-    m_hashes = 0;
   }
   //-----------------------------------------------------------------------------------------------------
   void miner::init_options(boost::program_options::options_description& desc)
@@ -213,6 +256,7 @@ namespace cryptonote
     command_line::add_arg(desc, arg_extra_messages);
     command_line::add_arg(desc, arg_start_mining);
     command_line::add_arg(desc, arg_mining_threads);
+    command_line::add_arg(desc, arg_mining_pin_threads);
     command_line::add_arg(desc, arg_bg_mining_enable);
     command_line::add_arg(desc, arg_bg_mining_ignore_battery);    
     command_line::add_arg(desc, arg_bg_mining_min_idle_interval_seconds);
@@ -261,6 +305,7 @@ namespace cryptonote
         m_threads_total = command_line::get_arg(vm, arg_mining_threads);
       }
     }
+    m_pin_threads = command_line::get_arg(vm, arg_mining_pin_threads);
 
     // Background mining parameters
     // Let init set all parameters even if background mining is not enabled, they can start later with params set
@@ -314,6 +359,11 @@ namespace cryptonote
 
     boost::interprocess::ipcdetail::atomic_write32(&m_stop, 0);
     boost::interprocess::ipcdetail::atomic_write32(&m_thread_index, 0);
+    {
+      CRITICAL_REGION_LOCAL1(m_last_hash_rates_lock);
+      m_threads_hashes = std::vector<std::atomic<uint64_t>>(threads_count);
+      m_threads_hash_rates.clear();
+    }
     set_is_background_mining_enabled(do_background);
     set_ignore_battery(ignore_battery);
     
@@ -348,6 +398,14 @@ namespace cryptonote
     }
   }
   //-----------------------------------------------------------------------------------------------------
+  std::vector<uint64_t> miner::get_threads_speed() const
+  {
+    if(!is_mining())
+      return std::vector<uint64_t>();
+    CRITICAL_REGION_LOCAL(m_last_hash_rates_lock);
+    return m_threads_hash_rates;
+  }
+  //-----------------------------------------------------------------------------------------------------
   void miner::send_stop_signal()
   {
     boost::interprocess::ipcdetail::atomic_write32(&m_stop, 1);
@@ -385,10 +443,13 @@ namespace cryptonote
   //-----------------------------------------------------------------------------------------------------
   bool miner::find_nonce_for_given_block(block& bl, const difficulty_type& diffic, uint64_t height)
   {
+    blobdata hashing_blob = get_block_hashing_blob(bl);
+    const size_t nonce_offset = get_block_hashing_blob_nonce_offset(bl);
     for(; bl.nonce != std::numeric_limits<uint32_t>::max(); bl.nonce++)
     {
       crypto::hash h;
-      get_block_longhash(bl, h, height);
+      set_hashing_blob_nonce(hashing_blob, nonce_offset, bl.nonce);
+      get_block_longhash(hashing_blob, bl.major_version, h, height);
 
       if(check_hash(h, diffic))
       {
@@ -444,6 +505,11 @@ namespace cryptonote
     difficulty_type local_diff = 0;
     uint32_t local_template_ver = 0;
     block b;
+    blobdata hashing_blob;
+    size_t nonce_offset = 0;
+    if(m_pin_threads && !pin_current_thread(th_local_index))
+      MWARNING("Failed to pin miner thread [" << th_local_index << "] to a CPU core");
+    // the scratchpad (hugepage backed where available) is allocated once and reused for every hash
     slow_hash_allocate_state();
     while(!m_stop)
     {
@@ -475,6 +541,8 @@ namespace cryptonote
         CRITICAL_REGION_END();
         local_template_ver = m_template_no;
         nonce = m_starter_nonce + th_local_index;
+        hashing_blob = get_block_hashing_blob(b);
+        nonce_offset = get_block_hashing_blob_nonce_offset(b);
       }
 
       if(!local_template_ver)//no any set_block_template call
@@ -484,13 +552,15 @@ namespace cryptonote
         continue;
       }
 
-      b.nonce = nonce;
       crypto::hash h;
-      get_block_longhash(b, h, height);
+      set_hashing_blob_nonce(hashing_blob, nonce_offset, nonce);
+      get_block_longhash(hashing_blob, b.major_version, h, height);
 
       if(check_hash(h, local_diff))
       {
         //we lucky!
+        b.nonce = nonce;
+        b.invalidate_hashes();
         ++m_config.current_extra_message_index;
         MGINFO_GREEN("Found block " << get_block_hash(b) << " at height " << height << " for difficulty: " << local_diff);
         if(!m_phandler->handle_block_found(b))
@@ -504,7 +574,7 @@ namespace cryptonote
         }
       }
       nonce+=m_threads_total;
-      ++m_hashes;
+      ++m_threads_hashes[th_local_index];
     }
     slow_hash_free_state();
     MGINFO("Miner thread stopped ["<< th_local_index << "]");
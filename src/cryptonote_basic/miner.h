@@ -70,6 +70,7 @@ namespace cryptonote
     bool on_block_chain_update();
     bool start(const account_public_address& adr, size_t threads_count, const boost::thread::attributes& attrs, bool do_background = false, bool ignore_battery = false);
     uint64_t get_speed() const;
+    std::vector<uint64_t> get_threads_speed() const;
     uint32_t get_threads_count() const;
     void send_stop_signal();
     bool stop();
@@ -141,12 +142,14 @@ namespace cryptonote
     miner_config m_config;
     std::string m_config_folder_path;    
     std::atomic<uint64_t> m_last_hr_merge_time;
-    std::atomic<uint64_t> m_hashes;
+    std::vector<std::atomic<uint64_t>> m_threads_hashes;
+    std::vector<uint64_t> m_threads_hash_rates;
     std::atomic<uint64_t> m_current_hash_rate;
-    epee::critical_section m_last_hash_rates_lock;
+    mutable epee::critical_section m_last_hash_rates_lock;
     std::list<uint64_t> m_last_hash_rates;
     bool m_do_print_hashrate;
     bool m_do_mining;
+    bool m_pin_threads;
 
     // background mining stuffs ..
 
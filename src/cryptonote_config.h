@@ -101,6 +101,9 @@
 
 #define COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT           1000
 
+#define COMMAND_RPC_GET_BLOCKS_STREAM_PAGE_COUNT        20 //blocks read and sent at a time by get_blocks_stream.bin
+#define BLOCK_RESPONSE_CACHE_MAX_SIZE                   (64*1024*1024) //bytes of packed block spans kept to answer syncing peers and wallets
+
 #define P2P_LOCAL_WHITE_PEERLIST_LIMIT                  1000
 #define P2P_LOCAL_GRAY_PEERLIST_LIMIT                   5000
 
@@ -121,7 +124,11 @@
 #define P2P_IDLE_CONNECTION_KILL_INTERVAL               (5*60) //5 minutes
 
 #define P2P_SUPPORT_FLAG_FLUFFY_BLOCKS                  0x01
-#define P2P_SUPPORT_FLAGS                               P2P_SUPPORT_FLAG_FLUFFY_BLOCKS
+#define P2P_SUPPORT_FLAG_COMPACT_BLOCKS                 0x02
+#define P2P_SUPPORT_FLAG_TX_RECONCILIATION              0x04
+#define P2P_SUPPORT_FLAGS                               (P2P_SUPPORT_FLAG_FLUFFY_BLOCKS | P2P_SUPPORT_FLAG_COMPACT_BLOCKS | P2P_SUPPORT_FLAG_TX_RECONCILIATION)
+
+#define P2P_TX_RECONCILIATION_INTERVAL                  2           //seconds
 
 #define ALLOW_DEBUG_COMMANDS
 
@@ -0,0 +1,122 @@
+// Copyright (c) 2018, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <iterator>
+#include <tuple>
+
+#include "block_response_cache.h"
+
+namespace cryptonote
+{
+  bool block_response_cache::key::operator<(const key &other) const
+  {
+    return std::tie(start_height, count, variant) < std::tie(other.start_height, other.count, other.variant);
+  }
+
+  block_response_cache::block_response_cache(size_t max_size):
+    m_max_size(max_size),
+    m_size(0),
+    m_generation(0)
+  {
+  }
+
+  size_t block_response_cache::get_span_size(const span &s)
+  {
+    return s.entries->size() + s.block_ids.size() * sizeof(crypto::hash);
+  }
+
+  void block_response_cache::erase(lru_list::iterator i)
+  {
+    m_size -= get_span_size(i->second);
+    m_spans.erase(i->first);
+    m_lru.erase(i);
+  }
+
+  bool block_response_cache::find(uint64_t start_height, uint64_t count, uint8_t variant, span &s)
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    const auto i = m_spans.find({start_height, count, variant});
+    if (i == m_spans.end())
+      return false;
+    m_lru.splice(m_lru.begin(), m_lru, i->second);
+    s = i->second->second;
+    return true;
+  }
+
+  void block_response_cache::add(uint64_t start_height, uint64_t count, uint8_t variant, span s, uint64_t generation)
+  {
+    const size_t size = get_span_size(s);
+    CRITICAL_REGION_LOCAL(m_lock);
+    if (generation != m_generation || size > m_max_size)
+      return;
+    const key k = {start_height, count, variant};
+    const auto i = m_spans.find(k);
+    if (i != m_spans.end())
+      erase(i->second);
+    while (m_size + size > m_max_size)
+      erase(std::prev(m_lru.end()));
+    m_lru.emplace_front(k, std::move(s));
+    m_spans[k] = m_lru.begin();
+    m_size += size;
+  }
+
+  void block_response_cache::invalidate(uint64_t height)
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    ++m_generation;
+    for (auto i = m_spans.begin(); i != m_spans.end(); )
+    {
+      const lru_list::iterator s = i->second;
+      ++i;
+      if (s->first.start_height + s->second.block_count > height)
+        erase(s);
+    }
+  }
+
+  void block_response_cache::clear()
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    ++m_generation;
+    m_spans.clear();
+    m_lru.clear();
+    m_size = 0;
+  }
+
+  uint64_t block_response_cache::get_generation() const
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    return m_generation;
+  }
+
+  size_t block_response_cache::get_size() const
+  {
+    CRITICAL_REGION_LOCAL(m_lock);
+    return m_size;
+  }
+}
@@ -0,0 +1,136 @@
+// Copyright (c) 2018, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "syncobj.h"
+#include "crypto/hash.h"
+
+namespace cryptonote
+{
+  /**
+   * @brief bounded cache of packed responses for spans of main chain blocks
+   *
+   * A span is stored as the portable-storage root entries of a response
+   * (e.g. "blocks", packed with store_t_entries_to_binary), so answering a
+   * request for it only means splicing those bytes into a reply. Spans are
+   * keyed by start height, requested count and a variant telling apart the
+   * differently packed responses, and the least recently used ones are
+   * dropped once the total size goes over the limit.
+   *
+   * Spans only ever cover main chain blocks, so they stay valid as blocks
+   * are added, and must be invalidated when blocks are popped.
+   */
+  class block_response_cache
+  {
+  public:
+    enum variant_flags
+    {
+      variant_pruned = 1,
+      variant_rpc = 2,
+      variant_no_miner_tx = 4,
+    };
+
+    struct span
+    {
+      std::shared_ptr<const std::string> entries; //!< packed root entries
+      size_t entry_count;                           //!< number of entries packed
+      uint64_t block_count;                         //!< number of blocks in the span
+      std::vector<crypto::hash> block_ids;          //!< ids of the blocks, if the requester needs them checked
+
+      span(): entry_count(0), block_count(0) {}
+    };
+
+    block_response_cache(size_t max_size);
+
+    /**
+     * @brief gets a cached span, marking it as recently used
+     *
+     * @return true if found
+     */
+    bool find(uint64_t start_height, uint64_t count, uint8_t variant, span &s);
+
+    /**
+     * @brief adds a span, unless blocks were popped since generation was read
+     *
+     * @param generation the value of get_generation() before the span was read from the db
+     */
+    void add(uint64_t start_height, uint64_t count, uint8_t variant, span s, uint64_t generation);
+
+    /**
+     * @brief drops all spans with blocks at or above height
+     */
+    void invalidate(uint64_t height);
+
+    /**
+     * @brief drops all spans
+     */
+    void clear();
+
+    /**
+     * @brief changes whenever spans are invalidated
+     */
+    uint64_t get_generation() const;
+
+    /**
+     * @brief the total size of the cached spans
+     */
+    size_t get_size() const;
+
+  private:
+    struct key
+    {
+      uint64_t start_height;
+      uint64_t count;
+      uint8_t variant;
+
+      bool operator<(const key &other) const;
+    };
+
+    typedef std::list<std::pair<key, span>> lru_list;
+
+    static size_t get_span_size(const span &s);
+    void erase(lru_list::iterator i);
+
+    mutable epee::critical_section m_lock;
+    const size_t m_max_size;
+    size_t m_size;
+    uint64_t m_generation;
+    lru_list m_lru; // most recently used first
+    std::map<key, lru_list::iterator> m_spans;
+  };
+}
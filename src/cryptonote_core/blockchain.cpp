@@ -46,6 +46,7 @@
 #include "file_io_utils.h"
 #include "common/int-util.h"
 #include "common/threadpool.h"
+#include "crypto/batch_verifier.h"
 #include "common/boost_serialization_helper.h"
 #include "warnings.h"
 #include "crypto/hash.h"
@@ -53,6 +54,7 @@
 #include "ringct/rctSigs.h"
 #include "common/perf_timer.h"
 #include "common/notify.h"
+#include "storages/portable_storage_template_helper.h"
 #if defined(PER_BLOCK_CHECKPOINT)
 #include "blocks/blocks.h"
 #endif
@@ -84,6 +86,19 @@ DISABLE_VS_WARNINGS(4267)
 // used to overestimate the block reward when estimating a per kB to use
 #define BLOCK_REWARD_OVERESTIMATE (10 * 1000000000000)
 
+namespace
+{
+  // the blocks of a NOTIFY_RESPONSE_GET_OBJECTS on their own, to be packed once and cached
+  struct get_objects_blocks
+  {
+    std::vector<block_complete_entry> blocks;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(blocks)
+    END_KV_SERIALIZE_MAP()
+  };
+}
+
 static const struct {
   uint8_t version;
   uint64_t height;
@@ -135,7 +150,10 @@ Blockchain::Blockchain(tx_memory_pool& tx_pool) :
   m_long_term_effective_median_block_weight(0),
   m_difficulty_for_next_block_top_hash(crypto::null_hash),
   m_difficulty_for_next_block(1),
-  m_btc_valid(false)
+  m_btc_valid(false),
+  m_btt_valid(false),
+  m_batch_popped_block(false),
+  m_block_response_cache(BLOCK_RESPONSE_CACHE_MAX_SIZE)
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
 }
@@ -467,6 +485,13 @@ bool Blockchain::init(BlockchainDB* db, const network_type nettype, bool offline
   if (test_options && test_options->long_term_block_weight_window)
     m_long_term_block_weights_window = test_options->long_term_block_weight_window;
 
+  // load the block weights windows here rather than when the first block
+  // is added, with m_blockchain_lock held. The long term one is loaded
+  // even before its fork, which would otherwise pay for it at the fork
+  const uint64_t db_height = m_db->height();
+  sync_block_weights_window(m_short_term_block_weights, db_height, CRYPTONOTE_REWARD_BLOCKS_WINDOW, false);
+  sync_block_weights_window(m_long_term_block_weights, db_height, m_long_term_block_weights_window, true);
+
   if (!update_next_cumulative_weight_limit())
     return false;
   return true;
@@ -531,6 +556,9 @@ bool Blockchain::deinit()
     throw DB_ERROR("The db pointer is null in Blockchain, the blockchain may be corrupt!");
   }
 
+  // waits for any lookups still running
+  m_output_prefetch_ahead.reset();
+
   try
   {
     m_db->close();
@@ -560,6 +588,7 @@ block Blockchain::pop_block_from_blockchain()
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
+  const bool difficulty_window_valid = m_timestamps_and_difficulties_height != 0 && m_timestamps_and_difficulties_height == m_db->height();
   m_timestamps_and_difficulties_height = 0;
 
   block popped_block;
@@ -582,6 +611,20 @@ block Blockchain::pop_block_from_blockchain()
     throw;
   }
 
+  m_block_response_cache.invalidate(m_db->height());
+
+  // step the difficulty window back along with the chain, so a reorg does
+  // not reload it in full for every block it pops and adds
+  if (difficulty_window_valid && !m_difficulty_window.empty())
+  {
+    const uint64_t height = m_db->height();
+    const uint64_t blocks_count = DIFFICULTY_BLOCKS_COUNT;
+    m_difficulty_window.pop_back();
+    if (height > blocks_count)
+      m_difficulty_window.push_front(m_db->get_block_timestamp(height - blocks_count), m_db->get_block_cumulative_difficulty(height - blocks_count));
+    m_timestamps_and_difficulties_height = height;
+  }
+
   // make sure the hard fork object updates its current version
   m_hardfork->on_block_popped(1);
 
@@ -614,6 +657,9 @@ block Blockchain::pop_block_from_blockchain()
   m_scan_table.clear();
   m_blocks_txs_check.clear();
   m_check_txin_table.clear();
+  m_batch_sig_table.clear();
+  m_output_prefetch_ahead.reset();
+  m_batch_popped_block = true;
 
   CHECK_AND_ASSERT_THROW_MES(update_next_cumulative_weight_limit(), "Error updating next cumulative weight limit");
 
@@ -631,6 +677,7 @@ bool Blockchain::reset_and_set_genesis_block(const block& b)
   m_alternative_chains.clear();
   invalidate_block_template_cache();
   m_db->reset();
+  m_block_response_cache.clear();
   m_hardfork->init();
 
   block_verification_context bvc = boost::value_initialized<block_verification_context>();
@@ -804,54 +851,32 @@ difficulty_type Blockchain::get_difficulty_for_next_block()
   }
 
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
-  std::vector<uint64_t> timestamps;
-  std::vector<difficulty_type> difficulties;
   auto height = m_db->height();
   // ND: Speedup
-  // 1. Keep a list of the last 735 (or less) blocks that is used to compute difficulty,
-  //    then when the next block difficulty is queried, push the latest height data and
-  //    pop the oldest one from the list. This only requires 1x read per height instead
-  //    of doing 735 (DIFFICULTY_BLOCKS_COUNT).
-  if (m_timestamps_and_difficulties_height != 0 && ((height - m_timestamps_and_difficulties_height) == 1) && m_timestamps.size() >= DIFFICULTY_BLOCKS_COUNT)
+  // 1. Keep a window of the last 735 (or less) blocks that is used to compute difficulty,
+  //    then when the next block difficulty is queried, push the latest height data, which
+  //    drops the oldest one from the window. This only requires 1x read per height instead
+  //    of doing 735 (DIFFICULTY_BLOCKS_COUNT). Popped blocks are rewound from the window in
+  //    pop_block_from_blockchain, so it only needs reloading when it was invalidated.
+  const uint64_t blocks_count = DIFFICULTY_BLOCKS_COUNT;
+  if (m_timestamps_and_difficulties_height != 0 && height >= m_timestamps_and_difficulties_height && height - m_timestamps_and_difficulties_height <= blocks_count)
   {
-    uint64_t index = height - 1;
-    m_timestamps.push_back(m_db->get_block_timestamp(index));
-    m_difficulties.push_back(m_db->get_block_cumulative_difficulty(index));
-
-    while (m_timestamps.size() > DIFFICULTY_BLOCKS_COUNT)
-      m_timestamps.erase(m_timestamps.begin());
-    while (m_difficulties.size() > DIFFICULTY_BLOCKS_COUNT)
-      m_difficulties.erase(m_difficulties.begin());
-
-    m_timestamps_and_difficulties_height = height;
-    timestamps = m_timestamps;
-    difficulties = m_difficulties;
+    for (uint64_t index = m_timestamps_and_difficulties_height; index < height; ++index)
+      m_difficulty_window.push_back(m_db->get_block_timestamp(index), m_db->get_block_cumulative_difficulty(index));
   }
   else
   {
-    size_t offset = height - std::min < size_t > (height, static_cast<size_t>(DIFFICULTY_BLOCKS_COUNT));
+    uint64_t offset = height - std::min<uint64_t>(height, blocks_count);
     if (offset == 0)
       ++offset;
 
-    timestamps.clear();
-    difficulties.clear();
-    if (height > offset)
-    {
-      timestamps.reserve(height - offset);
-      difficulties.reserve(height - offset);
-    }
+    m_difficulty_window.clear();
     for (; offset < height; offset++)
-    {
-      timestamps.push_back(m_db->get_block_timestamp(offset));
-      difficulties.push_back(m_db->get_block_cumulative_difficulty(offset));
-    }
-
-    m_timestamps_and_difficulties_height = height;
-    m_timestamps = timestamps;
-    m_difficulties = difficulties;
+      m_difficulty_window.push_back(m_db->get_block_timestamp(offset), m_db->get_block_cumulative_difficulty(offset));
   }
+  m_timestamps_and_difficulties_height = height;
   size_t target = get_difficulty_target();
-  difficulty_type diff = next_difficulty(timestamps, difficulties, target);
+  difficulty_type diff = m_difficulty_window.next_difficulty(target);
 
   CRITICAL_REGION_LOCAL1(m_difficulty_lock);
   m_difficulty_for_next_block_top_hash = top_hash;
@@ -884,8 +909,6 @@ bool Blockchain::rollback_blockchain_switching(std::list<block>& original_chain,
     return true;
   }
 
-  m_timestamps_and_difficulties_height = 0;
-
   // remove blocks from blockchain until we get back to where we should be.
   while (m_db->height() != rollback_height)
   {
@@ -920,8 +943,6 @@ bool Blockchain::switch_to_alternative_blockchain(std::list<blocks_ext_by_hash::
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
-  m_timestamps_and_difficulties_height = 0;
-
   // if empty alt chain passed (not sure how that could happen), return false
   CHECK_AND_ASSERT_MES(alt_chain.size(), false, "switch_to_alternative_blockchain: empty chain passed");
 
@@ -1024,64 +1045,65 @@ difficulty_type Blockchain::get_next_difficulty_for_alternative_chain(const std:
   }
 
   LOG_PRINT_L3("Blockchain::" << __func__);
-  std::vector<uint64_t> timestamps;
-  std::vector<difficulty_type> cumulative_difficulties;
+  const size_t blocks_count = DIFFICULTY_BLOCKS_COUNT;
+  difficulty_window window;
 
   // if the alt chain isn't long enough to calculate the difficulty target
   // based on its blocks alone, need to get more blocks from the main chain
-  if(alt_chain.size()< DIFFICULTY_BLOCKS_COUNT)
+  if(alt_chain.size() < blocks_count)
   {
     CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
     // Figure out start and stop offsets for main chain blocks
     size_t main_chain_stop_offset = alt_chain.size() ? alt_chain.front()->second.height : bei.height;
-    size_t main_chain_count = DIFFICULTY_BLOCKS_COUNT - std::min(static_cast<size_t>(DIFFICULTY_BLOCKS_COUNT), alt_chain.size());
+    size_t main_chain_count = blocks_count - std::min(blocks_count, alt_chain.size());
     main_chain_count = std::min(main_chain_count, main_chain_stop_offset);
     size_t main_chain_start_offset = main_chain_stop_offset - main_chain_count;
 
     if(!main_chain_start_offset)
       ++main_chain_start_offset; //skip genesis block
 
-    // get difficulties and timestamps from relevant main chain blocks
-    for(; main_chain_start_offset < main_chain_stop_offset; ++main_chain_start_offset)
+    // fork the main chain's window if the split is recent enough: drop its
+    // blocks above the split, then read only the older blocks it is missing.
+    // Any extra older blocks it has are dropped as the alt blocks are added.
+    const uint64_t main_height = m_timestamps_and_difficulties_height;
+    if (main_height != 0 && main_height == m_db->height() && main_height >= main_chain_stop_offset && main_height - main_chain_stop_offset < blocks_count)
     {
-      timestamps.push_back(m_db->get_block_timestamp(main_chain_start_offset));
-      cumulative_difficulties.push_back(m_db->get_block_cumulative_difficulty(main_chain_start_offset));
+      window = m_difficulty_window;
+      for (uint64_t h = main_height; h > main_chain_stop_offset; --h)
+        window.pop_back();
+      for (size_t h = main_chain_stop_offset - window.size(); h > main_chain_start_offset; )
+      {
+        --h;
+        window.push_front(m_db->get_block_timestamp(h), m_db->get_block_cumulative_difficulty(h));
+      }
     }
-
-    // make sure we haven't accidentally grabbed too many blocks...maybe don't need this check?
-    CHECK_AND_ASSERT_MES((alt_chain.size() + timestamps.size()) <= DIFFICULTY_BLOCKS_COUNT, false, "Internal error, alt_chain.size()[" << alt_chain.size() << "] + vtimestampsec.size()[" << timestamps.size() << "] NOT <= DIFFICULTY_WINDOW[]" << DIFFICULTY_BLOCKS_COUNT);
-
-    for (auto it : alt_chain)
+    else
     {
-      timestamps.push_back(it->second.bl.timestamp);
-      cumulative_difficulties.push_back(it->second.cumulative_difficulty);
+      // get difficulties and timestamps from relevant main chain blocks
+      for(; main_chain_start_offset < main_chain_stop_offset; ++main_chain_start_offset)
+        window.push_back(m_db->get_block_timestamp(main_chain_start_offset), m_db->get_block_cumulative_difficulty(main_chain_start_offset));
     }
+
+    for (auto it : alt_chain)
+      window.push_back(it->second.bl.timestamp, it->second.cumulative_difficulty);
   }
   // if the alt chain is long enough for the difficulty calc, grab difficulties
   // and timestamps from it alone
   else
   {
-    timestamps.resize(static_cast<size_t>(DIFFICULTY_BLOCKS_COUNT));
-    cumulative_difficulties.resize(static_cast<size_t>(DIFFICULTY_BLOCKS_COUNT));
-    size_t count = 0;
-    size_t max_i = timestamps.size()-1;
     // get difficulties and timestamps from most recent blocks in alt chain
-    for(auto it: boost::adaptors::reverse(alt_chain))
-    {
-      timestamps[max_i - count] = it->second.bl.timestamp;
-      cumulative_difficulties[max_i - count] = it->second.cumulative_difficulty;
-      count++;
-      if(count >= DIFFICULTY_BLOCKS_COUNT)
-        break;
-    }
+    auto it = alt_chain.end();
+    std::advance(it, -static_cast<std::ptrdiff_t>(blocks_count));
+    for (; it != alt_chain.end(); ++it)
+      window.push_back((*it)->second.bl.timestamp, (*it)->second.cumulative_difficulty);
   }
 
   // FIXME: This will fail if fork activation heights are subject to voting
   size_t target = get_ideal_hard_fork_version(bei.height) < 2 ? DIFFICULTY_TARGET_V1 : DIFFICULTY_TARGET_V2;
 
   // calculate the difficulty target for the block and return it
-  return next_difficulty(timestamps, cumulative_difficulties, target);
+  return window.next_difficulty(target);
 }
 //------------------------------------------------------------------
 // This function does a sanity check on basic things that all miner
@@ -1243,22 +1265,21 @@ bool Blockchain::create_block_template(block& b, const account_public_address& m
     invalidate_block_template_cache();
   }
 
-  b.major_version = m_hardfork->get_current_version();
-  b.minor_version = m_hardfork->get_ideal_version();
-  b.prev_id = get_tail_id();
-  b.timestamp = time(NULL);
-
-  uint64_t median_ts;
-  if (!check_block_timestamp(b, median_ts))
-  {
-    b.timestamp = median_ts;
-  }
+  const crypto::hash prev_id = get_tail_id();
+  const block_template_tip *tip = get_block_template_tip(prev_id, height);
+  if (!tip)
+    return false;
 
-  diffic = get_difficulty_for_next_block();
-  CHECK_AND_ASSERT_MES(diffic, false, "difficulty overhead.");
+  b.major_version = tip->major_version;
+  b.minor_version = tip->minor_version;
+  b.prev_id = prev_id;
+  b.timestamp = time(NULL);
+  if (b.timestamp < tip->median_timestamp)
+    b.timestamp = tip->median_timestamp;
 
-  median_weight = m_current_block_cumul_weight_limit / 2;
-  already_generated_coins = m_db->get_block_already_generated_coins(height - 1);
+  diffic = tip->difficulty;
+  median_weight = tip->median_weight;
+  already_generated_coins = tip->already_generated_coins;
 
   size_t txs_weight;
   uint64_t fee;
@@ -1420,7 +1441,6 @@ bool Blockchain::handle_alternative_block(const block& b, const crypto::hash& id
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
-  m_timestamps_and_difficulties_height = 0;
   uint64_t block_height = get_block_height(b);
   if(0 == block_height)
   {
@@ -1698,6 +1718,58 @@ bool Blockchain::handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NO
   return true;
 }
 //------------------------------------------------------------------
+bool Blockchain::handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NOTIFY_RESPONSE_GET_OBJECTS::request& rsp, block_response_cache::span& packed_blocks)
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  packed_blocks = block_response_cache::span();
+  if (arg.blocks.empty() || !arg.txs.empty())
+    return handle_get_objects(arg, rsp);
+
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  uint64_t start_height;
+  try
+  {
+    start_height = m_db->get_block_height(arg.blocks.front());
+  }
+  catch (const BLOCK_DNE &)
+  {
+    return handle_get_objects(arg, rsp);
+  }
+
+  if (m_block_response_cache.find(start_height, arg.blocks.size(), 0, packed_blocks) && packed_blocks.block_ids == arg.blocks)
+  {
+    rsp.current_blockchain_height = get_current_blockchain_height();
+    return true;
+  }
+  packed_blocks = block_response_cache::span();
+
+  if (!handle_get_objects(arg, rsp))
+    return false;
+  if (!rsp.missed_ids.empty() || start_height + arg.blocks.size() > m_db->height())
+    return true;
+  for (size_t i = 1; i < arg.blocks.size(); ++i)
+    if (m_db->get_block_hash_from_height(start_height + i) != arg.blocks[i])
+      return true;
+
+  // a main chain span, pack it once for this and later requests
+  get_objects_blocks blocks_rsp;
+  blocks_rsp.blocks = std::move(rsp.blocks);
+  rsp.blocks.clear();
+  std::string entries;
+  if (!epee::serialization::store_t_entries_to_binary(blocks_rsp, entries, packed_blocks.entry_count))
+  {
+    MERROR("Failed to pack blocks");
+    rsp.blocks = std::move(blocks_rsp.blocks);
+    packed_blocks = block_response_cache::span();
+    return true;
+  }
+  packed_blocks.entries = std::make_shared<const std::string>(std::move(entries));
+  packed_blocks.block_count = arg.blocks.size();
+  packed_blocks.block_ids = arg.blocks;
+  m_block_response_cache.add(start_height, arg.blocks.size(), 0, packed_blocks, m_block_response_cache.get_generation());
+  return true;
+}
+//------------------------------------------------------------------
 bool Blockchain::get_alternative_blocks(std::vector<block>& blocks) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
@@ -2043,11 +2115,7 @@ bool Blockchain::find_blockchain_supplement(const std::list<crypto::hash>& qbloc
   return result;
 }
 //------------------------------------------------------------------
-//FIXME: change argument to std::vector, low priority
-// find split point between ours and foreign blockchain (or start at
-// blockchain height <req_start_block>), and return up to max_count FULL
-// blocks by reference.
-bool Blockchain::find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, std::vector<std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata> > > >& blocks, uint64_t& total_height, uint64_t& start_height, bool pruned, bool get_miner_tx_hash, size_t max_count) const
+bool Blockchain::find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, uint64_t& start_height) const
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
@@ -2061,13 +2129,23 @@ bool Blockchain::find_blockchain_supplement(const uint64_t req_start_block, cons
       return false;
     }
     start_height = req_start_block;
+    return true;
   }
-  else
+  return find_blockchain_supplement(qblock_ids, start_height);
+}
+//------------------------------------------------------------------
+//FIXME: change argument to std::vector, low priority
+// find split point between ours and foreign blockchain (or start at
+// blockchain height <req_start_block>), and return up to max_count FULL
+// blocks by reference.
+bool Blockchain::find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, std::vector<std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata> > > >& blocks, uint64_t& total_height, uint64_t& start_height, bool pruned, bool get_miner_tx_hash, size_t max_count) const
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+
+  if(!find_blockchain_supplement(req_start_block, qblock_ids, start_height))
   {
-    if(!find_blockchain_supplement(qblock_ids, start_height))
-    {
-      return false;
-    }
+    return false;
   }
 
   m_db->block_txn_start(true);
@@ -2617,7 +2695,7 @@ bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc,
   auto it = m_check_txin_table.find(tx_prefix_hash);
   if(it == m_check_txin_table.end())
   {
-    m_check_txin_table.emplace(tx_prefix_hash, std::unordered_map<crypto::key_image, bool>());
+    m_check_txin_table.emplace(tx_prefix_hash, key_image_check_map());
     it = m_check_txin_table.find(tx_prefix_hash);
     assert(it != m_check_txin_table.end());
   }
@@ -2931,7 +3009,7 @@ bool Blockchain::check_tx_inputs(transaction& tx, tx_verification_context &tvc,
 //------------------------------------------------------------------
 void Blockchain::check_ring_signature(const crypto::hash &tx_prefix_hash, const crypto::key_image &key_image, const std::vector<rct::ctkey> &pubkeys, const std::vector<crypto::signature>& sig, uint64_t &result)
 {
-  LOG_PRINT_L1("Public spend key: " << key_image);
+  MLOG_HOT(el::Level::Info, "Public spend key: " << key_image);
   std::vector<const crypto::public_key *> p_output_keys;
   p_output_keys.reserve(pubkeys.size());
   for (auto &key : pubkeys)
@@ -2939,13 +3017,19 @@ void Blockchain::check_ring_signature(const crypto::hash &tx_prefix_hash, const
     // rct::key and crypto::public_key have the same structure, avoid object ctor/memcpy
     p_output_keys.push_back(&(const crypto::public_key&)key.dest);
   }
-  // Dilithium - sig verification
+  // Dilithium - sig verification, if not done in a batch beforehand
+  const auto itb = m_batch_sig_table.find(tx_prefix_hash);
+  if (itb != m_batch_sig_table.end() && !sig.empty() && itb->second.first == sig[0])
+  {
+    result = itb->second.second ? 1 : 0;
+    return;
+  }
   crypto::public_key k_i;
   std::memcpy(&k_i, &key_image, CRYPTO_PUBLICKEYBYTES);
   auto ok = crypto::check_signature(tx_prefix_hash, k_i, *sig.data());
   result = ok ? 1 : 0;//crypto::check_ring_signature(tx_prefix_hash, key_image, p_output_keys, sig.data()) ? 1 : 0;
   
-  LOG_PRINT_L1("Result: " << result <<" Ok: " << ok);
+  MLOG_HOT(el::Level::Info, "Result: " << result <<" Ok: " << ok);
 }
 
 //------------------------------------------------------------------
@@ -3648,17 +3732,13 @@ uint64_t Blockchain::get_next_long_term_block_weight(uint64_t block_weight) cons
   PERF_TIMER(get_next_long_term_block_weight);
 
   const uint64_t db_height = m_db->height();
-  const uint64_t nblocks = std::min<uint64_t>(m_long_term_block_weights_window, db_height);
 
   const uint8_t hf_version = get_current_hard_fork_version();
   if (hf_version < HF_VERSION_LONG_TERM_BLOCK_WEIGHT)
     return block_weight;
 
-  std::vector<uint64_t> weights;
-  weights.resize(nblocks);
-  for (uint64_t h = 0; h < nblocks; ++h)
-    weights[h] = m_db->get_block_long_term_weight(db_height - nblocks + h);
-  uint64_t long_term_median = epee::misc_utils::median(weights);
+  sync_block_weights_window(m_long_term_block_weights, db_height, m_long_term_block_weights_window, true);
+  uint64_t long_term_median = m_long_term_block_weights.median.median();
   uint64_t long_term_effective_median_block_weight = std::max<uint64_t>(CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V5, long_term_median);
 
   uint64_t short_term_constraint = long_term_effective_median_block_weight + long_term_effective_median_block_weight * 2 / 5;
@@ -3679,18 +3759,21 @@ bool Blockchain::update_next_cumulative_weight_limit(uint64_t *long_term_effecti
   uint64_t full_reward_zone = get_min_block_weight(hf_version);
   uint64_t long_term_block_weight;
 
+  sync_block_weights_window(m_short_term_block_weights, db_height, CRYPTONOTE_REWARD_BLOCKS_WINDOW, false);
+
   if (hf_version < HF_VERSION_LONG_TERM_BLOCK_WEIGHT)
   {
-    std::vector<uint64_t> weights;
-    get_last_n_blocks_weights(weights, CRYPTONOTE_REWARD_BLOCKS_WINDOW);
-    m_current_block_cumul_weight_median = epee::misc_utils::median(weights);
-    long_term_block_weight = weights.back();
+    m_current_block_cumul_weight_median = m_short_term_block_weights.median.median();
+    long_term_block_weight = m_short_term_block_weights.blocks.back().first;
   }
   else
   {
     const uint64_t block_weight = m_db->get_block_weight(db_height - 1);
 
-    std::vector<uint64_t> weights, new_weights;
+    // the long term window ends below the block just added
+    sync_block_weights_window(m_long_term_block_weights, db_height - 1, m_long_term_block_weights_window, true);
+    tools::sliding_median<uint64_t> &long_term_weights = m_long_term_block_weights.median;
+
     uint64_t long_term_median;
     if (db_height == 1)
     {
@@ -3698,31 +3781,29 @@ bool Blockchain::update_next_cumulative_weight_limit(uint64_t *long_term_effecti
     }
     else
     {
-      uint64_t nblocks = std::min<uint64_t>(m_long_term_block_weights_window, db_height);
-      if (nblocks == db_height)
-        --nblocks;
-      weights.resize(nblocks);
-      for (uint64_t h = 0; h < nblocks; ++h)
-        weights[h] = m_db->get_block_long_term_weight(db_height - nblocks + h - 1);
-      new_weights = weights;
-      long_term_median = epee::misc_utils::median(weights);
+      long_term_median = long_term_weights.median();
     }
     m_long_term_effective_median_block_weight = std::max<uint64_t>(CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V5, long_term_median);
 
     uint64_t short_term_constraint = m_long_term_effective_median_block_weight + m_long_term_effective_median_block_weight * 2 / 5;
     long_term_block_weight = std::min<uint64_t>(block_weight, short_term_constraint);
 
-    if (new_weights.empty())
-      new_weights.resize(1);
-    new_weights[0] = long_term_block_weight;
-    long_term_median = epee::misc_utils::median(new_weights);
+    // the new long term weight replaces the oldest one in the window, then
+    // the window is put back as it was, since it is only moved forward when
+    // the next block is added
+    const bool replace_oldest = !m_long_term_block_weights.blocks.empty();
+    const uint64_t oldest = replace_oldest ? m_long_term_block_weights.blocks.front().first : 0;
+    if (replace_oldest)
+      long_term_weights.erase(oldest);
+    long_term_weights.insert(long_term_block_weight);
+    long_term_median = long_term_weights.median();
+    long_term_weights.erase(long_term_block_weight);
+    if (replace_oldest)
+      long_term_weights.insert(oldest);
     m_long_term_effective_median_block_weight = std::max<uint64_t>(CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V5, long_term_median);
     short_term_constraint = m_long_term_effective_median_block_weight + m_long_term_effective_median_block_weight * 2 / 5;
 
-    weights.clear();
-    get_last_n_blocks_weights(weights, CRYPTONOTE_REWARD_BLOCKS_WINDOW);
-
-    uint64_t short_term_median = epee::misc_utils::median(weights);
+    uint64_t short_term_median = m_short_term_block_weights.median.median();
     uint64_t effective_median_block_weight = std::min<uint64_t>(std::max<uint64_t>(CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V5, short_term_median), CRYPTONOTE_SHORT_TERM_BLOCK_WEIGHT_SURGE_FACTOR * m_long_term_effective_median_block_weight);
 
     m_current_block_cumul_weight_median = effective_median_block_weight;
@@ -3739,6 +3820,65 @@ bool Blockchain::update_next_cumulative_weight_limit(uint64_t *long_term_effecti
   return true;
 }
 //------------------------------------------------------------------
+void Blockchain::sync_block_weights_window(block_weights_window &window, uint64_t height, uint64_t size, bool long_term) const
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+
+  const auto get_weight = [&](uint64_t h) {
+    return long_term ? m_db->get_block_long_term_weight(h) : m_db->get_block_weight(h);
+  };
+  const auto reset = [&window](uint64_t h) {
+    window.median.clear();
+    window.blocks.clear();
+    window.height = h;
+  };
+
+  if (window.size != size)
+  {
+    reset(0);
+    window.size = size;
+  }
+
+  m_db->block_txn_start(true);
+
+  // rewind blocks above the target height, or which are not on the main chain anymore
+  uint64_t rewound = 0;
+  while (window.height > 0 && (window.height > height || window.blocks.back().second != m_db->get_block_hash_from_height(window.height - 1)))
+  {
+    if (++rewound > size)
+    {
+      reset(0);
+      break;
+    }
+    window.median.erase(window.blocks.back().first);
+    window.blocks.pop_back();
+    --window.height;
+    if (window.height > window.blocks.size() && window.blocks.size() < size)
+    {
+      const uint64_t h = window.height - window.blocks.size() - 1;
+      const uint64_t weight = get_weight(h);
+      window.median.insert(weight);
+      window.blocks.push_front(std::make_pair(weight, m_db->get_block_hash_from_height(h)));
+    }
+  }
+
+  if (height - window.height > size)
+    reset(height - size);
+  for (; window.height < height; ++window.height)
+  {
+    const uint64_t weight = get_weight(window.height);
+    window.median.insert(weight);
+    window.blocks.push_back(std::make_pair(weight, m_db->get_block_hash_from_height(window.height)));
+    if (window.blocks.size() > size)
+    {
+      window.median.erase(window.blocks.front().first);
+      window.blocks.pop_front();
+    }
+  }
+
+  m_db->block_txn_stop();
+}
+//------------------------------------------------------------------
 bool Blockchain::add_new_block(const block& bl_, block_verification_context& bvc)
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
@@ -3923,6 +4063,8 @@ bool Blockchain::cleanup_handle_incoming_blocks(bool force_sync)
   m_scan_table.clear();
   m_blocks_txs_check.clear();
   m_check_txin_table.clear();
+  m_batch_sig_table.clear();
+  m_prechecked_sig_table.clear();
 
   // when we're well clear of the precomputed hashes, free the memory
   if (!m_blocks_hash_check.empty() && m_db->height() > m_blocks_hash_check.size() + 4096)
@@ -3939,21 +4081,102 @@ bool Blockchain::cleanup_handle_incoming_blocks(bool force_sync)
 }
 
 //------------------------------------------------------------------
-//FIXME: unused parameter txs
-void Blockchain::output_scan_worker(const uint64_t amount, const std::vector<uint64_t> &offsets, std::vector<output_data_t> &outputs, std::unordered_map<crypto::hash, cryptonote::transaction> &txs) const
+void Blockchain::batch_check_tx_signatures(const std::vector<std::pair<transaction, crypto::hash>> &txes)
 {
-  try
+  TIME_MEASURE_START(t);
+  std::vector<std::pair<const transaction*, crypto::hash>> unchecked;
+  unchecked.reserve(txes.size());
+  for (const auto &e : txes)
   {
-    m_db->get_output_key(amount, offsets, outputs, true);
+    const transaction &tx = e.first;
+    const auto it = m_batch_sig_table.find(e.second);
+    if (it != m_batch_sig_table.end() && !tx.signatures.empty() && !tx.signatures[0].empty() && it->second.first == tx.signatures[0][0])
+      continue;
+    unchecked.push_back(std::make_pair(&tx, e.second));
   }
-  catch (const std::exception& e)
-  {
-    MERROR_VER("EXCEPTION: " << e.what());
+  check_tx_signatures(unchecked, m_batch_sig_table);
+
+  TIME_MEASURE_FINISH(t);
+  if (m_show_time_stats && !unchecked.empty())
+    MDEBUG("Batch signature check of " << unchecked.size() << " txes took: " << t << " ms");
+}
+
+//------------------------------------------------------------------
+void Blockchain::check_tx_signatures(const std::vector<std::pair<const transaction*, crypto::hash>> &txes, tx_signature_results &results)
+{
+  // same selection as check_tx_inputs: only the first input's signature is checked
+  crypto::batch_signature_verifier verifier;
+  std::vector<const std::pair<const transaction*, crypto::hash>*> checked;
+  verifier.reserve(txes.size());
+  checked.reserve(txes.size());
+  for (const auto &e : txes)
+  {
+    const transaction &tx = *e.first;
+    if (tx.version != 1 || tx.vin.empty() || tx.signatures.empty() || tx.signatures[0].empty())
+      continue;
+    if (tx.vin[0].type() != typeid(txin_to_key))
+      continue;
+    const crypto::key_image &ki = boost::get<txin_to_key>(tx.vin[0]).k_image;
+    // key_image and public_key have the same structure, avoid object ctor/memcpy
+    verifier.add(e.second, reinterpret_cast<const crypto::public_key&>(ki), tx.signatures[0][0]);
+    checked.push_back(&e);
   }
-  catch (...)
-  {
+  if (checked.empty())
+    return;
+
+  std::vector<uint64_t> ok;
+  verifier.verify(ok, &tools::threadpool::getInstance());
+  for (size_t i = 0; i < checked.size(); ++i)
+    results[checked[i]->second] = std::make_pair(checked[i]->first->signatures[0][0], ok[i] != 0);
+}
 
+//------------------------------------------------------------------
+void Blockchain::add_prechecked_tx_signatures(const tx_signature_results &results)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  for (const auto &e : results)
+    m_prechecked_sig_table[e.first] = e.second;
+}
+
+//------------------------------------------------------------------
+void Blockchain::prefetch_outputs(const std::vector<block_complete_entry> &blocks)
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+
+  std::unique_ptr<output_prefetcher> prefetch(new output_prefetcher());
+  transaction tx;
+  for (const auto &entry : blocks)
+  {
+    for (const auto &tx_blob : entry.txs)
+    {
+      // bad txes are reported by prepare_handle_incoming_blocks
+      if (!parse_and_validate_tx_base_from_blob(tx_blob, tx))
+        continue;
+      for (const auto &txin : tx.vin)
+      {
+        if (txin.type() != typeid(txin_to_key))
+          continue;
+        const txin_to_key &in_to_key = boost::get<txin_to_key>(txin);
+        uint64_t offset = 0;
+        for (const uint64_t &relative_offset : in_to_key.key_offsets)
+        {
+          offset += relative_offset;
+          prefetch->add(in_to_key.amount, offset);
+        }
+      }
+    }
   }
+
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  m_output_prefetch_ahead.reset();
+
+  // a block popped in the current batch is still visible to other readers
+  // until the batch is committed
+  if (m_batch_popped_block || !m_db->can_thread_bulk_indices())
+    return;
+
+  prefetch->start(*m_db, &tools::threadpool::getInstance());
+  m_output_prefetch_ahead = std::move(prefetch);
 }
 
 uint64_t Blockchain::prevalidate_block_hashes(uint64_t height, const std::vector<crypto::hash> &hashes)
@@ -4058,7 +4281,8 @@ uint64_t Blockchain::prevalidate_block_hashes(uint64_t height, const std::vector
 // 2. Group all amounts (from txs) and related absolute offsets and form a table of tx_prefix_hash
 //    vs [k_image, output_keys] (m_scan_table). This is faster because it takes advantage of bulk queries
 //    and is threaded if possible. The table (m_scan_table) will be used later when querying output
-//    keys.
+//    keys. Outputs already looked up by prefetch_outputs while the previous span was added are
+//    reused.
 bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete_entry> &blocks_entry)
 {
   MTRACE("Blockchain::" << __func__);
@@ -4104,6 +4328,8 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
     m_tx_pool.lock();
     m_blockchain_lock.lock();
   }
+  // any earlier pop is committed by now
+  m_batch_popped_block = false;
 
   if ((m_db->height() + blocks_entry.size()) < m_blocks_hash_check.size())
     return true;
@@ -4217,6 +4443,8 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
 
   m_scan_table.clear();
   m_check_txin_table.clear();
+  m_batch_sig_table.clear();
+  m_batch_sig_table.swap(m_prechecked_sig_table);
 
   TIME_MEASURE_FINISH(prepare);
   m_fake_pow_calc_time = prepare / blocks_entry.size();
@@ -4226,12 +4454,12 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
 
   TIME_MEASURE_START(scantable);
 
-  // [input] stores all unique amounts found
-  std::vector < uint64_t > amounts;
-  // [input] stores all absolute_offsets for each amount
-  std::map<uint64_t, std::vector<uint64_t>> offset_map;
-  // [output] stores all output_data_t for each absolute_offset
-  std::map<uint64_t, std::vector<output_data_t>> tx_map;
+  // outputs looked up during the previous span by prefetch_outputs; a popped
+  // block drops them, so whatever they hold is still on the chain
+  std::unique_ptr<output_prefetcher> prefetched = std::move(m_output_prefetch_ahead);
+  if (prefetched)
+    prefetched->wait();
+  output_prefetcher prefetch;
   std::vector<std::pair<cryptonote::transaction, crypto::hash>> txes(total_txs);
 
 #define SCAN_TABLE_QUIT(m) \
@@ -4241,7 +4469,7 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
             return false; \
         } while(0); \
 
-  // generate sorted tables for all amounts and absolute offsets
+  // collect all outputs used as ring members which were not prefetched
   size_t tx_index = 0;
   for (const auto &entry : blocks_entry)
   {
@@ -4264,11 +4492,10 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
       if (its != m_scan_table.end())
         SCAN_TABLE_QUIT("Duplicate tx found from incoming blocks.");
 
-      m_scan_table.emplace(tx_prefix_hash, std::unordered_map<crypto::key_image, std::vector<output_data_t>>());
+      m_scan_table.emplace(tx_prefix_hash, key_image_outputs_map());
       its = m_scan_table.find(tx_prefix_hash);
       assert(its != m_scan_table.end());
 
-      // get all amounts from tx.vin(s)
       for (const auto &txin : tx.vin)
       {
         const txin_to_key &in_to_key = boost::get < txin_to_key > (txin);
@@ -4278,71 +4505,26 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
         if (it != its->second.end())
           SCAN_TABLE_QUIT("Duplicate key_image found from incoming blocks.");
 
-        amounts.push_back(in_to_key.amount);
-      }
-
-      // sort and remove duplicate amounts from amounts list
-      std::sort(amounts.begin(), amounts.end());
-      auto last = std::unique(amounts.begin(), amounts.end());
-      amounts.erase(last, amounts.end());
-
-      // add amount to the offset_map and tx_map
-      for (const uint64_t &amount : amounts)
-      {
-        if (offset_map.find(amount) == offset_map.end())
-          offset_map.emplace(amount, std::vector<uint64_t>());
-
-        if (tx_map.find(amount) == tx_map.end())
-          tx_map.emplace(amount, std::vector<output_data_t>());
-      }
-
-      // add new absolute_offsets to offset_map
-      for (const auto &txin : tx.vin)
-      {
-        const txin_to_key &in_to_key = boost::get < txin_to_key > (txin);
-        // no need to check for duplicate here.
-        auto absolute_offsets = relative_output_offsets_to_absolute(in_to_key.key_offsets);
-        for (const auto & offset : absolute_offsets)
-          offset_map[in_to_key.amount].push_back(offset);
-
+        uint64_t offset = 0;
+        for (const uint64_t &relative_offset : in_to_key.key_offsets)
+        {
+          offset += relative_offset;
+          if (!prefetched || !prefetched->find(in_to_key.amount, offset))
+            prefetch.add(in_to_key.amount, offset);
+        }
       }
     }
   }
 
-  // sort and remove duplicate absolute_offsets in offset_map
-  for (auto &offsets : offset_map)
-  {
-    std::sort(offsets.second.begin(), offsets.second.end());
-    auto last = std::unique(offsets.second.begin(), offsets.second.end());
-    offsets.second.erase(last, offsets.second.end());
-  }
-
-  // [output] stores all transactions for each tx_out_index::hash found
-  std::vector<std::unordered_map<crypto::hash, cryptonote::transaction>> transactions(amounts.size());
+  // the lookups run on the threadpool while the signatures are checked
+  prefetch.start(*m_db, &tpool);
 
-  threads = tpool.get_max_concurrency();
-  if (!m_db->can_thread_bulk_indices())
-    threads = 1;
-
-  if (threads > 1)
-  {
-    tools::threadpool::waiter waiter;
-
-    for (size_t i = 0; i < amounts.size(); i++)
-    {
-      uint64_t amount = amounts[i];
-      tpool.submit(&waiter, boost::bind(&Blockchain::output_scan_worker, this, amount, std::cref(offset_map[amount]), std::ref(tx_map[amount]), std::ref(transactions[i])), true);
-    }
-    waiter.wait(&tpool);
-  }
-  else
-  {
-    for (size_t i = 0; i < amounts.size(); i++)
-    {
-      uint64_t amount = amounts[i];
-      output_scan_worker(amount, offset_map[amount], tx_map[amount], transactions[i]);
-    }
-  }
+  // verify all signatures of the span at once, so handle_block_to_main_chain
+  // does not have to do it one input at a time
+  batch_check_tx_signatures(txes);
+  prefetch.wait();
+  if (m_cancel)
+    return false;
 
   // now generate a table for each tx_prefix and k_image hashes
   tx_index = 0;
@@ -4366,32 +4548,23 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
       for (const auto &txin : tx.vin)
       {
         const txin_to_key &in_to_key = boost::get < txin_to_key > (txin);
-        auto needed_offsets = relative_output_offsets_to_absolute(in_to_key.key_offsets);
 
+        // a partial list is completed by scan_outputkeys_for_indexes
         std::vector<output_data_t> outputs;
-        for (const uint64_t & offset_needed : needed_offsets)
+        outputs.reserve(in_to_key.key_offsets.size());
+        uint64_t offset = 0;
+        for (const uint64_t &relative_offset : in_to_key.key_offsets)
         {
-          size_t pos = 0;
-          bool found = false;
-
-          for (const uint64_t &offset_found : offset_map[in_to_key.amount])
-          {
-            if (offset_needed == offset_found)
-            {
-              found = true;
-              break;
-            }
-
-            ++pos;
-          }
-
-          if (found && pos < tx_map[in_to_key.amount].size())
-            outputs.push_back(tx_map[in_to_key.amount].at(pos));
-          else
+          offset += relative_offset;
+          const output_data_t *data = prefetch.find(in_to_key.amount, offset);
+          if (!data && prefetched)
+            data = prefetched->find(in_to_key.amount, offset);
+          if (!data)
             break;
+          outputs.push_back(*data);
         }
 
-        its->second.emplace(in_to_key.k_image, outputs);
+        its->second.emplace(in_to_key.k_image, std::move(outputs));
       }
     }
   }
@@ -4697,6 +4870,39 @@ void Blockchain::invalidate_block_template_cache()
   m_btc_valid = false;
 }
 
+const Blockchain::block_template_tip *Blockchain::get_block_template_tip(const crypto::hash &prev_id, uint64_t height)
+{
+  // the tip is checked rather than relying on invalidation, as anything
+  // changing these (new block, pop, reorg, reset) also changes the top id
+  if (m_btt_valid && m_btt.prev_id == prev_id)
+    return &m_btt;
+
+  MDEBUG("Computing block template data for new tip " << prev_id);
+  m_btt_valid = false;
+  m_btt.prev_id = prev_id;
+  m_btt.major_version = m_hardfork->get_current_version();
+  m_btt.minor_version = m_hardfork->get_ideal_version();
+
+  // same window as check_block_timestamp, no lower bound until it fills
+  m_btt.median_timestamp = 0;
+  if (height >= BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW)
+  {
+    std::vector<uint64_t> timestamps;
+    timestamps.reserve(BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW);
+    for (uint64_t offset = height - BLOCKCHAIN_TIMESTAMP_CHECK_WINDOW; offset < height; ++offset)
+      timestamps.push_back(m_db->get_block_timestamp(offset));
+    m_btt.median_timestamp = epee::misc_utils::median(timestamps);
+  }
+
+  m_btt.difficulty = get_difficulty_for_next_block();
+  CHECK_AND_ASSERT_MES(m_btt.difficulty, nullptr, "difficulty overhead.");
+
+  m_btt.median_weight = m_current_block_cumul_weight_limit / 2;
+  m_btt.already_generated_coins = m_db->get_block_already_generated_coins(height - 1);
+  m_btt_valid = true;
+  return &m_btt;
+}
+
 void Blockchain::cache_block_template(const block &b, const cryptonote::account_public_address &address, const blobdata &nonce, const difficulty_type &diff, uint64_t expected_reward, uint64_t pool_cookie)
 {
   MDEBUG("Setting block template cache");
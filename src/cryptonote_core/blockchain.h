@@ -39,6 +39,8 @@
 #include <boost/multi_index/member.hpp>
 #include <boost/circular_buffer.hpp>
 #include <atomic>
+#include <deque>
+#include <memory>
 #include <unordered_map>
 #include <unordered_set>
 
@@ -46,6 +48,8 @@
 #include "string_tools.h"
 #include "cryptonote_basic/cryptonote_basic.h"
 #include "common/util.h"
+#include "common/flat_hash_map.h"
+#include "common/sliding_median.h"
 #include "cryptonote_protocol/cryptonote_protocol_defs.h"
 #include "rpc/core_rpc_server_commands_defs.h"
 #include "cryptonote_basic/difficulty.h"
@@ -55,6 +59,8 @@
 #include "checkpoints/checkpoints.h"
 #include "cryptonote_basic/hardfork.h"
 #include "blockchain_db/blockchain_db.h"
+#include "output_prefetch.h"
+#include "block_response_cache.h"
 
 namespace tools { class Notify; }
 
@@ -413,6 +419,17 @@ namespace cryptonote
      */
     bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, uint64_t& starter_offset) const;
 
+    /**
+     * @brief find the height to send a foreign chain blocks from
+     *
+     * @param req_start_block if non-zero, specifies a start point (otherwise find most recent commonality)
+     * @param qblock_ids the foreign chain's "short history" (see get_short_chain_history)
+     * @param start_height return-by-reference the height of the first block to send
+     *
+     * @return true if a block found in common or req_start_block specified, else false
+     */
+    bool find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, uint64_t& start_height) const;
+
     /**
      * @brief get recent blocks for a foreign chain
      *
@@ -446,6 +463,21 @@ namespace cryptonote
      */
     bool handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NOTIFY_RESPONSE_GET_OBJECTS::request& rsp);
 
+    /**
+     * @brief retrieves a set of blocks and their transactions, packed for sending
+     *
+     * Like handle_get_objects, but when only blocks are requested and they make
+     * a span of the main chain, rsp.blocks is left empty and the blocks are
+     * returned packed instead, from the block response cache when possible.
+     *
+     * @param arg the request
+     * @param rsp return-by-reference the response to fill in
+     * @param packed_blocks return-by-reference the packed "blocks" entry of the response, if any
+     *
+     * @return true unless any blocks or transactions are missing
+     */
+    bool handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NOTIFY_RESPONSE_GET_OBJECTS::request& rsp, block_response_cache::span& packed_blocks);
+
     /**
      * @brief get number of outputs of an amount past the minimum spendable age
      *
@@ -920,16 +952,67 @@ namespace cryptonote
     }
 
     /**
-     * @brief get a number of outputs of a specific amount
+     * @brief get the cache of packed block spans sent to peers and wallets
+     *
+     * @return a reference to the cache, which is invalidated as blocks are popped
+     */
+    block_response_cache& get_block_response_cache()
+    {
+      return m_block_response_cache;
+    }
+
+    /**
+     * @brief signature check results, by transaction prefix hash
+     *
+     * The signature is kept so a malleated copy of a transaction is not
+     * trusted.
+     */
+    typedef std::unordered_map<crypto::hash, std::pair<crypto::signature, bool>> tx_signature_results;
+
+    /**
+     * @brief checks the signatures of a set of transactions in parallel
+     *
+     * Results are stored in m_batch_sig_table, keyed by transaction prefix
+     * hash, for check_ring_signature to pick up. Transactions already
+     * recorded there with the same signature are not checked again.
      *
-     * @param amount the amount
-     * @param offsets the indices (indexed to the amount) of the outputs
-     * @param outputs return-by-reference the outputs collected
-     * @param txs unused, candidate for removal
+     * @param txes the transactions and their prefix hashes
      */
-    void output_scan_worker(const uint64_t amount,const std::vector<uint64_t> &offsets,
-        std::vector<output_data_t> &outputs, std::unordered_map<crypto::hash,
-        cryptonote::transaction> &txs) const;
+    void batch_check_tx_signatures(const std::vector<std::pair<transaction, crypto::hash>> &txes);
+
+    /**
+     * @brief checks the signatures of a set of transactions in parallel
+     *
+     * This does not depend on the chain state, so it can be run ahead of
+     * the tip, without the blockchain lock.
+     *
+     * @param txes the transactions and their prefix hashes
+     * @param results return-by-reference the results, added to any already there
+     */
+    static void check_tx_signatures(const std::vector<std::pair<const transaction*, crypto::hash>> &txes, tx_signature_results &results);
+
+    /**
+     * @brief records signatures checked ahead of time with check_tx_signatures
+     *
+     * They are used by the next prepare_handle_incoming_blocks, and dropped
+     * by cleanup_handle_incoming_blocks.
+     *
+     * @param results the signature check results
+     */
+    void add_prechecked_tx_signatures(const tx_signature_results &results);
+
+    /**
+     * @brief starts looking up the outputs used by the next span of blocks
+     *
+     * Meant to be called once a span has been prepared, with the span
+     * that follows it: the lookups run on the threadpool while the current
+     * span is being added, and the next prepare_handle_incoming_blocks
+     * only has to look up what is still missing. Popping a block drops
+     * the lookups.
+     *
+     * @param blocks the next span of blocks
+     */
+    void prefetch_outputs(const std::vector<block_complete_entry> &blocks);
 
     /**
      * @brief computes the "short" and "long" hashes for a set of blocks
@@ -1012,10 +1095,19 @@ namespace cryptonote
     size_t m_current_block_cumul_weight_limit;
     size_t m_current_block_cumul_weight_median;
 
-    // metadata containers
-    std::unordered_map<crypto::hash, std::unordered_map<crypto::key_image, std::vector<output_data_t>>> m_scan_table;
+    // metadata containers, key images are attacker chosen, so they are hashed
+    // in full with a secret key rather than by their first word
+    typedef tools::flat_hash_map<crypto::key_image, std::vector<output_data_t>, crypto::fingerprint_hash<crypto::key_image>> key_image_outputs_map;
+    typedef tools::flat_hash_map<crypto::key_image, bool, crypto::fingerprint_hash<crypto::key_image>> key_image_check_map;
+    std::unordered_map<crypto::hash, key_image_outputs_map> m_scan_table;
     std::unordered_map<crypto::hash, crypto::hash> m_blocks_longhash_table;
-    std::unordered_map<crypto::hash, std::unordered_map<crypto::key_image, bool>> m_check_txin_table;
+    std::unordered_map<crypto::hash, key_image_check_map> m_check_txin_table;
+    tx_signature_results m_batch_sig_table;
+    tx_signature_results m_prechecked_sig_table;
+    std::unique_ptr<output_prefetcher> m_output_prefetch_ahead;
+    bool m_batch_popped_block;
+
+    block_response_cache m_block_response_cache;
 
     // SHA-3 hashes for each block and for fast pow checking
     std::vector<crypto::hash> m_blocks_hash_of_hashes;
@@ -1033,12 +1125,25 @@ namespace cryptonote
     uint64_t m_fake_scan_time;
     uint64_t m_sync_counter;
     uint64_t m_bytes_to_sync;
-    std::vector<uint64_t> m_timestamps;
-    std::vector<difficulty_type> m_difficulties;
+    difficulty_window m_difficulty_window;
     uint64_t m_timestamps_and_difficulties_height;
     uint64_t m_long_term_block_weights_window;
     uint64_t m_long_term_effective_median_block_weight;
 
+    // the weights of the last blocks below some height, along with their
+    // median, moved along with the chain instead of reloaded for each block
+    struct block_weights_window
+    {
+      block_weights_window(): height(0), size(0) {}
+
+      tools::sliding_median<uint64_t> median;
+      std::deque<std::pair<uint64_t, crypto::hash>> blocks; // weight and id, oldest first
+      uint64_t height; // blocks covers [height - blocks.size(), height)
+      uint64_t size;
+    };
+    mutable block_weights_window m_long_term_block_weights;
+    mutable block_weights_window m_short_term_block_weights;
+
     epee::critical_section m_difficulty_lock;
     crypto::hash m_difficulty_for_next_block_top_hash;
     difficulty_type m_difficulty_for_next_block;
@@ -1074,6 +1179,22 @@ namespace cryptonote
     uint64_t m_btc_expected_reward;
     bool m_btc_valid;
 
+    // the parts of a block template which only depend on the chain tip,
+    // kept across template requests for different addresses/nonces or
+    // pool contents, and recomputed when the tip changes
+    struct block_template_tip
+    {
+      crypto::hash prev_id;
+      uint8_t major_version;
+      uint8_t minor_version;
+      uint64_t median_timestamp;
+      difficulty_type difficulty;
+      size_t median_weight;
+      uint64_t already_generated_coins;
+    };
+    block_template_tip m_btt;
+    bool m_btt_valid;
+
     std::shared_ptr<tools::Notify> m_block_notify;
     std::shared_ptr<tools::Notify> m_reorg_notify;
 
@@ -1375,6 +1496,21 @@ namespace cryptonote
      * @return true
      */
     bool update_next_cumulative_weight_limit(uint64_t *long_term_effective_median_block_weight = NULL);
+
+    /**
+     * @brief move a block weights window so it holds the last blocks below a height
+     *
+     * Blocks which were popped off the main chain since the window was last
+     * moved are rewound first, then the missing blocks are loaded from the
+     * database. The window is only reloaded in full by init, or when it has
+     * to move by more than its size.
+     *
+     * @param window the window to move
+     * @param height the height the window should end at (exclusive)
+     * @param size the maximum number of blocks in the window
+     * @param long_term whether to track long term block weights rather than block weights
+     */
+    void sync_block_weights_window(block_weights_window &window, uint64_t height, uint64_t size, bool long_term) const;
     void return_tx_to_pool(std::vector<transaction> &txs);
 
     /**
@@ -1390,6 +1526,9 @@ namespace cryptonote
     /**
      * @brief validates a transaction input's ring signature
      *
+     * If the signature was already checked by the batch verifier in
+     * prepare_handle_incoming_blocks, the cached result is used.
+     *
      * @param tx_prefix_hash the transaction prefix' hash
      * @param key_image the key image generated from the true input
      * @param pubkeys the public keys for each input in the ring signature
@@ -1422,6 +1561,18 @@ namespace cryptonote
      */
     void invalidate_block_template_cache();
 
+    /**
+     * @brief gets the chain tip dependent parts of the next block template
+     *
+     * These are computed once per tip rather than once per template request.
+     *
+     * @param prev_id the current top block id
+     * @param height the current chain height
+     *
+     * @return the cached data, or nullptr on error
+     */
+    const block_template_tip *get_block_template_tip(const crypto::hash &prev_id, uint64_t height);
+
     /**
      * @brief stores a new cached block template
      *
@@ -145,7 +145,7 @@ namespace cryptonote
   };
   static const command_line::arg_descriptor<size_t> arg_block_sync_size  = {
     "block-sync-size"
-  , "How many blocks to sync at once during chain synchronization (0 = adaptive)."
+  , "How many blocks to ask a peer for during chain synchronization, before its speed is measured (0 = default)."
   , 0
   };
   static const command_line::arg_descriptor<std::string> arg_check_updates = {
@@ -1284,6 +1284,16 @@ namespace cryptonote
     return m_blockchain_storage.find_blockchain_supplement(req_start_block, qblock_ids, blocks, total_height, start_height, pruned, get_miner_tx_hash, max_count);
   }
   //-----------------------------------------------------------------------------------------------
+  bool core::find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, uint64_t& start_height) const
+  {
+    return m_blockchain_storage.find_blockchain_supplement(req_start_block, qblock_ids, start_height);
+  }
+  //-----------------------------------------------------------------------------------------------
+  block_response_cache& core::get_block_response_cache()
+  {
+    return m_blockchain_storage.get_block_response_cache();
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::get_outs(const COMMAND_RPC_GET_OUTPUTS_BIN::request& req, COMMAND_RPC_GET_OUTPUTS_BIN::response& res) const
   {
     return m_blockchain_storage.get_outs(req, res);
@@ -1394,6 +1404,12 @@ namespace cryptonote
     return true;
   }
 
+  //-----------------------------------------------------------------------------------------------
+  void core::prefetch_outputs(const std::vector<block_complete_entry> &blocks)
+  {
+    m_blockchain_storage.prefetch_outputs(blocks);
+  }
+
   //-----------------------------------------------------------------------------------------------
   bool core::cleanup_handle_incoming_blocks(bool force_sync)
   {
@@ -1465,6 +1481,11 @@ namespace cryptonote
     return m_mempool.get_transactions_count();
   }
   //-----------------------------------------------------------------------------------------------
+  uint64_t core::get_max_block_tx_count() const
+  {
+    return m_blockchain_storage.get_current_cumulative_block_weight_limit() / sizeof(crypto::hash);
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::have_block(const crypto::hash& id) const
   {
     return m_blockchain_storage.have_block(id);
@@ -1523,9 +1544,9 @@ namespace cryptonote
     return m_blockchain_storage.get_short_chain_history(ids);
   }
   //-----------------------------------------------------------------------------------------------
-  bool core::handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NOTIFY_RESPONSE_GET_OBJECTS::request& rsp, cryptonote_connection_context& context)
+  bool core::handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NOTIFY_RESPONSE_GET_OBJECTS::request& rsp, block_response_cache::span& packed_blocks, cryptonote_connection_context& context)
   {
-    return m_blockchain_storage.handle_get_objects(arg, rsp);
+    return m_blockchain_storage.handle_get_objects(arg, rsp, packed_blocks);
   }
   //-----------------------------------------------------------------------------------------------
   crypto::hash core::get_block_id_by_height(uint64_t height) const
@@ -90,12 +90,12 @@ namespace cryptonote
      core(i_cryptonote_protocol* pprotocol);
 
     /**
-     * @copydoc Blockchain::handle_get_objects
+     * @copydoc Blockchain::handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request&, NOTIFY_RESPONSE_GET_OBJECTS::request&, block_response_cache::span&)
      *
      * @note see Blockchain::handle_get_objects()
      * @param context connection context associated with the request
      */
-     bool handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NOTIFY_RESPONSE_GET_OBJECTS::request& rsp, cryptonote_connection_context& context);
+     bool handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NOTIFY_RESPONSE_GET_OBJECTS::request& rsp, block_response_cache::span& packed_blocks, cryptonote_connection_context& context);
 
      /**
       * @brief calls various idle routines
@@ -167,6 +167,13 @@ namespace cryptonote
       * @note see Blockchain::cleanup_handle_incoming_blocks
       */
      bool cleanup_handle_incoming_blocks(bool force_sync = false);
+
+     /**
+      * @copydoc Blockchain::prefetch_outputs
+      *
+      * @note see Blockchain::prefetch_outputs
+      */
+     void prefetch_outputs(const std::vector<block_complete_entry> &blocks);
      	     	
      /**
       * @brief check the size of a block against the current maximum
@@ -486,6 +493,17 @@ namespace cryptonote
       */
      size_t get_pool_transactions_count() const;
 
+     /**
+      * @brief get the largest number of txes a block can carry
+      *
+      * Every tx a block includes spends at least one key image, so it
+      * weighs more than a hash, and no more of them fit than hashes fit
+      * in the current block weight limit.
+      *
+      * @return the largest number of txes a block can carry
+      */
+     uint64_t get_max_block_tx_count() const;
+
      /**
       * @copydoc Blockchain::get_total_transactions
       *
@@ -521,6 +539,20 @@ namespace cryptonote
       */
      bool find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, std::vector<std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata> > > >& blocks, uint64_t& total_height, uint64_t& start_height, bool pruned, bool get_miner_tx_hash, size_t max_count) const;
 
+     /**
+      * @copydoc Blockchain::find_blockchain_supplement(const uint64_t, const std::list<crypto::hash>&, uint64_t&) const
+      *
+      * @note see Blockchain::find_blockchain_supplement(const uint64_t, const std::list<crypto::hash>&, uint64_t&) const
+      */
+     bool find_blockchain_supplement(const uint64_t req_start_block, const std::list<crypto::hash>& qblock_ids, uint64_t& start_height) const;
+
+     /**
+      * @copydoc Blockchain::get_block_response_cache
+      *
+      * @note see Blockchain::get_block_response_cache
+      */
+     block_response_cache& get_block_response_cache();
+
      /**
       * @brief gets some stats about the daemon
       *
@@ -30,11 +30,14 @@
 
 #include <unordered_set>
 #include <random>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/lock_guard.hpp>
 #include "include_base_utils.h"
 #include "string_tools.h"
 using namespace epee;
 
 #include "common/apply_permutation.h"
+#include "common/threadpool.h"
 #include "cryptonote_tx_utils.h"
 #include "cryptonote_config.h"
 #include "cryptonote_basic/miner.h"
@@ -53,6 +56,49 @@ namespace cryptonote
     #include "dilithium/ref/rng.h"
     }
   //---------------------------------------------------------------
+  // The reference DRBG behind dilithium_randombytes keeps global state, so
+  // transactions built on several threads at once have to take turns
+  static void generate_tx_random(void *data, size_t size)
+  {
+    static boost::mutex random_lock;
+    boost::lock_guard<boost::mutex> lock(random_lock);
+    dilithium_randombytes((unsigned char *)data, size);
+  }
+  //---------------------------------------------------------------
+  // Every input is signed with the spend key over the same prefix hash, so the
+  // signatures are independent of each other. They are computed on the thread
+  // pool, each one written straight into its input's slot, so the result does
+  // not depend on the order the tasks finish in.
+  static void sign_tx_inputs(transaction &tx, const std::vector<tx_source_entry> &sources, const account_keys &sender_account_keys, const crypto::hash &tx_prefix_hash, bool zero_secret_key)
+  {
+    tx.signatures.resize(sources.size());
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+      LOG_PRINT_L1("Outputs: " << sources[i].real_output <<" Fake: "<<sources[i].outputs.size());
+      tx.signatures[i].resize(sources[i].outputs.size());
+    }
+    if (zero_secret_key)
+      return;
+
+    // Dilithium - signature
+    crypto::public_key k_i;
+    crypto::secret_key sec;
+
+    std::memcpy(&k_i, &sender_account_keys.m_account_address.m_spend_public_key, CRYPTO_PUBLICKEYBYTES);
+    std::memcpy(&sec, &sender_account_keys.m_spend_secret_key, CRYPTO_SECRETKEYBYTES);
+
+    tools::threadpool& tpool = tools::threadpool::getInstance();
+    tools::threadpool::waiter waiter;
+    for (size_t i = 0; i < sources.size(); ++i)
+    {
+      if (tx.signatures[i].empty())
+        continue;
+      crypto::signature &sig = tx.signatures[i].front();
+      tpool.submit(&waiter, [&tx_prefix_hash, &k_i, &sec, &sig] { crypto::generate_signature(tx_prefix_hash, k_i, sec, sig); }, true);
+    }
+    waiter.wait(&tpool);
+  }
+  //---------------------------------------------------------------
   void classify_addresses(const std::vector<tx_destination_entry> &destinations, const boost::optional<cryptonote::account_public_address>& change_addr, size_t &num_stdaddresses, size_t &num_subaddresses, account_public_address &single_dest_subaddress)
   {
     num_stdaddresses = 0;
@@ -157,7 +203,7 @@ namespace cryptonote
       tx_out out;
       summary_amounts += out.amount = out_amounts[no];
       out.target = tk;
-      dilithium_randombytes((unsigned char *)&out.random, 32U);
+      generate_tx_random(&out.random, 32);
       tx.vout.push_back(out);
     }
 
@@ -425,7 +471,7 @@ namespace cryptonote
       txout_to_key tk;
       tk.key = out_eph_public_key;
       out.target = tk;
-      dilithium_randombytes((unsigned char *)&out.random, 32U);
+      generate_tx_random(&out.random, 32);
       tx.vout.push_back(out);
       output_index++;
       summary_outs_money += dst_entr.amount;
@@ -465,40 +511,18 @@ namespace cryptonote
       crypto::hash tx_prefix_hash;
       get_transaction_prefix_hash(tx, tx_prefix_hash);
 
+      sign_tx_inputs(tx, sources, sender_account_keys, tx_prefix_hash, zero_secret_key);
+
       std::stringstream ss_ring_s;
-      size_t i = 0;
-      bool alreadySigned = false;
-      for(const tx_source_entry& src_entr:  sources)
+      for (size_t i = 0; i < sources.size(); ++i)
       {
+        const tx_source_entry& src_entr = sources[i];
         ss_ring_s << "pub_keys:" << ENDL;
-        std::vector<const crypto::public_key*> keys_ptrs;
-        std::vector<crypto::public_key> keys(src_entr.outputs.size());
-        size_t ii = 0;
         for(const tx_source_entry::output_entry& o: src_entr.outputs)
-        {
-            keys_ptrs.push_back(&o.second);
-            ss_ring_s << o.second << ENDL;
-        }
-
-        tx.signatures.push_back(std::vector<crypto::signature>());
-        std::vector<crypto::signature>& sigs = tx.signatures.back();
-        sigs.resize(src_entr.outputs.size());
-        LOG_PRINT_L1("Outputs: " << src_entr.real_output <<" Fake: "<<src_entr.outputs.size());
-        if (!zero_secret_key)
-        {
-            // Dilithium - signature
-            crypto::public_key k_i;
-            crypto::secret_key sec;
-
-            std::memcpy(&k_i, &sender_account_keys.m_account_address.m_spend_public_key, CRYPTO_PUBLICKEYBYTES);
-            std::memcpy(&sec, &sender_account_keys.m_spend_secret_key, CRYPTO_SECRETKEYBYTES);
-
-            crypto::generate_signature(tx_prefix_hash, k_i, sec, *sigs.data());
-        }
+          ss_ring_s << o.second << ENDL;
         ss_ring_s << "signatures:" << ENDL;
-        std::for_each(sigs.begin(), sigs.end(), [&](const crypto::signature& s){ss_ring_s << s << ENDL;});
+        std::for_each(tx.signatures[i].begin(), tx.signatures[i].end(), [&](const crypto::signature& s){ss_ring_s << s << ENDL;});
         ss_ring_s << "prefix_hash:" << tx_prefix_hash << ENDL << "in_ephemeral_key: " << in_contexts[i].in_ephemeral.sec << ENDL << "real_output: " << src_entr.real_output << ENDL;
-        i++;
       }
 
       MCINFO("construct_tx", "transaction_created: " << get_transaction_hash(tx) << ENDL << obj_to_json_str(tx) << ENDL << ss_ring_s.str());
@@ -657,7 +681,7 @@ namespace cryptonote
           txin_to_key input_to_key;
           input_to_key.amount = src_entr.amount;
           input_to_key.k_image = msout ? rct::rct2ki(src_entr.multisig_kLRki.ki) : img;
-          dilithium_randombytes((unsigned char *)&input_to_key.random, 32U);
+          generate_tx_random(&input_to_key.random, 32);
 
           //fill outputs array and use relative offsets
           for(const tx_source_entry::output_entry& out_entry: src_entr.outputs)
@@ -737,7 +761,7 @@ namespace cryptonote
           txout_to_key tk;
           tk.key = out_eph_public_key;
           out.target = tk;
-          dilithium_randombytes((unsigned char *)&out.random, 32U);
+          generate_tx_random(&out.random, 32);
           tx.vout.push_back(out);
           output_index++;
           summary_outs_money += dst_entr.amount;
@@ -777,37 +801,18 @@ namespace cryptonote
           crypto::hash tx_prefix_hash;
           get_transaction_prefix_hash(tx, tx_prefix_hash);
 
+          sign_tx_inputs(tx, sources, sender_account_keys, tx_prefix_hash, zero_secret_key);
+
           std::stringstream ss_ring_s;
-          size_t i = 0;
-          for(const tx_source_entry& src_entr:  sources)
+          for (size_t i = 0; i < sources.size(); ++i)
           {
+              const tx_source_entry& src_entr = sources[i];
               ss_ring_s << "pub_keys:" << ENDL;
-              std::vector<const crypto::public_key*> keys_ptrs;
               for(const tx_source_entry::output_entry& o: src_entr.outputs)
-              {
-                  keys_ptrs.push_back(&o.second);
                   ss_ring_s << o.second << ENDL;
-              }
-
-              tx.signatures.push_back(std::vector<crypto::signature>());
-              std::vector<crypto::signature>& sigs = tx.signatures.back();
-              sigs.resize(src_entr.outputs.size());
-              LOG_PRINT_L1("Outputs: " << src_entr.real_output <<" Fake: "<<src_entr.outputs.size());
-              if (!zero_secret_key)
-              {
-                  // Dilithium - signature
-                  crypto::public_key k_i;
-                  crypto::secret_key sec;
-
-                  std::memcpy(&k_i, &sender_account_keys.m_account_address.m_spend_public_key, CRYPTO_PUBLICKEYBYTES);
-                  std::memcpy(&sec, &sender_account_keys.m_spend_secret_key, CRYPTO_SECRETKEYBYTES);
-
-                  crypto::generate_signature(tx_prefix_hash, k_i, sec, *sigs.data());
-              }
               ss_ring_s << "signatures:" << ENDL;
-              std::for_each(sigs.begin(), sigs.end(), [&](const crypto::signature& s){ss_ring_s << s << ENDL;});
+              std::for_each(tx.signatures[i].begin(), tx.signatures[i].end(), [&](const crypto::signature& s){ss_ring_s << s << ENDL;});
               ss_ring_s << "prefix_hash:" << tx_prefix_hash << ENDL << "in_ephemeral_key: " << in_contexts[i].in_ephemeral.sec << ENDL << "real_output: " << src_entr.real_output << ENDL;
-              i++;
           }
 
           MCINFO("construct_tx", "transaction_created: " << get_transaction_hash(tx) << ENDL << obj_to_json_str(tx) << ENDL << ss_ring_s.str());
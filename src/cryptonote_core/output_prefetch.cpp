@@ -0,0 +1,146 @@
+// Copyright (c) 2018, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <algorithm>
+#include <boost/bind.hpp>
+
+#include "misc_log_ex.h"
+#include "output_prefetch.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "blockchain"
+
+// largest number of outputs looked up in one read transaction
+#define OUTPUT_PREFETCH_CHUNK 512
+
+namespace cryptonote
+{
+  output_prefetcher::output_prefetcher(): m_tpool(NULL)
+  {
+  }
+
+  output_prefetcher::~output_prefetcher()
+  {
+    wait();
+  }
+
+  void output_prefetcher::start(BlockchainDB &db, tools::threadpool *tpool)
+  {
+    std::sort(m_requests.begin(), m_requests.end());
+    m_requests.erase(std::unique(m_requests.begin(), m_requests.end()), m_requests.end());
+
+    m_offsets.reserve(m_requests.size());
+    for (size_t i = 0; i < m_requests.size(); ++i)
+    {
+      const uint64_t amount = m_requests[i].first;
+      if (m_ranges.empty() || m_ranges.back().amount != amount)
+        m_ranges.push_back({amount, i, 0, m_chunks.size()});
+      amount_range &range = m_ranges.back();
+      if (range.count % OUTPUT_PREFETCH_CHUNK == 0)
+        m_chunks.push_back({amount, i, 0});
+      ++m_chunks.back().count;
+      ++range.count;
+      m_offsets.push_back(m_requests[i].second);
+    }
+    m_requests.clear();
+    m_requests.shrink_to_fit();
+
+    m_outputs.resize(m_offsets.size());
+    m_found.resize(m_chunks.size(), 0);
+    if (m_chunks.empty())
+      return;
+
+    if (!tpool || tpool->get_max_concurrency() <= 1 || !db.can_thread_bulk_indices())
+    {
+      lookup(db, 0, m_chunks.size());
+      return;
+    }
+
+    // small chunks, as with pre-rct amounts, are grouped so each task is
+    // worth its scheduling
+    m_tpool = tpool;
+    size_t first = 0, outputs = 0;
+    for (size_t i = 0; i < m_chunks.size(); ++i)
+    {
+      outputs += m_chunks[i].count;
+      if (outputs >= OUTPUT_PREFETCH_CHUNK || i + 1 == m_chunks.size())
+      {
+        tpool->submit(&m_waiter, boost::bind(&output_prefetcher::lookup, this, std::ref(db), first, i + 1), true);
+        first = i + 1;
+        outputs = 0;
+      }
+    }
+  }
+
+  void output_prefetcher::wait()
+  {
+    if (m_tpool)
+    {
+      m_waiter.wait(m_tpool);
+      m_tpool = NULL;
+    }
+  }
+
+  void output_prefetcher::lookup(BlockchainDB &db, size_t first_chunk, size_t end_chunk)
+  {
+    for (size_t i = first_chunk; i < end_chunk; ++i)
+    {
+      const chunk &c = m_chunks[i];
+      try
+      {
+        m_found[i] = db.get_output_keys_sorted(c.amount, &m_offsets[c.start], c.count, &m_outputs[c.start]);
+      }
+      catch (const std::exception &e)
+      {
+        // the caller looks up anything missing by itself
+        MERROR("Failed to prefetch outputs for amount " << c.amount << ": " << e.what());
+        m_found[i] = 0;
+      }
+    }
+  }
+
+  const output_data_t *output_prefetcher::find(uint64_t amount, uint64_t index) const
+  {
+    auto range = std::lower_bound(m_ranges.begin(), m_ranges.end(), amount,
+        [](const amount_range &r, uint64_t a) { return r.amount < a; });
+    if (range == m_ranges.end() || range->amount != amount)
+      return NULL;
+
+    const auto begin = m_offsets.begin() + range->start, end = begin + range->count;
+    const auto it = std::lower_bound(begin, end, index);
+    if (it == end || *it != index)
+      return NULL;
+
+    const size_t pos = it - m_offsets.begin();
+    const size_t c = range->first_chunk + (pos - range->start) / OUTPUT_PREFETCH_CHUNK;
+    if (pos - m_chunks[c].start >= m_found[c])
+      return NULL;
+    return &m_outputs[pos];
+  }
+}
@@ -0,0 +1,123 @@
+// Copyright (c) 2018, The Monero Project
+//
+// All rights reserved.
+//
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+//
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+//
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+//
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+//
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "common/threadpool.h"
+#include "blockchain_db/blockchain_db.h"
+
+namespace cryptonote
+{
+  /**
+   * @brief bulk lookup of the outputs referenced by a set of transactions
+   *
+   * Outputs are requested by (amount, amount index). When started, requests
+   * are grouped by amount and sorted by index, so the database is walked
+   * mostly forward rather than at random, and the results are stored in one
+   * arena parallel to the sorted indices instead of a vector per amount.
+   *
+   * Lookups are split in chunks run on the threadpool, each chunk in a read
+   * transaction of its own. Results are only valid after wait(), and only
+   * as long as no block has been popped since start().
+   */
+  class output_prefetcher
+  {
+  public:
+    output_prefetcher();
+    ~output_prefetcher();
+
+    /**
+     * @brief queues an output for lookup, duplicates are fine
+     */
+    void add(uint64_t amount, uint64_t index) { m_requests.push_back(std::make_pair(amount, index)); }
+
+    /**
+     * @brief starts looking up all queued outputs
+     *
+     * @param db the database to read from, which must outlive the lookup
+     * @param tpool the threadpool to run on, or NULL to run inline
+     */
+    void start(BlockchainDB &db, tools::threadpool *tpool);
+
+    /**
+     * @brief waits for the lookups started by start() to finish
+     */
+    void wait();
+
+    /**
+     * @brief gets a looked up output
+     *
+     * @return the output data, or NULL if it was not requested or not found
+     */
+    const output_data_t *find(uint64_t amount, uint64_t index) const;
+
+    /**
+     * @brief the number of distinct outputs requested
+     */
+    size_t size() const { return m_offsets.size(); }
+
+  private:
+    struct amount_range
+    {
+      uint64_t amount;
+      size_t start;
+      size_t count;
+      size_t first_chunk;
+    };
+
+    struct chunk
+    {
+      uint64_t amount;
+      size_t start;
+      size_t count;
+    };
+
+    void lookup(BlockchainDB &db, size_t first_chunk, size_t end_chunk);
+
+    std::vector<std::pair<uint64_t, uint64_t>> m_requests;
+
+    // sorted indices for all amounts, and the matching outputs
+    std::vector<uint64_t> m_offsets;
+    std::vector<output_data_t> m_outputs;
+    std::vector<amount_range> m_ranges;
+
+    // each amount's range is split in chunks, looked up separately;
+    // m_found[i] is the number of outputs of chunk i which were found
+    std::vector<chunk> m_chunks;
+    std::vector<size_t> m_found;
+
+    tools::threadpool *m_tpool;
+    tools::threadpool::waiter m_waiter;
+  };
+}
@@ -113,9 +113,11 @@ namespace cryptonote
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::add_tx(transaction &tx, /*const crypto::hash& tx_prefix_hash,*/ const crypto::hash &id, size_t tx_weight, tx_verification_context& tvc, bool kept_by_block, bool relayed, bool do_not_relay, uint8_t version)
   {
-    // this should already be called with that lock, but let's make it explicit for clarity
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-
+    // The checks up to check_tx_outputs only depend on the tx itself and
+    // on the chain, so they run without the pool lock, letting several
+    // txes be checked at once without holding up readers of the pool or
+    // block template creation. The pool lock is only taken for the parts
+    // that depend on, or change, the pool contents.
     PERF_TIMER(add_tx);
     if (tx.version == 0)
     {
@@ -125,16 +127,6 @@ namespace cryptonote
       return false;
     }
 
-    // we do not accept transactions that timed out before, unless they're
-    // kept_by_block
-    if (!kept_by_block && m_timed_out_transactions.find(id) != m_timed_out_transactions.end())
-    {
-      // not clear if we should set that, since verifivation (sic) did not fail before, since
-      // the tx was accepted before timing out.
-      tvc.m_verifivation_failed = true;
-      return false;
-    }
-
     if(!check_inputs_types_supported(tx))
     {
       tvc.m_verifivation_failed = true;
@@ -196,6 +188,8 @@ namespace cryptonote
     // if the transaction came from a block popped from the chain,
     // don't check if we have its key images as spent.
     // TODO: Investigate why not?
+    // This is only an early out, done before the more expensive output
+    // checks, and is repeated below with the pool lock held.
     if(!kept_by_block)
     {
       if(have_tx_rngs_as_spent(tx))
@@ -217,6 +211,29 @@ namespace cryptonote
       return false;
     }
 
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+
+    // we do not accept transactions that timed out before, unless they're
+    // kept_by_block
+    if (!kept_by_block && m_timed_out_transactions.find(id) != m_timed_out_transactions.end())
+    {
+      // not clear if we should set that, since verifivation (sic) did not fail before, since
+      // the tx was accepted before timing out.
+      tvc.m_verifivation_failed = true;
+      return false;
+    }
+
+    // another tx spending the same inputs may have been added while we
+    // were checking this one
+    if(!kept_by_block && have_tx_rngs_as_spent(tx))
+    {
+      mark_double_spend_rng(tx);
+      LOG_PRINT_L1("Transaction with id= "<< id << " used already spent key images");
+      tvc.m_verifivation_failed = true;
+      tvc.m_double_spend = true;
+      return false;
+    }
+
     // assume failure during verification steps until success is certain
     tvc.m_verifivation_failed = true;
 
@@ -255,6 +272,7 @@ namespace cryptonote
           //if (!insert_key_images(tx, kept_by_block))
           if(!insert_rngs(tx, kept_by_block)){ return false; }
           m_txs_by_fee_and_receive_time.emplace(std::pair<double, std::time_t>(fee / (double)tx_weight, receive_time), id);
+          m_block_candidates.emplace(std::pair<double, std::time_t>(fee / (double)tx_weight, receive_time), id);
         }
         catch (const std::exception &e)
         {
@@ -297,6 +315,7 @@ namespace cryptonote
         //if (!insert_key_images(tx, kept_by_block))
         if (!insert_rngs(tx, kept_by_block)){ return false; }
         m_txs_by_fee_and_receive_time.emplace(std::pair<double, std::time_t>(fee / (double)tx_weight, receive_time), id);
+        m_block_candidates.emplace(std::pair<double, std::time_t>(fee / (double)tx_weight, receive_time), id);
       }
       catch (const std::exception &e)
       {
@@ -386,6 +405,7 @@ namespace cryptonote
         //remove_transaction_keyimages(tx);
         remove_transaction_rngs(tx);
         MINFO("Pruned tx " << txid << " from txpool: weight: " << it->first.second << ", fee/byte: " << it->first.first);
+        remove_block_candidate(txid);
         m_txs_by_fee_and_receive_time.erase(it--);
         changed = true;
       }
@@ -421,16 +441,13 @@ namespace cryptonote
   //RNG------------------------------------------------------------------------------
   bool tx_memory_pool::insert_rngs(const cryptonote::transaction &tx, bool kept_by_block)
   {
+    const crypto::hash id = get_transaction_hash(tx);
     for(const auto& in: tx.vin)
     {
-      const crypto::hash id = get_transaction_hash(tx);
       CHECKED_GET_SPECIFIC_VARIANT(in, const txin_to_key, txin, false);
-      auto& rng_set = m_spent_rngs[txin.random];
-      CHECK_AND_ASSERT_MES(kept_by_block || rng_set.size() == 0, false, "internal error: kept_by_block=" << kept_by_block
-                                                                                                               << ",  rng_set.size()=" << rng_set.size() << ENDL << "txin.random=" <<(unsigned char *)&txin.random << ENDL
+      CHECK_AND_ASSERT_MES(m_spent_rngs.insert(txin.random, id, kept_by_block), false, "internal error: kept_by_block=" << kept_by_block
+                                                                                                               << ", rng already spent or inserted twice" << ENDL << "txin.random=" <<(unsigned char *)&txin.random << ENDL
                                                                                                                << "tx_id=" << id );
-      auto ins_res = rng_set.insert(id);
-      CHECK_AND_ASSERT_MES(ins_res.second, false, "internal error: try to insert duplicate iterator in rng set");
     }
     ++m_cookie;
     return true;
@@ -445,23 +462,9 @@ namespace cryptonote
     for(const txin_v& vi: tx.vin)
     {
       CHECKED_GET_SPECIFIC_VARIANT(vi, const txin_to_key, txin, false);
-      auto it = m_spent_rngs.find(txin.random);
-      CHECK_AND_ASSERT_MES(it != m_spent_rngs.end(), false, "failed to find transaction input in rngs. rng=" << (unsigned char *)&txin.random << ENDL
-                                                                                                                         << "transaction id = " << actual_hash);
-      auto& rng_set =  it->second;
-      CHECK_AND_ASSERT_MES(rng_set.size(), false, "empty rng set, img=" << (unsigned char *)&txin.random << ENDL
-                                                                                    << "transaction id = " << actual_hash);
-
-      auto it_in_set = rng_set.find(actual_hash);
-      CHECK_AND_ASSERT_MES(it_in_set != rng_set.end(), false, "transaction id not found in rng set, img=" << (unsigned char *)&txin.random << ENDL
+      // the rng entry goes away with its last transaction
+      CHECK_AND_ASSERT_MES(m_spent_rngs.erase(txin.random, actual_hash), false, "transaction id not found in rng set, img=" << (unsigned char *)&txin.random << ENDL
                                                                                                                       << "transaction id = " << actual_hash);
-      rng_set.erase(it_in_set);
-      if(!rng_set.size())
-      {
-        //it is now empty hash container for this key_image
-        m_spent_rngs.erase(it);
-      }
-
     }
     ++m_cookie;
     return true;
@@ -545,6 +548,7 @@ namespace cryptonote
       return false;
     }
 
+    remove_block_candidate(id);
     m_txs_by_fee_and_receive_time.erase(sorted_it);
     ++m_cookie;
     return true;
@@ -557,11 +561,19 @@ namespace cryptonote
   //---------------------------------------------------------------------------------
   sorted_tx_container::iterator tx_memory_pool::find_tx_in_sorted_container(const crypto::hash& id) const
   {
-    return std::find_if( m_txs_by_fee_and_receive_time.begin(), m_txs_by_fee_and_receive_time.end()
-                       , [&](const sorted_tx_container::value_type& a){
-                         return a.second == id;
-                       }
-    );
+    return m_txs_by_fee_and_receive_time.project<0>(m_txs_by_fee_and_receive_time.get<by_txid>().find(id));
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::remove_block_candidate(const crypto::hash &id)
+  {
+    m_block_candidates.get<by_txid>().erase(id);
+    m_checked_block_candidates.erase(id);
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::reset_block_candidates()
+  {
+    m_block_candidates = m_txs_by_fee_and_receive_time;
+    m_checked_block_candidates.clear();
   }
   //---------------------------------------------------------------------------------
   //TODO: investigate whether boolean return is appropriate
@@ -586,6 +598,7 @@ namespace cryptonote
         {
           m_txs_by_fee_and_receive_time.erase(sorted_it);
         }
+        remove_block_candidate(txid);
         m_timed_out_transactions.insert(txid);
         remove.insert(txid);
       }
@@ -688,15 +701,13 @@ namespace cryptonote
   //---------------------------------------------------------------------------------
   size_t tx_memory_pool::get_transactions_count(bool include_unrelayed_txes) const
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
+    boost::shared_lock<tools::recursive_shared_mutex> lock(m_transactions_lock);
     return m_blockchain.get_txpool_tx_count(include_unrelayed_txes);
   }
   //---------------------------------------------------------------------------------
   void tx_memory_pool::get_transactions(std::vector<transaction>& txs, bool include_unrelayed_txes) const
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
+    boost::shared_lock<tools::recursive_shared_mutex> lock(m_transactions_lock);
     txs.reserve(m_blockchain.get_txpool_tx_count(include_unrelayed_txes));
     m_blockchain.for_all_txpool_txes([&txs](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd){
       transaction tx;
@@ -713,8 +724,7 @@ namespace cryptonote
   //------------------------------------------------------------------
   void tx_memory_pool::get_transaction_hashes(std::vector<crypto::hash>& txs, bool include_unrelayed_txes) const
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
+    boost::shared_lock<tools::recursive_shared_mutex> lock(m_transactions_lock);
     txs.reserve(m_blockchain.get_txpool_tx_count(include_unrelayed_txes));
     m_blockchain.for_all_txpool_txes([&txs](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd){
       txs.push_back(txid);
@@ -724,8 +734,7 @@ namespace cryptonote
   //------------------------------------------------------------------
   void tx_memory_pool::get_transaction_backlog(std::vector<tx_backlog_entry>& backlog, bool include_unrelayed_txes) const
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
+    boost::shared_lock<tools::recursive_shared_mutex> lock(m_transactions_lock);
     const uint64_t now = time(NULL);
     backlog.reserve(m_blockchain.get_txpool_tx_count(include_unrelayed_txes));
     m_blockchain.for_all_txpool_txes([&backlog, now](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd){
@@ -736,8 +745,7 @@ namespace cryptonote
   //------------------------------------------------------------------
   void tx_memory_pool::get_transaction_stats(struct txpool_stats& stats, bool include_unrelayed_txes) const
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
+    boost::shared_lock<tools::recursive_shared_mutex> lock(m_transactions_lock);
     const uint64_t now = time(NULL);
     std::map<uint64_t, txpool_histo> agebytes;
     stats.txs_total = m_blockchain.get_txpool_tx_count(include_unrelayed_txes);
@@ -814,8 +822,7 @@ namespace cryptonote
   //TODO: investigate whether boolean return is appropriate
   bool tx_memory_pool::get_transactions_and_spent_keys_info(std::vector<tx_info>& tx_infos, std::vector<spent_key_image_info>& key_image_infos, bool include_sensitive_data) const
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
+    boost::shared_lock<tools::recursive_shared_mutex> lock(m_transactions_lock);
     tx_infos.reserve(m_blockchain.get_txpool_tx_count());
     key_image_infos.reserve(m_blockchain.get_txpool_tx_count());
     m_blockchain.for_all_txpool_txes([&tx_infos, key_image_infos, include_sensitive_data](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd){
@@ -849,13 +856,19 @@ namespace cryptonote
       return true;
     }, true, include_sensitive_data);
 
+    // copy out first, so the shards are not kept locked during the
+    // database lookups below
+    std::vector<std::pair<crypto::key_image, std::vector<crypto::hash>>> spent_key_images;
+    m_spent_key_images.for_each([&spent_key_images](const crypto::key_image &k_image, const std::unordered_set<crypto::hash> &kei_image_set){
+      spent_key_images.emplace_back(k_image, std::vector<crypto::hash>(kei_image_set.begin(), kei_image_set.end()));
+    });
+
     txpool_tx_meta_t meta;
-    for (const key_images_container::value_type& kee : m_spent_key_images) {
+    for (const auto& kee : spent_key_images) {
       const crypto::key_image& k_image = kee.first;
-      const std::unordered_set<crypto::hash>& kei_image_set = kee.second;
       spent_key_image_info ki;
       ki.id_hash = epee::string_tools::pod_to_hex(k_image);
-      for (const crypto::hash& tx_id_hash : kei_image_set)
+      for (const crypto::hash& tx_id_hash : kee.second)
       {
         if (!include_sensitive_data)
         {
@@ -887,8 +900,7 @@ namespace cryptonote
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::get_pool_for_rpc(std::vector<cryptonote::rpc::tx_in_pool>& tx_infos, cryptonote::rpc::key_images_with_tx_hashes& key_image_infos) const
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
+    boost::shared_lock<tools::recursive_shared_mutex> lock(m_transactions_lock);
     tx_infos.reserve(m_blockchain.get_txpool_tx_count());
     key_image_infos.reserve(m_blockchain.get_txpool_tx_count());
     m_blockchain.for_all_txpool_txes([&tx_infos, key_image_infos](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *bd){
@@ -919,30 +931,21 @@ namespace cryptonote
       return true;
     }, true, false);
 
-    for (const key_images_container::value_type& kee : m_spent_key_images) {
-      std::vector<crypto::hash> tx_hashes;
-      const std::unordered_set<crypto::hash>& kei_image_set = kee.second;
-      for (const crypto::hash& tx_id_hash : kei_image_set)
-      {
-        tx_hashes.push_back(tx_id_hash);
-      }
-
-      const crypto::key_image& k_image = kee.first;
-      key_image_infos[k_image] = tx_hashes;
-    }
+    m_spent_key_images.for_each([&key_image_infos](const crypto::key_image &k_image, const std::unordered_set<crypto::hash> &kei_image_set){
+      key_image_infos[k_image] = std::vector<crypto::hash>(kei_image_set.begin(), kei_image_set.end());
+    });
     return true;
   }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::check_for_key_images(const std::vector<crypto::key_image>& key_images, std::vector<bool> spent) const
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
+    boost::shared_lock<tools::recursive_shared_mutex> lock(m_transactions_lock);
 
     spent.clear();
 
     for (const auto& image : key_images)
     {
-      spent.push_back(m_spent_key_images.find(image) == m_spent_key_images.end() ? false : true);
+      spent.push_back(m_spent_key_images.contains(image));
     }
 
     return true;
@@ -950,14 +953,13 @@ namespace cryptonote
   //RNG------------------------------------------------------------------------------
   bool tx_memory_pool::check_for_rngs(const std::vector<crypto::pq_seed>& rng, std::vector<bool> spent) const
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
+    boost::shared_lock<tools::recursive_shared_mutex> lock(m_transactions_lock);
 
     spent.clear();
 
     for (const auto& _rng : rng)
     {
-      spent.push_back(m_spent_rngs.find(_rng) == m_spent_rngs.end() ? false : true);
+      spent.push_back(m_spent_rngs.contains(_rng));
     }
 
     return true;
@@ -965,8 +967,7 @@ namespace cryptonote
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::get_transaction(const crypto::hash& id, cryptonote::blobdata& txblob) const
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
+    boost::shared_lock<tools::recursive_shared_mutex> lock(m_transactions_lock);
     try
     {
       return m_blockchain.get_txpool_tx_blob(id, txblob);
@@ -981,6 +982,7 @@ namespace cryptonote
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     m_input_cache.clear();
+    reset_block_candidates();
     return true;
   }
   //---------------------------------------------------------------------------------
@@ -988,21 +990,19 @@ namespace cryptonote
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     m_input_cache.clear();
+    reset_block_candidates();
     return true;
   }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::have_tx(const crypto::hash &id) const
   {
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
+    boost::shared_lock<tools::recursive_shared_mutex> lock(m_transactions_lock);
     return m_blockchain.get_db().txpool_has_tx(id);
   }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::have_tx_keyimges_as_spent(const transaction& tx) const
   {
     LOG_PRINT_L1("tx_memory_pool::" << __func__);
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
     for(const auto& in: tx.vin)
     {
       CHECKED_GET_SPECIFIC_VARIANT(in, const txin_to_key, tokey_in, true);//should never fail
@@ -1015,8 +1015,6 @@ namespace cryptonote
   bool tx_memory_pool::have_tx_rngs_as_spent(const cryptonote::transaction &tx) const
   {
     LOG_PRINT_L1("tx_memory_pool::" << __func__);
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
     for(const auto& in: tx.vin)
     {
       CHECKED_GET_SPECIFIC_VARIANT(in, const txin_to_key, tokey_in, true);//should never fail
@@ -1030,8 +1028,7 @@ namespace cryptonote
   bool tx_memory_pool::have_tx_keyimg_as_spent(const crypto::key_image& key_im) const
   {
     LOG_PRINT_L1("tx_memory_pool::" << __func__);
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-//    return m_spent_key_images.end() != m_spent_key_images.find(key_im);
+//    return m_spent_key_images.contains(key_im);
 //    TODO: Not needed for now, but let it run anyway.
       return false;
   }
@@ -1039,8 +1036,7 @@ namespace cryptonote
   bool tx_memory_pool::have_tx_rng_as_spent(const crypto::pq_seed &rng) const
   {
     LOG_PRINT_L1("tx_memory_pool::" << __func__);
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    return m_spent_rngs.end() != m_spent_rngs.find(rng);
+    return m_spent_rngs.contains(rng);
   }
   //---------------------------------------------------------------------------------
   void tx_memory_pool::lock() const
@@ -1055,7 +1051,7 @@ namespace cryptonote
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::try_lock() const
   {
-    return m_transactions_lock.tryLock();
+    return m_transactions_lock.try_lock();
   }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::check_tx_inputs(const std::function<cryptonote::transaction&(void)> &get_tx, const crypto::hash &txid, uint64_t &max_used_block_height, crypto::hash &max_used_block_id, tx_verification_context &tvc, bool kept_by_block) const
@@ -1204,32 +1200,28 @@ namespace cryptonote
     for(size_t i = 0; i!= tx.vin.size(); i++)
     {
       CHECKED_GET_SPECIFIC_VARIANT(tx.vin[i], const txin_to_key, itk, void());
-      const key_images_container::const_iterator it = m_spent_key_images.find(itk.k_image);
-      if (it != m_spent_key_images.end())
+      for (const crypto::hash &txid: m_spent_key_images.get(itk.k_image))
       {
-        for (const crypto::hash &txid: it->second)
+        txpool_tx_meta_t meta{};
+        if (!m_blockchain.get_txpool_tx_meta(txid, meta))
         {
-          txpool_tx_meta_t meta{};
-          if (!m_blockchain.get_txpool_tx_meta(txid, meta))
+          MERROR("Failed to find tx meta in txpool");
+          // continue, not fatal
+          continue;
+        }
+        if (!meta.double_spend_seen)
+        {
+          MDEBUG("Marking " << txid << " as double spending " << itk.k_image);
+          meta.double_spend_seen = true;
+          changed = true;
+          try
           {
-            MERROR("Failed to find tx meta in txpool");
-            // continue, not fatal
-            continue;
+            m_blockchain.update_txpool_tx(txid, meta);
           }
-          if (!meta.double_spend_seen)
+          catch (const std::exception &e)
           {
-            MDEBUG("Marking " << txid << " as double spending " << itk.k_image);
-            meta.double_spend_seen = true;
-            changed = true;
-            try
-            {
-              m_blockchain.update_txpool_tx(txid, meta);
-            }
-            catch (const std::exception &e)
-            {
-              MERROR("Failed to update tx meta: " << e.what());
-              // continue, not fatal
-            }
+            MERROR("Failed to update tx meta: " << e.what());
+            // continue, not fatal
           }
         }
       }
@@ -1248,32 +1240,28 @@ namespace cryptonote
     for(size_t i = 0; i!= tx.vin.size(); i++)
     {
       CHECKED_GET_SPECIFIC_VARIANT(tx.vin[i], const txin_to_key, itk, void());
-      const rng_container::const_iterator it = m_spent_rngs.find(itk.random);
-      if (it != m_spent_rngs.end())
+      for (const crypto::hash &txid: m_spent_rngs.get(itk.random))
       {
-        for (const crypto::hash &txid: it->second)
+        txpool_tx_meta_t meta{};
+        if (!m_blockchain.get_txpool_tx_meta(txid, meta))
         {
-          txpool_tx_meta_t meta{};
-          if (!m_blockchain.get_txpool_tx_meta(txid, meta))
+          MERROR("Failed to find tx meta in txpool");
+          // continue, not fatal
+          continue;
+        }
+        if (!meta.double_spend_seen)
+        {
+          MDEBUG("Marking " << txid << " as double spending " << (unsigned char *)&itk.random);
+          meta.double_spend_seen = true;
+          changed = true;
+          try
           {
-            MERROR("Failed to find tx meta in txpool");
-            // continue, not fatal
-            continue;
+            m_blockchain.update_txpool_tx(txid, meta);
           }
-          if (!meta.double_spend_seen)
+          catch (const std::exception &e)
           {
-            MDEBUG("Marking " << txid << " as double spending " << (unsigned char *)&itk.random);
-            meta.double_spend_seen = true;
-            changed = true;
-            try
-            {
-              m_blockchain.update_txpool_tx(txid, meta);
-            }
-            catch (const std::exception &e)
-            {
-              MERROR("Failed to update tx meta: " << e.what());
-              // continue, not fatal
-            }
+            MERROR("Failed to update tx meta: " << e.what());
+            // continue, not fatal
           }
         }
       }
@@ -1285,8 +1273,7 @@ namespace cryptonote
   std::string tx_memory_pool::print_pool(bool short_format) const
   {
     std::stringstream ss;
-    CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
+    boost::shared_lock<tools::recursive_shared_mutex> lock(m_transactions_lock);
     m_blockchain.for_all_txpool_txes([&ss, short_format](const crypto::hash &txid, const txpool_tx_meta_t &meta, const cryptonote::blobdata *txblob) {
       ss << "id: " << txid << std::endl;
       if (!short_format) {
@@ -1331,26 +1318,35 @@ namespace cryptonote
     size_t max_total_weight_pre_v5 = (130 * median_weight) / 100 - CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE;
     size_t max_total_weight_v5 = 2 * median_weight - CRYPTONOTE_COINBASE_BLOB_RESERVED_SIZE;
     size_t max_total_weight = version >= 5 ? max_total_weight_v5 : max_total_weight_pre_v5;
-    std::vector<crypto::key_image> k_images;
 
     //RNG Specific
     std::unordered_set<crypto::pq_seed> rng;
 
+    // candidates found not ready to go, dropped after the loop
+    std::vector<crypto::hash> not_ready;
 
-    LOG_PRINT_L2("Filling block template, median weight " << median_weight << ", " << m_txs_by_fee_and_receive_time.size() << " txes in the pool");
+    LOG_PRINT_L2("Filling block template, median weight " << median_weight << ", " << m_block_candidates.size() << "/" << m_txs_by_fee_and_receive_time.size() << " txes in the pool are candidates, " << m_checked_block_candidates.size() << " already checked");
 
     LockedTXN lock(m_blockchain);
 
-    auto sorted_it = m_txs_by_fee_and_receive_time.begin();
-    for (; sorted_it != m_txs_by_fee_and_receive_time.end(); ++sorted_it)
+    auto sorted_it = m_block_candidates.begin();
+    for (; sorted_it != m_block_candidates.end(); ++sorted_it)
     {
+      const crypto::hash &txid = sorted_it->second;
+      auto checked_it = m_checked_block_candidates.find(txid);
+      const bool checked = checked_it != m_checked_block_candidates.end();
       txpool_tx_meta_t meta;
-      if (!m_blockchain.get_txpool_tx_meta(sorted_it->second, meta))
+      if (checked)
+      {
+        meta.weight = checked_it->second.weight;
+        meta.fee = checked_it->second.fee;
+      }
+      else if (!m_blockchain.get_txpool_tx_meta(txid, meta))
       {
         MERROR("  failed to find tx meta");
         continue;
       }
-      LOG_PRINT_L2("Considering " << sorted_it->second << ", weight " << meta.weight << ", current block weight " << total_weight << "/" << max_total_weight << ", current coinbase " << print_money(best_coinbase));
+      LOG_PRINT_L2("Considering " << txid << ", weight " << meta.weight << ", current block weight " << total_weight << "/" << max_total_weight << ", current coinbase " << print_money(best_coinbase));
 
       // Can not exceed maximum block weight
       if (max_total_weight < total_weight + meta.weight)
@@ -1388,55 +1384,73 @@ namespace cryptonote
         }
       }
 
-      cryptonote::blobdata txblob = m_blockchain.get_txpool_tx_blob(sorted_it->second);
-      cryptonote::transaction tx;
-
-      // Skip transactions that are not ready to be
-      // included into the blockchain or that are
-      // missing key images
-      const cryptonote::txpool_tx_meta_t original_meta = meta;
-      bool ready = false;
-      try
-      {
-        ready = is_transaction_ready_to_go(meta, sorted_it->second, txblob, tx);
-      }
-      catch (const std::exception &e)
-      {
-        MERROR("Failed to check transaction readiness: " << e.what());
-        // continue, not fatal
-      }
-      if (memcmp(&original_meta, &meta, sizeof(meta)))
+      if (!checked)
       {
-          try
-          {
-              m_blockchain.update_txpool_tx(sorted_it->second, meta);
-          }
-          catch (const std::exception &e)
-          {
-              MERROR("Failed to update tx meta: " << e.what());
-              // continue, not fatal
-          }
-      }
-      if (!ready)
-      {
-        LOG_PRINT_L2("  not ready to go");
-        continue;
+        cryptonote::blobdata txblob = m_blockchain.get_txpool_tx_blob(txid);
+        cryptonote::transaction tx;
+
+        // Skip transactions that are not ready to be
+        // included into the blockchain or that are
+        // missing key images
+        const cryptonote::txpool_tx_meta_t original_meta = meta;
+        bool ready = false;
+        try
+        {
+          ready = is_transaction_ready_to_go(meta, txid, txblob, tx);
+        }
+        catch (const std::exception &e)
+        {
+          MERROR("Failed to check transaction readiness: " << e.what());
+          // continue, not fatal
+        }
+        if (memcmp(&original_meta, &meta, sizeof(meta)))
+        {
+            try
+            {
+                m_blockchain.update_txpool_tx(txid, meta);
+            }
+            catch (const std::exception &e)
+            {
+                MERROR("Failed to update tx meta: " << e.what());
+                // continue, not fatal
+            }
+        }
+        if (!ready)
+        {
+          LOG_PRINT_L2("  not ready to go");
+          not_ready.push_back(txid);
+          continue;
+        }
+
+        block_candidate candidate{meta.weight, meta.fee, {}};
+        for (const txin_v &in: tx.vin)
+        {
+          if (in.type() == typeid(txin_to_key))
+            candidate.rngs.push_back(boost::get<txin_to_key>(in).random);
+        }
+        checked_it = m_checked_block_candidates.emplace(txid, std::move(candidate)).first;
       }
-      if (have_rngs(rng, tx))
+
+      const std::vector<crypto::pq_seed> &tx_rngs = checked_it->second.rngs;
+      if (std::any_of(tx_rngs.begin(), tx_rngs.end(), [&rng](const crypto::pq_seed &r) { return rng.count(r) != 0; }))
       {
         LOG_PRINT_L2("  rng already seen");
         continue;
       }
 
-      bl.tx_hashes.push_back(sorted_it->second);
+      bl.tx_hashes.push_back(txid);
       total_weight += meta.weight;
       fee += meta.fee;
       best_coinbase = coinbase;
-      append_key_images(k_images, tx);
-      append_rngs(rng, tx);
+      rng.insert(tx_rngs.begin(), tx_rngs.end());
       LOG_PRINT_L2("  added, new block weight " << total_weight << "/" << max_total_weight << ", coinbase " << print_money(best_coinbase));
     }
 
+    // these may become ready to go again at another tip, when
+    // on_blockchain_inc/dec make them candidates again
+    for (const crypto::hash &txid: not_ready)
+      remove_block_candidate(txid);
+
     expected_reward = best_coinbase;
     LOG_PRINT_L2("Block template filled with " << bl.tx_hashes.size() << " txes, weight "
         << total_weight << "/" << max_total_weight << ", coinbase " << print_money(best_coinbase)
@@ -1494,6 +1508,7 @@ namespace cryptonote
           {
             m_txs_by_fee_and_receive_time.erase(sorted_it);
           }
+          remove_block_candidate(txid);
           ++n_removed;
         }
         catch (const std::exception &e)
@@ -1516,6 +1531,7 @@ namespace cryptonote
     m_txpool_max_weight = max_txpool_weight ? max_txpool_weight : DEFAULT_TXPOOL_MAX_WEIGHT;
     m_txs_by_fee_and_receive_time.clear();
     m_spent_key_images.clear();
+    m_spent_rngs.clear();
     m_txpool_weight = 0;
     std::vector<crypto::hash> remove;
 
@@ -1547,6 +1563,7 @@ namespace cryptonote
       if (!r)
         return false;
     }
+    reset_block_candidates();
     if (!remove.empty())
     {
       LockedTXN lock(m_blockchain);
@@ -37,8 +37,15 @@
 #include <queue>
 #include <boost/serialization/version.hpp>
 #include <boost/utility.hpp>
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/identity.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/ordered_index.hpp>
 
 #include "string_tools.h"
+#include "common/sharded_map.h"
+#include "common/recursive_shared_mutex.h"
 #include "syncobj.h"
 #include "math_helper.h"
 #include "cryptonote_basic/cryptonote_basic_impl.h"
@@ -61,20 +68,29 @@ namespace cryptonote
   class txCompare
   {
   public:
-    bool operator()(const tx_by_fee_and_receive_time_entry& a, const tx_by_fee_and_receive_time_entry& b)
+    bool operator()(const tx_by_fee_and_receive_time_entry& a, const tx_by_fee_and_receive_time_entry& b) const
     {
       // sort by greatest first, not least
       if (a.first.first > b.first.first) return true;
       else if (a.first.first < b.first.first) return false;
       else if (a.first.second < b.first.second) return true;
       else if (a.first.second > b.first.second) return false;
-      else if (a.second != b.second) return true;
-      else return false;
+      else return memcmp(&a.second, &b.second, sizeof(a.second)) < 0;
     }
   };
 
-  //! container for sorting transactions by fee per unit size
-  typedef std::set<tx_by_fee_and_receive_time_entry, txCompare> sorted_tx_container;
+  struct by_txid {};
+
+  //! container for sorting transactions by fee per unit size, also indexed by txid
+  typedef boost::multi_index_container<
+    tx_by_fee_and_receive_time_entry,
+    boost::multi_index::indexed_by<
+      // sort by fee per unit size, then receive time
+      boost::multi_index::ordered_unique<boost::multi_index::identity<tx_by_fee_and_receive_time_entry>, txCompare>,
+      // access by txid
+      boost::multi_index::hashed_unique<boost::multi_index::tag<by_txid>, boost::multi_index::member<tx_by_fee_and_receive_time_entry, crypto::hash, &tx_by_fee_and_receive_time_entry::second> >
+    >
+  > sorted_tx_container;
 
   /**
    * @brief Transaction pool, handles transactions which are not part of a block
@@ -155,7 +171,8 @@ namespace cryptonote
     /**
      * @brief action to take when notified of a block added to the blockchain
      *
-     * Currently does nothing
+     * Puts every pool transaction back in the block candidates, since
+     * whether one is ready to go depends on the chain tip
      *
      * @param new_block_height the height of the blockchain after the change
      * @param top_block_id the hash of the new top block
@@ -167,7 +184,8 @@ namespace cryptonote
     /**
      * @brief action to take when notified of a block removed from the blockchain
      *
-     * Currently does nothing
+     * Puts every pool transaction back in the block candidates, since
+     * whether one is ready to go depends on the chain tip
      *
      * @param new_block_height the height of the blockchain after the change
      * @param top_block_id the hash of the new top block
@@ -185,6 +203,9 @@ namespace cryptonote
 
     /**
      * @brief locks the transaction pool
+     *
+     * This keeps the pool from changing and read only queries from
+     * running, except on the calling thread
      */
     void lock() const;
 
@@ -220,6 +241,11 @@ namespace cryptonote
     /**
      * @brief Chooses transactions for a block to include
      *
+     * Only the block candidates are considered. A candidate is checked
+     * against the chain the first time it is considered at a given tip,
+     * and dropped from the candidates until the tip changes if it is not
+     * ready to go.
+     *
      * @param bl return-by-reference the block to fill in with transactions
      * @param median_weight the current median block weight
      * @param already_generated_coins the current total number of coins "minted"
@@ -569,6 +595,20 @@ namespace cryptonote
      */
     void prune(size_t bytes = 0);
 
+#if defined(DEBUG_CREATE_BLOCK_TEMPLATE)
+public:
+#endif
+    //! lock for the pool, taken exclusively by anything modifying it
+    /*! Read only queries take it shared, so they run alongside each other
+     *  and see the pool between two changes. The exclusive side is
+     *  recursive, since Blockchain takes it through lock() and then calls
+     *  back into the pool.
+     */
+    mutable tools::recursive_shared_mutex m_transactions_lock;
+#if defined(DEBUG_CREATE_BLOCK_TEMPLATE)
+private:
+#endif
+
     //TODO: confirm the below comments and investigate whether or not this
     //      is the desired behavior
     //! map key images to transactions which spent them
@@ -577,25 +617,15 @@ namespace cryptonote
      *  in the event of a reorg where someone creates a new/different
      *  transaction on the assumption that the original will not be in a
      *  block again.
+     *
+     *  Sharded so double spend checks can run concurrently with each
+     *  other and with changes to the pool; changes still happen with
+     *  m_transactions_lock held.
      */
-    typedef std::unordered_map<crypto::key_image, std::unordered_set<crypto::hash> > key_images_container;
-
-    // RNG
-    typedef std::unordered_map<crypto::pq_seed, std::unordered_set<crypto::hash> > rng_container;
-
-#if defined(DEBUG_CREATE_BLOCK_TEMPLATE)
-public:
-#endif
-    mutable epee::critical_section m_transactions_lock;  //!< lock for the pool
-#if defined(DEBUG_CREATE_BLOCK_TEMPLATE)
-private:
-#endif
-
-    //! container for spent key images from the transactions in the pool
-    key_images_container m_spent_key_images;
+    tools::sharded_multimap<crypto::key_image, crypto::hash> m_spent_key_images;
 
     //! container for spent rng from transactions in the pool
-    rng_container m_spent_rngs;
+    tools::sharded_multimap<crypto::pq_seed, crypto::hash> m_spent_rngs;
 
     //TODO: this time should be a named constant somewhere, not hard-coded
     //! interval on which to check for stale/"stuck" transactions
@@ -616,6 +646,37 @@ private:
      */
     sorted_tx_container::iterator find_tx_in_sorted_container(const crypto::hash& id) const;
 
+    //! what fill_block_template keeps of a candidate found ready to go
+    struct block_candidate
+    {
+      uint64_t weight;
+      uint64_t fee;
+      std::vector<crypto::pq_seed> rngs;
+    };
+
+    //! transactions fill_block_template may pick, in the same order as m_txs_by_fee_and_receive_time
+    /*! These are the pool transactions not yet found to be not ready to
+     *  go at the current chain tip. The ones already found ready to go
+     *  at this tip are also in m_checked_block_candidates, so a template
+     *  request at an unchanged tip does not read or check them again.
+     */
+    sorted_tx_container m_block_candidates;
+
+    //! block candidates found ready to go at the current chain tip
+    std::unordered_map<crypto::hash, block_candidate> m_checked_block_candidates;
+
+    /**
+     * @brief remove a transaction from the block candidates
+     *
+     * @param id the hash of the transaction to remove
+     */
+    void remove_block_candidate(const crypto::hash &id);
+
+    /**
+     * @brief make every pool transaction a block candidate to be checked again
+     */
+    void reset_block_candidates();
+
     //! cache/call Blockchain::check_tx_inputs results
     bool check_tx_inputs(const std::function<cryptonote::transaction&(void)> &get_tx, const crypto::hash &txid, uint64_t &max_used_block_height, crypto::hash &max_used_block_id, tx_verification_context &tvc, bool kept_by_block = false) const;
 
@@ -0,0 +1,98 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <string.h>
+#include "common/int-util.h"
+#include "compact_block.h"
+
+namespace cryptonote
+{
+  //---------------------------------------------------------------------------
+  crypto::hash get_compact_block_key(const blobdata &stripped_block, uint64_t nonce)
+  {
+    blobdata data = stripped_block;
+    nonce = SWAP64LE(nonce);
+    data.append((const char*)&nonce, sizeof(nonce));
+    return crypto::cn_fast_hash(data.data(), data.size());
+  }
+  //---------------------------------------------------------------------------
+  uint64_t get_short_tx_id(const crypto::hash &key, const crypto::hash &txid)
+  {
+    char data[2 * sizeof(crypto::hash)];
+    memcpy(data, &key, sizeof(key));
+    memcpy(data + sizeof(key), &txid, sizeof(txid));
+    const crypto::hash h = crypto::cn_fast_hash(data, sizeof(data));
+    uint64_t short_id = 0;
+    memcpy(&short_id, &h, COMPACT_BLOCK_SHORT_ID_SIZE);
+    return SWAP64LE(short_id);
+  }
+  //---------------------------------------------------------------------------
+  void add_short_tx_id(std::string &short_ids, uint64_t short_id)
+  {
+    short_id = SWAP64LE(short_id);
+    short_ids.append((const char*)&short_id, COMPACT_BLOCK_SHORT_ID_SIZE);
+  }
+  //---------------------------------------------------------------------------
+  size_t get_short_tx_id_count(const std::string &short_ids)
+  {
+    return short_ids.size() / COMPACT_BLOCK_SHORT_ID_SIZE;
+  }
+  //---------------------------------------------------------------------------
+  uint64_t get_short_tx_id(const std::string &short_ids, size_t index)
+  {
+    uint64_t short_id = 0;
+    memcpy(&short_id, short_ids.data() + index * COMPACT_BLOCK_SHORT_ID_SIZE, COMPACT_BLOCK_SHORT_ID_SIZE);
+    return SWAP64LE(short_id);
+  }
+  //---------------------------------------------------------------------------
+  void short_tx_id_index::add(const crypto::hash &txid)
+  {
+    const uint64_t short_id = get_short_tx_id(m_key, txid);
+    if (m_collisions.find(short_id) != m_collisions.end())
+      return;
+    auto i = m_txids.find(short_id);
+    if (i == m_txids.end())
+    {
+      m_txids.insert(std::make_pair(short_id, txid));
+    }
+    else if (i->second != txid)
+    {
+      m_txids.erase(i);
+      m_collisions.insert(short_id);
+    }
+  }
+  //---------------------------------------------------------------------------
+  bool short_tx_id_index::find(uint64_t short_id, crypto::hash &txid) const
+  {
+    auto i = m_txids.find(short_id);
+    if (i == m_txids.end())
+      return false;
+    txid = i->second;
+    return true;
+  }
+}
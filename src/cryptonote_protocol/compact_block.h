@@ -0,0 +1,76 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include "crypto/hash.h"
+#include "cryptonote_basic/blobdatatype.h"
+
+// size of a short tx id on the wire, in bytes
+#define COMPACT_BLOCK_SHORT_ID_SIZE 6
+
+namespace cryptonote
+{
+  /* Short tx ids for compact block relay.
+   *
+   * A compact block carries the block without its tx hashes, and a short
+   * id for each tx the receiver is expected to have in its pool. The ids
+   * are salted with a key made from the stripped block and a nonce picked
+   * by the sender, so a collision found against one block is of no use
+   * against the next one. A receiver that resolves a short id to the wrong
+   * tx ends up with a block hash that does not match the one announced,
+   * and falls back to fetching the full block.
+   */
+  crypto::hash get_compact_block_key(const blobdata &stripped_block, uint64_t nonce);
+  uint64_t get_short_tx_id(const crypto::hash &key, const crypto::hash &txid);
+
+  void add_short_tx_id(std::string &short_ids, uint64_t short_id);
+  size_t get_short_tx_id_count(const std::string &short_ids);
+  uint64_t get_short_tx_id(const std::string &short_ids, size_t index);
+
+  /* Maps short ids back to the txids they were made from. Short ids
+   * shared by more than one txid are remembered, and never resolved.
+   */
+  class short_tx_id_index
+  {
+  public:
+    short_tx_id_index(const crypto::hash &key): m_key(key) {}
+
+    void add(const crypto::hash &txid);
+    bool find(uint64_t short_id, crypto::hash &txid) const;
+    size_t size() const { return m_txids.size(); }
+
+  private:
+    crypto::hash m_key;
+    std::unordered_map<uint64_t, crypto::hash> m_txids;
+    std::unordered_set<uint64_t> m_collisions;
+  };
+}
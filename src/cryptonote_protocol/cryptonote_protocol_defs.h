@@ -280,5 +280,97 @@ namespace cryptonote
       END_KV_SERIALIZE_MAP()
     };
   }; 
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  struct NOTIFY_NEW_COMPACT_BLOCK
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 10;
+
+    struct request
+    {
+      blobdata block; // without its tx hashes
+      crypto::hash block_hash;
+      uint64_t nonce;
+      std::string short_ids; // for the txs which are not prefilled, in block order
+      std::vector<uint64_t> prefilled_tx_indices;
+      std::vector<blobdata> prefilled_txs;
+      uint64_t current_blockchain_height;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(block)
+        KV_SERIALIZE_VAL_POD_AS_BLOB(block_hash)
+        KV_SERIALIZE(nonce)
+        KV_SERIALIZE(short_ids)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(prefilled_tx_indices)
+        KV_SERIALIZE(prefilled_txs)
+        KV_SERIALIZE(current_blockchain_height)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  struct NOTIFY_REQUEST_TX_SKETCH
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 11;
+
+    struct request
+    {
+      uint64_t salt;
+      uint64_t set_size;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(salt)
+        KV_SERIALIZE(set_size)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  struct NOTIFY_TX_SKETCH
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 12;
+
+    struct request
+    {
+      uint64_t salt;
+      uint64_t set_size;
+      std::vector<uint32_t> sketch; // empty if it would have been too large
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(salt)
+        KV_SERIALIZE(set_size)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(sketch)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  struct NOTIFY_TX_INVENTORY
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 13;
+
+    struct request
+    {
+      uint64_t salt;
+      std::vector<uint32_t> have_ids;
+      std::vector<uint32_t> want_ids;
+      bool want_all; // reconciliation failed, send back every short id we did not list
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(salt)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(have_ids)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(want_ids)
+        KV_SERIALIZE(want_all)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
     
 }
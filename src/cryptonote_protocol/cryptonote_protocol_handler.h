@@ -43,8 +43,11 @@
 #include "cryptonote_protocol_defs.h"
 #include "cryptonote_protocol_handler_common.h"
 #include "block_queue.h"
+#include "span_scheduler.h"
+#include "tx_reconciler.h"
 #include "cryptonote_basic/connection_context.h"
 #include "cryptonote_basic/cryptonote_stat_info.h"
+#include "cryptonote_core/block_response_cache.h"
 #include <boost/circular_buffer.hpp>
 
 PUSH_WARNINGS
@@ -90,6 +93,10 @@ namespace cryptonote
       HANDLE_NOTIFY_T2(NOTIFY_RESPONSE_CHAIN_ENTRY, &cryptonote_protocol_handler::handle_response_chain_entry)
       HANDLE_NOTIFY_T2(NOTIFY_NEW_FLUFFY_BLOCK, &cryptonote_protocol_handler::handle_notify_new_fluffy_block)			
       HANDLE_NOTIFY_T2(NOTIFY_REQUEST_FLUFFY_MISSING_TX, &cryptonote_protocol_handler::handle_request_fluffy_missing_tx)						
+      HANDLE_NOTIFY_T2(NOTIFY_NEW_COMPACT_BLOCK, &cryptonote_protocol_handler::handle_notify_new_compact_block)
+      HANDLE_NOTIFY_T2(NOTIFY_REQUEST_TX_SKETCH, &cryptonote_protocol_handler::handle_request_tx_sketch)
+      HANDLE_NOTIFY_T2(NOTIFY_TX_SKETCH, &cryptonote_protocol_handler::handle_tx_sketch)
+      HANDLE_NOTIFY_T2(NOTIFY_TX_INVENTORY, &cryptonote_protocol_handler::handle_tx_inventory)
     END_INVOKE_MAP2()
 
     bool on_idle();
@@ -119,18 +126,27 @@ namespace cryptonote
     int handle_response_chain_entry(int command, NOTIFY_RESPONSE_CHAIN_ENTRY::request& arg, cryptonote_connection_context& context);
     int handle_notify_new_fluffy_block(int command, NOTIFY_NEW_FLUFFY_BLOCK::request& arg, cryptonote_connection_context& context);
     int handle_request_fluffy_missing_tx(int command, NOTIFY_REQUEST_FLUFFY_MISSING_TX::request& arg, cryptonote_connection_context& context);
+    int handle_notify_new_compact_block(int command, NOTIFY_NEW_COMPACT_BLOCK::request& arg, cryptonote_connection_context& context);
+    int handle_request_tx_sketch(int command, NOTIFY_REQUEST_TX_SKETCH::request& arg, cryptonote_connection_context& context);
+    int handle_tx_sketch(int command, NOTIFY_TX_SKETCH::request& arg, cryptonote_connection_context& context);
+    int handle_tx_inventory(int command, NOTIFY_TX_INVENTORY::request& arg, cryptonote_connection_context& context);
 		
     //----------------- i_bc_protocol_layout ---------------------------------------
     virtual bool relay_block(NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& exclude_context);
     virtual bool relay_transactions(NOTIFY_NEW_TRANSACTIONS::request& arg, cryptonote_connection_context& exclude_context);
     //----------------------------------------------------------------------------------
     //bool get_payload_sync_data(HANDSHAKE_DATA::request& hshd, cryptonote_connection_context& context);
+    bool relay_block(NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& exclude_context, const std::vector<uint64_t> &prefill_tx_indices);
+    bool make_compact_block(const NOTIFY_NEW_BLOCK::request& arg, const std::vector<uint64_t> &prefill_tx_indices, NOTIFY_NEW_COMPACT_BLOCK::request& compact_arg) const;
+    void add_relayed_block(const block_complete_entry &b, uint64_t current_blockchain_height, cryptonote_connection_context& context, const std::vector<uint64_t> &prefill_tx_indices);
     bool request_missing_objects(cryptonote_connection_context& context, bool check_having_blocks, bool force_next_span = false);
     size_t get_synchronizing_connections_count();
     bool on_connection_synchronized();
     bool should_download_next_span(cryptonote_connection_context& context) const;
     void drop_connection(cryptonote_connection_context &context, bool add_fail, bool flush_all_spans);
     bool kick_idle_peers();
+    bool reconcile_txs();
+    void get_pool_short_ids(uint64_t salt, std::unordered_set<uint32_t> &short_ids) const;
     int try_add_next_blocks(cryptonote_connection_context &context);
 
     t_core& m_core;
@@ -142,7 +158,10 @@ namespace cryptonote
     std::atomic<bool> m_stopping;
     boost::mutex m_sync_lock;
     block_queue m_block_queue;
+    span_scheduler m_span_scheduler;
+    tx_reconciler m_tx_reconciler;
     epee::math_helper::once_a_time_seconds<30> m_idle_peer_kicker;
+    epee::math_helper::once_a_time_seconds<P2P_TX_RECONCILIATION_INTERVAL> m_tx_reconciliation_timer;
 
     boost::mutex m_buffer_mutex;
     double get_avg_block_size();
@@ -152,10 +171,17 @@ namespace cryptonote
       bool post_notify(typename t_parameter::request& arg, cryptonote_connection_context& context)
       {
         LOG_PRINT_L2("[" << epee::net_utils::print_connection_context_short(context) << "] post " << typeid(t_parameter).name() << " -->");
-        std::string blob;
-        epee::serialization::store_t_to_binary(arg, blob);
+        std::shared_ptr<const epee::byte_segments> blob = epee::serialization::store_t_to_segments(arg);
         //handler_response_blocks_now(blob.size()); // XXX
-        return m_p2p->invoke_notify_to_peer(t_parameter::ID, blob, context);
+        return blob && m_p2p->invoke_notify_to_peer(t_parameter::ID, blob, context);
+      }
+
+      template<class t_parameter>
+      bool post_notify(typename t_parameter::request& arg, const block_response_cache::span& packed, cryptonote_connection_context& context)
+      {
+        LOG_PRINT_L2("[" << epee::net_utils::print_connection_context_short(context) << "] post packed " << typeid(t_parameter).name() << " -->");
+        std::shared_ptr<const epee::byte_segments> blob = epee::serialization::store_t_to_segments(arg, packed.entries, packed.entry_count);
+        return blob && m_p2p->invoke_notify_to_peer(t_parameter::ID, blob, context);
       }
 
       template<class t_parameter>
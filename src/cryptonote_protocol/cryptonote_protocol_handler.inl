@@ -42,15 +42,17 @@
 #include "cryptonote_basic/cryptonote_format_utils.h"
 #include "profile_tools.h"
 #include "net/network_throttle-detail.hpp"
+#include "compact_block.h"
 
 #undef MONERO_DEFAULT_LOG_CATEGORY
 #define MONERO_DEFAULT_LOG_CATEGORY "net.cn"
 
 #define MLOG_P2P_MESSAGE(x) MCINFO("net.p2p.msg", context << x)
 
-#define BLOCK_QUEUE_NBLOCKS_THRESHOLD 10 // chunks of N blocks
-#define BLOCK_QUEUE_SIZE_THRESHOLD (100*1024*1024) // MB
+#define BLOCK_QUEUE_SIZE_THRESHOLD (100*1024*1024) // bytes queued or in flight
 #define REQUEST_NEXT_SCHEDULED_SPAN_THRESHOLD (5 * 1000000) // microseconds
+#define REQUEST_NEXT_SCHEDULED_SPAN_MIN_THRESHOLD (1 * 1000000) // microseconds
+#define REQUEST_NEXT_SCHEDULED_SPAN_FACTOR 2 // times the expected duration
 #define IDLE_PEER_KICK_TIME (600 * 1000000) // microseconds
 #define PASSIVE_PEER_KICK_TIME (60 * 1000000) // microseconds
 
@@ -105,6 +107,7 @@ namespace cryptonote
       NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
       m_core.get_short_chain_history(r.block_ids);
       LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size() );
+      context.m_last_request_time = boost::posix_time::microsec_clock::universal_time();
       post_notify<NOTIFY_REQUEST_CHAIN>(r, context);
     }
     else if(context.m_state == cryptonote_connection_context::state_standby)
@@ -393,6 +396,7 @@ namespace cryptonote
       NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
       m_core.get_short_chain_history(r.block_ids);
       LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size() );
+      context.m_last_request_time = boost::posix_time::microsec_clock::universal_time();
       post_notify<NOTIFY_REQUEST_CHAIN>(r, context);
     }
 
@@ -447,6 +451,11 @@ namespace cryptonote
       // Also, remember to pepper some whitespace changes around to bother
       // moneromooo ... only because I <3 him. 
       std::vector<uint64_t> need_tx_indices;
+
+      // txes we did not have are likely to be missing from our peers' pools
+      // too, so they get sent along when we relay the block compactly
+      std::unordered_set<crypto::hash> received_txs;
+      std::vector<uint64_t> prefill_tx_indices;
         
       transaction tx;
       crypto::hash tx_hash;
@@ -516,6 +525,7 @@ namespace cryptonote
           if(!m_core.pool_has_tx(tx_hash))
           {
             MDEBUG("Incoming tx " << tx_hash << " not in pool, adding");
+            received_txs.insert(tx_hash);
             cryptonote::tx_verification_context tvc = AUTO_VAL_INIT(tvc);                        
             if(!m_core.handle_incoming_tx(tx_blob, tvc, true, true, false) || tvc.m_verifivation_failed)
             {
@@ -574,6 +584,8 @@ namespace cryptonote
         if(m_core.get_pool_transaction(tx_hash, txblob))
         {
           have_tx.push_back(txblob);
+          if (received_txs.find(tx_hash) != received_txs.end())
+            prefill_tx_indices.push_back(tx_idx);
         }
         else
         {
@@ -625,43 +637,7 @@ namespace cryptonote
         block_complete_entry b;
         b.block = arg.b.block;
         b.txs = have_tx;
-
-        std::vector<block_complete_entry> blocks;
-        blocks.push_back(b);
-        m_core.prepare_handle_incoming_blocks(blocks);
-          
-        block_verification_context bvc = boost::value_initialized<block_verification_context>();
-        m_core.handle_incoming_block(arg.b.block, bvc); // got block from handle_notify_new_block
-        if (!m_core.cleanup_handle_incoming_blocks(true))
-        {
-          LOG_PRINT_CCONTEXT_L0("Failure in cleanup_handle_incoming_blocks");
-          m_core.resume_mine();
-          return 1;
-        }
-        m_core.resume_mine();
-        
-        if( bvc.m_verifivation_failed )
-        {
-          LOG_PRINT_CCONTEXT_L0("Block verification failed, dropping connection");
-          drop_connection(context, true, false);
-          return 1;
-        }
-        if( bvc.m_added_to_main_chain )
-        {
-          //TODO: Add here announce protocol usage
-          NOTIFY_NEW_BLOCK::request reg_arg = AUTO_VAL_INIT(reg_arg);
-          reg_arg.current_blockchain_height = arg.current_blockchain_height;
-          reg_arg.b = b;
-          relay_block(reg_arg, context);
-        }
-        else if( bvc.m_marked_as_orphaned )
-        {
-          context.m_state = cryptonote_connection_context::state_synchronizing;
-          NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
-          m_core.get_short_chain_history(r.block_ids);
-          LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size() );
-          post_notify<NOTIFY_REQUEST_CHAIN>(r, context);
-        }            
+        add_relayed_block(b, arg.current_blockchain_height, context, prefill_tx_indices);
       }
     } 
     else
@@ -759,6 +735,304 @@ namespace cryptonote
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_notify_new_compact_block(int command, NOTIFY_NEW_COMPACT_BLOCK::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_NEW_COMPACT_BLOCK (height " << arg.current_blockchain_height << ", " << get_short_tx_id_count(arg.short_ids)
+        << " short ids, " << arg.prefilled_txs.size() << " prefilled txes)");
+    if(context.m_state != cryptonote_connection_context::state_normal)
+      return 1;
+    if(!is_synchronized()) // can happen if a peer connection goes to normal but another thread still hasn't finished adding queued blocks
+    {
+      LOG_DEBUG_CC(context, "Received new block while syncing, ignored");
+      return 1;
+    }
+
+    block new_block;
+    if (!parse_and_validate_block_from_blob(arg.block, new_block) || !new_block.tx_hashes.empty())
+    {
+      LOG_ERROR_CCONTEXT("sent wrong compact block: failed to parse and validate block, dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+    if (arg.short_ids.size() % COMPACT_BLOCK_SHORT_ID_SIZE || arg.prefilled_tx_indices.size() != arg.prefilled_txs.size())
+    {
+      LOG_ERROR_CCONTEXT("sent wrong compact block: inconsistent tx counts, dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+    // the tx count only comes from the peer, and sizes what we allocate
+    // below, so it must fit in a block before anything is allocated
+    const size_t n_txes = get_short_tx_id_count(arg.short_ids) + arg.prefilled_txs.size();
+    if (n_txes > m_core.get_max_block_tx_count())
+    {
+      LOG_ERROR_CCONTEXT("sent wrong compact block: " << n_txes << " txes, more than a block can carry, dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+    for (size_t i = 0; i < arg.prefilled_tx_indices.size(); ++i)
+    {
+      if (arg.prefilled_tx_indices[i] >= n_txes || (i > 0 && arg.prefilled_tx_indices[i] <= arg.prefilled_tx_indices[i - 1]))
+      {
+        LOG_ERROR_CCONTEXT("sent wrong compact block: bad prefilled tx index " << arg.prefilled_tx_indices[i] << ", dropping connection");
+        drop_connection(context, false, false);
+        return 1;
+      }
+    }
+
+    m_core.pause_mine();
+
+    new_block.tx_hashes.resize(n_txes);
+    std::vector<blobdata> have_tx(n_txes);
+    std::vector<bool> resolved(n_txes, false);
+    std::vector<uint64_t> prefill_tx_indices;
+    for (size_t i = 0; i < arg.prefilled_txs.size(); ++i)
+    {
+      const uint64_t tx_idx = arg.prefilled_tx_indices[i];
+      transaction tx;
+      crypto::hash tx_hash, tx_prefix_hash;
+      if (!parse_and_validate_tx_from_blob(arg.prefilled_txs[i], tx, tx_hash, tx_prefix_hash))
+      {
+        LOG_ERROR_CCONTEXT("sent wrong tx: failed to parse and validate prefilled transaction, dropping connection");
+        drop_connection(context, false, false);
+        m_core.resume_mine();
+        return 1;
+      }
+      if (!m_core.pool_has_tx(tx_hash))
+      {
+        MDEBUG("Incoming tx " << tx_hash << " not in pool, adding");
+        cryptonote::tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+        if(!m_core.handle_incoming_tx(arg.prefilled_txs[i], tvc, true, true, false) || tvc.m_verifivation_failed)
+        {
+          LOG_PRINT_CCONTEXT_L1("Block verification failed: transaction verification failed, dropping connection");
+          drop_connection(context, false, false);
+          m_core.resume_mine();
+          return 1;
+        }
+        prefill_tx_indices.push_back(tx_idx);
+      }
+      new_block.tx_hashes[tx_idx] = tx_hash;
+      have_tx[tx_idx] = std::move(arg.prefilled_txs[i]);
+      resolved[tx_idx] = true;
+    }
+
+    // match the short ids against our pool, anything we can't find or
+    // can't tell apart from another tx gets requested by index
+    std::vector<uint64_t> need_tx_indices;
+    if (!arg.short_ids.empty())
+    {
+      short_tx_id_index pool_index(get_compact_block_key(arg.block, arg.nonce));
+      std::vector<crypto::hash> pool_txids;
+      m_core.get_pool_transaction_hashes(pool_txids);
+      for (const auto &txid: pool_txids)
+        pool_index.add(txid);
+
+      size_t short_idx = 0;
+      for (size_t tx_idx = 0; tx_idx < n_txes; ++tx_idx)
+      {
+        if (resolved[tx_idx])
+          continue;
+        if (!pool_index.find(get_short_tx_id(arg.short_ids, short_idx++), new_block.tx_hashes[tx_idx]) ||
+            !m_core.get_pool_transaction(new_block.tx_hashes[tx_idx], have_tx[tx_idx]))
+          need_tx_indices.push_back(tx_idx);
+      }
+    }
+
+    if (need_tx_indices.empty())
+    {
+      new_block.invalidate_hashes();
+      if (get_block_hash(new_block) != arg.block_hash)
+      {
+        // a short id matched the wrong tx, let the fluffy block path sort it
+        // out by full hash
+        MDEBUG("Compact block " << arg.block_hash << " does not match the txes we picked from our pool");
+      }
+      else
+      {
+        MDEBUG("We have all needed txes for this compact block");
+        block_complete_entry b;
+        b.block = block_to_blob(new_block);
+        b.txs = std::move(have_tx);
+        add_relayed_block(b, arg.current_blockchain_height, context, prefill_tx_indices);
+        return 1;
+      }
+    }
+
+    // the peer answers with the full block, as a fluffy block
+    MDEBUG("We are missing " << need_tx_indices.size() << " txes for compact block " << arg.block_hash);
+    NOTIFY_REQUEST_FLUFFY_MISSING_TX::request missing_tx_req;
+    missing_tx_req.block_hash = arg.block_hash;
+    missing_tx_req.current_blockchain_height = arg.current_blockchain_height;
+    missing_tx_req.missing_tx_indices = std::move(need_tx_indices);
+
+    m_core.resume_mine();
+    post_notify<NOTIFY_REQUEST_FLUFFY_MISSING_TX>(missing_tx_req, context);
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_request_tx_sketch(int command, NOTIFY_REQUEST_TX_SKETCH::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_REQUEST_TX_SKETCH (" << arg.set_size << " txes)");
+    // the side which started the connection asks for sketches
+    if(context.m_state != cryptonote_connection_context::state_normal || !context.m_is_income)
+      return 1;
+
+    NOTIFY_TX_SKETCH::request rsp;
+    rsp.salt = arg.salt;
+    rsp.set_size = m_tx_reconciler.start_round(context.m_connection_id, arg.salt);
+    tx_sketch sketch;
+    if (m_tx_reconciler.get_sketch(context.m_connection_id, arg.set_size, sketch))
+      rsp.sketch = sketch.get_syndromes();
+    post_notify<NOTIFY_TX_SKETCH>(rsp, context);
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_tx_sketch(int command, NOTIFY_TX_SKETCH::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_TX_SKETCH (" << arg.set_size << " txes, capacity " << arg.sketch.size() << ")");
+    if(context.m_state != cryptonote_connection_context::state_normal || context.m_is_income)
+      return 1;
+    if(!m_tx_reconciler.has_round(context.m_connection_id, arg.salt))
+    {
+      LOG_DEBUG_CC(context, "Received tx sketch for an unknown round, ignored");
+      return 1;
+    }
+    if(!m_tx_reconciler.is_sketch_capacity_valid(context.m_connection_id, arg.salt, arg.sketch.size(), arg.set_size))
+    {
+      LOG_ERROR_CCONTEXT("Received tx sketch of capacity " << arg.sketch.size() << ", larger than we asked for, dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+
+    NOTIFY_TX_INVENTORY::request inv = AUTO_VAL_INIT(inv);
+    inv.salt = arg.salt;
+    std::vector<uint32_t> remote_only;
+    if (m_tx_reconciler.reconcile(context.m_connection_id, arg.salt, tx_sketch(arg.sketch), arg.set_size, inv.have_ids, remote_only))
+    {
+      std::unordered_set<uint32_t> pool_ids;
+      if (!remote_only.empty())
+        get_pool_short_ids(arg.salt, pool_ids);
+      for (uint32_t short_id: remote_only)
+        if (pool_ids.find(short_id) == pool_ids.end())
+          inv.want_ids.push_back(short_id);
+      if (inv.have_ids.empty() && inv.want_ids.empty())
+        return 1;
+    }
+    else
+    {
+      // fall back to announcing everything we had for this round
+      inv.have_ids = m_tx_reconciler.get_short_ids(context.m_connection_id, arg.salt);
+      inv.want_all = true;
+    }
+
+    LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_TX_INVENTORY: have " << inv.have_ids.size() << ", want " << inv.want_ids.size() << (inv.want_all ? " (all)" : ""));
+    post_notify<NOTIFY_TX_INVENTORY>(inv, context);
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_tx_inventory(int command, NOTIFY_TX_INVENTORY::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_TX_INVENTORY (have " << arg.have_ids.size() << ", want " << arg.want_ids.size() << (arg.want_all ? " (all)" : "") << ")");
+    if(context.m_state != cryptonote_connection_context::state_normal)
+      return 1;
+    if(!m_tx_reconciler.has_round(context.m_connection_id, arg.salt))
+    {
+      LOG_DEBUG_CC(context, "Received tx inventory for an unknown round, ignored");
+      return 1;
+    }
+
+    if (!arg.want_ids.empty())
+    {
+      NOTIFY_NEW_TRANSACTIONS::request txs;
+      m_tx_reconciler.get_txs(context.m_connection_id, arg.salt, arg.want_ids, txs.txs);
+      if (!txs.txs.empty())
+        post_notify<NOTIFY_NEW_TRANSACTIONS>(txs, context);
+    }
+
+    // while syncing we would ignore the txes anyway
+    if (!is_synchronized())
+      return 1;
+
+    NOTIFY_TX_INVENTORY::request rsp = AUTO_VAL_INIT(rsp);
+    rsp.salt = arg.salt;
+    if (!arg.have_ids.empty())
+    {
+      std::unordered_set<uint32_t> pool_ids;
+      get_pool_short_ids(arg.salt, pool_ids);
+      for (uint32_t short_id: arg.have_ids)
+        if (pool_ids.find(short_id) == pool_ids.end())
+          rsp.want_ids.push_back(short_id);
+    }
+    if (arg.want_all)
+    {
+      const std::unordered_set<uint32_t> remote_ids(arg.have_ids.begin(), arg.have_ids.end());
+      for (uint32_t short_id: m_tx_reconciler.get_short_ids(context.m_connection_id, arg.salt))
+        if (remote_ids.find(short_id) == remote_ids.end())
+          rsp.have_ids.push_back(short_id);
+    }
+    if (!rsp.have_ids.empty() || !rsp.want_ids.empty())
+    {
+      LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_TX_INVENTORY: have " << rsp.have_ids.size() << ", want " << rsp.want_ids.size());
+      post_notify<NOTIFY_TX_INVENTORY>(rsp, context);
+    }
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_cryptonote_protocol_handler<t_core>::get_pool_short_ids(uint64_t salt, std::unordered_set<uint32_t> &short_ids) const
+  {
+    std::vector<crypto::hash> txids;
+    m_core.get_pool_transaction_hashes(txids);
+    short_ids.reserve(txids.size());
+    for (const crypto::hash &txid: txids)
+      short_ids.insert(get_relay_short_id(salt, txid));
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_cryptonote_protocol_handler<t_core>::add_relayed_block(const block_complete_entry &b, uint64_t current_blockchain_height, cryptonote_connection_context& context, const std::vector<uint64_t> &prefill_tx_indices)
+  {
+    std::vector<block_complete_entry> blocks;
+    blocks.push_back(b);
+    m_core.prepare_handle_incoming_blocks(blocks);
+
+    block_verification_context bvc = boost::value_initialized<block_verification_context>();
+    m_core.handle_incoming_block(b.block, bvc); // got block from handle_notify_new_block
+    if (!m_core.cleanup_handle_incoming_blocks(true))
+    {
+      LOG_PRINT_CCONTEXT_L0("Failure in cleanup_handle_incoming_blocks");
+      m_core.resume_mine();
+      return;
+    }
+    m_core.resume_mine();
+
+    if( bvc.m_verifivation_failed )
+    {
+      LOG_PRINT_CCONTEXT_L0("Block verification failed, dropping connection");
+      drop_connection(context, true, false);
+      return;
+    }
+    if( bvc.m_added_to_main_chain )
+    {
+      //TODO: Add here announce protocol usage
+      NOTIFY_NEW_BLOCK::request reg_arg = AUTO_VAL_INIT(reg_arg);
+      reg_arg.current_blockchain_height = current_blockchain_height;
+      reg_arg.b = b;
+      relay_block(reg_arg, context, prefill_tx_indices);
+    }
+    else if( bvc.m_marked_as_orphaned )
+    {
+      context.m_state = cryptonote_connection_context::state_synchronizing;
+      NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
+      m_core.get_short_chain_history(r.block_ids);
+      LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size() );
+      context.m_last_request_time = boost::posix_time::microsec_clock::universal_time();
+      post_notify<NOTIFY_REQUEST_CHAIN>(r, context);
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
   int t_cryptonote_protocol_handler<t_core>::handle_notify_new_transactions(int command, NOTIFY_NEW_TRANSACTIONS::request& arg, cryptonote_connection_context& context)
   {
     MLOG_P2P_MESSAGE("Received NOTIFY_NEW_TRANSACTIONS (" << arg.txs.size() << " txes)");
@@ -805,15 +1079,19 @@ namespace cryptonote
   {
     MLOG_P2P_MESSAGE("Received NOTIFY_REQUEST_GET_OBJECTS (" << arg.blocks.size() << " blocks, " << arg.txs.size() << " txes)");
     NOTIFY_RESPONSE_GET_OBJECTS::request rsp;
-    if(!m_core.handle_get_objects(arg, rsp, context))
+    block_response_cache::span packed_blocks;
+    if(!m_core.handle_get_objects(arg, rsp, packed_blocks, context))
     {
       LOG_ERROR_CCONTEXT("failed to handle request NOTIFY_REQUEST_GET_OBJECTS, dropping connection");
       drop_connection(context, false, false);
       return 1;
     }
-    LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_RESPONSE_GET_OBJECTS: blocks.size()=" << rsp.blocks.size() << ", txs.size()=" << rsp.txs.size()
+    LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_RESPONSE_GET_OBJECTS: blocks.size()=" << (rsp.blocks.size() + packed_blocks.block_count) << ", txs.size()=" << rsp.txs.size()
                             << ", rsp.m_current_blockchain_height=" << rsp.current_blockchain_height << ", missed_ids.size()=" << rsp.missed_ids.size());
-    post_notify<NOTIFY_RESPONSE_GET_OBJECTS>(rsp, context);
+    if (packed_blocks.entries)
+      post_notify<NOTIFY_RESPONSE_GET_OBJECTS>(rsp, packed_blocks, context);
+    else
+      post_notify<NOTIFY_RESPONSE_GET_OBJECTS>(rsp, context);
     //handler_response_blocks_now(sizeof(rsp)); // XXX
     //handler_response_blocks_now(200);
     return 1;
@@ -956,6 +1234,7 @@ namespace cryptonote
       // add that new span to the block queue
       const boost::posix_time::time_duration dt = now - context.m_last_request_time;
       const float rate = size * 1e6 / (dt.total_microseconds() + 1);
+      m_span_scheduler.add_span_sample(context.m_connection_id, dt.total_microseconds() / 1e6, size, arg.blocks.size());
       MDEBUG(context << " adding span: " << arg.blocks.size() << " at height " << start_height << ", " << dt.total_microseconds()/1e6 << " seconds, " << (rate/1e3) << " kB/s, size now " << (m_block_queue.get_data_size() + blocks_size) / 1048576.f << " MB");
       m_block_queue.add_blocks(start_height, arg.blocks, context.m_connection_id, rate, blocks_size);
 
@@ -1051,6 +1330,19 @@ skip:
 
           m_core.prepare_handle_incoming_blocks(blocks);
 
+          // look up the outputs the next span uses while this one is added
+          std::vector<cryptonote::block_complete_entry> next_blocks;
+          const uint64_t next_height = start_height + blocks.size();
+          m_block_queue.foreach([&next_blocks, next_height](const block_queue::span &span) {
+            if (span.start_block_height < next_height)
+              return true;
+            if (span.start_block_height == next_height)
+              next_blocks = span.blocks;
+            return false;
+          });
+          if (!next_blocks.empty())
+            m_core.prefetch_outputs(next_blocks);
+
           uint64_t block_process_time_full = 0, transactions_process_time_full = 0;
           size_t num_txs = 0;
           for(const block_complete_entry& block_entry: blocks)
@@ -1208,6 +1500,7 @@ skip:
   bool t_cryptonote_protocol_handler<t_core>::on_idle()
   {
     m_idle_peer_kicker.do_call(boost::bind(&t_cryptonote_protocol_handler<t_core>::kick_idle_peers, this));
+    m_tx_reconciliation_timer.do_call(boost::bind(&t_cryptonote_protocol_handler<t_core>::reconcile_txs, this));
     return m_core.on_idle();
   }
   //------------------------------------------------------------------------------------------------------------------------
@@ -1243,6 +1536,29 @@ skip:
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
+  bool t_cryptonote_protocol_handler<t_core>::reconcile_txs()
+  {
+    // each connection has its txes reconciled by the side which started it
+    std::vector<std::pair<boost::uuids::uuid, std::string>> requests;
+    m_p2p->for_each_connection([&](cryptonote_connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)->bool
+    {
+      if (peer_id && !context.m_is_income && context.m_state == cryptonote_connection_context::state_normal &&
+          (support_flags & P2P_SUPPORT_FLAG_TX_RECONCILIATION))
+      {
+        NOTIFY_REQUEST_TX_SKETCH::request req;
+        req.salt = crypto::rand<uint64_t>();
+        req.set_size = m_tx_reconciler.start_round(context.m_connection_id, req.salt);
+        requests.push_back(std::make_pair(context.m_connection_id, std::string()));
+        epee::serialization::store_t_to_binary(req, requests.back().second);
+      }
+      return true;
+    });
+    for (const auto &r: requests)
+      m_p2p->relay_notify_to_list(NOTIFY_REQUEST_TX_SKETCH::ID, r.second, std::list<boost::uuids::uuid>(1, r.first));
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
   int t_cryptonote_protocol_handler<t_core>::handle_request_chain(int command, NOTIFY_REQUEST_CHAIN::request& arg, cryptonote_connection_context& context)
   {
     MLOG_P2P_MESSAGE("Received NOTIFY_REQUEST_CHAIN (" << arg.block_ids.size() << " blocks");
@@ -1312,9 +1628,27 @@ skip:
       MDEBUG(context << " we should download it as we're the fastest peer");
       return true;
     }
+
+    // a span taking much longer than its peer's measured speed predicts is
+    // asked again, from the fastest of the peers waiting for something to do
+    int64_t threshold = REQUEST_NEXT_SCHEDULED_SPAN_THRESHOLD;
+    const double expected = m_span_scheduler.get_expected_duration(span_connection_id, span.second);
+    if (expected >= 0)
+      threshold = std::min<int64_t>(threshold, std::max<int64_t>(REQUEST_NEXT_SCHEDULED_SPAN_MIN_THRESHOLD, expected * REQUEST_NEXT_SCHEDULED_SPAN_FACTOR * 1e6));
     const boost::posix_time::ptime now = boost::posix_time::microsec_clock::universal_time();
-    if ((now - request_time).total_microseconds() > REQUEST_NEXT_SCHEDULED_SPAN_THRESHOLD)
+    if ((now - request_time).total_microseconds() > threshold)
     {
+      std::vector<boost::uuids::uuid> idle;
+      m_p2p->for_each_connection([&](cryptonote_connection_context& ctx, nodetool::peerid_type peer_id, uint32_t support_flags)->bool{
+        if (ctx.m_state == cryptonote_connection_context::state_standby)
+          idle.push_back(ctx.m_connection_id);
+        return true;
+      });
+      if (!m_span_scheduler.is_fastest(context.m_connection_id, idle))
+      {
+        MDEBUG(context << " this span was requested long ago, but a faster peer is idle");
+        return false;
+      }
       MDEBUG(context << " we should download it as this span was requested long ago");
       return true;
     }
@@ -1339,13 +1673,15 @@ skip:
       bool first = true;
       while (1)
       {
-        size_t nblocks = m_block_queue.get_num_filled_spans();
-        size_t size = m_block_queue.get_data_size();
-        if (nblocks < BLOCK_QUEUE_NBLOCKS_THRESHOLD || size < BLOCK_QUEUE_SIZE_THRESHOLD)
+        // count what was asked for but not received yet, so the budget
+        // holds whatever the size of the blocks
+        const size_t size = m_block_queue.get_data_size();
+        const uint64_t in_flight = m_span_scheduler.get_expected_bytes(m_block_queue.get_num_scheduled_blocks());
+        if (size + in_flight < BLOCK_QUEUE_SIZE_THRESHOLD)
         {
           if (!first)
           {
-            LOG_DEBUG_CC(context, "Block queue is " << nblocks << " and " << size << ", resuming");
+            LOG_DEBUG_CC(context, "Block queue is " << size << " bytes, " << in_flight << " in flight, resuming");
           }
           break;
         }
@@ -1368,7 +1704,7 @@ skip:
 
         if (first)
         {
-          LOG_DEBUG_CC(context, "Block queue is " << nblocks << " and " << size << ", pausing");
+          LOG_DEBUG_CC(context, "Block queue is " << size << " bytes, " << in_flight << " in flight, pausing");
           first = false;
           context.m_state = cryptonote_connection_context::state_standby;
         }
@@ -1400,7 +1736,7 @@ skip:
       NOTIFY_REQUEST_GET_OBJECTS::request req;
       bool is_next = false;
       size_t count = 0;
-      const size_t count_limit = m_core.get_block_sync_size(m_core.get_current_blockchain_height());
+      const size_t count_limit = m_span_scheduler.get_span_blocks(context.m_connection_id, m_core.get_block_sync_size(m_core.get_current_blockchain_height()));
       std::pair<uint64_t, uint64_t> span = std::make_pair(0, 0);
       {
         MDEBUG(context << " checking for gap");
@@ -1633,6 +1969,9 @@ skip:
       return 1;
     }
 
+    const boost::posix_time::time_duration dt = boost::posix_time::microsec_clock::universal_time() - context.m_last_request_time;
+    m_span_scheduler.add_latency_sample(context.m_connection_id, dt.total_microseconds() / 1e6, arg.m_block_ids.size() * sizeof(crypto::hash));
+
     context.m_remote_blockchain_height = arg.total_height;
     context.m_last_response_height = arg.start_height + arg.m_block_ids.size()-1;
     if(context.m_last_response_height > context.m_remote_blockchain_height)
@@ -1676,6 +2015,12 @@ skip:
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
   bool t_cryptonote_protocol_handler<t_core>::relay_block(NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& exclude_context)
+  {
+    return relay_block(arg, exclude_context, std::vector<uint64_t>());
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  bool t_cryptonote_protocol_handler<t_core>::relay_block(NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& exclude_context, const std::vector<uint64_t> &prefill_tx_indices)
   {
     NOTIFY_NEW_FLUFFY_BLOCK::request fluffy_arg = AUTO_VAL_INIT(fluffy_arg);
     fluffy_arg.current_blockchain_height = arg.current_blockchain_height;    
@@ -1683,13 +2028,18 @@ skip:
     fluffy_arg.b = arg.b;
     fluffy_arg.b.txs = fluffy_txs;
 
-    // sort peers between fluffy ones and others
-    std::list<boost::uuids::uuid> fullConnections, fluffyConnections;
-    m_p2p->for_each_connection([this, &exclude_context, &fullConnections, &fluffyConnections](connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)
+    // sort peers between compact, fluffy and others
+    std::list<boost::uuids::uuid> fullConnections, fluffyConnections, compactConnections;
+    m_p2p->for_each_connection([this, &exclude_context, &fullConnections, &fluffyConnections, &compactConnections](connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)
     {
       if (peer_id && exclude_context.m_connection_id != context.m_connection_id)
       {
-        if(m_core.fluffy_blocks_enabled() && (support_flags & P2P_SUPPORT_FLAG_FLUFFY_BLOCKS))
+        if(m_core.fluffy_blocks_enabled() && (support_flags & P2P_SUPPORT_FLAG_COMPACT_BLOCKS))
+        {
+          LOG_DEBUG_CC(context, "PEER SUPPORTS COMPACT BLOCKS - RELAYING SHORT TX IDS");
+          compactConnections.push_back(context.m_connection_id);
+        }
+        else if(m_core.fluffy_blocks_enabled() && (support_flags & P2P_SUPPORT_FLAG_FLUFFY_BLOCKS))
         {
           LOG_DEBUG_CC(context, "PEER SUPPORTS FLUFFY BLOCKS - RELAYING THIN/COMPACT WHATEVER BLOCK");
           fluffyConnections.push_back(context.m_connection_id);
@@ -1703,17 +2053,28 @@ skip:
       return true;
     });
 
-    // send fluffy ones first, we want to encourage people to run that
+    // send compact and fluffy ones first, we want to encourage people to run that
+    if (!compactConnections.empty())
+    {
+      NOTIFY_NEW_COMPACT_BLOCK::request compact_arg = AUTO_VAL_INIT(compact_arg);
+      if (make_compact_block(arg, prefill_tx_indices, compact_arg))
+      {
+        std::shared_ptr<const epee::byte_segments> compactBlob = epee::serialization::store_t_to_segments(compact_arg);
+        m_p2p->relay_notify_to_list(NOTIFY_NEW_COMPACT_BLOCK::ID, compactBlob, compactConnections);
+      }
+      else
+      {
+        fluffyConnections.splice(fluffyConnections.end(), compactConnections);
+      }
+    }
     if (!fluffyConnections.empty())
     {
-      std::string fluffyBlob;
-      epee::serialization::store_t_to_binary(fluffy_arg, fluffyBlob);
+      std::shared_ptr<const epee::byte_segments> fluffyBlob = epee::serialization::store_t_to_segments(fluffy_arg);
       m_p2p->relay_notify_to_list(NOTIFY_NEW_FLUFFY_BLOCK::ID, fluffyBlob, fluffyConnections);
     }
     if (!fullConnections.empty())
     {
-      std::string fullBlob;
-      epee::serialization::store_t_to_binary(arg, fullBlob);
+      std::shared_ptr<const epee::byte_segments> fullBlob = epee::serialization::store_t_to_segments(arg);
       m_p2p->relay_notify_to_list(NOTIFY_NEW_BLOCK::ID, fullBlob, fullConnections);
     }
 
@@ -1721,12 +2082,91 @@ skip:
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
+  bool t_cryptonote_protocol_handler<t_core>::make_compact_block(const NOTIFY_NEW_BLOCK::request& arg, const std::vector<uint64_t> &prefill_tx_indices, NOTIFY_NEW_COMPACT_BLOCK::request& compact_arg) const
+  {
+    block b;
+    if (!parse_and_validate_block_from_blob(arg.b.block, b) || b.tx_hashes.size() != arg.b.txs.size())
+    {
+      MERROR("Failed to make compact block, relaying it as a fluffy block");
+      return false;
+    }
+    compact_arg.block_hash = get_block_hash(b);
+    compact_arg.current_blockchain_height = arg.current_blockchain_height;
+
+    // the tx hashes are what we replace with short ids, the miner tx stays
+    std::vector<crypto::hash> tx_hashes;
+    tx_hashes.swap(b.tx_hashes);
+    b.invalidate_hashes();
+    compact_arg.block = block_to_blob(b);
+    compact_arg.nonce = crypto::rand<uint64_t>();
+    const crypto::hash key = get_compact_block_key(compact_arg.block, compact_arg.nonce);
+
+    std::vector<bool> prefill(tx_hashes.size(), false);
+    for (uint64_t tx_idx: prefill_tx_indices)
+      if (tx_idx < prefill.size())
+        prefill[tx_idx] = true;
+    for (size_t tx_idx = 0; tx_idx < tx_hashes.size(); ++tx_idx)
+    {
+      if (prefill[tx_idx])
+      {
+        compact_arg.prefilled_tx_indices.push_back(tx_idx);
+        compact_arg.prefilled_txs.push_back(arg.b.txs[tx_idx]);
+      }
+      else
+      {
+        add_short_tx_id(compact_arg.short_ids, get_short_tx_id(key, tx_hashes[tx_idx]));
+      }
+    }
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
   bool t_cryptonote_protocol_handler<t_core>::relay_transactions(NOTIFY_NEW_TRANSACTIONS::request& arg, cryptonote_connection_context& exclude_context)
   {
     // no check for success, so tell core they're relayed unconditionally
     for(auto tx_blob_it = arg.txs.begin(); tx_blob_it!=arg.txs.end(); ++tx_blob_it)
       m_core.on_transaction_relayed(*tx_blob_it);
-    return relay_post_notify<NOTIFY_NEW_TRANSACTIONS>(arg, exclude_context);
+
+    // peers which reconcile txes get them in their next round, others now
+    std::list<boost::uuids::uuid> floodConnections;
+    std::vector<boost::uuids::uuid> reconcileConnections;
+    m_p2p->for_each_connection([&exclude_context, &floodConnections, &reconcileConnections](connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)
+    {
+      if (peer_id && exclude_context.m_connection_id != context.m_connection_id)
+      {
+        if (support_flags & P2P_SUPPORT_FLAG_TX_RECONCILIATION)
+          reconcileConnections.push_back(context.m_connection_id);
+        else
+          floodConnections.push_back(context.m_connection_id);
+      }
+      return true;
+    });
+
+    if (!reconcileConnections.empty())
+    {
+      std::vector<tx_reconciler::tx_ptr> txs;
+      txs.reserve(arg.txs.size());
+      for (const blobdata &tx_blob: arg.txs)
+      {
+        transaction tx;
+        crypto::hash tx_prefix_hash;
+        std::shared_ptr<tx_reconciler::tx> rtx = std::make_shared<tx_reconciler::tx>();
+        if (!parse_and_validate_tx_from_blob(tx_blob, tx, rtx->txid, tx_prefix_hash))
+        {
+          MERROR("Failed to parse relayed transaction");
+          continue;
+        }
+        rtx->blob = tx_blob;
+        txs.push_back(std::move(rtx));
+      }
+      m_tx_reconciler.add_txs(reconcileConnections, txs);
+    }
+    if (!floodConnections.empty())
+    {
+      std::shared_ptr<const epee::byte_segments> txBlob = epee::serialization::store_t_to_segments(arg);
+      m_p2p->relay_notify_to_list(NOTIFY_NEW_TRANSACTIONS::ID, txBlob, floodConnections);
+    }
+    return true;
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
@@ -1760,6 +2200,8 @@ skip:
     }
 
     m_block_queue.flush_spans(context.m_connection_id, false);
+    m_span_scheduler.remove_connection(context.m_connection_id);
+    m_tx_reconciler.remove_connection(context.m_connection_id);
   }
 
   //------------------------------------------------------------------------------------------------------------------------
@@ -0,0 +1,145 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <boost/uuid/uuid_io.hpp>
+#include "misc_log_ex.h"
+#include "span_scheduler.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "cn.span_scheduler"
+
+// weight of a new throughput/block size sample in the running averages
+#define SPAN_SCHEDULER_SMOOTHING 0.25
+// a span should take at least this long to transfer...
+#define SPAN_MIN_TRANSFER_TIME 1.0 // seconds
+// ... and at least this many round trips, so latency is amortized
+#define SPAN_LATENCY_MULTIPLE 8
+#define SPAN_MAX_BYTES (32*1024*1024)
+#define SPAN_MAX_BLOCKS 1000
+// latency samples are filtered to track the lower bound: they drop
+// at once, but rise slowly, since replies to requests we do not time
+// carry processing time on the other side
+#define SPAN_LATENCY_RISE 0.1
+
+namespace cryptonote
+{
+
+void span_scheduler::add_latency_sample(const boost::uuids::uuid &connection_id, double seconds, size_t bytes)
+{
+  boost::unique_lock<boost::mutex> lock(m_mutex);
+  peer &p = m_peers[connection_id];
+  if (p.has_throughput && p.throughput > 0)
+    seconds -= bytes / p.throughput;
+  seconds = std::max(seconds, 0.0);
+  if (!p.has_latency || seconds < p.latency)
+    p.latency = seconds;
+  else
+    p.latency += (seconds - p.latency) * SPAN_LATENCY_RISE;
+  p.has_latency = true;
+  MDEBUG("Latency for " << connection_id << ": " << p.latency << " s");
+}
+
+void span_scheduler::add_span_sample(const boost::uuids::uuid &connection_id, double seconds, size_t bytes, uint64_t nblocks)
+{
+  if (nblocks == 0 || bytes == 0)
+    return;
+  boost::unique_lock<boost::mutex> lock(m_mutex);
+  peer &p = m_peers[connection_id];
+
+  // keep at least part of the time as transfer time, as a latency
+  // estimate taken on a quiet link may be above what we see now
+  double transfer = seconds;
+  if (p.has_latency)
+    transfer = std::max(seconds - p.latency, seconds / 4);
+  const double throughput = bytes / std::max(transfer, 1e-3);
+  p.throughput = p.has_throughput ? p.throughput + (throughput - p.throughput) * SPAN_SCHEDULER_SMOOTHING : throughput;
+  p.has_throughput = true;
+
+  const double block_size = bytes / (double)nblocks;
+  m_block_size = m_block_size > 0 ? m_block_size + (block_size - m_block_size) * SPAN_SCHEDULER_SMOOTHING : block_size;
+  MDEBUG("Throughput for " << connection_id << ": " << p.throughput / 1e3 << " kB/s, average block size " << m_block_size);
+}
+
+void span_scheduler::remove_connection(const boost::uuids::uuid &connection_id)
+{
+  boost::unique_lock<boost::mutex> lock(m_mutex);
+  m_peers.erase(connection_id);
+}
+
+uint64_t span_scheduler::get_span_blocks(const boost::uuids::uuid &connection_id, uint64_t default_blocks) const
+{
+  boost::unique_lock<boost::mutex> lock(m_mutex);
+  const auto i = m_peers.find(connection_id);
+  if (i == m_peers.end() || !i->second.has_throughput || m_block_size <= 0)
+    return default_blocks;
+  const peer &p = i->second;
+
+  const double latency = p.has_latency ? p.latency : 0.0;
+  const double transfer_time = std::max<double>(SPAN_MIN_TRANSFER_TIME, SPAN_LATENCY_MULTIPLE * latency);
+  const double bytes = std::min<double>(p.throughput * transfer_time, SPAN_MAX_BYTES);
+  const uint64_t nblocks = std::max<uint64_t>(1, std::min<uint64_t>(bytes / m_block_size, SPAN_MAX_BLOCKS));
+  MDEBUG("Span size for " << connection_id << ": " << nblocks << " blocks, " << bytes / 1e3 << " kB");
+  return nblocks;
+}
+
+uint64_t span_scheduler::get_expected_bytes(uint64_t nblocks) const
+{
+  boost::unique_lock<boost::mutex> lock(m_mutex);
+  return nblocks * m_block_size;
+}
+
+double span_scheduler::get_expected_duration(const boost::uuids::uuid &connection_id, uint64_t nblocks) const
+{
+  boost::unique_lock<boost::mutex> lock(m_mutex);
+  const auto i = m_peers.find(connection_id);
+  if (i == m_peers.end() || !i->second.has_throughput || i->second.throughput <= 0 || m_block_size <= 0)
+    return -1.0;
+  const peer &p = i->second;
+  return (p.has_latency ? p.latency : 0.0) + nblocks * m_block_size / p.throughput;
+}
+
+double span_scheduler::get_throughput(const boost::uuids::uuid &connection_id) const
+{
+  const auto i = m_peers.find(connection_id);
+  if (i == m_peers.end() || !i->second.has_throughput)
+    return 0.0;
+  return i->second.throughput;
+}
+
+bool span_scheduler::is_fastest(const boost::uuids::uuid &connection_id, const std::vector<boost::uuids::uuid> &candidates) const
+{
+  boost::unique_lock<boost::mutex> lock(m_mutex);
+  const double throughput = get_throughput(connection_id);
+  for (const auto &id: candidates)
+    if (id != connection_id && get_throughput(id) > throughput)
+      return false;
+  return true;
+}
+
+}
@@ -0,0 +1,91 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <boost/thread/mutex.hpp>
+#include <boost/uuid/uuid.hpp>
+#include <boost/functional/hash.hpp>
+
+namespace cryptonote
+{
+  /* Sizes block span requests from what each peer was measured to deliver.
+   *
+   * Each peer gets a latency estimate, from the replies to small requests,
+   * and a throughput estimate, from the block spans it sent, with the
+   * latency taken out. A span is then sized so it takes long enough to
+   * transfer that the round trip is only a small part of the request, in
+   * bytes, and turned into a number of blocks using the average size of
+   * the blocks seen so far.
+   */
+  class span_scheduler
+  {
+  public:
+    span_scheduler(): m_block_size(0) {}
+
+    void add_latency_sample(const boost::uuids::uuid &connection_id, double seconds, size_t bytes);
+    void add_span_sample(const boost::uuids::uuid &connection_id, double seconds, size_t bytes, uint64_t nblocks);
+    void remove_connection(const boost::uuids::uuid &connection_id);
+
+    /* Number of blocks to ask from that peer, or default_blocks if it was
+     * not measured yet.
+     */
+    uint64_t get_span_blocks(const boost::uuids::uuid &connection_id, uint64_t default_blocks) const;
+
+    /* Expected size of that many blocks, or 0 if no block was seen yet.
+     */
+    uint64_t get_expected_bytes(uint64_t nblocks) const;
+
+    /* Expected time for that peer to send that many blocks, or a negative
+     * value if it was not measured yet.
+     */
+    double get_expected_duration(const boost::uuids::uuid &connection_id, uint64_t nblocks) const;
+
+    /* Whether no peer among the candidates was measured faster than that one.
+     */
+    bool is_fastest(const boost::uuids::uuid &connection_id, const std::vector<boost::uuids::uuid> &candidates) const;
+
+  private:
+    struct peer
+    {
+      double latency;
+      double throughput;
+      bool has_latency;
+      bool has_throughput;
+    };
+
+    double get_throughput(const boost::uuids::uuid &connection_id) const;
+
+  private:
+    std::unordered_map<boost::uuids::uuid, peer, boost::hash<boost::uuids::uuid>> m_peers;
+    double m_block_size;
+    mutable boost::mutex m_mutex;
+  };
+}
@@ -0,0 +1,236 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <string.h>
+#include <algorithm>
+#include <unordered_set>
+#include "common/int-util.h"
+#include "misc_log_ex.h"
+#include "tx_reconciler.h"
+
+#undef MONERO_DEFAULT_LOG_CATEGORY
+#define MONERO_DEFAULT_LOG_CATEGORY "cn.tx_reconciler"
+
+// peers which do not reconcile with us get no more than that queued
+#define TX_RECONCILIATION_MAX_QUEUED 8192
+// decoding is quadratic in the capacity, past that we fall back to
+// exchanging every short id
+#define TX_SKETCH_MAX_CAPACITY 128
+// expected part of the smaller round which the other side lacks
+#define TX_SKETCH_DIFFERENCE_RATIO 0.25
+#define TX_SKETCH_MIN_CAPACITY 8
+
+namespace cryptonote
+{
+  //---------------------------------------------------------------------------
+  uint32_t get_relay_short_id(uint64_t salt, const crypto::hash &txid)
+  {
+    char data[sizeof(salt) + sizeof(txid)];
+    salt = SWAP64LE(salt);
+    memcpy(data, &salt, sizeof(salt));
+    memcpy(data + sizeof(salt), &txid, sizeof(txid));
+    const crypto::hash h = crypto::cn_fast_hash(data, sizeof(data));
+    uint32_t short_id;
+    memcpy(&short_id, &h, sizeof(short_id));
+    short_id = SWAP32LE(short_id);
+    // 0 can't be in a sketch
+    return short_id ? short_id : 1;
+  }
+  //---------------------------------------------------------------------------
+  size_t tx_reconciler::get_sketch_capacity(size_t local_size, size_t remote_size)
+  {
+    if (local_size == 0 && remote_size == 0)
+      return 0;
+    const size_t difference = local_size > remote_size ? local_size - remote_size : remote_size - local_size;
+    return difference + (size_t)(std::min(local_size, remote_size) * TX_SKETCH_DIFFERENCE_RATIO) + TX_SKETCH_MIN_CAPACITY;
+  }
+  //---------------------------------------------------------------------------
+  void tx_reconciler::add_txs(const std::vector<boost::uuids::uuid> &connection_ids, const std::vector<tx_ptr> &txs)
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    for (const boost::uuids::uuid &connection_id: connection_ids)
+    {
+      std::vector<tx_ptr> &queued = m_peers[connection_id].queued;
+      for (const tx_ptr &tx: txs)
+      {
+        if (queued.size() >= TX_RECONCILIATION_MAX_QUEUED)
+          break;
+        queued.push_back(tx);
+      }
+    }
+  }
+  //---------------------------------------------------------------------------
+  void tx_reconciler::remove_connection(const boost::uuids::uuid &connection_id)
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    m_peers.erase(connection_id);
+  }
+  //---------------------------------------------------------------------------
+  size_t tx_reconciler::start_round(const boost::uuids::uuid &connection_id, uint64_t salt)
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    peer &p = m_peers[connection_id];
+    std::swap(p.previous, p.current);
+    p.current.salt = salt;
+    p.current.txes.clear();
+
+    // a tx whose short id is already taken waits for the next round,
+    // where the salt differs
+    std::vector<tx_ptr> queued;
+    queued.swap(p.queued);
+    for (tx_ptr &tx: queued)
+    {
+      const uint32_t short_id = get_relay_short_id(salt, tx->txid);
+      auto i = p.current.txes.find(short_id);
+      if (i == p.current.txes.end())
+        p.current.txes.insert(std::make_pair(short_id, std::move(tx)));
+      else if (i->second->txid != tx->txid)
+        p.queued.push_back(std::move(tx));
+    }
+    return p.current.txes.size();
+  }
+  //---------------------------------------------------------------------------
+  bool tx_reconciler::get_sketch(const boost::uuids::uuid &connection_id, size_t remote_size, tx_sketch &sketch) const
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    auto i = m_peers.find(connection_id);
+    const size_t local_size = i == m_peers.end() ? 0 : i->second.current.txes.size();
+    const size_t capacity = get_sketch_capacity(local_size, remote_size);
+    if (capacity > TX_SKETCH_MAX_CAPACITY)
+      return false;
+    sketch = tx_sketch(capacity);
+    if (i != m_peers.end())
+      for (const auto &e: i->second.current.txes)
+        sketch.add(e.first);
+    return true;
+  }
+  //---------------------------------------------------------------------------
+  bool tx_reconciler::is_sketch_capacity_valid(const boost::uuids::uuid &connection_id, uint64_t salt, size_t capacity, size_t remote_size) const
+  {
+    if (capacity > TX_SKETCH_MAX_CAPACITY)
+      return false;
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    const round *r = find_round(connection_id, salt);
+    const size_t local_size = r ? r->txes.size() : 0;
+    return capacity <= get_sketch_capacity(local_size, remote_size);
+  }
+  //---------------------------------------------------------------------------
+  bool tx_reconciler::reconcile(const boost::uuids::uuid &connection_id, uint64_t salt, const tx_sketch &remote_sketch, size_t remote_size,
+      std::vector<uint32_t> &local_only, std::vector<uint32_t> &remote_only) const
+  {
+    local_only.clear();
+    remote_only.clear();
+
+    std::unordered_set<uint32_t> local_ids;
+    {
+      boost::unique_lock<boost::mutex> lock(m_mutex);
+      const round *r = find_round(connection_id, salt);
+      if (r)
+        for (const auto &e: r->txes)
+          local_ids.insert(e.first);
+    }
+    if (remote_sketch.capacity() > TX_SKETCH_MAX_CAPACITY || remote_sketch.capacity() > get_sketch_capacity(local_ids.size(), remote_size))
+    {
+      MDEBUG("Tx sketch of capacity " << remote_sketch.capacity() << " is too large for " << local_ids.size() << "/" << remote_size << " txes");
+      return false;
+    }
+    if (remote_sketch.capacity() == 0)
+      return local_ids.empty() && remote_size == 0;
+    tx_sketch sketch(remote_sketch.capacity());
+    for (uint32_t short_id: local_ids)
+      sketch.add(short_id);
+
+    // decoding is slow enough not to hold the lock over it
+    sketch.merge(remote_sketch);
+    std::vector<uint32_t> difference;
+    if (!sketch.decode(difference))
+    {
+      MDEBUG("Failed to decode tx sketch of capacity " << remote_sketch.capacity() << ", " << local_ids.size() << "/" << remote_size << " txes");
+      return false;
+    }
+    for (uint32_t short_id: difference)
+    {
+      if (local_ids.find(short_id) != local_ids.end())
+        local_only.push_back(short_id);
+      else
+        remote_only.push_back(short_id);
+    }
+    return true;
+  }
+  //---------------------------------------------------------------------------
+  const tx_reconciler::round *tx_reconciler::find_round(const boost::uuids::uuid &connection_id, uint64_t salt) const
+  {
+    auto i = m_peers.find(connection_id);
+    if (i == m_peers.end())
+      return NULL;
+    if (i->second.current.salt == salt)
+      return &i->second.current;
+    if (i->second.previous.salt == salt)
+      return &i->second.previous;
+    return NULL;
+  }
+  //---------------------------------------------------------------------------
+  bool tx_reconciler::has_round(const boost::uuids::uuid &connection_id, uint64_t salt) const
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    return find_round(connection_id, salt) != NULL;
+  }
+  //---------------------------------------------------------------------------
+  std::vector<uint32_t> tx_reconciler::get_short_ids(const boost::uuids::uuid &connection_id, uint64_t salt) const
+  {
+    boost::unique_lock<boost::mutex> lock(m_mutex);
+    std::vector<uint32_t> short_ids;
+    const round *r = find_round(connection_id, salt);
+    if (r)
+    {
+      short_ids.reserve(r->txes.size());
+      for (const auto &e: r->txes)
+        short_ids.push_back(e.first);
+    }
+    return short_ids;
+  }
+  //---------------------------------------------------------------------------
+  void tx_reconciler::get_txs(const boost::uuids::uuid &connection_id, uint64_t salt, const std::vector<uint32_t> &short_ids, std::vector<blobdata> &txs) const
+  {
+    std::vector<tx_ptr> found;
+    {
+      boost::unique_lock<boost::mutex> lock(m_mutex);
+      const round *r = find_round(connection_id, salt);
+      if (!r)
+        return;
+      for (uint32_t short_id: short_ids)
+      {
+        auto i = r->txes.find(short_id);
+        if (i != r->txes.end())
+          found.push_back(i->second);
+      }
+    }
+    for (const tx_ptr &tx: found)
+      txs.push_back(tx->blob);
+  }
+}
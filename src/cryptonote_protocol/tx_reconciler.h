@@ -0,0 +1,116 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <boost/thread/mutex.hpp>
+#include <boost/uuid/uuid.hpp>
+#include <boost/functional/hash.hpp>
+#include "crypto/hash.h"
+#include "cryptonote_basic/blobdatatype.h"
+#include "tx_sketch.h"
+
+namespace cryptonote
+{
+  uint32_t get_relay_short_id(uint64_t salt, const crypto::hash &txid);
+
+  /* Keeps the txes we have to relay to each peer which reconciles txes,
+   * instead of having them flooded.
+   *
+   * Txes are queued per peer as they come, and moved into a round when
+   * the peer and us next reconcile, with short ids salted for that round.
+   * The side which started the connection asks for a sketch of the other
+   * side's round, and merges it with its own to find which short ids only
+   * one of them has. Those are then announced, and only the txes missing
+   * from the other side's pool are fetched. The previous round is kept,
+   * so late requests for it can still be served.
+   */
+  class tx_reconciler
+  {
+  public:
+    struct tx
+    {
+      crypto::hash txid;
+      blobdata blob;
+    };
+    typedef std::shared_ptr<const tx> tx_ptr;
+
+    void add_txs(const std::vector<boost::uuids::uuid> &connection_ids, const std::vector<tx_ptr> &txs);
+    void remove_connection(const boost::uuids::uuid &connection_id);
+
+    /* Moves the txes queued for that peer into a new round, and returns
+     * how many there are.
+     */
+    size_t start_round(const boost::uuids::uuid &connection_id, uint64_t salt);
+
+    /* Sketch of the current round, large enough to reconcile with a peer
+     * whose round has remote_size txes, or false if it would be too large
+     * to decode.
+     */
+    bool get_sketch(const boost::uuids::uuid &connection_id, size_t remote_size, tx_sketch &sketch) const;
+
+    /* Whether a sketch the peer sent for that round is no larger than
+     * the one get_sketch would have made for it, since the decoding cost
+     * grows with the square of the capacity.
+     */
+    bool is_sketch_capacity_valid(const boost::uuids::uuid &connection_id, uint64_t salt, size_t capacity, size_t remote_size) const;
+
+    /* Short ids which are in only one of that round and the peer's, or
+     * false if the sketch is too large or could not be decoded.
+     */
+    bool reconcile(const boost::uuids::uuid &connection_id, uint64_t salt, const tx_sketch &remote_sketch, size_t remote_size,
+        std::vector<uint32_t> &local_only, std::vector<uint32_t> &remote_only) const;
+
+    bool has_round(const boost::uuids::uuid &connection_id, uint64_t salt) const;
+    std::vector<uint32_t> get_short_ids(const boost::uuids::uuid &connection_id, uint64_t salt) const;
+    void get_txs(const boost::uuids::uuid &connection_id, uint64_t salt, const std::vector<uint32_t> &short_ids, std::vector<blobdata> &txs) const;
+
+    static size_t get_sketch_capacity(size_t local_size, size_t remote_size);
+
+  private:
+    struct round
+    {
+      uint64_t salt;
+      std::unordered_map<uint32_t, tx_ptr> txes;
+    };
+    struct peer
+    {
+      std::vector<tx_ptr> queued;
+      round current;
+      round previous;
+    };
+
+    const round *find_round(const boost::uuids::uuid &connection_id, uint64_t salt) const;
+
+    mutable boost::mutex m_mutex;
+    std::unordered_map<boost::uuids::uuid, peer, boost::hash<boost::uuids::uuid>> m_peers;
+  };
+}
@@ -0,0 +1,297 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include "tx_sketch.h"
+
+// GF(2^32) is built on x^32 + x^7 + x^3 + x^2 + 1
+#define TX_SKETCH_FIELD_BITS 32
+
+namespace
+{
+  typedef std::vector<uint32_t> poly; // lowest degree first, no leading zeroes
+
+  // multiplies by a fixed a: the carry-less product is taken four bits
+  // of the other operand at a time, from a table of multiples of a
+  class gf_multiplier
+  {
+  public:
+    gf_multiplier(uint32_t a)
+    {
+      t[0] = 0;
+      t[1] = a;
+      for (int i = 2; i < 16; i += 2)
+      {
+        t[i] = t[i / 2] << 1;
+        t[i + 1] = t[i] ^ a;
+      }
+    }
+
+    uint32_t operator()(uint32_t b) const
+    {
+      uint64_t r = 0;
+      for (int i = 0; i < TX_SKETCH_FIELD_BITS; i += 4)
+        r ^= t[(b >> i) & 15] << i;
+
+      // fold the high half back twice, x^32 being x^7 + x^3 + x^2 + 1
+      for (int i = 0; i < 2; ++i)
+      {
+        const uint64_t h = r >> TX_SKETCH_FIELD_BITS;
+        r = (r & 0xffffffff) ^ h ^ (h << 2) ^ (h << 3) ^ (h << 7);
+      }
+      return r;
+    }
+
+  private:
+    uint64_t t[16];
+  };
+
+  uint32_t gf_mul(uint32_t a, uint32_t b)
+  {
+    return gf_multiplier(a)(b);
+  }
+
+  uint32_t gf_inv(uint32_t a)
+  {
+    // a^(2^32-2), as the product of a^2, a^4, ... a^(2^31)
+    uint32_t r = 1;
+    for (int i = 1; i < TX_SKETCH_FIELD_BITS; ++i)
+    {
+      a = gf_mul(a, a);
+      r = gf_mul(r, a);
+    }
+    return r;
+  }
+
+  void trim(poly &p)
+  {
+    while (!p.empty() && p.back() == 0)
+      p.pop_back();
+  }
+
+  void make_monic(poly &p)
+  {
+    const uint32_t inv = gf_inv(p.back());
+    for (uint32_t &c: p)
+      c = gf_mul(c, inv);
+  }
+
+  // reduces a modulo the monic m, and returns the quotient if needed
+  void poly_mod(poly &a, const poly &m, poly *quotient = NULL)
+  {
+    const size_t dm = m.size() - 1;
+    if (quotient)
+      quotient->assign(a.size() > dm ? a.size() - dm : 0, 0);
+    for (size_t i = a.size(); i-- > dm; )
+    {
+      const uint32_t c = a[i];
+      if (!c)
+        continue;
+      if (quotient)
+        (*quotient)[i - dm] = c;
+      const gf_multiplier mc(c);
+      for (size_t j = 0; j <= dm; ++j)
+        a[i - dm + j] ^= mc(m[j]);
+    }
+    if (a.size() > dm)
+      a.resize(dm);
+    trim(a);
+  }
+
+  // squaring is linear in characteristic 2: only the coefficients get squared
+  poly poly_sqr_mod(const poly &a, const poly &m)
+  {
+    poly r(a.empty() ? 0 : 2 * a.size() - 1, 0);
+    for (size_t i = 0; i < a.size(); ++i)
+      r[2 * i] = gf_mul(a[i], a[i]);
+    poly_mod(r, m);
+    return r;
+  }
+
+  poly poly_gcd(poly a, poly b)
+  {
+    while (!b.empty())
+    {
+      make_monic(b);
+      poly_mod(a, b);
+      std::swap(a, b);
+    }
+    make_monic(a);
+    return a;
+  }
+
+  // connection polynomial of the syndromes, by Berlekamp-Massey
+  poly berlekamp_massey(const std::vector<uint32_t> &s)
+  {
+    poly c(1, 1), b(1, 1);
+    size_t l = 0, m = 1;
+    uint32_t bd = 1;
+    for (size_t n = 0; n < s.size(); ++n)
+    {
+      uint32_t d = s[n];
+      for (size_t i = 1; i <= l && i < c.size(); ++i)
+        d ^= gf_mul(c[i], s[n - i]);
+      if (d == 0)
+      {
+        ++m;
+        continue;
+      }
+      const uint32_t coef = gf_mul(d, gf_inv(bd));
+      const poly t = c;
+      if (c.size() < b.size() + m)
+        c.resize(b.size() + m, 0);
+      const gf_multiplier mcoef(coef);
+      for (size_t i = 0; i < b.size(); ++i)
+        c[i + m] ^= mcoef(b[i]);
+      if (2 * l <= n)
+      {
+        l = n + 1 - l;
+        b = t;
+        bd = d;
+        m = 1;
+      }
+      else
+      {
+        ++m;
+      }
+    }
+    c.resize(l + 1, 0);
+    return c;
+  }
+
+  // roots of a monic polynomial known to split into distinct linear factors,
+  // found by splitting it with the traces of r.z, for r over a basis
+  bool find_roots(const poly &f, std::vector<uint32_t> &roots)
+  {
+    if (f.size() == 1)
+      return true;
+    if (f.size() == 2)
+    {
+      roots.push_back(f[0]);
+      return true;
+    }
+    for (int k = 0; k < TX_SKETCH_FIELD_BITS; ++k)
+    {
+      poly t(2, 0);
+      t[1] = 1u << k;
+      poly_mod(t, f);
+      poly trace = t;
+      for (int i = 1; i < TX_SKETCH_FIELD_BITS; ++i)
+      {
+        t = poly_sqr_mod(t, f);
+        if (trace.size() < t.size())
+          trace.resize(t.size(), 0);
+        for (size_t j = 0; j < t.size(); ++j)
+          trace[j] ^= t[j];
+      }
+      trim(trace);
+      if (trace.empty())
+        continue;
+      const poly g = poly_gcd(f, trace);
+      if (g.size() <= 1 || g.size() >= f.size())
+        continue;
+      poly rest = f, q;
+      poly_mod(rest, g, &q);
+      return find_roots(g, roots) && find_roots(q, roots);
+    }
+    return false;
+  }
+}
+
+namespace cryptonote
+{
+  //---------------------------------------------------------------------------
+  void tx_sketch::add(uint32_t element)
+  {
+    const gf_multiplier sqr(gf_mul(element, element));
+    uint32_t p = element;
+    for (uint32_t &s: m_syndromes)
+    {
+      s ^= p;
+      p = sqr(p);
+    }
+  }
+  //---------------------------------------------------------------------------
+  void tx_sketch::merge(const tx_sketch &other)
+  {
+    m_syndromes.resize(std::min(m_syndromes.size(), other.m_syndromes.size()));
+    for (size_t i = 0; i < m_syndromes.size(); ++i)
+      m_syndromes[i] ^= other.m_syndromes[i];
+  }
+  //---------------------------------------------------------------------------
+  bool tx_sketch::decode(std::vector<uint32_t> &elements) const
+  {
+    elements.clear();
+
+    // the even power sums are the squares of the lower ones
+    const size_t capacity = m_syndromes.size();
+    std::vector<uint32_t> s(2 * capacity);
+    for (size_t i = 0; i < capacity; ++i)
+    {
+      s[2 * i] = m_syndromes[i];
+      s[2 * i + 1] = gf_mul(s[i], s[i]);
+    }
+
+    const poly c = berlekamp_massey(s);
+    const size_t l = c.size() - 1;
+    if (l == 0)
+      return true;
+    if (l > capacity || c[l] == 0)
+      return false;
+
+    // the elements are the roots of the reversed polynomial, which must
+    // divide z^(2^32) - z, ie have as many distinct roots as its degree
+    poly f(c.rbegin(), c.rend());
+    poly z(2, 0);
+    z[1] = 1;
+    poly t = z;
+    poly_mod(z, f);
+    poly_mod(t, f);
+    for (int i = 0; i < TX_SKETCH_FIELD_BITS; ++i)
+      t = poly_sqr_mod(t, f);
+    if (t != z)
+      return false;
+
+    if (!find_roots(f, elements) || elements.size() != l)
+    {
+      elements.clear();
+      return false;
+    }
+
+    // a difference larger than the capacity can decode to a wrong set
+    tx_sketch check(capacity);
+    for (uint32_t e: elements)
+      check.add(e);
+    if (check.m_syndromes != m_syndromes)
+    {
+      elements.clear();
+      return false;
+    }
+    return true;
+  }
+}
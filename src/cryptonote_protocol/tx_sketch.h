@@ -0,0 +1,68 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace cryptonote
+{
+  /* A PinSketch of a set of 32 bit short ids, for set reconciliation.
+   *
+   * The sketch of capacity c holds the odd power sums x, x^3, ... x^(2c-1)
+   * of its elements, in GF(2^32). Adding an element twice removes it, so
+   * merging two sketches leaves the sketch of the symmetric difference of
+   * their sets, which can be decoded as long as it has at most c elements,
+   * whatever the size of the sets themselves. A sketch truncated to fewer
+   * power sums is the sketch of lower capacity of the same set.
+   *
+   * Elements must not be 0.
+   */
+  class tx_sketch
+  {
+  public:
+    tx_sketch(size_t capacity = 0): m_syndromes(capacity, 0) {}
+    tx_sketch(const std::vector<uint32_t> &syndromes): m_syndromes(syndromes) {}
+
+    size_t capacity() const { return m_syndromes.size(); }
+    const std::vector<uint32_t> &get_syndromes() const { return m_syndromes; }
+
+    void add(uint32_t element);
+    void merge(const tx_sketch &other);
+
+    /* Recovers the elements, or returns false if there are more of them
+     * than the capacity.
+     */
+    bool decode(std::vector<uint32_t> &elements) const;
+
+  private:
+    std::vector<uint32_t> m_syndromes;
+  };
+}
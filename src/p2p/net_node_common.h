@@ -44,9 +44,11 @@ namespace nodetool
   struct i_p2p_endpoint
   {
     virtual bool relay_notify_to_list(int command, const std::string& data_buff, const std::list<boost::uuids::uuid>& connections)=0;
+    virtual bool relay_notify_to_list(int command, const std::shared_ptr<const epee::byte_segments>& data_buff, const std::list<boost::uuids::uuid>& connections)=0;
     virtual bool relay_notify_to_all(int command, const std::string& data_buff, const epee::net_utils::connection_context_base& context)=0;
     virtual bool invoke_command_to_peer(int command, const std::string& req_buff, std::string& resp_buff, const epee::net_utils::connection_context_base& context)=0;
     virtual bool invoke_notify_to_peer(int command, const std::string& req_buff, const epee::net_utils::connection_context_base& context)=0;
+    virtual bool invoke_notify_to_peer(int command, const std::shared_ptr<const epee::byte_segments>& req_buff, const epee::net_utils::connection_context_base& context)=0;
     virtual bool drop_connection(const epee::net_utils::connection_context_base& context)=0;
     virtual void request_callback(const epee::net_utils::connection_context_base& context)=0;
     virtual uint64_t get_connections_count()=0;
@@ -65,6 +67,10 @@ namespace nodetool
     {
       return false;
     }
+    virtual bool relay_notify_to_list(int command, const std::shared_ptr<const epee::byte_segments>& data_buff, const std::list<boost::uuids::uuid>& connections)
+    {
+      return false;
+    }
     virtual bool relay_notify_to_all(int command, const std::string& data_buff, const epee::net_utils::connection_context_base& context)
     {
       return false;
@@ -77,6 +83,10 @@ namespace nodetool
     {
       return true;
     }
+    virtual bool invoke_notify_to_peer(int command, const std::shared_ptr<const epee::byte_segments>& req_buff, const epee::net_utils::connection_context_base& context)
+    {
+      return true;
+    }
     virtual bool drop_connection(const epee::net_utils::connection_context_base& context)
     {
       return false;
@@ -63,6 +63,18 @@ namespace
       reasons += ", ";
     reasons += reason;
   }
+
+  // the cacheable part of a get_blocks.bin response
+  struct get_blocks_entries
+  {
+    std::vector<cryptonote::block_complete_entry> &blocks;
+    std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &output_indices;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(blocks)
+      KV_SERIALIZE(output_indices)
+    END_KV_SERIALIZE_MAP()
+  };
 }
 
 namespace cryptonote
@@ -209,6 +221,7 @@ namespace cryptonote
     }
     res.database_size = m_core.get_blockchain_storage().get_db().get_database_size();
     res.update_available = m_core.is_update_available();
+    crypto::get_prepared_key_cache_stats(res.prepared_key_cache_hits, res.prepared_key_cache_misses);
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -222,16 +235,11 @@ namespace cryptonote
     END_SERIALIZE()
   };
   //------------------------------------------------------------------------------------------------------------------------------
-  bool core_rpc_server::on_get_blocks(const COMMAND_RPC_GET_BLOCKS_FAST::request& req, COMMAND_RPC_GET_BLOCKS_FAST::response& res)
+  bool core_rpc_server::get_blocks(const std::list<crypto::hash>& block_ids, uint64_t start_height, bool prune, bool no_miner_tx, size_t max_count, COMMAND_RPC_GET_BLOCKS_FAST::response& res)
   {
-    PERF_TIMER(on_get_blocks);
-    bool r;
-    if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_BLOCKS_FAST>(invoke_http_mode::BIN, "/getblocks.bin", req, res, r))
-      return r;
-
     std::vector<std::pair<std::pair<cryptonote::blobdata, crypto::hash>, std::vector<std::pair<crypto::hash, cryptonote::blobdata> > > > bs;
 
-    if(!m_core.find_blockchain_supplement(req.start_height, req.block_ids, bs, res.current_height, res.start_height, req.prune, !req.no_miner_tx, COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT))
+    if(!m_core.find_blockchain_supplement(start_height, block_ids, bs, res.current_height, res.start_height, prune, !no_miner_tx, max_count))
     {
       res.status = "Failed";
       return false;
@@ -248,7 +256,7 @@ namespace cryptonote
       unpruned_size += bd.first.first.size();
       res.output_indices.push_back(COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices());
       res.output_indices.back().indices.push_back(COMMAND_RPC_GET_BLOCKS_FAST::tx_output_indices());
-      if (!req.no_miner_tx)
+      if (!no_miner_tx)
       {
         bool r = m_core.get_tx_outputs_gindexs(bd.first.second, res.output_indices.back().indices.back().indices);
         if (!r)
@@ -278,9 +286,123 @@ namespace cryptonote
       }
     }
 
-    MDEBUG("on_get_blocks: " << bs.size() << " blocks, " << ntxes << " txes, pruned size " << pruned_size << ", unpruned size " << unpruned_size);
+    MDEBUG("get_blocks: " << bs.size() << " blocks, " << ntxes << " txes, pruned size " << pruned_size << ", unpruned size " << unpruned_size);
     res.status = CORE_RPC_STATUS_OK;
     return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_blocks(const COMMAND_RPC_GET_BLOCKS_FAST::request& req, COMMAND_RPC_GET_BLOCKS_FAST::response& res, std::string& packed_res)
+  {
+    PERF_TIMER(on_get_blocks);
+    bool r;
+    if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_BLOCKS_FAST>(invoke_http_mode::BIN, "/getblocks.bin", req, res, r))
+      return r;
+
+    // spans short of the top are the same for every wallet syncing through them, so
+    // their blocks and output indices are kept packed and spliced into the response
+    block_response_cache& cache = m_core.get_block_response_cache();
+    const uint8_t variant = block_response_cache::variant_rpc | (req.prune ? block_response_cache::variant_pruned : 0) | (req.no_miner_tx ? block_response_cache::variant_no_miner_tx : 0);
+    const uint64_t generation = cache.get_generation();
+    uint64_t cache_start_height = 0;
+    block_response_cache::span packed;
+    if (m_core.find_blockchain_supplement(req.start_height, req.block_ids, cache_start_height) &&
+        cache.find(cache_start_height, COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT, variant, packed))
+    {
+      res.start_height = cache_start_height;
+      res.current_height = m_core.get_current_blockchain_height();
+      res.status = CORE_RPC_STATUS_OK;
+      MDEBUG("on_get_blocks: " << packed.block_count << " cached blocks from " << cache_start_height);
+      return epee::serialization::store_t_to_binary(res, packed_res, *packed.entries, packed.entry_count);
+    }
+
+    if (!get_blocks(req.block_ids, req.start_height, req.prune, req.no_miner_tx, COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT, res))
+      return false;
+
+    if (!res.blocks.empty() && res.start_height + res.blocks.size() < res.current_height)
+    {
+      get_blocks_entries entries{res.blocks, res.output_indices};
+      std::shared_ptr<std::string> buff = std::make_shared<std::string>();
+      if (epee::serialization::store_t_entries_to_binary(entries, *buff, packed.entry_count))
+      {
+        packed.entries = buff;
+        packed.block_count = res.blocks.size();
+        cache.add(res.start_height, COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT, variant, packed, generation);
+        res.blocks.clear();
+        res.output_indices.clear();
+        return epee::serialization::store_t_to_binary(res, packed_res, *packed.entries, packed.entry_count);
+      }
+    }
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_blocks_stream(const COMMAND_RPC_GET_BLOCKS_FAST::request& req, COMMAND_RPC_GET_BLOCKS_FAST::response& res, std::function<bool(COMMAND_RPC_GET_BLOCKS_FAST::response&)>& next_page)
+  {
+    PERF_TIMER(on_get_blocks_stream);
+    bool r;
+    if (use_bootstrap_daemon_if_necessary<COMMAND_RPC_GET_BLOCKS_FAST>(invoke_http_mode::BIN, "/getblocks.bin", req, res, r))
+      return r;
+
+    // the same blocks as get_blocks.bin, but only a page of them is read at a time,
+    // when the previous one has been sent
+    struct stream_state
+    {
+      std::list<crypto::hash> block_ids;
+      uint64_t next_height;
+      uint64_t blocks_left;
+      crypto::hash top_hash;
+      bool started;
+    };
+    std::shared_ptr<stream_state> state = std::make_shared<stream_state>();
+    state->block_ids = req.block_ids;
+    state->next_height = req.start_height;
+    state->blocks_left = COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT;
+    state->top_hash = crypto::null_hash;
+    state->started = false;
+    const bool prune = req.prune, no_miner_tx = req.no_miner_tx;
+    next_page = [this, state, prune, no_miner_tx](COMMAND_RPC_GET_BLOCKS_FAST::response& page) -> bool
+    {
+      if (state->blocks_left == 0)
+        return false;
+      if (state->started && state->next_height >= m_core.get_current_blockchain_height())
+        return false;
+
+      const size_t count = std::min<uint64_t>(state->blocks_left, COMMAND_RPC_GET_BLOCKS_STREAM_PAGE_COUNT);
+      if (!get_blocks(state->block_ids, state->next_height, prune, no_miner_tx, count, page))
+      {
+        state->blocks_left = 0;
+        return true;
+      }
+
+      block b;
+      if (state->started)
+      {
+        // stop where the chain changed under us, the client picks up from there next time
+        if (page.blocks.empty() || page.start_height != state->next_height)
+          return false;
+        if (!parse_and_validate_block_from_blob(page.blocks.front().block, b) || b.prev_id != state->top_hash)
+        {
+          MDEBUG("on_get_blocks_stream: chain changed at height " << state->next_height << ", ending stream");
+          return false;
+        }
+      }
+      if (!page.blocks.empty())
+      {
+        if (!parse_and_validate_block_from_blob(page.blocks.back().block, b))
+        {
+          page.status = "Failed";
+          state->blocks_left = 0;
+          return true;
+        }
+        state->top_hash = get_block_hash(b);
+      }
+
+      state->started = true;
+      state->block_ids.clear();
+      state->next_height = page.start_height + page.blocks.size();
+      state->blocks_left = page.blocks.empty() ? 0 : state->blocks_left - std::min<uint64_t>(state->blocks_left, page.blocks.size());
+      return true;
+    };
+    return true;
   }
     bool core_rpc_server::on_get_alt_blocks_hashes(const COMMAND_RPC_GET_ALT_BLOCKS_HASHES::request& req, COMMAND_RPC_GET_ALT_BLOCKS_HASHES::response& res)
     {
@@ -822,6 +944,7 @@ namespace cryptonote
     if ( lMiner.is_mining() ) {
       res.speed = lMiner.get_speed();
       res.threads_count = lMiner.get_threads_count();
+      res.threads_speed = lMiner.get_threads_speed();
       const account_public_address& lMiningAdr = lMiner.get_mining_address();
       res.address = get_account_address_as_str(m_nettype, false, lMiningAdr);
     }
@@ -1608,6 +1731,7 @@ namespace cryptonote
     }
     res.database_size = m_core.get_blockchain_storage().get_db().get_database_size();
     res.update_available = m_core.is_update_available();
+    crypto::get_prepared_key_cache_stats(res.prepared_key_cache_hits, res.prepared_key_cache_misses);
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -49,7 +49,7 @@ namespace cryptonote
 // advance which version they will stop working with
 // Don't go over 32767 for any of these
 #define CORE_RPC_VERSION_MAJOR 2
-#define CORE_RPC_VERSION_MINOR 1
+#define CORE_RPC_VERSION_MINOR 4
 #define MAKE_CORE_RPC_VERSION(major,minor) (((major)<<16)|(minor))
 #define CORE_RPC_VERSION MAKE_CORE_RPC_VERSION(CORE_RPC_VERSION_MAJOR, CORE_RPC_VERSION_MINOR)
 
@@ -927,6 +927,8 @@ struct COMMAND_RPC_IS_RNG_SPENT
       bool was_bootstrap_ever_used;
       uint64_t database_size;
       bool update_available;
+      uint64_t prepared_key_cache_hits;
+      uint64_t prepared_key_cache_misses;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(status)
@@ -961,6 +963,8 @@ struct COMMAND_RPC_IS_RNG_SPENT
         KV_SERIALIZE(was_bootstrap_ever_used)
         KV_SERIALIZE(database_size)
         KV_SERIALIZE(update_available)
+        KV_SERIALIZE_OPT(prepared_key_cache_hits, (uint64_t)0)
+        KV_SERIALIZE_OPT(prepared_key_cache_misses, (uint64_t)0)
       END_KV_SERIALIZE_MAP()
     };
   };
@@ -1004,6 +1008,7 @@ struct COMMAND_RPC_IS_RNG_SPENT
       bool active;
       uint64_t speed;
       uint32_t threads_count;
+      std::vector<uint64_t> threads_speed;
       std::string address;
       bool is_background_mining_enabled;
 
@@ -1012,6 +1017,7 @@ struct COMMAND_RPC_IS_RNG_SPENT
         KV_SERIALIZE(active)
         KV_SERIALIZE(speed)
         KV_SERIALIZE(threads_count)
+        KV_SERIALIZE(threads_speed)
         KV_SERIALIZE(address)
         KV_SERIALIZE(is_background_mining_enabled)
       END_KV_SERIALIZE_MAP()
@@ -2050,7 +2050,7 @@ void wallet2::parse_block_round(const cryptonote::blobdata &blob, cryptonote::bl
     bl_id = get_block_hash(bl);
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::pull_blocks(uint64_t start_height, uint64_t &blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<cryptonote::block_complete_entry> &blocks, std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &o_indices)
+void wallet2::pull_blocks(uint64_t start_height, uint64_t &blocks_start_height, const std::list<crypto::hash> &short_chain_history, const std::function<void(std::vector<cryptonote::block_complete_entry>&, std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices>&)> &page_handler)
 {
   cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::request req = AUTO_VAL_INIT(req);
   cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response res = AUTO_VAL_INIT(res);
@@ -2059,6 +2059,52 @@ void wallet2::pull_blocks(uint64_t start_height, uint64_t &blocks_start_height,
   req.prune = true;
   req.start_height = start_height;
   req.no_miner_tx = m_refresh_type == RefreshNoCoinbase;
+
+  uint32_t rpc_version;
+  const boost::optional<std::string> result = m_node_rpc_proxy.get_rpc_version(rpc_version);
+  if (!result && rpc_version >= MAKE_CORE_RPC_VERSION(2, 3))
+  {
+    // recent daemons send the blocks a page at a time, which we hand over as they come in
+    std::string status = CORE_RPC_STATUS_OK, internal_error;
+    size_t blocks_received = 0;
+    bool got_page = false;
+    const std::function<bool(cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response&)> on_page = [&](cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response &page) -> bool
+    {
+      if (page.status != CORE_RPC_STATUS_OK)
+      {
+        status = page.status;
+        return false;
+      }
+      if (page.blocks.size() != page.output_indices.size())
+      {
+        internal_error = "mismatched blocks (" + boost::lexical_cast<std::string>(page.blocks.size()) + ") and output_indices (" +
+            boost::lexical_cast<std::string>(page.output_indices.size()) + ") sizes from daemon";
+        return false;
+      }
+      if (!got_page)
+        blocks_start_height = page.start_height;
+      else if (page.start_height != blocks_start_height + blocks_received)
+      {
+        internal_error = "non contiguous blocks from daemon";
+        return false;
+      }
+      got_page = true;
+      blocks_received += page.blocks.size();
+      page_handler(page.blocks, page.output_indices);
+      return true;
+    };
+    bool r;
+    {
+      boost::lock_guard<boost::mutex> lock(m_daemon_rpc_mutex);
+      r = net_utils::invoke_http_bin_stream("/getblocks_stream.bin", req, on_page, m_http_client, rpc_timeout);
+    }
+    THROW_WALLET_EXCEPTION_IF(status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "getblocks_stream.bin");
+    THROW_WALLET_EXCEPTION_IF(status != CORE_RPC_STATUS_OK, error::get_blocks_error, status);
+    THROW_WALLET_EXCEPTION_IF(!internal_error.empty(), error::wallet_internal_error, internal_error);
+    THROW_WALLET_EXCEPTION_IF(!r || !got_page, error::no_connection_to_daemon, "getblocks_stream.bin");
+    return;
+  }
+
   m_daemon_rpc_mutex.lock();
   bool r = net_utils::invoke_http_bin("/getblocks.bin", req, res, m_http_client, rpc_timeout);
   m_daemon_rpc_mutex.unlock();
@@ -2070,8 +2116,7 @@ void wallet2::pull_blocks(uint64_t start_height, uint64_t &blocks_start_height,
       boost::lexical_cast<std::string>(res.output_indices.size()) + ") sizes from daemon");
 
   blocks_start_height = res.start_height;
-  blocks = std::move(res.blocks);
-  o_indices = std::move(res.output_indices);
+  page_handler(res.blocks, res.output_indices);
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::pull_hashes(uint64_t start_height, uint64_t &blocks_start_height, const std::list<crypto::hash> &short_chain_history, std::vector<crypto::hash> &hashes)
@@ -2252,20 +2297,57 @@ void wallet2::pull_and_parse_next_blocks(uint64_t start_height, uint64_t &blocks
       ++i;
     }
 
-    // pull the new blocks
+    // pull the new blocks, parsing each page while the next ones come in
     std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> o_indices;
-    pull_blocks(start_height, blocks_start_height, short_chain_history, blocks, o_indices);
-    THROW_WALLET_EXCEPTION_IF(blocks.size() != o_indices.size(), error::wallet_internal_error, "Mismatched sizes of blocks and o_indices");
-
     tools::threadpool& tpool = tools::threadpool::getInstance();
     tools::threadpool::waiter waiter;
-    parsed_blocks.resize(blocks.size());
-    for (size_t i = 0; i < blocks.size(); ++i)
+    boost::mutex error_lock;
+    blocks.clear();
+    parsed_blocks.clear();
+    blocks.reserve(COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT);
+    parsed_blocks.reserve(COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT);
+    try
     {
-      tpool.submit(&waiter, boost::bind(&wallet2::parse_block_round, this, std::cref(blocks[i].block),
-        std::ref(parsed_blocks[i].block), std::ref(parsed_blocks[i].hash), std::ref(parsed_blocks[i].error)), true);
+      pull_blocks(start_height, blocks_start_height, short_chain_history, [&](std::vector<cryptonote::block_complete_entry> &page_blocks, std::vector<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::block_output_indices> &page_o_indices)
+      {
+        const size_t first = blocks.size();
+        // parsers in flight point into blocks and parsed_blocks, which
+        // come with whatever capacity the caller left them, and the daemon
+        // may send more blocks than we reserved for
+        const size_t needed = first + page_blocks.size();
+        if (needed > blocks.capacity() || needed > parsed_blocks.capacity())
+          waiter.wait(&tpool);
+        for (auto &b: page_blocks)
+          blocks.push_back(std::move(b));
+        for (auto &o: page_o_indices)
+          o_indices.push_back(std::move(o));
+        parsed_blocks.resize(blocks.size());
+        for (size_t i = first; i < blocks.size(); ++i)
+        {
+          tpool.submit(&waiter, boost::bind(&wallet2::parse_block_round, this, std::cref(blocks[i].block),
+            std::ref(parsed_blocks[i].block), std::ref(parsed_blocks[i].hash), std::ref(parsed_blocks[i].error)), true);
+          parsed_blocks[i].txes.resize(blocks[i].txs.size());
+          for (size_t j = 0; j < blocks[i].txs.size(); ++j)
+          {
+            tpool.submit(&waiter, [&, i, j](){
+              if (!parse_and_validate_tx_base_from_blob(blocks[i].txs[j], parsed_blocks[i].txes[j]))
+              {
+                boost::unique_lock<boost::mutex> lock(error_lock);
+                error = true;
+              }
+            }, true);
+          }
+        }
+      });
+    }
+    catch (...)
+    {
+      waiter.wait(&tpool);
+      throw;
     }
     waiter.wait(&tpool);
+    THROW_WALLET_EXCEPTION_IF(blocks.size() != o_indices.size(), error::wallet_internal_error, "Mismatched sizes of blocks and o_indices");
+
     for (size_t i = 0; i < blocks.size(); ++i)
     {
       if (parsed_blocks[i].error)
@@ -2275,23 +2357,6 @@ void wallet2::pull_and_parse_next_blocks(uint64_t start_height, uint64_t &blocks
       }
       parsed_blocks[i].o_indices = std::move(o_indices[i]);
     }
-
-    boost::mutex error_lock;
-    for (size_t i = 0; i < blocks.size(); ++i)
-    {
-      parsed_blocks[i].txes.resize(blocks[i].txs.size());
-      for (size_t j = 0; j < blocks[i].txs.size(); ++j)
-      {
-        tpool.submit(&waiter, [&, i, j](){
-          if (!parse_and_validate_tx_base_from_blob(blocks[i].txs[j], parsed_blocks[i].txes[j]))
-          {
-            boost::unique_lock<boost::mutex> lock(error_lock);
-            error = true;
-          }
-        }, true);
-      }
-    }
-    waiter.wait(&tpool);
   }
   catch(...)
   {
@@ -7364,7 +7429,7 @@ void wallet2::get_outs(std::vector<std::vector<tools::wallet2::get_outs_entry>>
 template<typename T>
 void wallet2::transfer_selected(const std::vector<cryptonote::tx_destination_entry>& dsts, const std::vector<size_t>& selected_transfers, size_t fake_outputs_count,
   std::vector<std::vector<tools::wallet2::get_outs_entry>> &outs,
-  uint64_t unlock_time, uint64_t fee, const std::vector<uint8_t>& extra, T destination_split_strategy, const tx_dust_policy& dust_policy, cryptonote::transaction& tx, pending_tx &ptx)
+  uint64_t unlock_time, uint64_t fee, const std::vector<uint8_t>& extra, T destination_split_strategy, const tx_dust_policy& dust_policy, cryptonote::transaction& tx, pending_tx &ptx, uint64_t upper_transaction_weight_limit)
 {
   using namespace cryptonote;
   // throw if attempting a transaction with no destinations
@@ -7372,7 +7437,8 @@ void wallet2::transfer_selected(const std::vector<cryptonote::tx_destination_ent
 
   THROW_WALLET_EXCEPTION_IF(m_multisig, error::wallet_internal_error, "Multisig wallets cannot spend non rct outputs");
 
-  uint64_t upper_transaction_weight_limit = get_upper_transaction_weight_limit();
+  if (upper_transaction_weight_limit == 0)
+    upper_transaction_weight_limit = get_upper_transaction_weight_limit();
   uint64_t needed_money = fee;
   LOG_PRINT_L2("transfer: starting with fee " << print_money (needed_money));
 
@@ -7526,13 +7592,14 @@ void wallet2::transfer_selected(const std::vector<cryptonote::tx_destination_ent
 
 void wallet2::transfer_selected_rct(std::vector<cryptonote::tx_destination_entry> dsts, const std::vector<size_t>& selected_transfers, size_t fake_outputs_count,
   std::vector<std::vector<tools::wallet2::get_outs_entry>> &outs,
-  uint64_t unlock_time, uint64_t fee, const std::vector<uint8_t>& extra, cryptonote::transaction& tx, pending_tx &ptx, const rct::RCTConfig &rct_config)
+  uint64_t unlock_time, uint64_t fee, const std::vector<uint8_t>& extra, cryptonote::transaction& tx, pending_tx &ptx, const rct::RCTConfig &rct_config, uint64_t upper_transaction_weight_limit)
 {
   using namespace cryptonote;
   // throw if attempting a transaction with no destinations
   THROW_WALLET_EXCEPTION_IF(dsts.empty(), error::zero_destination);
 
-  uint64_t upper_transaction_weight_limit = get_upper_transaction_weight_limit();
+  if (upper_transaction_weight_limit == 0)
+    upper_transaction_weight_limit = get_upper_transaction_weight_limit();
   uint64_t needed_money = fee;
   LOG_PRINT_L2("transfer_selected_rct: starting with fee " << print_money (needed_money));
   LOG_PRINT_L2("selected transfers: " << strjoin(selected_transfers, " "));
@@ -8861,9 +8928,8 @@ skip_tx:
     " total fee, " << print_money(accumulated_change) << " total change");
 
   hwdev.set_mode(hw::device::TRANSACTION_CREATE_REAL);
-  for (std::vector<TX>::iterator i = txes.begin(); i != txes.end(); ++i)
+  auto build_tx = [&](TX &tx)
   {
-    TX &tx = *i;
     cryptonote::transaction test_tx;
     pending_tx test_ptx;
     if (use_rct) {
@@ -8876,7 +8942,8 @@ skip_tx:
                             extra,                      /* const std::vector<uint8_t>& extra, */
                             test_tx,                    /* OUT   cryptonote::transaction& tx, */
                             test_ptx,                   /* OUT   cryptonote::transaction& tx, */
-                            rct_config);
+                            rct_config,
+                            upper_transaction_weight_limit);
     } else {
       transfer_selected(tx.dsts,
                         tx.selected_transfers,
@@ -8888,12 +8955,37 @@ skip_tx:
                         detail::digit_split_strategy,
                         tx_dust_policy(::config::DEFAULT_DUST_THRESHOLD),
                         test_tx,
-                        test_ptx);
+                        test_ptx,
+                        upper_transaction_weight_limit);
     }
     auto txBlob = t_serializable_object_to_blob(test_ptx.tx);
     tx.tx = test_tx;
     tx.ptx = test_ptx;
     tx.weight = get_transaction_weight(test_tx, txBlob.size());
+  };
+
+  // The candidates are settled by now, and each has its outs and is given the
+  // weight limit resolved above, so building one does not reach the daemon:
+  // m_node_rpc_proxy's caches and m_http_client are not safe to use from the
+  // pool. They are built concurrently unless a hardware device or the
+  // multisig bookkeeping needs to see them one at a time
+  const bool have_all_outs = std::all_of(txes.begin(), txes.end(), [](const TX &tx) { return !tx.outs.empty(); });
+  if (txes.size() > 1 && have_all_outs && !m_multisig && hwdev.get_type() == hw::device::SOFTWARE)
+  {
+    std::vector<std::exception_ptr> errors(txes.size());
+    tools::threadpool& tpool = tools::threadpool::getInstance();
+    tools::threadpool::waiter waiter;
+    for (size_t n = 0; n < txes.size(); ++n)
+      tpool.submit(&waiter, [&, n] { try { build_tx(txes[n]); } catch (...) { errors[n] = std::current_exception(); } });
+    waiter.wait(&tpool);
+    for (const std::exception_ptr &e: errors)
+      if (e)
+        std::rethrow_exception(e);
+  }
+  else
+  {
+    for (TX &tx: txes)
+      build_tx(tx);
   }
 
   std::vector<wallet2::pending_tx> ptx_vector;
@@ -54,6 +54,7 @@ int main(int argc, char *argv[]) {
     data.clear(data.rdstate());
     uint64_t timestamp, difficulty, cumulative_difficulty = 0;
     size_t n = 0;
+    cryptonote::difficulty_window window;
     while (data >> timestamp >> difficulty) {
         size_t begin, end;
         if (n < DIFFICULTY_WINDOW + DIFFICULTY_LAG) {
@@ -72,8 +73,32 @@ int main(int argc, char *argv[]) {
                 << "Found: " << res << endl;
             return 1;
         }
+        if (window.next_difficulty(DEFAULT_TEST_DIFFICULTY_TARGET) != difficulty) {
+            cerr << "Wrong windowed difficulty for block " << n << endl
+                << "Expected: " << difficulty << endl
+                << "Found: " << window.next_difficulty(DEFAULT_TEST_DIFFICULTY_TARGET) << endl;
+            return 1;
+        }
+        // now and then, rewind the window a few blocks as a reorg would and
+        // move it forward again, which must get it back to the same state
+        if (n % 97 == 0 && n > 0) {
+            const size_t rewind = min<size_t>(n, 1 + n % 13);
+            for (size_t i = 0; i < rewind; ++i) {
+                window.pop_back();
+                const size_t height = n - 1 - i;
+                if (height >= DIFFICULTY_BLOCKS_COUNT)
+                    window.push_front(timestamps[height - (DIFFICULTY_BLOCKS_COUNT)], cumulative_difficulties[height - (DIFFICULTY_BLOCKS_COUNT)]);
+            }
+            for (size_t height = n - rewind; height < n; ++height)
+                window.push_back(timestamps[height], cumulative_difficulties[height]);
+            if (window.next_difficulty(DEFAULT_TEST_DIFFICULTY_TARGET) != difficulty) {
+                cerr << "Wrong difficulty for block " << n << " after rewinding the window" << endl;
+                return 1;
+            }
+        }
         timestamps.push_back(timestamp);
         cumulative_difficulties.push_back(cumulative_difficulty += difficulty);
+        window.push_back(timestamp, cumulative_difficulty);
         ++n;
     }
     if (!data.eof()) {
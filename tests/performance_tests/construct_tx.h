@@ -30,6 +30,10 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
+
+#include "common/threadpool.h"
 #include "cryptonote_basic/account.h"
 #include "cryptonote_basic/cryptonote_basic.h"
 #include "cryptonote_core/cryptonote_tx_utils.h"
@@ -82,3 +86,64 @@ private:
   std::vector<cryptonote::tx_destination_entry> m_destinations;
   cryptonote::transaction m_tx;
 };
+
+// Builds a_threads transactions of a_in_count inputs each at the same time, the
+// way a wallet sweeping many inputs builds its candidate transactions
+template<size_t a_in_count, size_t a_threads>
+class test_construct_tx_threads : private multi_tx_test_base<2>
+{
+  static_assert(0 < a_in_count, "in_count must be greater than 0");
+  static_assert(0 < a_threads, "threads must be greater than 0");
+
+public:
+  static const size_t loop_count = a_in_count < 100 ? 10 : 2;
+  static const size_t in_count = a_in_count;
+  static const size_t threads = a_threads;
+
+  typedef multi_tx_test_base<2> base_class;
+
+  bool init()
+  {
+    using namespace cryptonote;
+
+    if (!base_class::init())
+      return false;
+
+    m_alice.generate();
+
+    const tx_source_entry source = this->m_sources.front();
+    this->m_sources.assign(in_count, source);
+    m_destinations.push_back(tx_destination_entry(this->m_source_amount / 2, m_alice.get_keys().m_account_address, false));
+    m_destinations.push_back(tx_destination_entry(this->m_source_amount / 2, m_alice.get_keys().m_account_address, false));
+
+    m_tpool.reset(tools::threadpool::getNewForUnitTests(threads));
+    return true;
+  }
+
+  bool test()
+  {
+    std::atomic<bool> success(true);
+    tools::threadpool::waiter waiter;
+    for (size_t n = 0; n < threads; ++n)
+      m_tpool->submit(&waiter, [this, &success] { if (!construct()) success = false; });
+    waiter.wait(m_tpool.get());
+    return success;
+  }
+
+private:
+  bool construct() const
+  {
+    std::vector<cryptonote::tx_source_entry> sources = this->m_sources;
+    std::vector<cryptonote::tx_destination_entry> destinations = m_destinations;
+    cryptonote::transaction tx;
+    crypto::secret_key tx_key;
+    std::vector<crypto::secret_key> additional_tx_keys;
+    std::unordered_map<crypto::public_key, cryptonote::subaddress_index> subaddresses;
+    subaddresses[this->m_miners[this->real_source_idx].get_keys().m_account_address.m_spend_public_key] = {0,0};
+    return cryptonote::construct_tx_and_get_tx_key(this->m_miners[this->real_source_idx].get_keys(), subaddresses, sources, destinations, cryptonote::account_public_address{}, std::vector<uint8_t>(), tx, 0, tx_key, additional_tx_keys);
+  }
+
+  cryptonote::account_base m_alice;
+  std::vector<cryptonote::tx_destination_entry> m_destinations;
+  std::unique_ptr<tools::threadpool> m_tpool;
+};
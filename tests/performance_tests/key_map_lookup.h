@@ -0,0 +1,82 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <unordered_map>
+#include <vector>
+#include "crypto/crypto.h"
+#include "common/flat_hash_map.h"
+
+enum test_key_map_type
+{
+  key_map_unordered_map,
+  key_map_flat,
+};
+
+// Looks up key images in a map of nkeys, half of them present, as the
+// wallet and the block import caches do
+template<test_key_map_type type, size_t nkeys>
+class test_key_map_lookup
+{
+public:
+  static const size_t loop_count = 100;
+  static const size_t lookups = 1000;
+
+  typedef typename std::conditional<type == key_map_flat,
+      tools::flat_hash_map<crypto::key_image, size_t, crypto::fingerprint_hash<crypto::key_image>>,
+      std::unordered_map<crypto::key_image, size_t>>::type map_type;
+
+  bool init()
+  {
+    m_map.reserve(nkeys);
+    m_keys.reserve(lookups);
+    for (size_t n = 0; n < nkeys; ++n)
+    {
+      const crypto::key_image k = crypto::rand<crypto::key_image>();
+      m_map.emplace(k, n);
+      if (n < lookups / 2)
+        m_keys.push_back(k);
+    }
+    while (m_keys.size() < lookups)
+      m_keys.push_back(crypto::rand<crypto::key_image>());
+    return m_map.size() == nkeys;
+  }
+
+  bool test()
+  {
+    size_t found = 0;
+    for (const crypto::key_image &k: m_keys)
+      found += m_map.find(k) != m_map.end();
+    return found == lookups / 2;
+  }
+
+private:
+  map_type m_map;
+  std::vector<crypto::key_image> m_keys;
+};
@@ -0,0 +1,74 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "misc_log_ex.h"
+#include "crypto/crypto.h"
+
+enum test_log_overhead_type
+{
+  log_overhead_none,
+  log_overhead_runtime,
+  log_overhead_hot,
+};
+
+// Cost of a disabled per-call trace of a key, as done in the crypto and
+// ring signature checks: none, a runtime level check, or a hot path log
+template<test_log_overhead_type type>
+class test_log_overhead
+{
+public:
+  static const size_t loop_count = 1000;
+  static const size_t calls = 1000;
+
+  bool init()
+  {
+    m_key = crypto::rand<crypto::public_key>();
+    return true;
+  }
+
+  bool test()
+  {
+    size_t n = 0;
+    for (size_t i = 0; i < calls; ++i)
+    {
+      switch (type)
+      {
+        case log_overhead_runtime: MCTRACE("perf.log", "key: " << m_key); break;
+        case log_overhead_hot: MLOG_HOT(el::Level::Trace, "key: " << m_key); break;
+        default: break;
+      }
+      n += m_key.data[i % sizeof(m_key.data)];
+    }
+    return n != (size_t)-1;
+  }
+
+private:
+  crypto::public_key m_key;
+};
@@ -58,6 +58,10 @@
 #include "bulletproof.h"
 #include "crypto_ops.h"
 #include "multiexp.h"
+#include "threadpool.h"
+#include "tx_pool_churn.h"
+#include "key_map_lookup.h"
+#include "log_overhead.h"
 
 namespace po = boost::program_options;
 
@@ -144,6 +148,13 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE5(filter, p, test_construct_tx, 100, 2, true, rct::RangeProofPaddedBulletproof, 2);
   TEST_PERFORMANCE5(filter, p, test_construct_tx, 100, 10, true, rct::RangeProofPaddedBulletproof, 2);
 
+  TEST_PERFORMANCE2(filter, p, test_construct_tx_threads, 10, 1);
+  TEST_PERFORMANCE2(filter, p, test_construct_tx_threads, 10, 4);
+  TEST_PERFORMANCE2(filter, p, test_construct_tx_threads, 100, 1);
+  TEST_PERFORMANCE2(filter, p, test_construct_tx_threads, 100, 4);
+  TEST_PERFORMANCE2(filter, p, test_construct_tx_threads, 500, 1);
+  TEST_PERFORMANCE2(filter, p, test_construct_tx_threads, 500, 4);
+
   TEST_PERFORMANCE3(filter, p, test_check_tx_signature, 1, 2, false);
   TEST_PERFORMANCE3(filter, p, test_check_tx_signature, 2, 2, false);
   TEST_PERFORMANCE3(filter, p, test_check_tx_signature, 10, 2, false);
@@ -196,6 +207,23 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE1(filter, p, test_cn_fast_hash, 32);
   TEST_PERFORMANCE1(filter, p, test_cn_fast_hash, 16384);
 
+  TEST_PERFORMANCE3(filter, p, test_threadpool, threadpool_mutex_queue, 100, 4);
+  TEST_PERFORMANCE3(filter, p, test_threadpool, threadpool_work_stealing, 100, 4);
+  TEST_PERFORMANCE3(filter, p, test_threadpool, threadpool_mutex_queue, 10000, 4);
+  TEST_PERFORMANCE3(filter, p, test_threadpool, threadpool_work_stealing, 10000, 4);
+  TEST_PERFORMANCE3(filter, p, test_threadpool, threadpool_mutex_queue, 10000, 16);
+  TEST_PERFORMANCE3(filter, p, test_threadpool, threadpool_work_stealing, 10000, 16);
+
+  TEST_PERFORMANCE2(filter, p, test_tx_pool_churn, 100000, false);
+  TEST_PERFORMANCE2(filter, p, test_tx_pool_churn, 100000, true);
+
+  TEST_PERFORMANCE2(filter, p, test_key_map_lookup, key_map_unordered_map, 1000000);
+  TEST_PERFORMANCE2(filter, p, test_key_map_lookup, key_map_flat, 1000000);
+
+  TEST_PERFORMANCE1(filter, p, test_log_overhead, log_overhead_none);
+  TEST_PERFORMANCE1(filter, p, test_log_overhead, log_overhead_runtime);
+  TEST_PERFORMANCE1(filter, p, test_log_overhead, log_overhead_hot);
+
   TEST_PERFORMANCE3(filter, p, test_ringct_mlsag, 1, 3, false);
   TEST_PERFORMANCE3(filter, p, test_ringct_mlsag, 1, 5, false);
   TEST_PERFORMANCE3(filter, p, test_ringct_mlsag, 1, 10, false);
@@ -0,0 +1,191 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <boost/config.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include "common/threadpool.h"
+
+// The single queue, single mutex pool tools::threadpool used to be, as a baseline
+class mutex_queue_threadpool
+{
+public:
+  class waiter {
+    boost::mutex mt;
+    boost::condition_variable cv;
+    int num;
+  public:
+    waiter(): num(0) {}
+    void inc() { const boost::unique_lock<boost::mutex> lock(mt); num++; }
+    void dec() { const boost::unique_lock<boost::mutex> lock(mt); if (!--num) cv.notify_all(); }
+    void wait(mutex_queue_threadpool *tpool)
+    {
+      if (tpool)
+        tpool->run(true);
+      boost::unique_lock<boost::mutex> lock(mt);
+      while (num)
+        cv.wait(lock);
+    }
+  };
+
+  mutex_queue_threadpool(unsigned int max_threads): active(0), max(max_threads), running(true)
+  {
+    for (unsigned int i = 1; i < max; ++i)
+      threads.push_back(boost::thread(boost::bind(&mutex_queue_threadpool::run, this, false)));
+  }
+
+  ~mutex_queue_threadpool()
+  {
+    {
+      const boost::unique_lock<boost::mutex> lock(mutex);
+      running = false;
+      has_work.notify_all();
+    }
+    for (auto &t: threads)
+      t.join();
+  }
+
+  void submit(waiter *obj, std::function<void()> f)
+  {
+    boost::unique_lock<boost::mutex> lock(mutex);
+    if (active == max && !queue.empty())
+    {
+      lock.unlock();
+      f();
+      return;
+    }
+    if (obj)
+      obj->inc();
+    queue.push_back({obj, f});
+    has_work.notify_one();
+  }
+
+private:
+  struct entry {
+    waiter *wo;
+    std::function<void()> f;
+  };
+
+  void run(bool flush)
+  {
+    boost::unique_lock<boost::mutex> lock(mutex);
+    while (running)
+    {
+      while (queue.empty() && running)
+      {
+        if (flush)
+          return;
+        has_work.wait(lock);
+      }
+      if (!running)
+        break;
+      active++;
+      entry e = queue.front();
+      queue.pop_front();
+      lock.unlock();
+      e.f();
+      if (e.wo)
+        e.wo->dec();
+      lock.lock();
+      active--;
+    }
+  }
+
+  std::deque<entry> queue;
+  boost::condition_variable has_work;
+  boost::mutex mutex;
+  std::vector<boost::thread> threads;
+  unsigned int active;
+  unsigned int max;
+  bool running;
+};
+
+enum test_threadpool_type
+{
+  threadpool_mutex_queue,
+  threadpool_work_stealing,
+};
+
+// Submits a batch of tiny tasks and waits for them, the way wallet refresh
+// and block preparation use the pool. With --stats, the spread of the per
+// batch times shows the tail latency.
+template<test_threadpool_type type, size_t ntasks, unsigned int nthreads>
+class test_threadpool
+{
+public:
+  static const size_t loop_count = ntasks >= 10000 ? 100 : 1000;
+
+  bool init()
+  {
+#if defined(BOOST_HAS_PTHREADS) && !defined(__APPLE__) && !defined(__FreeBSD__) && !defined(__OpenBSD__) && !defined(__DragonFly__) && !defined(__sun)
+    // main() pins the process to one core, and the pool threads would inherit it
+    cpu_set_t pinned, all;
+    ::pthread_getaffinity_np(::pthread_self(), sizeof(pinned), &pinned);
+    CPU_ZERO(&all);
+    for (int i = 0; i < CPU_SETSIZE; ++i)
+      CPU_SET(i, &all);
+    ::pthread_setaffinity_np(::pthread_self(), sizeof(all), &all);
+#endif
+    if (type == threadpool_mutex_queue)
+      m_mutex_queue.reset(new mutex_queue_threadpool(nthreads));
+    else
+      m_work_stealing.reset(tools::threadpool::getNewForUnitTests(nthreads));
+#if defined(BOOST_HAS_PTHREADS) && !defined(__APPLE__) && !defined(__FreeBSD__) && !defined(__OpenBSD__) && !defined(__DragonFly__) && !defined(__sun)
+    ::pthread_setaffinity_np(::pthread_self(), sizeof(pinned), &pinned);
+#endif
+    return true;
+  }
+
+  bool test()
+  {
+    return type == threadpool_mutex_queue ? run_batch(*m_mutex_queue) : run_batch(*m_work_stealing);
+  }
+
+private:
+  template<typename T>
+  bool run_batch(T &tpool)
+  {
+    m_count = 0;
+    typename T::waiter waiter;
+    for (size_t n = 0; n < ntasks; ++n)
+      tpool.submit(&waiter, [this](){ m_count.fetch_add(1, std::memory_order_relaxed); });
+    waiter.wait(&tpool);
+    return m_count == ntasks;
+  }
+
+  std::unique_ptr<mutex_queue_threadpool> m_mutex_queue;
+  std::unique_ptr<tools::threadpool> m_work_stealing;
+  std::atomic<size_t> m_count;
+};
@@ -0,0 +1,85 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include "crypto/crypto.h"
+#include "cryptonote_core/tx_pool.h"
+
+// Takes txes out of a pool sized container by txid and puts them back with
+// a new fee, as take_tx, remove_stuck_transactions and validate do. The
+// linear variant looks txids up the way the pool did before it had a txid
+// index.
+template<size_t ntxes, bool indexed>
+class test_tx_pool_churn
+{
+public:
+  static const size_t loop_count = indexed ? 1000 : 5;
+  static const size_t churn = 100;
+
+  bool init()
+  {
+    m_txids.resize(ntxes);
+    for (size_t n = 0; n < ntxes; ++n)
+    {
+      m_txids[n] = crypto::rand<crypto::hash>();
+      m_txs.emplace(std::pair<double, std::time_t>(crypto::rand<uint32_t>() / 1000.0, n), m_txids[n]);
+    }
+    m_picks.resize(churn);
+    for (size_t n = 0; n < churn; ++n)
+      m_picks[n] = crypto::rand<uint32_t>() % ntxes;
+    return m_txs.size() == ntxes;
+  }
+
+  bool test()
+  {
+    for (size_t n = 0; n < churn; ++n)
+    {
+      const crypto::hash &txid = m_txids[m_picks[n]];
+      cryptonote::sorted_tx_container::iterator it;
+      if (indexed)
+        it = m_txs.project<0>(m_txs.get<cryptonote::by_txid>().find(txid));
+      else
+        it = std::find_if(m_txs.begin(), m_txs.end(), [&](const cryptonote::tx_by_fee_and_receive_time_entry &e) { return e.second == txid; });
+      if (it == m_txs.end())
+        return false;
+      cryptonote::tx_by_fee_and_receive_time_entry e = *it;
+      m_txs.erase(it);
+      e.first.first += 1.0;
+      m_txs.emplace(e);
+    }
+    return m_txs.size() == ntxes;
+  }
+
+private:
+  cryptonote::sorted_tx_container m_txs;
+  std::vector<crypto::hash> m_txids;
+  std::vector<uint32_t> m_picks;
+};
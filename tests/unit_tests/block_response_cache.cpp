@@ -0,0 +1,178 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <memory>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "include_base_utils.h"
+#include "cryptonote_core/block_response_cache.h"
+#include "serialization/keyvalue_serialization.h"
+#include "storages/portable_storage_template_helper.h"
+
+namespace
+{
+  cryptonote::block_response_cache::span make_span(uint64_t block_count, size_t size)
+  {
+    cryptonote::block_response_cache::span s;
+    s.entries = std::make_shared<std::string>(size, 'x');
+    s.entry_count = 1;
+    s.block_count = block_count;
+    return s;
+  }
+
+  struct blocks_entries
+  {
+    std::vector<std::string> blocks;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(blocks)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct height_fields
+  {
+    uint64_t start_height;
+    std::string status;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(start_height)
+      KV_SERIALIZE(status)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct full_response
+  {
+    std::vector<std::string> blocks;
+    uint64_t start_height;
+    std::string status;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(blocks)
+      KV_SERIALIZE(start_height)
+      KV_SERIALIZE(status)
+    END_KV_SERIALIZE_MAP()
+  };
+}
+
+TEST(block_response_cache, find)
+{
+  cryptonote::block_response_cache cache(1000);
+  cryptonote::block_response_cache::span s;
+  ASSERT_FALSE(cache.find(10, 20, 0, s));
+  cache.add(10, 20, 0, make_span(20, 100), cache.get_generation());
+  ASSERT_TRUE(cache.find(10, 20, 0, s));
+  ASSERT_EQ(s.block_count, 20);
+  ASSERT_EQ(s.entries->size(), 100);
+  ASSERT_FALSE(cache.find(10, 20, cryptonote::block_response_cache::variant_pruned, s));
+  ASSERT_FALSE(cache.find(10, 21, 0, s));
+  ASSERT_FALSE(cache.find(11, 20, 0, s));
+  ASSERT_EQ(cache.get_size(), 100);
+
+  cache.add(10, 20, 0, make_span(20, 50), cache.get_generation());
+  ASSERT_TRUE(cache.find(10, 20, 0, s));
+  ASSERT_EQ(s.entries->size(), 50);
+  ASSERT_EQ(cache.get_size(), 50);
+}
+
+TEST(block_response_cache, evicts_least_recently_used)
+{
+  cryptonote::block_response_cache cache(300);
+  cryptonote::block_response_cache::span s;
+  cache.add(0, 10, 0, make_span(10, 100), cache.get_generation());
+  cache.add(10, 10, 0, make_span(10, 100), cache.get_generation());
+  cache.add(20, 10, 0, make_span(10, 100), cache.get_generation());
+  ASSERT_TRUE(cache.find(0, 10, 0, s));
+  cache.add(30, 10, 0, make_span(10, 100), cache.get_generation());
+  ASSERT_EQ(cache.get_size(), 300);
+  ASSERT_TRUE(cache.find(0, 10, 0, s));
+  ASSERT_FALSE(cache.find(10, 10, 0, s));
+  ASSERT_TRUE(cache.find(20, 10, 0, s));
+  ASSERT_TRUE(cache.find(30, 10, 0, s));
+
+  // too large to ever fit
+  cache.add(40, 10, 0, make_span(10, 301), cache.get_generation());
+  ASSERT_FALSE(cache.find(40, 10, 0, s));
+  ASSERT_EQ(cache.get_size(), 300);
+}
+
+TEST(block_response_cache, invalidate)
+{
+  cryptonote::block_response_cache cache(1000);
+  cryptonote::block_response_cache::span s;
+  cache.add(0, 10, 0, make_span(10, 100), cache.get_generation());
+  cache.add(10, 10, 0, make_span(10, 100), cache.get_generation());
+  cache.add(20, 10, 0, make_span(5, 100), cache.get_generation());
+  const uint64_t generation = cache.get_generation();
+  cache.invalidate(25);
+  ASSERT_NE(cache.get_generation(), generation);
+  ASSERT_TRUE(cache.find(0, 10, 0, s));
+  ASSERT_TRUE(cache.find(10, 10, 0, s));
+  ASSERT_TRUE(cache.find(20, 10, 0, s));
+  cache.invalidate(15);
+  ASSERT_TRUE(cache.find(0, 10, 0, s));
+  ASSERT_FALSE(cache.find(10, 10, 0, s));
+  ASSERT_FALSE(cache.find(20, 10, 0, s));
+  ASSERT_EQ(cache.get_size(), 100);
+
+  // a span read before the pop is stale
+  cache.add(10, 10, 0, make_span(10, 100), generation);
+  ASSERT_FALSE(cache.find(10, 10, 0, s));
+
+  cache.clear();
+  ASSERT_FALSE(cache.find(0, 10, 0, s));
+  ASSERT_EQ(cache.get_size(), 0);
+}
+
+TEST(block_response_cache, spliced_entries)
+{
+  blocks_entries entries;
+  entries.blocks = {"a", std::string(5000, 'b'), "c"};
+  std::string raw;
+  size_t count = 0;
+  ASSERT_TRUE(epee::serialization::store_t_entries_to_binary(entries, raw, count));
+  ASSERT_EQ(count, 1);
+
+  height_fields fields;
+  fields.start_height = 42;
+  fields.status = "OK";
+  std::string spliced;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(fields, spliced, raw, count));
+
+  full_response res;
+  ASSERT_TRUE(epee::serialization::load_t_from_binary(res, spliced));
+  ASSERT_EQ(res.blocks, entries.blocks);
+  ASSERT_EQ(res.start_height, 42);
+  ASSERT_EQ(res.status, "OK");
+
+  std::shared_ptr<const std::string> shared_raw = std::make_shared<std::string>(raw);
+  std::shared_ptr<const epee::byte_segments> segments = epee::serialization::store_t_to_segments(fields, shared_raw, count);
+  ASSERT_TRUE(segments != nullptr);
+  ASSERT_EQ(segments->str(), spliced);
+}
@@ -32,6 +32,7 @@
 #include <iostream>
 #include <chrono>
 #include <thread>
+#include <unordered_set>
 
 #include "gtest/gtest.h"
 
@@ -42,6 +43,7 @@
 #include "blockchain_db/berkeleydb/db_bdb.h"
 #endif
 #include "cryptonote_basic/cryptonote_format_utils.h"
+#include "ringct/rctOps.h"
 
 using namespace cryptonote;
 using epee::string_tools::pod_to_hex;
@@ -346,4 +348,490 @@ TYPED_TEST(BlockchainDBTest, RetrieveBlockData)
   ASSERT_HASH_EQ(get_block_hash(this->m_blocks[1]), hashes[1]);
 }
 
+TYPED_TEST(BlockchainDBTest, RetrieveOutputData)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  // make sure open does not throw
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+
+  // every miner output can be found by amount, with its key and height
+  for (uint64_t height = 0; height < 2; ++height)
+  {
+    for (const tx_out &out: this->m_blocks[height].miner_tx.vout)
+    {
+      const crypto::public_key &key = boost::get<txout_to_key>(out.target).key;
+      const uint64_t num_outputs = this->m_db->get_num_outputs(out.amount);
+      bool found = false;
+      for (uint64_t index = 0; index < num_outputs && !found; ++index)
+      {
+        const output_data_t data = this->m_db->get_output_key(out.amount, index);
+        if (data.pubkey == key && data.height == height)
+        {
+          ASSERT_EQ(rct::zeroCommit(out.amount), data.commitment);
+          found = true;
+        }
+      }
+      ASSERT_TRUE(found);
+    }
+  }
+
+  const uint64_t amount = this->m_blocks[1].miner_tx.vout[0].amount;
+  const uint64_t num_outputs = this->m_db->get_num_outputs(amount);
+  std::vector<uint64_t> distribution;
+  uint64_t base;
+  ASSERT_TRUE(this->m_db->get_output_distribution(amount, 0, 0, distribution, base));
+  ASSERT_EQ(2, distribution.size());
+  ASSERT_EQ(num_outputs, distribution.back());
+
+  // popping a block takes its outputs away again
+  block b;
+  std::vector<transaction> txs;
+  ASSERT_NO_THROW(this->m_db->pop_block(b, txs));
+  size_t popped = 0;
+  for (const tx_out &out: this->m_blocks[1].miner_tx.vout)
+    popped += out.amount == amount;
+  ASSERT_EQ(num_outputs - popped, this->m_db->get_num_outputs(amount));
+  ASSERT_THROW(this->m_db->get_output_key(amount, num_outputs - 1), OUTPUT_DNE);
+}
+
+TYPED_TEST(BlockchainDBTest, RetrieveTxBlobs)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  // make sure open does not throw
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+  uint64_t unique_keys, key_references;
+  ASSERT_TRUE(this->m_db->get_tx_key_stats(unique_keys, key_references));
+  const uint64_t references_0 = key_references;
+  ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+
+  // stored txes come back byte for byte, whatever keys they share
+  for (size_t height = 0; height < 2; ++height)
+  {
+    std::vector<transaction> txs = this->m_txs[height];
+    txs.push_back(this->m_blocks[height].miner_tx);
+    for (const transaction &tx: txs)
+    {
+      cryptonote::blobdata bd;
+      ASSERT_TRUE(this->m_db->get_tx_blob(get_transaction_hash(tx), bd));
+      ASSERT_EQ(tx_to_blob(tx), bd);
+    }
+  }
+
+  ASSERT_TRUE(this->m_db->get_tx_key_stats(unique_keys, key_references));
+  ASSERT_GT(key_references, references_0);
+  ASSERT_LE(unique_keys, key_references);
+
+  // popping a block releases its keys again
+  block b;
+  std::vector<transaction> txs;
+  ASSERT_NO_THROW(this->m_db->pop_block(b, txs));
+  ASSERT_TRUE(this->m_db->get_tx_key_stats(unique_keys, key_references));
+  ASSERT_EQ(references_0, key_references);
+}
+
+// the tests below write tables the way an older version of the LMDB
+// backend did, and check open() migrates them
+
+typedef BlockchainDBTest<BlockchainLMDB> BlockchainLMDBTest;
+
+// same orderings as db_lmdb.cpp, which LMDB needs again to write to a table
+int compare_hash32(const MDB_val *a, const MDB_val *b)
+{
+  const uint32_t *va = (const uint32_t*)a->mv_data;
+  const uint32_t *vb = (const uint32_t*)b->mv_data;
+  for (int n = 7; n >= 0; n--)
+  {
+    if (va[n] == vb[n])
+      continue;
+    return va[n] < vb[n] ? -1 : 1;
+  }
+  return 0;
+}
+
+int compare_uint64(const MDB_val *a, const MDB_val *b)
+{
+  const uint64_t va = *(const uint64_t *)a->mv_data;
+  const uint64_t vb = *(const uint64_t *)b->mv_data;
+  return (va < vb) ? -1 : va > vb;
+}
+
+int compare_string(const MDB_val *a, const MDB_val *b)
+{
+  return strcmp((const char*)a->mv_data, (const char*)b->mv_data);
+}
+
+const uint64_t zerokey = 0;
+const MDB_val zerokval = { sizeof(zerokey), (void *)&zerokey };
+
+// direct write access to a closed LMDB database
+struct raw_lmdb
+{
+  MDB_env *env;
+  MDB_txn *txn;
+
+  raw_lmdb(): env(NULL), txn(NULL) {}
+  ~raw_lmdb()
+  {
+    if (txn)
+      mdb_txn_abort(txn);
+    if (env)
+      mdb_env_close(env);
+  }
+
+  int open(const std::string &folder)
+  {
+    int result;
+    if ((result = mdb_env_create(&env)))
+      return result;
+    if ((result = mdb_env_set_maxdbs(env, 32)))
+      return result;
+    if ((result = mdb_env_open(env, folder.c_str(), 0, 0664)))
+      return result;
+    return mdb_txn_begin(env, NULL, 0, &txn);
+  }
+
+  int open_table(const char *name, unsigned int flags, MDB_dbi &dbi)
+  {
+    return mdb_dbi_open(txn, name, flags, &dbi);
+  }
+
+  int set_version(uint32_t version)
+  {
+    MDB_dbi dbi;
+    int result = mdb_dbi_open(txn, "properties", 0, &dbi);
+    if (result)
+      return result;
+    mdb_set_compare(txn, dbi, compare_string);
+    MDB_val k = { sizeof("version"), (void *)"version" };
+    MDB_val v = { sizeof(version), (void *)&version };
+    return mdb_put(txn, dbi, &k, &v, 0);
+  }
+
+  int commit()
+  {
+    const int result = mdb_txn_commit(txn);
+    txn = NULL;
+    return result;
+  }
+};
+
+TEST_F(BlockchainLMDBTest, MigrateSpentKeys)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+  this->set_prefix(dirPath);
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->m_db->close();
+
+  // version 4 kept the full key images in spent_keys, and had no
+  // spent_key_images; enough of them for several migration batches
+  std::vector<crypto::key_image> key_images;
+  for (size_t i = 0; i < 2500; ++i)
+    key_images.push_back(crypto::rand<crypto::key_image>());
+  {
+    raw_lmdb raw;
+    ASSERT_EQ(0, raw.open(dirPath));
+    MDB_dbi spent_keys, spent_key_images;
+    ASSERT_EQ(0, raw.open_table("spent_keys", MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED, spent_keys));
+    ASSERT_EQ(0, raw.open_table("spent_key_images", 0, spent_key_images));
+    ASSERT_EQ(0, mdb_drop(raw.txn, spent_key_images, 1));
+    mdb_set_dupsort(raw.txn, spent_keys, compare_hash32);
+    for (const crypto::key_image &ki: key_images)
+    {
+      MDB_val v = { sizeof(ki), (void *)&ki };
+      ASSERT_EQ(0, mdb_put(raw.txn, spent_keys, (MDB_val *)&zerokval, &v, MDB_NODUPDATA));
+    }
+    ASSERT_EQ(0, raw.set_version(4));
+    ASSERT_EQ(0, raw.commit());
+  }
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  for (const crypto::key_image &ki: key_images)
+    ASSERT_TRUE(this->m_db->has_key_image(ki));
+  ASSERT_FALSE(this->m_db->has_key_image(crypto::rand<crypto::key_image>()));
+
+  std::unordered_set<crypto::key_image> listed;
+  ASSERT_TRUE(this->m_db->for_all_key_images([&listed](const crypto::key_image &ki) { listed.insert(ki); return true; }));
+  ASSERT_EQ(listed, std::unordered_set<crypto::key_image>(key_images.begin(), key_images.end()));
+
+  ASSERT_NO_THROW(this->m_db->close());
+}
+
+#pragma pack(push, 1)
+// output_amounts records up to version 5, with the output's pubkey
+struct v5_outkey
+{
+  uint64_t amount_index;
+  uint64_t output_id;
+  output_data_t data;
+};
+struct v5_pre_rct_outkey
+{
+  uint64_t amount_index;
+  uint64_t output_id;
+  crypto::public_key pubkey;
+  uint64_t unlock_time;
+  uint64_t height;
+};
+// and from version 6, with the pubkey (and commitment) in output_pubkeys
+struct v6_outkey
+{
+  uint64_t amount_index;
+  uint64_t output_id;
+  uint64_t unlock_time;
+  uint64_t height;
+};
+struct v6_outpubkey
+{
+  crypto::public_key pubkey;
+  rct::key commitment;
+};
+#pragma pack(pop)
+
+// writes three RCT and three pre RCT outputs of amount 5 in the version 5
+// format, with interleaved output ids; if partly_migrated, the first one is
+// already moved to the table an interrupted migration leaves behind
+void write_v5_outputs(const std::string &dirPath, bool partly_migrated, std::vector<output_data_t> &rct_outputs, std::vector<output_data_t> &pre_rct_outputs)
+{
+  raw_lmdb raw;
+  ASSERT_EQ(0, raw.open(dirPath));
+  MDB_dbi output_amounts, output_pubkeys, output_amountr;
+  ASSERT_EQ(0, raw.open_table("output_amounts", MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED, output_amounts));
+  ASSERT_EQ(0, raw.open_table("output_pubkeys", MDB_INTEGERKEY, output_pubkeys));
+  mdb_set_dupsort(raw.txn, output_amounts, compare_uint64);
+  if (partly_migrated)
+  {
+    ASSERT_EQ(0, raw.open_table("output_amountr", MDB_INTEGERKEY | MDB_DUPSORT | MDB_DUPFIXED | MDB_CREATE, output_amountr));
+    mdb_set_dupsort(raw.txn, output_amountr, compare_uint64);
+  }
+
+  for (uint64_t n = 0; n < 3; ++n)
+  {
+    output_data_t data;
+    data.pubkey = crypto::rand<crypto::public_key>();
+    data.unlock_time = 100 + n;
+    data.height = 10 + n;
+    data.commitment = crypto::rand<rct::key>();
+    rct_outputs.push_back(data);
+    const uint64_t amount = 0, output_id = 2 * n;
+    MDB_val k = { sizeof(amount), (void *)&amount };
+    if (partly_migrated && n == 0)
+    {
+      const v6_outkey ok = { n, output_id, data.unlock_time, data.height };
+      const v6_outpubkey opk = { data.pubkey, data.commitment };
+      MDB_val v = { sizeof(ok), (void *)&ok };
+      ASSERT_EQ(0, mdb_put(raw.txn, output_amountr, &k, &v, MDB_APPENDDUP));
+      MDB_val pk = { sizeof(output_id), (void *)&output_id };
+      MDB_val pv = { sizeof(opk), (void *)&opk };
+      ASSERT_EQ(0, mdb_put(raw.txn, output_pubkeys, &pk, &pv, 0));
+      continue;
+    }
+    const v5_outkey ok = { n, output_id, data };
+    MDB_val v = { sizeof(ok), (void *)&ok };
+    ASSERT_EQ(0, mdb_put(raw.txn, output_amounts, &k, &v, MDB_APPENDDUP));
+  }
+  for (uint64_t n = 0; n < 3; ++n)
+  {
+    output_data_t data;
+    data.pubkey = crypto::rand<crypto::public_key>();
+    data.unlock_time = 200 + n;
+    data.height = 20 + n;
+    data.commitment = rct::zeroCommit(5);
+    pre_rct_outputs.push_back(data);
+    const uint64_t amount = 5;
+    const v5_pre_rct_outkey ok = { n, 2 * n + 1, data.pubkey, data.unlock_time, data.height };
+    MDB_val k = { sizeof(amount), (void *)&amount };
+    MDB_val v = { sizeof(ok), (void *)&ok };
+    ASSERT_EQ(0, mdb_put(raw.txn, output_amounts, &k, &v, MDB_APPENDDUP));
+  }
+  ASSERT_EQ(0, raw.set_version(5));
+  ASSERT_EQ(0, raw.commit());
+}
+
+void check_outputs(BlockchainDB *db, uint64_t amount, const std::vector<output_data_t> &outputs)
+{
+  ASSERT_EQ(outputs.size(), db->get_num_outputs(amount));
+  for (size_t n = 0; n < outputs.size(); ++n)
+  {
+    const output_data_t data = db->get_output_key(amount, n);
+    ASSERT_EQ(outputs[n].pubkey, data.pubkey);
+    ASSERT_EQ(outputs[n].unlock_time, data.unlock_time);
+    ASSERT_EQ(outputs[n].height, data.height);
+    ASSERT_EQ(outputs[n].commitment, data.commitment);
+  }
+  ASSERT_THROW(db->get_output_key(amount, outputs.size()), OUTPUT_DNE);
+}
+
+TEST_F(BlockchainLMDBTest, MigrateOutputAmounts)
+{
+  for (bool partly_migrated: {false, true})
+  {
+    boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    std::string dirPath = tempPath.string();
+    this->set_prefix(dirPath);
+    ASSERT_NO_THROW(this->m_db->open(dirPath));
+    this->get_filenames();
+    this->m_db->close();
+
+    std::vector<output_data_t> rct_outputs, pre_rct_outputs;
+    ASSERT_NO_FATAL_FAILURE(write_v5_outputs(dirPath, partly_migrated, rct_outputs, pre_rct_outputs));
+
+    ASSERT_NO_THROW(this->m_db->open(dirPath));
+    ASSERT_NO_FATAL_FAILURE(check_outputs(this->m_db, 0, rct_outputs));
+    ASSERT_NO_FATAL_FAILURE(check_outputs(this->m_db, 5, pre_rct_outputs));
+    ASSERT_NO_THROW(this->m_db->close());
+    this->remove_files();
+  }
+}
+
+// a stored tx, with its version 6 txs_pruned record
+struct v6_tx
+{
+  uint64_t tx_id;
+  uint64_t height;
+  crypto::hash hash;
+  cryptonote::blobdata blob;
+  cryptonote::blobdata pruned;
+};
+
+// turns the txs_pruned records of the txes above min_height back into the
+// version 6 format, which kept the pruned blobs whole; the tx_keys records
+// the others reference are in tx_keys. An interrupted migration leaves
+// the records it already moved in txs_prunec instead
+void write_v6_txs(const std::string &dirPath, const std::vector<v6_tx> &txs, uint64_t min_height, const std::vector<std::pair<std::string, std::string>> &tx_keys, bool partly_migrated)
+{
+  raw_lmdb raw;
+  ASSERT_EQ(0, raw.open(dirPath));
+  MDB_dbi txs_pruned, txs_prunec, tx_keys_dbi;
+  ASSERT_EQ(0, raw.open_table("txs_pruned", MDB_INTEGERKEY, txs_pruned));
+  ASSERT_EQ(0, raw.open_table("tx_keys", 0, tx_keys_dbi));
+  if (partly_migrated)
+    ASSERT_EQ(0, raw.open_table("txs_prunec", MDB_INTEGERKEY | MDB_CREATE, txs_prunec));
+
+  ASSERT_EQ(0, mdb_drop(raw.txn, tx_keys_dbi, 0));
+  for (const auto &e: tx_keys)
+  {
+    MDB_val k = { e.first.size(), (void *)e.first.data() };
+    MDB_val v = { e.second.size(), (void *)e.second.data() };
+    ASSERT_EQ(0, mdb_put(raw.txn, tx_keys_dbi, &k, &v, 0));
+  }
+
+  for (const v6_tx &tx: txs)
+  {
+    MDB_val k = { sizeof(tx.tx_id), (void *)&tx.tx_id };
+    if (tx.height < min_height)
+    {
+      if (partly_migrated)
+      {
+        MDB_val v;
+        ASSERT_EQ(0, mdb_get(raw.txn, txs_pruned, &k, &v));
+        const std::string interned((const char *)v.mv_data, v.mv_size);
+        MDB_val iv = { interned.size(), (void *)interned.data() };
+        ASSERT_EQ(0, mdb_put(raw.txn, txs_prunec, &k, &iv, MDB_APPEND));
+        ASSERT_EQ(0, mdb_del(raw.txn, txs_pruned, &k, NULL));
+      }
+      continue;
+    }
+    MDB_val v = { tx.pruned.size(), (void *)tx.pruned.data() };
+    ASSERT_EQ(0, mdb_put(raw.txn, txs_pruned, &k, &v, 0));
+  }
+  ASSERT_EQ(0, raw.set_version(6));
+  ASSERT_EQ(0, raw.commit());
+}
+
+std::vector<std::pair<std::string, std::string>> read_tx_keys(const std::string &dirPath)
+{
+  std::vector<std::pair<std::string, std::string>> tx_keys;
+  raw_lmdb raw;
+  EXPECT_EQ(0, raw.open(dirPath));
+  MDB_dbi dbi;
+  EXPECT_EQ(0, raw.open_table("tx_keys", 0, dbi));
+  MDB_cursor *cur;
+  EXPECT_EQ(0, mdb_cursor_open(raw.txn, dbi, &cur));
+  MDB_val k, v;
+  for (int result = mdb_cursor_get(cur, &k, &v, MDB_FIRST); result == 0; result = mdb_cursor_get(cur, &k, &v, MDB_NEXT))
+    tx_keys.push_back(std::make_pair(std::string((const char *)k.mv_data, k.mv_size), std::string((const char *)v.mv_data, v.mv_size)));
+  mdb_cursor_close(cur);
+  return tx_keys;
+}
+
+TEST_F(BlockchainLMDBTest, MigrateTxKeys)
+{
+  // a version 6 database, one where a migration was interrupted after it
+  // renamed txs_prunec, and one where it was interrupted while moving records
+  for (int state = 0; state < 3; ++state)
+  {
+    boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+    std::string dirPath = tempPath.string();
+    this->set_prefix(dirPath);
+    ASSERT_NO_THROW(this->m_db->open(dirPath));
+    this->get_filenames();
+    this->init_hard_fork();
+
+    // the txes of block 0 are already interned, except in a version 6 database
+    const uint64_t min_height = state ? 1 : 0;
+    std::vector<std::pair<std::string, std::string>> tx_keys;
+    std::vector<v6_tx> txs;
+    for (uint64_t height = 0; height < 2; ++height)
+    {
+      if (height == min_height)
+      {
+        ASSERT_NO_THROW(this->m_db->close());
+        tx_keys = read_tx_keys(dirPath);
+        ASSERT_NO_THROW(this->m_db->open(dirPath));
+      }
+      ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[height], t_sizes[height], t_sizes[height], t_diffs[height], t_coins[height], this->m_txs[height]));
+      std::vector<transaction> block_txs = this->m_txs[height];
+      block_txs.push_back(this->m_blocks[height].miner_tx);
+      for (const transaction &tx: block_txs)
+      {
+        v6_tx stored;
+        stored.height = height;
+        stored.hash = get_transaction_hash(tx);
+        stored.blob = tx_to_blob(tx);
+        ASSERT_TRUE(this->m_db->tx_exists(stored.hash, stored.tx_id));
+        ASSERT_TRUE(this->m_db->get_pruned_tx_blob(stored.hash, stored.pruned));
+        txs.push_back(stored);
+      }
+    }
+    uint64_t unique_keys, key_references;
+    ASSERT_TRUE(this->m_db->get_tx_key_stats(unique_keys, key_references));
+    ASSERT_NO_THROW(this->m_db->close());
+
+    ASSERT_NO_FATAL_FAILURE(write_v6_txs(dirPath, txs, min_height, tx_keys, state == 2));
+
+    ASSERT_NO_THROW(this->m_db->open(dirPath));
+    for (const v6_tx &tx: txs)
+    {
+      cryptonote::blobdata bd;
+      ASSERT_TRUE(this->m_db->get_tx_blob(tx.hash, bd));
+      ASSERT_EQ(tx.blob, bd);
+    }
+    uint64_t migrated_unique_keys, migrated_key_references;
+    ASSERT_TRUE(this->m_db->get_tx_key_stats(migrated_unique_keys, migrated_key_references));
+    ASSERT_EQ(unique_keys, migrated_unique_keys);
+    ASSERT_EQ(key_references, migrated_key_references);
+    ASSERT_NO_THROW(this->m_db->close());
+    this->remove_files();
+  }
+}
+
 }  // anonymous namespace
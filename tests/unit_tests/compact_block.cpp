@@ -0,0 +1,83 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include "gtest/gtest.h"
+#include "crypto/crypto.h"
+#include "cryptonote_protocol/compact_block.h"
+
+TEST(compact_block, short_id_encoding)
+{
+  std::string short_ids;
+  cryptonote::add_short_tx_id(short_ids, 0);
+  cryptonote::add_short_tx_id(short_ids, 0x123456789abcULL);
+  cryptonote::add_short_tx_id(short_ids, 0xffffffffffffULL);
+  ASSERT_EQ(short_ids.size(), 3 * COMPACT_BLOCK_SHORT_ID_SIZE);
+  ASSERT_EQ(cryptonote::get_short_tx_id_count(short_ids), 3);
+  ASSERT_EQ(cryptonote::get_short_tx_id(short_ids, 0), 0);
+  ASSERT_EQ(cryptonote::get_short_tx_id(short_ids, 1), 0x123456789abcULL);
+  ASSERT_EQ(cryptonote::get_short_tx_id(short_ids, 2), 0xffffffffffffULL);
+}
+
+TEST(compact_block, salted)
+{
+  const cryptonote::blobdata stripped_block = "block";
+  const crypto::hash key0 = cryptonote::get_compact_block_key(stripped_block, 0);
+  const crypto::hash key1 = cryptonote::get_compact_block_key(stripped_block, 1);
+  ASSERT_NE(key0, key1);
+  ASSERT_EQ(key0, cryptonote::get_compact_block_key(stripped_block, 0));
+
+  const crypto::hash txid = crypto::rand<crypto::hash>();
+  const uint64_t short_id = cryptonote::get_short_tx_id(key0, txid);
+  ASSERT_EQ(short_id, cryptonote::get_short_tx_id(key0, txid));
+  ASSERT_NE(short_id, cryptonote::get_short_tx_id(key1, txid));
+  ASSERT_LT(short_id, 1ULL << (8 * COMPACT_BLOCK_SHORT_ID_SIZE));
+}
+
+TEST(compact_block, index)
+{
+  const crypto::hash key = crypto::rand<crypto::hash>();
+  cryptonote::short_tx_id_index index(key);
+  std::vector<crypto::hash> txids;
+  for (size_t n = 0; n < 1000; ++n)
+  {
+    txids.push_back(crypto::rand<crypto::hash>());
+    index.add(txids.back());
+  }
+  // adding a txid again does not make it ambiguous
+  index.add(txids.front());
+  ASSERT_EQ(index.size(), txids.size());
+
+  crypto::hash txid;
+  for (const auto &h: txids)
+  {
+    ASSERT_TRUE(index.find(cryptonote::get_short_tx_id(key, h), txid));
+    ASSERT_EQ(txid, h);
+  }
+  ASSERT_FALSE(index.find(cryptonote::get_short_tx_id(key, crypto::rand<crypto::hash>()), txid));
+}
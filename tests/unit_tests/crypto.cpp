@@ -33,6 +33,10 @@
 #include <string>
 
 #include "cryptonote_basic/cryptonote_basic_impl.h"
+#include "crypto/batch_verifier.h"
+#include "crypto/prepared_key_cache.h"
+#include "crypto/siphash.h"
+#include "common/threadpool.h"
 
 namespace
 {
@@ -170,3 +174,112 @@ TEST(Crypto, verify_32)
     }
   }
 }
+
+TEST(Crypto, batch_verify)
+{
+  static const size_t N = 37;
+  std::vector<crypto::public_key> pubs(N);
+  std::vector<crypto::signature> sigs(N);
+  std::vector<crypto::hash> hashes(N);
+  for (size_t i = 0; i < N; ++i)
+  {
+    crypto::secret_key sec;
+    crypto::generate_keys(pubs[i], sec);
+    hashes[i] = crypto::rand<crypto::hash>();
+    crypto::generate_signature(hashes[i], pubs[i], sec, sigs[i]);
+  }
+
+  std::shared_ptr<tools::threadpool> tpool(tools::threadpool::getNewForUnitTests(4));
+  crypto::batch_signature_verifier verifier;
+  for (size_t i = 0; i < N; ++i)
+    ASSERT_EQ(verifier.add(hashes[i], pubs[i], sigs[i]), i);
+
+  std::vector<uint64_t> results;
+  ASSERT_TRUE(verifier.verify(results, tpool.get()));
+  ASSERT_EQ(results.size(), N);
+
+  // corrupt one signature, only that one should fail, threaded or not
+  sigs[N / 2].data[0] ^= 1;
+  for (tools::threadpool *t: {tpool.get(), (tools::threadpool*)NULL})
+  {
+    ASSERT_FALSE(verifier.verify(results, t));
+    for (size_t i = 0; i < N; ++i)
+      ASSERT_EQ(results[i], i == N / 2 ? 0 : 1);
+  }
+}
+
+TEST(Crypto, prepared_public_key)
+{
+  crypto::public_key pub;
+  crypto::secret_key sec;
+  crypto::generate_keys(pub, sec);
+  const crypto::hash h = crypto::rand<crypto::hash>();
+  crypto::signature sig;
+  crypto::generate_signature(h, pub, sec, sig);
+
+  // must agree with the unprepared check, including on bad signatures
+  const crypto::prepared_public_key prepared(pub);
+  unsigned char m[sizeof(crypto::signature)];
+  unsigned long long mlen;
+  ASSERT_TRUE(crypto::check_signature(h, prepared, sig));
+  ASSERT_EQ(crypto::crypto_sign_dilithium_open(m, &mlen, (const unsigned char*)&sig, sizeof(sig), (const unsigned char*)&pub), 0);
+  for (size_t i = 0; i < sizeof(sig); i += 97)
+  {
+    crypto::signature bad = sig;
+    bad.data[i] ^= 0x10;
+    ASSERT_EQ(crypto::check_signature(h, prepared, bad), crypto::crypto_sign_dilithium_open(m, &mlen, (const unsigned char*)&bad, sizeof(bad), (const unsigned char*)&pub) == 0);
+  }
+}
+
+TEST(Crypto, prepared_key_cache)
+{
+  crypto::prepared_key_cache cache(4, 2);
+  std::vector<crypto::public_key> pubs(8);
+  for (auto &pub: pubs)
+  {
+    crypto::secret_key sec;
+    crypto::generate_keys(pub, sec);
+  }
+
+  auto p0 = cache.get(pubs[0]);
+  ASSERT_EQ(cache.get_misses(), 1);
+  ASSERT_EQ(cache.get(pubs[0]), p0);
+  ASSERT_EQ(cache.get_hits(), 1);
+
+  for (const auto &pub: pubs)
+    cache.get(pub);
+  ASSERT_LE(cache.size(), 4);
+  ASSERT_EQ(cache.get_hits() + cache.get_misses(), 10);
+}
+
+TEST(Crypto, siphash)
+{
+  // vectors from the SipHash paper's reference implementation, key and
+  // message bytes counting up from 0
+  uint64_t key[2];
+  unsigned char k[16], m[64];
+  for (size_t i = 0; i < sizeof(k); ++i)
+    k[i] = i;
+  for (size_t i = 0; i < sizeof(m); ++i)
+    m[i] = i;
+  memcpy(key, k, sizeof(key));
+  key[0] = SWAP64LE(key[0]);
+  key[1] = SWAP64LE(key[1]);
+  ASSERT_EQ(crypto::siphash(key, m, 0), 0x726fdb47dd0e0e31ull);
+  ASSERT_EQ(crypto::siphash(key, m, 15), 0xa129ca6149be45e5ull);
+  ASSERT_EQ(crypto::siphash(key, m, 63), 0x958a324ceb064572ull);
+}
+
+TEST(Crypto, key_fingerprint)
+{
+  // every byte counts, not only some sampled words
+  crypto::key_image ki;
+  memset(&ki, 0, sizeof(ki));
+  const uint64_t fingerprint = crypto::key_fingerprint(&ki, sizeof(ki));
+  for (size_t i = 0; i < sizeof(ki); ++i)
+  {
+    crypto::key_image other = ki;
+    other.data[i] ^= 1;
+    ASSERT_NE(crypto::key_fingerprint(&other, sizeof(other)), fingerprint);
+  }
+}
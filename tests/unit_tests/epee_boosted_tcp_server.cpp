@@ -80,6 +80,45 @@ namespace
   };
 
   typedef epee::net_utils::boosted_tcp_server<test_protocol_handler> test_tcp_server;
+
+  struct segmented_send_config
+  {
+    std::shared_ptr<const epee::byte_segments> m_message;
+  };
+
+  // sends the configured message as soon as a connection is accepted
+  struct segmented_send_protocol_handler
+  {
+    typedef test_connection_context connection_context;
+    typedef segmented_send_config config_type;
+
+    segmented_send_protocol_handler(epee::net_utils::i_service_endpoint* psnd_hndlr, config_type& config, connection_context& /*conn_context*/)
+      : m_psnd_hndlr(psnd_hndlr), m_config(config)
+    {
+    }
+
+    void after_init_connection()
+    {
+      m_psnd_hndlr->do_send(m_config.m_message);
+    }
+
+    void handle_qued_callback()
+    {
+    }
+
+    bool release_protocol()
+    {
+      return true;
+    }
+
+    bool handle_recv(const void* /*data*/, size_t /*size*/)
+    {
+      return false;
+    }
+
+    epee::net_utils::i_service_endpoint* m_psnd_hndlr;
+    config_type& m_config;
+  };
 }
 
 TEST(boosted_tcp_server, worker_threads_are_exception_resistant)
@@ -132,3 +171,29 @@ TEST(boosted_tcp_server, worker_threads_are_exception_resistant)
   ASSERT_TRUE(srv.timed_wait_server_stop(5 * 1000));
   ASSERT_TRUE(srv.deinit_server());
 }
+
+TEST(boosted_tcp_server, gather_writes_segmented_messages)
+{
+  const std::string blob(100000, 'b');
+  std::shared_ptr<epee::byte_segments> message = std::make_shared<epee::byte_segments>();
+  message->write("head", 4);
+  message->write_ref(blob.data(), blob.size());
+  message->write("tail", 4);
+
+  epee::net_utils::boosted_tcp_server<segmented_send_protocol_handler> srv(epee::net_utils::e_connection_type_RPC); // RPC disables network limit for unit tests
+  srv.get_config_object().m_message = message;
+  ASSERT_TRUE(srv.init_server(test_server_port, test_server_host));
+  ASSERT_TRUE(srv.run_server(2, false));
+
+  boost::asio::io_service io_service;
+  boost::asio::ip::tcp::socket socket(io_service);
+  socket.connect(boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string(test_server_host), test_server_port));
+  std::string received(message->size(), 0);
+  boost::asio::read(socket, boost::asio::buffer(&received[0], received.size()));
+  EXPECT_EQ(message->str(), received);
+  socket.close();
+
+  srv.send_stop_signal();
+  ASSERT_TRUE(srv.timed_wait_server_stop(5 * 1000));
+  ASSERT_TRUE(srv.deinit_server());
+}
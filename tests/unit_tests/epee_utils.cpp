@@ -33,6 +33,7 @@
 #include <cstdint>
 #include <gtest/gtest.h>
 #include <iterator>
+#include <list>
 #include <string>
 #include <sstream>
 #include <vector>
@@ -43,11 +44,13 @@
 
 #include "boost/archive/portable_binary_iarchive.hpp"
 #include "boost/archive/portable_binary_oarchive.hpp"
+#include "byte_segments.h"
 #include "hex.h"
 #include "net/net_utils_base.h"
 #include "net/local_ip.h"
 #include "p2p/net_peerlist_boost_serialization.h"
 #include "span.h"
+#include "storages/portable_storage_template_helper.h"
 #include "string_tools.h"
 
 namespace
@@ -372,6 +375,78 @@ TEST(Span, ToMutSpan)
   EXPECT_EQ((std::vector<unsigned>{1, 2, 3, 4}), mut);
 }
 
+TEST(ByteSegments, Writing)
+{
+  const std::string big(100, 'b');
+  epee::byte_segments segments;
+  EXPECT_EQ(0u, segments.size());
+  EXPECT_EQ(0u, segments.segment_count());
+
+  segments.write("ab", 2);
+  segments.write("cd", 2);
+  EXPECT_EQ(1u, segments.segment_count());
+  segments.write_ref(big.data(), big.size());
+  segments.write_ref(big.data(), 0);
+  segments.write("e", 1);
+  ASSERT_EQ(3u, segments.segment_count());
+  EXPECT_EQ(105u, segments.size());
+  EXPECT_EQ(big.data(), (const char*)segments.segment(1).data());
+  EXPECT_EQ("abcd" + big + "e", segments.str());
+}
+
+TEST(ByteSegments, Append)
+{
+  std::shared_ptr<epee::byte_segments> body = std::make_shared<epee::byte_segments>();
+  body->write("body", 4);
+  std::weak_ptr<epee::byte_segments> weak_body = body;
+
+  epee::byte_segments packet;
+  packet.write("head", 4);
+  packet.append(std::move(body));
+  packet.write("tail", 4);
+  EXPECT_FALSE(weak_body.expired());
+  EXPECT_EQ(3u, packet.segment_count());
+  EXPECT_EQ("headbodytail", packet.str());
+}
+
+namespace
+{
+  struct segmented_test_struct
+  {
+    std::string small_blob;
+    std::list<std::string> blobs;
+    uint64_t height;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(small_blob)
+      KV_SERIALIZE(blobs)
+      KV_SERIALIZE(height)
+    END_KV_SERIALIZE_MAP()
+  };
+}
+
+TEST(ByteSegments, PortableStorage)
+{
+  segmented_test_struct s;
+  s.small_blob = "small";
+  s.blobs.push_back(std::string(PORTABLE_STORAGE_MIN_REF_STRING_SIZE, 'x'));
+  s.blobs.push_back(std::string(100000, 'y'));
+  s.height = 42;
+
+  std::shared_ptr<const epee::byte_segments> segments = epee::serialization::store_t_to_segments(s);
+  ASSERT_TRUE(segments != nullptr);
+  EXPECT_LE(3u, segments->segment_count());
+  const std::string flat = epee::serialization::store_t_to_binary(s);
+  EXPECT_EQ(flat.size(), segments->size());
+  EXPECT_EQ(flat, segments->str());
+
+  segmented_test_struct loaded;
+  ASSERT_TRUE(epee::serialization::load_t_from_binary(loaded, segments->str()));
+  EXPECT_EQ(s.small_blob, loaded.small_blob);
+  EXPECT_EQ(s.blobs, loaded.blobs);
+  EXPECT_EQ(s.height, loaded.height);
+}
+
 TEST(ToHex, String)
 {
   EXPECT_TRUE(epee::to_hex::string(nullptr).empty());
@@ -0,0 +1,168 @@
+// Copyright (c) 2019, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <map>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <boost/archive/portable_binary_iarchive.hpp>
+#include <boost/archive/portable_binary_oarchive.hpp>
+#include "gtest/gtest.h"
+#include "crypto/crypto.h"
+#include "common/flat_hash_map.h"
+#include "common/unordered_containers_boost_serialization.h"
+#include "cryptonote_basic/cryptonote_boost_serialization.h"
+
+TEST(flat_hash_map, basic)
+{
+  tools::flat_hash_map<int, std::string> map;
+  ASSERT_TRUE(map.empty());
+  ASSERT_TRUE(map.find(0) == map.end());
+  ASSERT_TRUE(map.emplace(1, "one").second);
+  ASSERT_FALSE(map.emplace(1, "uno").second);
+  ASSERT_EQ(map.at(1), "one");
+  map[2] = "two";
+  ASSERT_EQ(map.size(), 2);
+  ASSERT_EQ(map.count(2), 1);
+  ASSERT_EQ(map.count(3), 0);
+  ASSERT_THROW(map.at(3), std::out_of_range);
+  ASSERT_EQ(map.erase(3), 0);
+  ASSERT_EQ(map.erase(1), 1);
+  ASSERT_TRUE(map.find(1) == map.end());
+  ASSERT_EQ(map.find(2)->second, "two");
+  map.clear();
+  ASSERT_TRUE(map.empty());
+  ASSERT_TRUE(map.find(2) == map.end());
+}
+
+TEST(flat_hash_map, matches_std_map)
+{
+  // small key range, so most operations hit a key inserted or erased
+  // before, and erases shift back runs at every load
+  tools::flat_hash_map<uint32_t, uint32_t> map;
+  std::map<uint32_t, uint32_t> ref;
+  for (int n = 0; n < 100000; ++n)
+  {
+    const uint32_t k = crypto::rand<uint32_t>() % 2000;
+    if (crypto::rand<uint8_t>() & 1)
+    {
+      map[k] = n;
+      ref[k] = n;
+    }
+    else
+    {
+      ASSERT_EQ(map.erase(k), ref.erase(k));
+    }
+  }
+  ASSERT_EQ(map.size(), ref.size());
+  for (const auto &e: ref)
+  {
+    const auto i = map.find(e.first);
+    ASSERT_TRUE(i != map.end());
+    ASSERT_EQ(i->second, e.second);
+  }
+  size_t n = 0;
+  for (const auto &e: map)
+  {
+    ASSERT_EQ(ref[e.first], e.second);
+    ++n;
+  }
+  ASSERT_EQ(n, ref.size());
+}
+
+TEST(flat_hash_map, erase_while_iterating)
+{
+  tools::flat_hash_map<int, int> map;
+  for (int n = 0; n < 1000; ++n)
+    map[n] = n;
+  for (auto i = map.begin(); i != map.end(); )
+  {
+    if (i->second % 3)
+      i = map.erase(i);
+    else
+      ++i;
+  }
+  ASSERT_EQ(map.size(), 334);
+  for (const auto &e: map)
+    ASSERT_EQ(e.first % 3, 0);
+}
+
+TEST(flat_hash_map, large_keys)
+{
+  tools::flat_hash_map<crypto::key_image, size_t, crypto::fingerprint_hash<crypto::key_image>> map;
+  std::vector<crypto::key_image> keys(100);
+  for (size_t n = 0; n < keys.size(); ++n)
+  {
+    // only differ in the last byte, which the std::hash of key_image ignores
+    memset(&keys[n], 0, sizeof(keys[n]));
+    keys[n].data[sizeof(keys[n].data) - 1] = n;
+    ASSERT_TRUE(map.emplace(keys[n], n).second);
+  }
+  ASSERT_NE(crypto::key_fingerprint(&keys[0], sizeof(keys[0])), crypto::key_fingerprint(&keys[1], sizeof(keys[1])));
+  for (size_t n = 0; n < keys.size(); ++n)
+    ASSERT_EQ(map.at(keys[n]), n);
+}
+
+TEST(flat_hash_map, boost_serialization)
+{
+  // the wallet cache has these saved as std::unordered_map
+  typedef tools::flat_hash_map<crypto::key_image, size_t, crypto::fingerprint_hash<crypto::key_image>> flat_map;
+  flat_map map;
+  for (size_t n = 0; n < 100; ++n)
+    map.emplace(crypto::rand<crypto::key_image>(), n);
+
+  std::stringstream ss;
+  {
+    boost::archive::portable_binary_oarchive ar(ss);
+    ar << map;
+  }
+  std::unordered_map<crypto::key_image, size_t> std_map;
+  {
+    boost::archive::portable_binary_iarchive ar(ss);
+    ar >> std_map;
+  }
+  ASSERT_EQ(std_map.size(), map.size());
+  for (const auto &e: map)
+    ASSERT_EQ(std_map.at(e.first), e.second);
+
+  std::stringstream ss2;
+  {
+    boost::archive::portable_binary_oarchive ar(ss2);
+    ar << std_map;
+  }
+  flat_map map2;
+  map2.emplace(crypto::rand<crypto::key_image>(), 0);
+  {
+    boost::archive::portable_binary_iarchive ar(ss2);
+    ar >> map2;
+  }
+  ASSERT_EQ(map2.size(), map.size());
+  for (const auto &e: map)
+    ASSERT_EQ(map2.at(e.first), e.second);
+}
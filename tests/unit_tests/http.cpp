@@ -61,6 +61,11 @@
 #include "md5_l.h"
 #include "string_tools.h"
 #include "crypto/crypto.h"
+#include "net/abstract_tcp_server2.h"
+#include "net/http_client.h"
+#include "net/http_protocol_handler.h"
+#include "serialization/keyvalue_serialization.h"
+#include "storages/http_abstract_invoke.h"
 
 namespace {
 namespace http = epee::net_utils::http;
@@ -743,3 +748,70 @@ TEST(HTTP, Add_Field)
 
   EXPECT_STREQ("leading textfoo: bar\r\nbar: foo\r\nmoarbars: moarfoo\r\n", str.c_str());
 }
+
+namespace
+{
+  struct stream_page
+  {
+    uint64_t index;
+    std::string data;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(index)
+      KV_SERIALIZE(data)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  // streams three large pages, each produced only once the previous one is sent
+  struct stream_handler: http::i_http_server_handler<epee::net_utils::connection_context_base>
+  {
+    virtual bool handle_http_request(const http::http_request_info& query_info, http::http_response_info& response, epee::net_utils::connection_context_base& context)
+    {
+      std::shared_ptr<uint64_t> next = std::make_shared<uint64_t>(0);
+      response.m_body_stream = [next](std::string& piece) -> bool
+      {
+        if (*next == 3)
+          return true;
+        stream_page page{*next, std::string(200000, 'a' + *next)};
+        ++*next;
+        return epee::serialization::store_t_to_binary_frame(page, piece);
+      };
+      return true;
+    }
+  };
+}
+
+TEST(HTTP_Server, StreamedBody)
+{
+  typedef http::http_custom_handler<epee::net_utils::connection_context_base> handler_type;
+  stream_handler handler;
+  epee::net_utils::boosted_tcp_server<handler_type> srv(epee::net_utils::e_connection_type_RPC);
+  srv.get_config_object().m_phandler = &handler;
+  srv.get_config_object().rng = rng;
+  ASSERT_TRUE(srv.init_server(5627, "127.0.0.1"));
+  ASSERT_TRUE(srv.run_server(2, false));
+
+  http::http_simple_client client;
+  client.set_server("127.0.0.1", "5627", boost::none);
+  // twice, to check the connection is usable again once the body is done
+  for (int i = 0; i < 2; ++i)
+  {
+    std::vector<stream_page> pages;
+    const std::function<bool(stream_page&)> on_page = [&pages](stream_page& page) { pages.push_back(page); return true; };
+    ASSERT_TRUE(epee::net_utils::invoke_http_bin_stream("/", stream_page(), on_page, client));
+    ASSERT_EQ(3, pages.size());
+    for (uint64_t n = 0; n < pages.size(); ++n)
+    {
+      EXPECT_EQ(n, pages[n].index);
+      EXPECT_EQ(std::string(200000, 'a' + n), pages[n].data);
+    }
+  }
+
+  // a page rejected by the client ends the call
+  const std::function<bool(stream_page&)> reject = [](stream_page&) { return false; };
+  EXPECT_FALSE(epee::net_utils::invoke_http_bin_stream("/", stream_page(), reject, client));
+
+  srv.send_stop_signal();
+  ASSERT_TRUE(srv.timed_wait_server_stop(5 * 1000));
+  ASSERT_TRUE(srv.deinit_server());
+}
@@ -46,10 +46,11 @@ private:
   {
     size_t weight;
     uint64_t long_term_weight;
+    crypto::hash id;
   };
 
 public:
-  TestDB() { m_open = true; }
+  TestDB(): added(0) { m_open = true; }
 
   virtual void add_block( const cryptonote::block& blk
                         , size_t block_weight
@@ -59,22 +60,21 @@ public:
                         , uint64_t num_rct_outs
                         , const crypto::hash& blk_hash
                         ) override {
-    blocks.push_back({block_weight, long_term_block_weight});
+    // give each added block its own id, so a block added after a pop does not look like the popped one
+    crypto::hash id = crypto::null_hash;
+    *(uint64_t*)&id = ++added;
+    blocks.push_back({block_weight, long_term_block_weight, id});
   }
   virtual uint64_t height() const override { return blocks.size(); }
   virtual size_t get_block_weight(const uint64_t &h) const override { return blocks[h].weight; }
   virtual uint64_t get_block_long_term_weight(const uint64_t &h) const override { return blocks[h].long_term_weight; }
-  virtual crypto::hash top_block_hash() const override {
-    uint64_t h = height();
-    crypto::hash top = crypto::null_hash;
-    if (h)
-      *(uint64_t*)&top = h - 1;
-    return top;
-  }
+  virtual crypto::hash get_block_hash_from_height(const uint64_t &h) const override { return blocks[h].id; }
+  virtual crypto::hash top_block_hash() const override { return blocks.empty() ? crypto::null_hash : blocks.back().id; }
   virtual void pop_block(cryptonote::block &blk, std::vector<cryptonote::transaction> &txs) override { blocks.pop_back(); }
 
 private:
   std::vector<block_t> blocks;
+  uint64_t added;
 };
 
 static uint32_t lcg_seed = 0;
@@ -85,6 +85,48 @@ static uint32_t lcg()
   return lcg_seed;
 }
 
+// the median computations as they were before the weights windows were kept
+// across blocks, reloading every weight from the db
+static uint64_t reference_next_long_term_block_weight(const cryptonote::BlockchainDB &db, uint64_t window, uint64_t block_weight)
+{
+  const uint64_t db_height = db.height();
+  const uint64_t nblocks = std::min<uint64_t>(window, db_height);
+  std::vector<uint64_t> weights(nblocks);
+  for (uint64_t h = 0; h < nblocks; ++h)
+    weights[h] = db.get_block_long_term_weight(db_height - nblocks + h);
+  const uint64_t long_term_effective_median_block_weight = std::max<uint64_t>(CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V5, epee::misc_utils::median(weights));
+  return std::min<uint64_t>(block_weight, long_term_effective_median_block_weight + long_term_effective_median_block_weight * 2 / 5);
+}
+
+static void reference_weight_limit(const cryptonote::BlockchainDB &db, uint64_t window, uint64_t &median, uint64_t &long_term_effective_median_block_weight)
+{
+  const uint64_t db_height = db.height();
+  std::vector<uint64_t> weights, new_weights;
+  uint64_t long_term_median = CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V5;
+  if (db_height > 1)
+  {
+    uint64_t nblocks = std::min<uint64_t>(window, db_height);
+    if (nblocks == db_height)
+      --nblocks;
+    weights.resize(nblocks);
+    for (uint64_t h = 0; h < nblocks; ++h)
+      weights[h] = db.get_block_long_term_weight(db_height - nblocks + h - 1);
+    new_weights = weights;
+    long_term_median = epee::misc_utils::median(weights);
+  }
+  long_term_effective_median_block_weight = std::max<uint64_t>(CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V5, long_term_median);
+  const uint64_t short_term_constraint = long_term_effective_median_block_weight + long_term_effective_median_block_weight * 2 / 5;
+  if (new_weights.empty())
+    new_weights.resize(1);
+  new_weights[0] = std::min<uint64_t>(db.get_block_weight(db_height - 1), short_term_constraint);
+  long_term_effective_median_block_weight = std::max<uint64_t>(CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V5, epee::misc_utils::median(new_weights));
+
+  weights.clear();
+  for (uint64_t h = db_height - std::min<uint64_t>(db_height, CRYPTONOTE_REWARD_BLOCKS_WINDOW); h < db_height; ++h)
+    weights.push_back(db.get_block_weight(h));
+  median = std::min<uint64_t>(std::max<uint64_t>(CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V5, epee::misc_utils::median(weights)), CRYPTONOTE_SHORT_TERM_BLOCK_WEIGHT_SURGE_FACTOR * long_term_effective_median_block_weight);
+}
+
 }
 
 #define PREFIX_WINDOW(hf_version,window) \
@@ -382,3 +424,49 @@ TEST(long_term_block_weight, long_growth_spike_and_drop)
   ASSERT_GT(long_term_effective_median_block_weight, 300000 * 1.07);
   ASSERT_LT(long_term_effective_median_block_weight, 300000 * 1.09);
 }
+
+TEST(long_term_block_weight, matches_full_recompute_across_reorgs)
+{
+  static const uint64_t window = 300;
+  PREFIX_WINDOW(10, window);
+
+  lcg_seed = 42;
+  for (int n = 0; n < 400; ++n)
+  {
+    // mostly grow the chain, with the odd reorg, sometimes deeper than the window
+    const uint32_t r = lcg();
+    const uint64_t max_remove = bc->get_db().height() - 1;
+    const uint64_t remove = std::min<uint64_t>(max_remove, r % 16 == 0 ? lcg() % (2 * window) : r % 4 == 0 ? lcg() % 8 : 0);
+    const uint64_t add = 1 + lcg() % 40;
+
+    for (uint64_t i = 0; i < remove; ++i)
+    {
+      cryptonote::block b;
+      std::vector<cryptonote::transaction> txs;
+      bc->get_db().pop_block(b, txs);
+    }
+    if (remove > 0)
+    {
+      uint64_t long_term_effective_median_block_weight, expected_median, expected_long_term_effective_median_block_weight;
+      ASSERT_TRUE(bc->update_next_cumulative_weight_limit(&long_term_effective_median_block_weight));
+      reference_weight_limit(bc->get_db(), window, expected_median, expected_long_term_effective_median_block_weight);
+      ASSERT_EQ(long_term_effective_median_block_weight, expected_long_term_effective_median_block_weight);
+      ASSERT_EQ(bc->get_current_cumulative_block_weight_median(), std::max<uint64_t>(expected_median, CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V5));
+    }
+
+    for (uint64_t i = 0; i < add; ++i)
+    {
+      const uint64_t limit = bc->get_current_cumulative_block_weight_limit();
+      const size_t w = lcg() % 3 == 0 ? limit : lcg() % limit;
+      const uint64_t ltw = bc->get_next_long_term_block_weight(w);
+      ASSERT_EQ(ltw, reference_next_long_term_block_weight(bc->get_db(), window, w));
+      bc->get_db().add_block(cryptonote::block(), w, ltw, bc->get_db().height(), bc->get_db().height(), {});
+
+      uint64_t long_term_effective_median_block_weight, expected_median, expected_long_term_effective_median_block_weight;
+      ASSERT_TRUE(bc->update_next_cumulative_weight_limit(&long_term_effective_median_block_weight));
+      reference_weight_limit(bc->get_db(), window, expected_median, expected_long_term_effective_median_block_weight);
+      ASSERT_EQ(long_term_effective_median_block_weight, expected_long_term_effective_median_block_weight);
+      ASSERT_EQ(bc->get_current_cumulative_block_weight_median(), std::max<uint64_t>(expected_median, CRYPTONOTE_BLOCK_GRANTED_FULL_REWARD_ZONE_V5));
+    }
+  }
+}
@@ -0,0 +1,149 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <atomic>
+#include <memory>
+
+#include "gtest/gtest.h"
+#include "common/threadpool.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/output_prefetch.h"
+#include "blockchain_db/testdb.h"
+
+namespace
+{
+
+// every amount has 1000 outputs, whose unlock time encodes amount and index
+class TestDB: public cryptonote::BaseTestDB
+{
+public:
+  TestDB(): unsorted(false) { m_open = true; }
+
+  virtual void get_output_key(const uint64_t &amount, const std::vector<uint64_t> &offsets, std::vector<cryptonote::output_data_t> &outputs, bool allow_partial = false) override
+  {
+    outputs.clear();
+    for (size_t i = 0; i < offsets.size(); ++i)
+    {
+      if (i > 0 && offsets[i] <= offsets[i - 1])
+        unsorted = true;
+      if (offsets[i] >= 1000)
+        break;
+      cryptonote::output_data_t data = cryptonote::output_data_t();
+      data.unlock_time = amount * 1000 + offsets[i];
+      data.height = offsets[i];
+      outputs.push_back(data);
+    }
+  }
+  virtual bool can_thread_bulk_indices() const override { return true; }
+
+  std::atomic<bool> unsorted;
+};
+
+void check_found(const cryptonote::output_prefetcher &prefetch, uint64_t amount, uint64_t index)
+{
+  const cryptonote::output_data_t *data = prefetch.find(amount, index);
+  ASSERT_TRUE(data != NULL);
+  ASSERT_EQ(data->unlock_time, amount * 1000 + index);
+  ASSERT_EQ(data->height, index);
+}
+
+}
+
+TEST(output_prefetch, empty)
+{
+  TestDB db;
+  cryptonote::output_prefetcher prefetch;
+  prefetch.start(db, NULL);
+  prefetch.wait();
+  ASSERT_EQ(prefetch.size(), 0);
+  ASSERT_TRUE(prefetch.find(0, 0) == NULL);
+}
+
+TEST(output_prefetch, find)
+{
+  TestDB db;
+  cryptonote::output_prefetcher prefetch;
+  prefetch.add(5, 40);
+  prefetch.add(0, 7);
+  prefetch.add(5, 3);
+  prefetch.add(0, 7);
+  prefetch.add(0, 2);
+  prefetch.start(db, NULL);
+  prefetch.wait();
+
+  ASSERT_FALSE(db.unsorted);
+  ASSERT_EQ(prefetch.size(), 4);
+  check_found(prefetch, 0, 2);
+  check_found(prefetch, 0, 7);
+  check_found(prefetch, 5, 3);
+  check_found(prefetch, 5, 40);
+  ASSERT_TRUE(prefetch.find(0, 3) == NULL);
+  ASSERT_TRUE(prefetch.find(5, 7) == NULL);
+  ASSERT_TRUE(prefetch.find(1, 2) == NULL);
+}
+
+TEST(output_prefetch, partial)
+{
+  TestDB db;
+  cryptonote::output_prefetcher prefetch;
+  prefetch.add(0, 998);
+  prefetch.add(0, 999);
+  prefetch.add(0, 1000);
+  prefetch.add(0, 1200);
+  prefetch.start(db, NULL);
+  prefetch.wait();
+
+  check_found(prefetch, 0, 998);
+  check_found(prefetch, 0, 999);
+  ASSERT_TRUE(prefetch.find(0, 1000) == NULL);
+  ASSERT_TRUE(prefetch.find(0, 1200) == NULL);
+}
+
+TEST(output_prefetch, threaded)
+{
+  std::shared_ptr<tools::threadpool> tpool(tools::threadpool::getNewForUnitTests(4));
+  TestDB db;
+  cryptonote::output_prefetcher prefetch;
+  // enough for several chunks of one amount, and many small amounts
+  for (uint64_t index = 1100; index-- > 0; )
+    prefetch.add(0, index);
+  for (uint64_t amount = 1; amount < 100; ++amount)
+    prefetch.add(amount, amount);
+  prefetch.start(db, tpool.get());
+  prefetch.wait();
+
+  ASSERT_FALSE(db.unsorted);
+  ASSERT_EQ(prefetch.size(), 1100 + 99);
+  for (uint64_t index = 0; index < 1000; ++index)
+    check_found(prefetch, 0, index);
+  for (uint64_t index = 1000; index < 1100; ++index)
+    ASSERT_TRUE(prefetch.find(0, index) == NULL);
+  for (uint64_t amount = 1; amount < 100; ++amount)
+    check_found(prefetch, amount, amount);
+}
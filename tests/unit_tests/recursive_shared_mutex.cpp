@@ -0,0 +1,98 @@
+// Copyright (c) 2019, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <atomic>
+#include <thread>
+#include <boost/thread/shared_lock_guard.hpp>
+#include "gtest/gtest.h"
+#include "common/recursive_shared_mutex.h"
+
+TEST(recursive_shared_mutex, recursive_owner)
+{
+  tools::recursive_shared_mutex mutex;
+  mutex.lock();
+  mutex.lock();
+  ASSERT_TRUE(mutex.try_lock());
+  mutex.lock_shared();
+  mutex.unlock_shared();
+  mutex.unlock();
+  mutex.unlock();
+
+  // still held, other threads can take it neither way
+  std::atomic<bool> locked(false);
+  std::thread t([&](){ locked = mutex.try_lock(); if (locked) mutex.unlock(); });
+  t.join();
+  ASSERT_FALSE(locked);
+
+  mutex.unlock();
+  std::thread t2([&](){ locked = mutex.try_lock(); if (locked) mutex.unlock(); });
+  t2.join();
+  ASSERT_TRUE(locked);
+}
+
+TEST(recursive_shared_mutex, readers_and_writers)
+{
+  tools::recursive_shared_mutex mutex;
+  std::atomic<int> readers(0), max_readers(0);
+  int value = 0;
+  std::atomic<bool> torn(false);
+  std::vector<std::thread> threads;
+  for (int n = 0; n < 8; ++n)
+  {
+    threads.push_back(std::thread([&, n](){
+      for (int i = 0; i < 2000; ++i)
+      {
+        if ((i + n) % 4)
+        {
+          boost::shared_lock_guard<tools::recursive_shared_mutex> lock(mutex);
+          const int r = ++readers;
+          for (int m = max_readers; r > m && !max_readers.compare_exchange_weak(m, r); ) {}
+          if (value % 2)
+            torn = true;
+          --readers;
+        }
+        else
+        {
+          mutex.lock();
+          // nested, as when a writer calls back into its object
+          mutex.lock_shared();
+          if (readers != 0)
+            torn = true;
+          ++value;
+          ++value;
+          mutex.unlock_shared();
+          mutex.unlock();
+        }
+      }
+    }));
+  }
+  for (auto &t: threads)
+    t.join();
+  ASSERT_FALSE(torn);
+  ASSERT_EQ(value, 8 * 2000 / 4 * 2);
+}
@@ -37,6 +37,8 @@
 #include <boost/archive/portable_binary_iarchive.hpp>
 #include "cryptonote_basic/cryptonote_basic.h"
 #include "cryptonote_basic/cryptonote_basic_impl.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "common/int-util.h"
 #include "ringct/rctSigs.h"
 #include "serialization/binary_archive.h"
 #include "serialization/json_archive.h"
@@ -464,3 +466,28 @@ TEST(Serialization, serializes_transacion_signatures_correctly)
     blob.resize(blob.size() + sizeof(crypto::signature) / 2);
     ASSERT_FALSE(serialization::parse_binary(blob, tx1));
 }
+
+TEST(Serialization, block_hashing_blob_nonce_offset)
+{
+  cryptonote::block b;
+  b.major_version = 7;
+  b.minor_version = 200;
+  b.prev_id = crypto::rand<crypto::hash>();
+  b.miner_tx.version = 2;
+
+  for (uint64_t timestamp: {UINT64_C(0), UINT64_C(127), UINT64_C(128), UINT64_C(1537000000), std::numeric_limits<uint64_t>::max()})
+  {
+    b.timestamp = timestamp;
+    b.nonce = 0;
+    b.invalidate_hashes();
+    cryptonote::blobdata patched = cryptonote::get_block_hashing_blob(b);
+    const size_t offset = cryptonote::get_block_hashing_blob_nonce_offset(b);
+    ASSERT_LE(offset + sizeof(b.nonce), patched.size());
+
+    b.nonce = 0xdeadbeef;
+    b.invalidate_hashes();
+    const uint32_t nonce = SWAP32LE(b.nonce);
+    memcpy(&patched[offset], &nonce, sizeof(nonce));
+    ASSERT_EQ(cryptonote::get_block_hashing_blob(b), patched);
+  }
+}
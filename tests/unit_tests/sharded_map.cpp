@@ -0,0 +1,100 @@
+// Copyright (c) 2019, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+#include "common/sharded_map.h"
+
+TEST(sharded_map, insert_erase)
+{
+  tools::sharded_multimap<int, int> map;
+  ASSERT_TRUE(map.insert(1, 10));
+  ASSERT_FALSE(map.insert(1, 10));
+  ASSERT_TRUE(map.insert(1, 11));
+  ASSERT_FALSE(map.insert(1, 12, false));
+  ASSERT_TRUE(map.insert(2, 20, false));
+  ASSERT_TRUE(map.contains(1));
+  ASSERT_FALSE(map.contains(3));
+  ASSERT_EQ(map.size(), 2);
+  ASSERT_EQ(map.get(1).size(), 2);
+  ASSERT_TRUE(map.get(3).empty());
+
+  ASSERT_FALSE(map.erase(1, 12));
+  ASSERT_TRUE(map.erase(1, 10));
+  ASSERT_TRUE(map.contains(1));
+  ASSERT_TRUE(map.erase(1, 11));
+  ASSERT_FALSE(map.contains(1));
+  ASSERT_EQ(map.size(), 1);
+
+  map.clear();
+  ASSERT_EQ(map.size(), 0);
+}
+
+TEST(sharded_map, for_each)
+{
+  tools::sharded_multimap<int, int> map;
+  for (int i = 0; i < 1000; ++i)
+    ASSERT_TRUE(map.insert(i, i * 2));
+  size_t n = 0, sum = 0;
+  map.for_each([&n, &sum](int k, const std::unordered_set<int> &v) {
+    ++n;
+    ASSERT_EQ(v.size(), 1);
+    ASSERT_EQ(*v.begin(), k * 2);
+    sum += k;
+  });
+  ASSERT_EQ(n, 1000);
+  ASSERT_EQ(sum, 999 * 1000 / 2);
+}
+
+TEST(sharded_map, concurrent_exclusive_insert)
+{
+  // with allow_existing false, exactly one of several racing inserts
+  // for the same key must win
+  static const int N = 4;
+  static const int keys = 10000;
+  tools::sharded_multimap<int, int> map;
+  std::vector<int> won(N, 0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < N; ++t)
+  {
+    threads.push_back(std::thread([&map, &won, t]() {
+      for (int k = 0; k < keys; ++k)
+        if (map.insert(k, t, false))
+          ++won[t];
+    }));
+  }
+  for (auto &thread: threads)
+    thread.join();
+  int total = 0;
+  for (int t = 0; t < N; ++t)
+    total += won[t];
+  ASSERT_EQ(total, keys);
+  ASSERT_EQ(map.size(), keys);
+}
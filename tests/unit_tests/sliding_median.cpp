@@ -0,0 +1,81 @@
+// Copyright (c) 2019, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <deque>
+#include <vector>
+#include "gtest/gtest.h"
+#include "misc_language.h"
+#include "common/sliding_median.h"
+
+TEST(sliding_median, basic)
+{
+  tools::sliding_median<uint64_t> m;
+  ASSERT_TRUE(m.empty());
+  ASSERT_EQ(m.median(), 0);
+  m.insert(5);
+  ASSERT_EQ(m.median(), 5);
+  m.insert(1);
+  ASSERT_EQ(m.median(), 3);
+  m.insert(5);
+  ASSERT_EQ(m.median(), 5);
+  ASSERT_EQ(m.size(), 3);
+  ASSERT_FALSE(m.erase(4));
+  ASSERT_TRUE(m.erase(5));
+  ASSERT_EQ(m.median(), 3);
+  ASSERT_TRUE(m.erase(5));
+  ASSERT_FALSE(m.erase(5));
+  ASSERT_EQ(m.median(), 1);
+  m.clear();
+  ASSERT_TRUE(m.empty());
+  ASSERT_EQ(m.median(), 0);
+}
+
+TEST(sliding_median, matches_epee_median)
+{
+  tools::sliding_median<uint64_t> m;
+  std::deque<uint64_t> window;
+  uint32_t seed = 17;
+  for (int i = 0; i < 20000; ++i)
+  {
+    seed = seed * 1103515245 + 12345;
+    // a narrow range of values so duplicates are common
+    const uint64_t v = (seed >> 16) % 64;
+    const size_t max_size = 1 + (seed >> 8) % 101;
+    m.insert(v);
+    window.push_back(v);
+    while (window.size() > max_size)
+    {
+      ASSERT_TRUE(m.erase(window.front()));
+      window.pop_front();
+    }
+    std::vector<uint64_t> values(window.begin(), window.end());
+    ASSERT_EQ(m.size(), values.size());
+    ASSERT_EQ(m.median(), epee::misc_utils::median(values));
+  }
+}
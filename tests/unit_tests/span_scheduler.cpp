@@ -0,0 +1,97 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+#include <boost/uuid/uuid.hpp>
+#include "gtest/gtest.h"
+#include "crypto/crypto.h"
+#include "cryptonote_protocol/span_scheduler.h"
+
+static const boost::uuids::uuid &uuid1()
+{
+  static const boost::uuids::uuid uuid = crypto::rand<boost::uuids::uuid>();
+  return uuid;
+}
+
+static const boost::uuids::uuid &uuid2()
+{
+  static const boost::uuids::uuid uuid = crypto::rand<boost::uuids::uuid>();
+  return uuid;
+}
+
+TEST(span_scheduler, unmeasured)
+{
+  cryptonote::span_scheduler ss;
+  ASSERT_EQ(ss.get_span_blocks(uuid1(), 20), 20);
+  ASSERT_EQ(ss.get_expected_bytes(10), 0);
+  ASSERT_LT(ss.get_expected_duration(uuid1(), 10), 0);
+  ss.add_latency_sample(uuid1(), 0.1, 1000);
+  ASSERT_EQ(ss.get_span_blocks(uuid1(), 20), 20);
+}
+
+TEST(span_scheduler, sized_by_throughput)
+{
+  cryptonote::span_scheduler ss;
+  // 20 blocks of 50 kB in one second, and in ten seconds
+  ss.add_span_sample(uuid1(), 1.0, 1000000, 20);
+  ss.add_span_sample(uuid2(), 10.0, 1000000, 20);
+  ASSERT_EQ(ss.get_expected_bytes(10), 500000);
+  ASSERT_EQ(ss.get_span_blocks(uuid1(), 20), 20);
+  ASSERT_EQ(ss.get_span_blocks(uuid2(), 20), 2);
+  ASSERT_NEAR(ss.get_expected_duration(uuid1(), 20), 1.0, 1e-6);
+  ASSERT_TRUE(ss.is_fastest(uuid1(), {uuid1(), uuid2()}));
+  ASSERT_FALSE(ss.is_fastest(uuid2(), {uuid1(), uuid2()}));
+
+  ss.remove_connection(uuid1());
+  ASSERT_EQ(ss.get_span_blocks(uuid1(), 20), 20);
+  ASSERT_TRUE(ss.is_fastest(uuid2(), {uuid1(), uuid2()}));
+}
+
+TEST(span_scheduler, latency)
+{
+  cryptonote::span_scheduler ss;
+  // latency is taken out of the transfer time, and long round trips
+  // get larger spans
+  ss.add_latency_sample(uuid1(), 0.5, 0);
+  ss.add_span_sample(uuid1(), 1.5, 1000000, 20);
+  ASSERT_EQ(ss.get_span_blocks(uuid1(), 20), 80);
+  ASSERT_NEAR(ss.get_expected_duration(uuid1(), 80), 4.5, 1e-6);
+
+  // a higher sample only moves the estimate a little
+  ss.add_latency_sample(uuid1(), 5.0, 0);
+  ASSERT_LT(ss.get_expected_duration(uuid1(), 80), 5.5);
+}
+
+TEST(span_scheduler, bounds)
+{
+  cryptonote::span_scheduler ss;
+  ss.add_span_sample(uuid1(), 1.0, 1000000000, 1000000);
+  ASSERT_EQ(ss.get_span_blocks(uuid1(), 20), 1000);
+  ss.add_span_sample(uuid2(), 100.0, 1000, 1);
+  ASSERT_EQ(ss.get_span_blocks(uuid2(), 20), 1);
+}
@@ -32,12 +32,94 @@
 
 #include <vector>
 
+#include "common/threadpool.h"
 #include "common/util.h"
+#include "cryptonote_basic/account.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
 #include "cryptonote_core/cryptonote_tx_utils.h"
 
 namespace
 {
   uint64_t const TEST_FEE = 5000000000; // 5 * 10^9
+
+  // spends all of a miner tx's outputs to another address, with a given tx key
+  bool construct_spend(const cryptonote::account_base &from, const cryptonote::transaction &source, const cryptonote::account_public_address &to,
+      const cryptonote::keypair &tx_key, cryptonote::transaction &tx)
+  {
+    std::vector<cryptonote::tx_source_entry> sources;
+    uint64_t amount = 0;
+    for (size_t n = 0; n < source.vout.size(); ++n)
+    {
+      cryptonote::tx_source_entry src = AUTO_VAL_INIT(src);
+      src.outputs.push_back(std::make_pair(n, boost::get<cryptonote::txout_to_key>(source.vout[n].target).key));
+      src.real_output = 0;
+      src.real_out_tx_key = cryptonote::get_tx_pub_key_from_extra(source);
+      src.real_output_in_tx_index = n;
+      src.amount = source.vout[n].amount;
+      amount += src.amount;
+      sources.push_back(src);
+    }
+    std::vector<cryptonote::tx_destination_entry> destinations(1, cryptonote::tx_destination_entry(amount, to, false));
+    std::unordered_map<crypto::public_key, cryptonote::subaddress_index> subaddresses;
+    subaddresses[from.get_keys().m_account_address.m_spend_public_key] = {0,0};
+    return cryptonote::construct_tx_with_tx_key(from.get_keys(), subaddresses, sources, destinations, boost::none, std::vector<uint8_t>(), tx, 0,
+        tx_key.sec, tx_key.pub, std::vector<crypto::secret_key>(), false, { rct::RangeProofBorromean, 0 }, NULL, false);
+  }
+
+  // the per input and output random seeds are the only part not set by the
+  // sources, destinations and keys
+  void clear_random(cryptonote::transaction &tx)
+  {
+    for (cryptonote::txin_v &in: tx.vin)
+      if (in.type() == typeid(cryptonote::txin_to_key))
+        memset(&boost::get<cryptonote::txin_to_key>(in).random, 0, sizeof(crypto::pq_seed));
+    for (cryptonote::tx_out &out: tx.vout)
+      memset(&out.random, 0, sizeof(out.random));
+  }
+}
+
+TEST(construct_tx, concurrent_matches_sequential)
+{
+  // the wallet builds its candidate transactions on the thread pool, and
+  // each of them signs its inputs on the thread pool too
+  cryptonote::account_base from, to;
+  from.generate();
+  to.generate();
+  const size_t count = 4;
+  std::vector<cryptonote::transaction> sources(count);
+  std::vector<cryptonote::keypair> tx_keys;
+  for (cryptonote::transaction &source: sources)
+  {
+    ASSERT_TRUE(cryptonote::construct_miner_tx(0, 0, 5000, 500, 500, from.get_keys().m_account_address, source));
+    tx_keys.push_back(cryptonote::keypair::generate(from.get_keys().get_device()));
+  }
+
+  std::vector<cryptonote::transaction> sequential(count), concurrent(count);
+  for (size_t n = 0; n < count; ++n)
+    ASSERT_TRUE(construct_spend(from, sources[n], to.get_keys().m_account_address, tx_keys[n], sequential[n]));
+
+  std::vector<char> success(count, 0);
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  tools::threadpool::waiter waiter;
+  for (size_t n = 0; n < count; ++n)
+    tpool.submit(&waiter, [&, n] { success[n] = construct_spend(from, sources[n], to.get_keys().m_account_address, tx_keys[n], concurrent[n]); });
+  waiter.wait(&tpool);
+
+  for (size_t n = 0; n < count; ++n)
+  {
+    ASSERT_TRUE(success[n]);
+    const crypto::hash prefix_hash = cryptonote::get_transaction_prefix_hash(concurrent[n]);
+    ASSERT_EQ(concurrent[n].signatures.size(), concurrent[n].vin.size());
+    for (const std::vector<crypto::signature> &signatures: concurrent[n].signatures)
+    {
+      ASSERT_EQ(signatures.size(), 1);
+      ASSERT_TRUE(crypto::check_signature(prefix_hash, from.get_keys().m_account_address.m_spend_public_key, signatures[0]));
+    }
+    clear_random(sequential[n]);
+    clear_random(concurrent[n]);
+    ASSERT_EQ(cryptonote::t_serializable_object_to_blob(static_cast<const cryptonote::transaction_prefix&>(concurrent[n])),
+        cryptonote::t_serializable_object_to_blob(static_cast<const cryptonote::transaction_prefix&>(sequential[n])));
+  }
 }
 
 TEST(parse_tx_extra, handles_empty_extra)
@@ -26,10 +26,12 @@
 // STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
 // THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
+#include <array>
 #include <atomic>
 #include "gtest/gtest.h"
 #include "misc_language.h"
 #include "common/threadpool.h"
+#include "common/work_stealing_deque.h"
 
 TEST(threadpool, wait_nothing)
 {
@@ -144,3 +146,65 @@ TEST(threadpool, leaf_reentrancy)
   waiter.wait(tpool.get());
   ASSERT_EQ(counter, 500000);
 }
+
+TEST(threadpool, large_callable)
+{
+  std::shared_ptr<tools::threadpool> tpool(tools::threadpool::getNewForUnitTests(4));
+  tools::threadpool::waiter waiter;
+
+  // too large to be stored in the task itself
+  std::array<uint64_t, 64> data;
+  for (size_t i = 0; i < data.size(); ++i)
+    data[i] = i;
+  std::atomic<uint64_t> sum(0);
+  for (int i = 0; i < 100; ++i)
+    tpool->submit(&waiter, [data, &sum](){ for (uint64_t x: data) sum += x; });
+  waiter.wait(tpool.get());
+  ASSERT_EQ(sum, 100 * 63 * 64 / 2);
+}
+
+TEST(work_stealing_deque, steal)
+{
+  static const int N = 100000;
+  tools::work_stealing_deque<int*> deque(2);
+  std::vector<int> items(N, 0);
+  std::atomic<bool> done(false);
+  std::atomic<int> taken(0);
+
+  std::vector<boost::thread> thieves;
+  for (int i = 0; i < 3; ++i)
+  {
+    thieves.push_back(boost::thread([&](){
+      int *x;
+      while (!done || !deque.empty())
+        if (deque.steal(x))
+        {
+          ++*x;
+          ++taken;
+        }
+    }));
+  }
+
+  int *x;
+  for (int i = 0; i < N; ++i)
+  {
+    deque.push(&items[i]);
+    if (i % 3 == 0 && deque.pop(x))
+    {
+      ++*x;
+      ++taken;
+    }
+  }
+  while (deque.pop(x))
+  {
+    ++*x;
+    ++taken;
+  }
+  done = true;
+  for (auto &t: thieves)
+    t.join();
+
+  ASSERT_EQ(taken, N);
+  for (int i = 0; i < N; ++i)
+    ASSERT_EQ(items[i], 1);
+}
@@ -0,0 +1,193 @@
+// Copyright (c) 2018, The Monero Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include "gtest/gtest.h"
+#include "crypto/crypto.h"
+#include "cryptonote_protocol/tx_reconciler.h"
+
+static uint32_t random_element()
+{
+  uint32_t e;
+  do e = crypto::rand<uint32_t>(); while (e == 0);
+  return e;
+}
+
+static cryptonote::tx_reconciler::tx_ptr make_tx()
+{
+  std::shared_ptr<cryptonote::tx_reconciler::tx> tx = std::make_shared<cryptonote::tx_reconciler::tx>();
+  tx->txid = crypto::rand<crypto::hash>();
+  tx->blob = std::string((const char*)&tx->txid, sizeof(tx->txid));
+  return tx;
+}
+
+TEST(tx_sketch, empty)
+{
+  cryptonote::tx_sketch sketch(10);
+  std::vector<uint32_t> elements;
+  ASSERT_TRUE(sketch.decode(elements));
+  ASSERT_TRUE(elements.empty());
+}
+
+TEST(tx_sketch, symmetric_difference)
+{
+  for (size_t n = 1; n <= 40; ++n)
+  {
+    cryptonote::tx_sketch a(40), b(40);
+    for (size_t i = 0; i < 200; ++i)
+    {
+      const uint32_t e = random_element();
+      a.add(e);
+      b.add(e);
+    }
+    std::vector<uint32_t> difference;
+    for (size_t i = 0; i < n; ++i)
+    {
+      difference.push_back(random_element());
+      (i & 1 ? a : b).add(difference.back());
+    }
+    a.merge(b);
+    std::vector<uint32_t> elements;
+    ASSERT_TRUE(a.decode(elements));
+    std::sort(difference.begin(), difference.end());
+    std::sort(elements.begin(), elements.end());
+    ASSERT_EQ(elements, difference);
+  }
+}
+
+TEST(tx_sketch, over_capacity)
+{
+  cryptonote::tx_sketch sketch(16);
+  for (size_t i = 0; i < 24; ++i)
+    sketch.add(random_element());
+  std::vector<uint32_t> elements;
+  ASSERT_FALSE(sketch.decode(elements));
+  ASSERT_TRUE(elements.empty());
+}
+
+TEST(tx_sketch, truncated)
+{
+  cryptonote::tx_sketch large(32), small(8);
+  std::vector<uint32_t> added;
+  for (size_t i = 0; i < 5; ++i)
+  {
+    added.push_back(random_element());
+    large.add(added.back());
+  }
+  small.merge(large);
+  ASSERT_EQ(small.capacity(), 8);
+  std::vector<uint32_t> elements;
+  ASSERT_TRUE(small.decode(elements));
+  std::sort(added.begin(), added.end());
+  std::sort(elements.begin(), elements.end());
+  ASSERT_EQ(elements, added);
+}
+
+TEST(tx_reconciler, reconcile)
+{
+  const boost::uuids::uuid a_to_b = crypto::rand<boost::uuids::uuid>();
+  const boost::uuids::uuid b_to_a = crypto::rand<boost::uuids::uuid>();
+  cryptonote::tx_reconciler a, b;
+
+  std::vector<cryptonote::tx_reconciler::tx_ptr> common, a_only, b_only;
+  for (size_t i = 0; i < 50; ++i)
+    common.push_back(make_tx());
+  for (size_t i = 0; i < 5; ++i)
+    a_only.push_back(make_tx());
+  for (size_t i = 0; i < 3; ++i)
+    b_only.push_back(make_tx());
+  a.add_txs({a_to_b}, common);
+  a.add_txs({a_to_b}, a_only);
+  b.add_txs({b_to_a}, common);
+  b.add_txs({b_to_a}, b_only);
+
+  const uint64_t salt = crypto::rand<uint64_t>();
+  const size_t a_size = a.start_round(a_to_b, salt);
+  ASSERT_EQ(a_size, 55);
+  const size_t b_size = b.start_round(b_to_a, salt);
+  ASSERT_EQ(b_size, 53);
+
+  cryptonote::tx_sketch sketch;
+  ASSERT_TRUE(b.get_sketch(b_to_a, a_size, sketch));
+  std::vector<uint32_t> local_only, remote_only;
+  ASSERT_TRUE(a.reconcile(a_to_b, salt, sketch, b_size, local_only, remote_only));
+  ASSERT_EQ(local_only.size(), a_only.size());
+  ASSERT_EQ(remote_only.size(), b_only.size());
+
+  std::vector<cryptonote::blobdata> txs;
+  b.get_txs(b_to_a, salt, remote_only, txs);
+  ASSERT_EQ(txs.size(), b_only.size());
+  for (const auto &tx: b_only)
+    ASSERT_TRUE(std::find(txs.begin(), txs.end(), tx->blob) != txs.end());
+
+  // the round is still there after the next one starts, but not after that
+  a.start_round(a_to_b, salt + 1);
+  ASSERT_TRUE(a.has_round(a_to_b, salt));
+  a.start_round(a_to_b, salt + 2);
+  ASSERT_FALSE(a.has_round(a_to_b, salt));
+}
+
+TEST(tx_reconciler, too_large)
+{
+  const boost::uuids::uuid id = crypto::rand<boost::uuids::uuid>();
+  cryptonote::tx_reconciler r;
+  std::vector<cryptonote::tx_reconciler::tx_ptr> txs;
+  for (size_t i = 0; i < 1000; ++i)
+    txs.push_back(make_tx());
+  r.add_txs({id}, txs);
+  ASSERT_EQ(r.start_round(id, 0), 1000);
+  cryptonote::tx_sketch sketch;
+  ASSERT_FALSE(r.get_sketch(id, 0, sketch));
+  ASSERT_EQ(r.get_short_ids(id, 0).size(), 1000);
+  r.remove_connection(id);
+  ASSERT_TRUE(r.get_short_ids(id, 0).empty());
+}
+
+TEST(tx_reconciler, oversized_sketch)
+{
+  const boost::uuids::uuid id = crypto::rand<boost::uuids::uuid>();
+  cryptonote::tx_reconciler r;
+  std::vector<cryptonote::tx_reconciler::tx_ptr> txs;
+  for (size_t i = 0; i < 20; ++i)
+    txs.push_back(make_tx());
+  r.add_txs({id}, txs);
+  const uint64_t salt = crypto::rand<uint64_t>();
+  ASSERT_EQ(r.start_round(id, salt), 20);
+
+  // what the peer's get_sketch would have sent for 10 txes is fine
+  const size_t capacity = cryptonote::tx_reconciler::get_sketch_capacity(10, 20);
+  ASSERT_TRUE(r.is_sketch_capacity_valid(id, salt, capacity, 10));
+  ASSERT_FALSE(r.is_sketch_capacity_valid(id, salt, capacity + 1, 10));
+  std::vector<uint32_t> local_only, remote_only;
+  ASSERT_FALSE(r.reconcile(id, salt, cryptonote::tx_sketch(capacity + 1), 10, local_only, remote_only));
+
+  // a peer claiming a huge round still can't go past the decoding limit
+  ASSERT_TRUE(r.is_sketch_capacity_valid(id, salt, 100, 1000000));
+  ASSERT_FALSE(r.is_sketch_capacity_valid(id, salt, 100000, 1000000));
+  ASSERT_FALSE(r.reconcile(id, salt, cryptonote::tx_sketch(100000), 1000000, local_only, remote_only));
+}